@@ -0,0 +1,516 @@
+
+/*
+ * Licensed Materials - Property of IBM
+ *
+ * trousers - An open source TCG Software Stack
+ *
+ * (C) Copyright International Business Machines Corp. 2004-2007
+ *
+ */
+
+/*
+ * marshal-bench: time the blob marshalling routines that sit on every request path, on the
+ * TSP side (Trspi_LoadBlob_* and Trspi_UnloadBlob_*) and the TCS side (tcs_utils.c, tcs_key.c
+ * and the tcsd's setData()/getData()).
+ *
+ * Each case runs for at least the minimum time and prints one line:
+ *
+ *	<case name> <iterations> <ns per op> ns/op
+ *
+ * Case names are stable, so the output of two builds can be compared line by line.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <time.h>
+
+#include "trousers/tss.h"
+#include "trousers/trousers.h"
+#include "trousers_types.h"
+#include "tcs_tsp.h"
+#include "tcs_utils.h"
+#include "tcsd_wrap.h"
+#include "tcsd.h"
+#include "rpc_tcstp_tcs.h"
+
+/* libtcs.a is normally linked into the tcsd, which defines these */
+struct tcsd_config tcsd_options;
+struct tpm_properties tpm_metrics;
+char *tcsd_config_file = NULL;
+
+char
+platform_get_runlevel()
+{
+	return 'u';
+}
+
+#define BENCH_RSA_BYTES		256
+#define BENCH_EVENT_BYTES	64
+#define BENCH_NUM_PCRS		24
+
+struct marshal_case {
+	const char *name;
+	int (*run)(UINT64 iterations);
+};
+
+/* keeps the compiler from dropping the work being timed */
+static volatile UINT64 marshal_sink;
+
+static BYTE rsa_parms[12] = { 0, 0, 0x08, 0, 0, 0, 0, 2, 0, 0, 0, 0 };
+static BYTE key_modulus[BENCH_RSA_BYTES];
+static BYTE key_enc[BENCH_RSA_BYTES];
+static BYTE key_blob[1024];
+static UINT64 key_blob_size;
+
+static BYTE event_data[BENCH_EVENT_BYTES];
+static BYTE event_blob[256];
+static UINT64 event_blob_size;
+
+static BYTE pcr_select[BENCH_NUM_PCRS / 8];
+static BYTE pcr_values[BENCH_NUM_PCRS * TPM_SHA1_160_HASH_LEN];
+static BYTE composite_blob[1024];
+static UINT64 composite_blob_size;
+
+static UINT64
+marshal_now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (UINT64)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+init_tcpa_key(TCPA_KEY *key)
+{
+	memset(key, 0, sizeof(TCPA_KEY));
+	key->ver.major = 1;
+	key->ver.minor = 1;
+	key->keyUsage = TPM_KEY_SIGNING;
+	key->authDataUsage = TPM_AUTH_ALWAYS;
+	key->algorithmParms.algorithmID = TCPA_ALG_RSA;
+	key->algorithmParms.encScheme = TCPA_ES_NONE;
+	key->algorithmParms.sigScheme = TCPA_SS_RSASSAPKCS1v15_SHA1;
+	key->algorithmParms.parmSize = sizeof(rsa_parms);
+	key->algorithmParms.parms = rsa_parms;
+	key->pubKey.keyLength = sizeof(key_modulus);
+	key->pubKey.key = key_modulus;
+	key->encSize = sizeof(key_enc);
+	key->encData = key_enc;
+}
+
+static void
+free_tcpa_key(TCPA_KEY *key)
+{
+	free(key->algorithmParms.parms);
+	free(key->PCRInfo);
+	free(key->pubKey.key);
+	free(key->encData);
+}
+
+static void
+init_blobs()
+{
+	TCPA_KEY key;
+	TSS_PCR_EVENT event;
+	TCPA_PCR_SELECTION select;
+	UINT32 i;
+
+	for (i = 0; i < sizeof(key_modulus); i++) {
+		key_modulus[i] = i * 7;
+		key_enc[i] = i * 13;
+	}
+
+	init_tcpa_key(&key);
+	key_blob_size = 0;
+	Trspi_LoadBlob_KEY(&key_blob_size, key_blob, &key);
+
+	memset(&event, 0, sizeof(event));
+	event.versionInfo.bMajor = 1;
+	event.versionInfo.bMinor = 2;
+	event.ulPcrIndex = 10;
+	event.eventType = TSS_EV_ACTION;
+	event.ulPcrValueLength = TPM_SHA1_160_HASH_LEN;
+	event.rgbPcrValue = pcr_values;
+	event.ulEventLength = sizeof(event_data);
+	event.rgbEvent = event_data;
+	event_blob_size = 0;
+	Trspi_LoadBlob_PCR_EVENT(&event_blob_size, event_blob, &event);
+
+	memset(pcr_select, 0xff, sizeof(pcr_select));
+	select.sizeOfSelect = sizeof(pcr_select);
+	select.pcrSelect = pcr_select;
+	composite_blob_size = 0;
+	Trspi_LoadBlob_PCR_SELECTION(&composite_blob_size, composite_blob, &select);
+	Trspi_LoadBlob_UINT32(&composite_blob_size, sizeof(pcr_values), composite_blob);
+	Trspi_LoadBlob(&composite_blob_size, sizeof(pcr_values), composite_blob, pcr_values);
+}
+
+static int
+bench_trspi_load_key(UINT64 iterations)
+{
+	TCPA_KEY key;
+	BYTE blob[1024];
+	UINT64 i, offset;
+
+	init_tcpa_key(&key);
+	for (i = 0; i < iterations; i++) {
+		offset = 0;
+		Trspi_LoadBlob_KEY(&offset, blob, &key);
+		marshal_sink += offset;
+	}
+
+	return 0;
+}
+
+static int
+bench_trspi_unload_key(UINT64 iterations)
+{
+	TCPA_KEY key;
+	UINT64 i, offset;
+
+	for (i = 0; i < iterations; i++) {
+		offset = 0;
+		if (Trspi_UnloadBlob_KEY(&offset, key_blob, &key))
+			return -1;
+		marshal_sink += offset;
+		free_tcpa_key(&key);
+	}
+
+	return 0;
+}
+
+static int
+bench_tcs_load_key(UINT64 iterations)
+{
+	TSS_KEY key;
+	BYTE blob[1024];
+	UINT64 i, offset = 0;
+
+	if (UnloadBlob_TSS_KEY(&offset, key_blob, &key))
+		return -1;
+
+	for (i = 0; i < iterations; i++) {
+		offset = 0;
+		LoadBlob_TSS_KEY(&offset, blob, &key);
+		marshal_sink += offset;
+	}
+
+	destroy_key_refs(&key);
+
+	return 0;
+}
+
+static int
+bench_tcs_unload_key(UINT64 iterations)
+{
+	TSS_KEY key;
+	UINT64 i, offset;
+
+	for (i = 0; i < iterations; i++) {
+		offset = 0;
+		if (UnloadBlob_TSS_KEY(&offset, key_blob, &key))
+			return -1;
+		marshal_sink += offset;
+		destroy_key_refs(&key);
+	}
+
+	return 0;
+}
+
+static int
+bench_trspi_unload_composite(UINT64 iterations)
+{
+	TCPA_PCR_COMPOSITE composite;
+	UINT64 i, offset;
+
+	for (i = 0; i < iterations; i++) {
+		offset = 0;
+		if (Trspi_UnloadBlob_PCR_COMPOSITE(&offset, composite_blob, &composite))
+			return -1;
+		marshal_sink += offset;
+		free(composite.select.pcrSelect);
+		free(composite.pcrValue);
+	}
+
+	return 0;
+}
+
+static int
+bench_trspi_load_pcr_info_long(UINT64 iterations)
+{
+	TPM_PCR_INFO_LONG info;
+	BYTE blob[256];
+	UINT64 i, offset;
+
+	memset(&info, 0, sizeof(info));
+	info.tag = TPM_TAG_PCR_INFO_LONG;
+	info.localityAtCreation = TPM_LOC_ZERO;
+	info.localityAtRelease = TPM_LOC_ZERO;
+	info.creationPCRSelection.sizeOfSelect = sizeof(pcr_select);
+	info.creationPCRSelection.pcrSelect = pcr_select;
+	info.releasePCRSelection.sizeOfSelect = sizeof(pcr_select);
+	info.releasePCRSelection.pcrSelect = pcr_select;
+
+	for (i = 0; i < iterations; i++) {
+		offset = 0;
+		Trspi_LoadBlob_PCR_INFO_LONG(&offset, blob, &info);
+		marshal_sink += offset;
+	}
+
+	return 0;
+}
+
+static int
+bench_trspi_load_event(UINT64 iterations)
+{
+	TSS_PCR_EVENT event;
+	BYTE blob[256];
+	UINT64 i, offset = 0;
+
+	if (Trspi_UnloadBlob_PCR_EVENT(&offset, event_blob, &event))
+		return -1;
+
+	for (i = 0; i < iterations; i++) {
+		offset = 0;
+		Trspi_LoadBlob_PCR_EVENT(&offset, blob, &event);
+		marshal_sink += offset;
+	}
+
+	free(event.rgbPcrValue);
+	free(event.rgbEvent);
+
+	return 0;
+}
+
+static int
+bench_trspi_unload_event(UINT64 iterations)
+{
+	TSS_PCR_EVENT event;
+	UINT64 i, offset;
+
+	for (i = 0; i < iterations; i++) {
+		offset = 0;
+		if (Trspi_UnloadBlob_PCR_EVENT(&offset, event_blob, &event))
+			return -1;
+		marshal_sink += offset;
+		free(event.rgbPcrValue);
+		free(event.rgbEvent);
+	}
+
+	return 0;
+}
+
+/* the response to a GetPubKey with authorization, as the tcsd sends it */
+static int
+build_getpubkey_response(struct tcsd_comm_data *comm)
+{
+	UINT32 size = BENCH_RSA_BYTES + 28;
+	TPM_AUTH auth;
+
+	memset(&auth, 0x3c, sizeof(auth));
+
+	initData(comm, 3);
+	if (setData(TCSD_PACKET_TYPE_AUTH, 0, &auth, 0, comm) ||
+	    setData(TCSD_PACKET_TYPE_UINT32, 1, &size, 0, comm) ||
+	    setData(TCSD_PACKET_TYPE_PBYTE, 2, key_blob, size, comm))
+		return -1;
+
+	return 0;
+}
+
+/* The request of a LoadKeyByBlob with authorization, as the tcsd receives it. The tcsd's
+ * setData() writes auths in the response layout, which has no handle and the even nonce, so
+ * the auth is written in the request layout by hand */
+static int
+build_loadkey_request(struct tcsd_comm_data *comm)
+{
+	TCS_CONTEXT_HANDLE hContext = 0xa0001234;
+	TCS_KEY_HANDLE hParent = 0x40000000;
+	UINT32 size = key_blob_size;
+	BYTE auth[sizeof(UINT32) + 2 * TPM_SHA1_160_HASH_LEN + sizeof(TSS_BOOL)];
+
+	memset(auth, 0x3c, sizeof(auth));
+
+	initData(comm, 5);
+	if (setData(TCSD_PACKET_TYPE_UINT32, 0, &hContext, 0, comm) ||
+	    setData(TCSD_PACKET_TYPE_UINT32, 1, &hParent, 0, comm) ||
+	    setData(TCSD_PACKET_TYPE_UINT32, 2, &size, 0, comm) ||
+	    setData(TCSD_PACKET_TYPE_PBYTE, 3, key_blob, size, comm) ||
+	    setData(TCSD_PACKET_TYPE_PBYTE, 4, auth, sizeof(auth), comm))
+		return -1;
+
+	comm->buf[comm->hdr.type_offset + 4] = TCSD_PACKET_TYPE_AUTH;
+
+	return 0;
+}
+
+static int
+bench_tcs_setdata(UINT64 iterations)
+{
+	struct tcsd_comm_data comm;
+	UINT64 i;
+	int rc = 0;
+
+	comm.buf_size = TCSD_INIT_TXBUF_SIZE;
+	if ((comm.buf = calloc(1, comm.buf_size)) == NULL)
+		return -1;
+
+	for (i = 0; i < iterations; i++) {
+		if ((rc = build_getpubkey_response(&comm)))
+			break;
+		marshal_sink += comm.hdr.packet_size;
+	}
+
+	free(comm.buf);
+
+	return rc;
+}
+
+static int
+bench_tcs_getdata(UINT64 iterations)
+{
+	struct tcsd_comm_data comm;
+	struct tcsd_packet_hdr hdr;
+	TCS_CONTEXT_HANDLE hContext;
+	TCS_KEY_HANDLE hParent;
+	UINT32 size;
+	BYTE blob[1024];
+	TPM_AUTH auth;
+	UINT64 i;
+	int rc = -1;
+
+	comm.buf_size = TCSD_INIT_TXBUF_SIZE;
+	if ((comm.buf = calloc(1, comm.buf_size)) == NULL)
+		return -1;
+
+	if (build_loadkey_request(&comm))
+		goto done;
+	/* getData() consumes the parameters, so each pass starts from the same header */
+	hdr = comm.hdr;
+
+	for (i = 0; i < iterations; i++) {
+		comm.hdr = hdr;
+		if (getData(TCSD_PACKET_TYPE_UINT32, 0, &hContext, 0, &comm) ||
+		    getData(TCSD_PACKET_TYPE_UINT32, 1, &hParent, 0, &comm) ||
+		    getData(TCSD_PACKET_TYPE_UINT32, 2, &size, 0, &comm) ||
+		    size > sizeof(blob) ||
+		    getData(TCSD_PACKET_TYPE_PBYTE, 3, blob, size, &comm) ||
+		    getData(TCSD_PACKET_TYPE_AUTH, 4, &auth, 0, &comm))
+			goto done;
+		marshal_sink += size;
+	}
+	rc = 0;
+done:
+	free(comm.buf);
+
+	return rc;
+}
+
+static struct marshal_case marshal_cases[] = {
+	{ "Trspi_LoadBlob_KEY/rsa2048", bench_trspi_load_key },
+	{ "Trspi_UnloadBlob_KEY/rsa2048", bench_trspi_unload_key },
+	{ "LoadBlob_TSS_KEY/rsa2048", bench_tcs_load_key },
+	{ "UnloadBlob_TSS_KEY/rsa2048", bench_tcs_unload_key },
+	{ "Trspi_UnloadBlob_PCR_COMPOSITE/24", bench_trspi_unload_composite },
+	{ "Trspi_LoadBlob_PCR_INFO_LONG/24", bench_trspi_load_pcr_info_long },
+	{ "Trspi_LoadBlob_PCR_EVENT/64", bench_trspi_load_event },
+	{ "Trspi_UnloadBlob_PCR_EVENT/64", bench_trspi_unload_event },
+	{ "setData/GetPubKey", bench_tcs_setdata },
+	{ "getData/LoadKeyByBlob", bench_tcs_getdata },
+	{ NULL, NULL }
+};
+
+/* grow the iteration count until a run takes at least min_ns */
+static int
+run_case(struct marshal_case *c, UINT64 min_ns)
+{
+	UINT64 n = 1, start, elapsed;
+	double next;
+
+	for (;;) {
+		start = marshal_now();
+		if (c->run(n)) {
+			printf("%-36s FAILED\n", c->name);
+			return -1;
+		}
+		elapsed = marshal_now() - start;
+
+		if (elapsed >= min_ns || n >= (1ULL << 40))
+			break;
+
+		/* aim 20% past the target so the last pass is rarely short */
+		next = (double)n * 1.2 * min_ns / (elapsed ? elapsed : 1);
+		if (next > n * 100.0)
+			next = n * 100.0;
+		n = (UINT64)next + 1;
+	}
+
+	printf("%-36s %12llu %10.1f ns/op\n", c->name, (unsigned long long)n,
+	       (double)elapsed / n);
+
+	return 0;
+}
+
+static void
+usage(void)
+{
+	fprintf(stderr, "\tusage: marshal-bench [-t ms] [-l] [case ...]\n\n");
+	fprintf(stderr, "\t-t|--time\tminimum run time of each case in ms (default 500)\n");
+	fprintf(stderr, "\t-l|--list\tlist the cases\n");
+	fprintf(stderr, "\t-h|--help\tdisplay this help message\n\n");
+	fprintf(stderr, "\tWith no case names, all cases are run. A name matches every case "
+			"it is a prefix of.\n\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	struct marshal_case *c;
+	UINT64 min_ns = 500 * 1000000ULL;
+	int opt, i, rc = 0, option_index = 0;
+	struct option long_options[] = {
+		{"help", 0, NULL, 'h'},
+		{"time", 1, NULL, 't'},
+		{"list", 0, NULL, 'l'},
+		{0, 0, 0, 0}
+	};
+
+	while ((opt = getopt_long(argc, argv, "ht:l", long_options, &option_index)) != -1) {
+		switch (opt) {
+			case 't':
+				min_ns = strtoull(optarg, NULL, 0) * 1000000ULL;
+				break;
+			case 'l':
+				for (c = marshal_cases; c->name; c++)
+					printf("%s\n", c->name);
+				return 0;
+			case 'h':
+				/* fall through */
+			default:
+				usage();
+				return -1;
+		}
+	}
+
+	init_blobs();
+
+	for (c = marshal_cases; c->name; c++) {
+		if (optind == argc) {
+			rc |= run_case(c, min_ns);
+			continue;
+		}
+
+		for (i = optind; i < argc; i++) {
+			if (!strncmp(c->name, argv[i], strlen(argv[i]))) {
+				rc |= run_case(c, min_ns);
+				break;
+			}
+		}
+	}
+
+	return rc;
+}
@@ -0,0 +1,738 @@
+
+/*
+ * Licensed Materials - Property of IBM
+ *
+ * trousers - An open source TCG Software Stack
+ *
+ * (C) Copyright International Business Machines Corp. 2004-2007
+ *
+ */
+
+/*
+ * tcsd-bench: drive a weighted mix of TSP operations against a tcsd from a number of threads
+ * (and optionally processes), then report throughput and latency percentiles per operation.
+ * Run it against a tcsd on a mock or emulated TPM to compare builds and configurations.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "trousers/tss.h"
+#include "trousers/trousers.h"
+#include "stats_hist.h"
+
+/* Latencies are recorded in microseconds in the log-linear buckets of stats_hist.h, finer
+ * than the TCSD's own, so a percentile is off by at most 1/BENCH_SUB_BUCKETS */
+#define BENCH_SUB_BITS		4
+#define BENCH_SUB_BUCKETS	(1 << BENCH_SUB_BITS)
+#define BENCH_BUCKETS		(BENCH_SUB_BUCKETS * 36)
+
+struct bench_hist {
+	UINT64 count;
+	UINT64 errors;
+	UINT64 total;
+	UINT64 max;
+	TSS_RESULT last_error;
+	UINT64 buckets[BENCH_BUCKETS];
+};
+
+enum bench_op {
+	BENCH_OP_CONTEXT = 0,
+	BENCH_OP_PCRREAD,
+	BENCH_OP_RANDOM,
+	BENCH_OP_SIGN,
+	BENCH_OP_SEAL,
+	BENCH_OP_EVENTLOG,
+	BENCH_NUM_OPS
+};
+
+struct bench_thread {
+	TSS_HCONTEXT hContext;
+	TSS_HTPM hTPM;
+	TSS_HKEY hSRK;
+	TSS_HENCDATA hEncData;
+	TSS_HPOLICY hPolicy;
+	unsigned int seed;
+	UINT32 pcr;
+	TSS_RESULT setup_result;
+	struct bench_hist hist[BENCH_NUM_OPS];
+};
+
+struct bench_op_desc {
+	const char *name;
+	const char *help;
+	TSS_RESULT (*run)(struct bench_thread *);
+	int weight;
+};
+
+static TSS_RESULT bench_context(struct bench_thread *);
+static TSS_RESULT bench_pcrread(struct bench_thread *);
+static TSS_RESULT bench_random(struct bench_thread *);
+static TSS_RESULT bench_sign(struct bench_thread *);
+static TSS_RESULT bench_seal(struct bench_thread *);
+static TSS_RESULT bench_eventlog(struct bench_thread *);
+
+/* the default mix needs neither the SRK secret nor a key */
+static struct bench_op_desc bench_ops[BENCH_NUM_OPS] = {
+	{ "context", "Create, Connect and Close a context", bench_context, 1 },
+	{ "pcrread", "Tspi_TPM_PcrRead", bench_pcrread, 4 },
+	{ "random", "Tspi_TPM_GetRandom of 20 bytes", bench_random, 4 },
+	{ "sign", "LoadKeyByUUID and Tspi_Hash_Sign", bench_sign, 0 },
+	{ "seal", "Tspi_Data_Seal and Tspi_Data_Unseal under the SRK", bench_seal, 0 },
+	{ "eventlog", "Tspi_TPM_GetEventLog", bench_eventlog, 1 },
+};
+
+static TSS_UNICODE *bench_host = NULL;
+static BYTE bench_srk_secret[] = TSS_WELL_KNOWN_SECRET;
+static BYTE *bench_srk_pass = NULL;
+static TSS_UUID bench_key_uuid = { 0x74637364, 0x6265, 0x6e63, 0x68, 0x00,
+				   { 0x00, 0x00, 0x00, 0x00, 0x00, 0x01 } };
+static TSS_UUID bench_srk_uuid = TSS_UUID_SRK;
+static int bench_threads = 1, bench_procs = 1, bench_seconds = 10;
+static UINT64 bench_iterations = 0;
+static int bench_weight_total;
+
+static UINT64
+bench_now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (UINT64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+bench_record(struct bench_hist *hist, UINT64 v, TSS_RESULT result)
+{
+	hist->count++;
+	hist->total += v;
+	hist->buckets[hist_bucket(v, BENCH_SUB_BITS, BENCH_BUCKETS)]++;
+	if (v > hist->max)
+		hist->max = v;
+	if (result) {
+		hist->errors++;
+		hist->last_error = result;
+	}
+}
+
+static void
+bench_merge(struct bench_hist *dst, struct bench_hist *src)
+{
+	UINT32 i;
+
+	dst->count += src->count;
+	dst->errors += src->errors;
+	dst->total += src->total;
+	if (src->max > dst->max)
+		dst->max = src->max;
+	if (src->last_error)
+		dst->last_error = src->last_error;
+	for (i = 0; i < BENCH_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+}
+
+/* the upper bound of the bucket holding the value at p per mille */
+static UINT64
+bench_percentile(struct bench_hist *hist, UINT32 p)
+{
+	return hist_percentile(hist->buckets, BENCH_BUCKETS, BENCH_SUB_BITS, hist->count,
+			       hist->max, p, 1000);
+}
+
+static TSS_RESULT
+bench_connect(TSS_HCONTEXT *hContext)
+{
+	TSS_RESULT result;
+
+	if ((result = Tspi_Context_Create(hContext)))
+		return result;
+
+	if ((result = Tspi_Context_Connect(*hContext, bench_host))) {
+		Tspi_Context_Close(*hContext);
+		return result;
+	}
+
+	return TSS_SUCCESS;
+}
+
+static TSS_RESULT
+bench_set_secret(TSS_HCONTEXT hContext, TSS_HOBJECT hObject, TSS_HPOLICY *hPolicyOut)
+{
+	TSS_HPOLICY hPolicy;
+	TSS_RESULT result;
+
+	if ((result = Tspi_Context_CreateObject(hContext, TSS_OBJECT_TYPE_POLICY,
+						TSS_POLICY_USAGE, &hPolicy)))
+		return result;
+
+	if (bench_srk_pass)
+		result = Tspi_Policy_SetSecret(hPolicy, TSS_SECRET_MODE_PLAIN,
+					       strlen((char *)bench_srk_pass), bench_srk_pass);
+	else
+		result = Tspi_Policy_SetSecret(hPolicy, TSS_SECRET_MODE_SHA1,
+					       sizeof(bench_srk_secret), bench_srk_secret);
+	if (result)
+		return result;
+
+	if ((result = Tspi_Policy_AssignToObject(hPolicy, hObject)))
+		return result;
+
+	if (hPolicyOut)
+		*hPolicyOut = hPolicy;
+
+	return TSS_SUCCESS;
+}
+
+static TSS_RESULT
+bench_load_srk(TSS_HCONTEXT hContext, TSS_HKEY *hSRK)
+{
+	TSS_RESULT result;
+
+	if ((result = Tspi_Context_LoadKeyByUUID(hContext, TSS_PS_TYPE_SYSTEM, bench_srk_uuid,
+						 hSRK)))
+		return result;
+
+	return bench_set_secret(hContext, *hSRK, NULL);
+}
+
+static TSS_RESULT
+bench_context(struct bench_thread *t)
+{
+	TSS_HCONTEXT hContext;
+	TSS_RESULT result;
+
+	if ((result = bench_connect(&hContext)))
+		return result;
+
+	return Tspi_Context_Close(hContext);
+}
+
+static TSS_RESULT
+bench_pcrread(struct bench_thread *t)
+{
+	BYTE *value;
+	UINT32 len;
+	TSS_RESULT result;
+
+	/* the first 8 PCRs exist on every TPM */
+	t->pcr = (t->pcr + 1) % 8;
+	if ((result = Tspi_TPM_PcrRead(t->hTPM, t->pcr, &len, &value)))
+		return result;
+
+	Tspi_Context_FreeMemory(t->hContext, value);
+
+	return TSS_SUCCESS;
+}
+
+static TSS_RESULT
+bench_random(struct bench_thread *t)
+{
+	BYTE *random;
+	TSS_RESULT result;
+
+	if ((result = Tspi_TPM_GetRandom(t->hTPM, 20, &random)))
+		return result;
+
+	Tspi_Context_FreeMemory(t->hContext, random);
+
+	return TSS_SUCCESS;
+}
+
+static TSS_RESULT
+bench_sign(struct bench_thread *t)
+{
+	TSS_HKEY hKey;
+	TSS_HHASH hHash;
+	BYTE digest[20], *sig;
+	UINT32 sigLen;
+	TSS_RESULT result;
+
+	memset(digest, 0x5a, sizeof(digest));
+
+	if ((result = Tspi_Context_LoadKeyByUUID(t->hContext, TSS_PS_TYPE_SYSTEM, bench_key_uuid,
+						 &hKey)))
+		return result;
+
+	if ((result = Tspi_Context_CreateObject(t->hContext, TSS_OBJECT_TYPE_HASH,
+						TSS_HASH_SHA1, &hHash)))
+		goto done;
+
+	if ((result = Tspi_Hash_SetHashValue(hHash, sizeof(digest), digest)) == TSS_SUCCESS &&
+	    (result = Tspi_Hash_Sign(hHash, hKey, &sigLen, &sig)) == TSS_SUCCESS)
+		Tspi_Context_FreeMemory(t->hContext, sig);
+
+	Tspi_Context_CloseObject(t->hContext, hHash);
+done:
+	Tspi_Context_CloseObject(t->hContext, hKey);
+
+	return result;
+}
+
+static TSS_RESULT
+bench_seal(struct bench_thread *t)
+{
+	BYTE data[32], *out;
+	UINT32 outLen;
+	TSS_RESULT result;
+
+	memset(data, 0xa5, sizeof(data));
+
+	if ((result = Tspi_Data_Seal(t->hEncData, t->hSRK, sizeof(data), data, 0)))
+		return result;
+
+	if ((result = Tspi_Data_Unseal(t->hEncData, t->hSRK, &outLen, &out)))
+		return result;
+
+	if (outLen != sizeof(data) || memcmp(out, data, outLen))
+		result = TSS_E_INTERNAL_ERROR;
+
+	Tspi_Context_FreeMemory(t->hContext, out);
+
+	return result;
+}
+
+static TSS_RESULT
+bench_eventlog(struct bench_thread *t)
+{
+	TSS_PCR_EVENT *events;
+	UINT32 num;
+	TSS_RESULT result;
+
+	if ((result = Tspi_TPM_GetEventLog(t->hTPM, &num, &events)))
+		return result;
+
+	if (num)
+		Tspi_Context_FreeMemory(t->hContext, (BYTE *)events);
+
+	return TSS_SUCCESS;
+}
+
+static TSS_RESULT
+bench_thread_init(struct bench_thread *t)
+{
+	TSS_RESULT result;
+
+	if ((result = bench_connect(&t->hContext)))
+		return result;
+
+	if ((result = Tspi_Context_GetTpmObject(t->hContext, &t->hTPM)))
+		return result;
+
+	if (!bench_ops[BENCH_OP_SEAL].weight)
+		return TSS_SUCCESS;
+
+	if ((result = bench_load_srk(t->hContext, &t->hSRK)))
+		return result;
+
+	if ((result = Tspi_Context_CreateObject(t->hContext, TSS_OBJECT_TYPE_ENCDATA,
+						TSS_ENCDATA_SEAL, &t->hEncData)))
+		return result;
+
+	return bench_set_secret(t->hContext, t->hEncData, &t->hPolicy);
+}
+
+static void *
+bench_thread_run(void *arg)
+{
+	struct bench_thread *t = (struct bench_thread *)arg;
+	UINT64 deadline, i, start, end;
+	TSS_RESULT result;
+	int op, pick;
+
+	if ((t->setup_result = result = bench_thread_init(t))) {
+		fprintf(stderr, "thread setup failed: %s\n", Trspi_Error_String(result));
+		if (t->hContext)
+			Tspi_Context_Close(t->hContext);
+		return NULL;
+	}
+
+	deadline = bench_now() + (UINT64)bench_seconds * 1000000;
+	for (i = 0; bench_iterations ? i < bench_iterations : bench_now() < deadline; i++) {
+		pick = rand_r(&t->seed) % bench_weight_total;
+		for (op = 0; pick >= bench_ops[op].weight; op++)
+			pick -= bench_ops[op].weight;
+
+		start = bench_now();
+		result = bench_ops[op].run(t);
+		end = bench_now();
+
+		bench_record(&t->hist[op], end - start, result);
+	}
+
+	Tspi_Context_Close(t->hContext);
+
+	return NULL;
+}
+
+/* run bench_threads threads in this process, merging their results into hist */
+static int
+bench_run(struct bench_hist *hist, UINT64 *elapsed, unsigned int seed)
+{
+	struct bench_thread *threads;
+	pthread_t *ids;
+	UINT64 start;
+	int i, op, rc = 0;
+
+	threads = calloc(bench_threads, sizeof(struct bench_thread));
+	ids = calloc(bench_threads, sizeof(pthread_t));
+	if (threads == NULL || ids == NULL) {
+		fprintf(stderr, "malloc failed\n");
+		free(threads);
+		free(ids);
+		return -1;
+	}
+
+	start = bench_now();
+	for (i = 0; i < bench_threads; i++) {
+		threads[i].seed = seed + i;
+		if (pthread_create(&ids[i], NULL, bench_thread_run, &threads[i])) {
+			fprintf(stderr, "pthread_create: %s\n", strerror(errno));
+			rc = -1;
+			break;
+		}
+	}
+
+	while (i--)
+		pthread_join(ids[i], NULL);
+	*elapsed = bench_now() - start;
+
+	for (i = 0; i < bench_threads; i++) {
+		if (threads[i].setup_result)
+			rc = -1;
+		for (op = 0; op < BENCH_NUM_OPS; op++)
+			bench_merge(&hist[op], &threads[i].hist[op]);
+	}
+
+	free(threads);
+	free(ids);
+
+	return rc;
+}
+
+static int
+bench_read_all(int fd, void *buf, size_t len)
+{
+	ssize_t rc;
+	size_t done = 0;
+
+	while (done < len) {
+		rc = read(fd, (BYTE *)buf + done, len - done);
+		if (rc < 0 && errno == EINTR)
+			continue;
+		if (rc <= 0)
+			return -1;
+		done += rc;
+	}
+
+	return 0;
+}
+
+/* fork bench_procs children, each running bench_run() and sending its results back down
+ * its own pipe, so that the client side isn't limited by one process' locks */
+static int
+bench_run_procs(struct bench_hist *hist, UINT64 *elapsed)
+{
+	struct bench_hist *child;
+	int i, n, op, fds[2], *readfds, rc = 0;
+	UINT64 child_elapsed;
+	pid_t pid;
+
+	child = calloc(BENCH_NUM_OPS, sizeof(struct bench_hist));
+	readfds = calloc(bench_procs, sizeof(int));
+	if (child == NULL || readfds == NULL) {
+		fprintf(stderr, "malloc failed\n");
+		free(child);
+		free(readfds);
+		return -1;
+	}
+
+	for (n = 0; n < bench_procs; n++) {
+		if (pipe(fds)) {
+			fprintf(stderr, "pipe: %s\n", strerror(errno));
+			rc = -1;
+			break;
+		}
+
+		if ((pid = fork()) < 0) {
+			fprintf(stderr, "fork: %s\n", strerror(errno));
+			close(fds[0]);
+			close(fds[1]);
+			rc = -1;
+			break;
+		} else if (pid == 0) {
+			close(fds[0]);
+			if (bench_run(child, &child_elapsed, getpid()) ||
+			    write(fds[1], &child_elapsed, sizeof(child_elapsed)) < 0 ||
+			    write(fds[1], child, BENCH_NUM_OPS * sizeof(struct bench_hist)) < 0)
+				_exit(1);
+			_exit(0);
+		}
+
+		close(fds[1]);
+		readfds[n] = fds[0];
+	}
+
+	*elapsed = 0;
+	for (i = 0; i < n; i++) {
+		if (bench_read_all(readfds[i], &child_elapsed, sizeof(child_elapsed)) ||
+		    bench_read_all(readfds[i], child, BENCH_NUM_OPS * sizeof(struct bench_hist))) {
+			fprintf(stderr, "lost the results of a benchmark process\n");
+			rc = -1;
+		} else {
+			if (child_elapsed > *elapsed)
+				*elapsed = child_elapsed;
+			for (op = 0; op < BENCH_NUM_OPS; op++)
+				bench_merge(&hist[op], &child[op]);
+		}
+		close(readfds[i]);
+	}
+
+	while (wait(NULL) > 0)
+		;
+	free(child);
+	free(readfds);
+
+	return rc;
+}
+
+static void
+bench_report(struct bench_hist *hist, UINT64 elapsed)
+{
+	struct bench_hist all;
+	double secs = elapsed / 1000000.0;
+	int op;
+
+	memset(&all, 0, sizeof(all));
+
+	printf("%d process(es) x %d thread(s), %.2f seconds\n\n", bench_procs, bench_threads,
+	       secs);
+	printf("%-10s %10s %8s %10s %9s %9s %9s %9s %9s\n", "op", "count", "errors", "ops/s",
+	       "mean(us)", "p50(us)", "p90(us)", "p99(us)", "max(us)");
+
+	for (op = 0; op <= BENCH_NUM_OPS; op++) {
+		struct bench_hist *h = op < BENCH_NUM_OPS ? &hist[op] : &all;
+
+		if (!h->count)
+			continue;
+
+		printf("%-10s %10llu %8llu %10.1f %9llu %9llu %9llu %9llu %9llu\n",
+		       op < BENCH_NUM_OPS ? bench_ops[op].name : "total",
+		       (unsigned long long)h->count, (unsigned long long)h->errors,
+		       h->count / secs, (unsigned long long)(h->total / h->count),
+		       (unsigned long long)bench_percentile(h, 500),
+		       (unsigned long long)bench_percentile(h, 900),
+		       (unsigned long long)bench_percentile(h, 990),
+		       (unsigned long long)h->max);
+
+		if (op < BENCH_NUM_OPS)
+			bench_merge(&all, h);
+	}
+
+	for (op = 0; op < BENCH_NUM_OPS; op++) {
+		if (hist[op].errors)
+			fprintf(stderr, "%s: last error %s\n", bench_ops[op].name,
+				Trspi_Error_String(hist[op].last_error));
+	}
+}
+
+/* create the signing key used by the sign operation and register it in system PS */
+static TSS_RESULT
+bench_key_setup(TSS_HCONTEXT hContext, int keep_key)
+{
+	TSS_HKEY hSRK, hKey;
+	TSS_RESULT result;
+
+	if (keep_key && !Tspi_Context_LoadKeyByUUID(hContext, TSS_PS_TYPE_SYSTEM, bench_key_uuid,
+						    &hKey))
+		return TSS_SUCCESS;
+
+	if ((result = bench_load_srk(hContext, &hSRK)))
+		return result;
+
+	if ((result = Tspi_Context_CreateObject(hContext, TSS_OBJECT_TYPE_RSAKEY,
+						TSS_KEY_TYPE_SIGNING | TSS_KEY_SIZE_2048 |
+						TSS_KEY_NO_AUTHORIZATION, &hKey)))
+		return result;
+
+	if ((result = Tspi_Key_CreateKey(hKey, hSRK, 0)))
+		return result;
+
+	/* left behind by an earlier run that didn't finish */
+	Tspi_Context_UnregisterKey(hContext, TSS_PS_TYPE_SYSTEM, bench_key_uuid, &hSRK);
+
+	return Tspi_Context_RegisterKey(hContext, hKey, TSS_PS_TYPE_SYSTEM, bench_key_uuid,
+					TSS_PS_TYPE_SYSTEM, bench_srk_uuid);
+}
+
+static int
+bench_parse_mix(char *mix)
+{
+	char *entry, *value, *save = NULL;
+	int op;
+
+	for (op = 0; op < BENCH_NUM_OPS; op++)
+		bench_ops[op].weight = 0;
+
+	for (entry = strtok_r(mix, ",", &save); entry; entry = strtok_r(NULL, ",", &save)) {
+		if ((value = strchr(entry, '=')) != NULL)
+			*value++ = '\0';
+
+		for (op = 0; op < BENCH_NUM_OPS; op++) {
+			if (!strcmp(entry, bench_ops[op].name))
+				break;
+		}
+		if (op == BENCH_NUM_OPS) {
+			fprintf(stderr, "unknown operation \"%s\"\n", entry);
+			return -1;
+		}
+
+		bench_ops[op].weight = value ? atoi(value) : 1;
+		if (bench_ops[op].weight < 0) {
+			fprintf(stderr, "bad weight for \"%s\"\n", entry);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static void
+usage(void)
+{
+	int op;
+
+	fprintf(stderr, "\tusage: tcsd-bench [-t threads] [-p processes] [-d seconds | "
+			"-n iterations]\n\t\t[-m op[=weight],...] [-H host] [-s srk secret] "
+			"[-k]\n\n");
+	fprintf(stderr, "\t-t|--threads\tthreads per process, each with its own context "
+			"(default 1)\n");
+	fprintf(stderr, "\t-p|--processes\tnumber of processes (default 1)\n");
+	fprintf(stderr, "\t-d|--duration\tseconds to run for (default 10)\n");
+	fprintf(stderr, "\t-n|--iterations\toperations per thread, instead of a duration\n");
+	fprintf(stderr, "\t-m|--mix\tweighted operation mix (default "
+			"context=1,pcrread=4,random=4,eventlog=1)\n");
+	fprintf(stderr, "\t-H|--host\ttcsd host name (default localhost, the port is "
+			"taken from TSS_TCSD_PORT)\n");
+	fprintf(stderr, "\t-s|--srk-secret\tSRK secret for sign and seal (default the well "
+			"known secret)\n");
+	fprintf(stderr, "\t-k|--keep-key\tleave the signing key registered after the run "
+			"and reuse it next time\n");
+	fprintf(stderr, "\t-h|--help\tdisplay this help message\n\n");
+	fprintf(stderr, "\toperations:\n");
+	for (op = 0; op < BENCH_NUM_OPS; op++)
+		fprintf(stderr, "\t  %-10s%s\n", bench_ops[op].name, bench_ops[op].help);
+	fprintf(stderr, "\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	struct bench_hist *hist;
+	TSS_HCONTEXT hContext = 0;
+	TSS_HKEY hKey;
+	TSS_RESULT result;
+	UINT64 elapsed;
+	unsigned len;
+	int c, op, rc, keep_key = 0, option_index = 0;
+	struct option long_options[] = {
+		{"help", 0, NULL, 'h'},
+		{"threads", 1, NULL, 't'},
+		{"processes", 1, NULL, 'p'},
+		{"duration", 1, NULL, 'd'},
+		{"iterations", 1, NULL, 'n'},
+		{"mix", 1, NULL, 'm'},
+		{"host", 1, NULL, 'H'},
+		{"srk-secret", 1, NULL, 's'},
+		{"keep-key", 0, NULL, 'k'},
+		{0, 0, 0, 0}
+	};
+
+	while ((c = getopt_long(argc, argv, "ht:p:d:n:m:H:s:k", long_options,
+				&option_index)) != -1) {
+		switch (c) {
+			case 't':
+				bench_threads = atoi(optarg);
+				break;
+			case 'p':
+				bench_procs = atoi(optarg);
+				break;
+			case 'd':
+				bench_seconds = atoi(optarg);
+				break;
+			case 'n':
+				bench_iterations = strtoull(optarg, NULL, 0);
+				break;
+			case 'm':
+				if (bench_parse_mix(optarg))
+					return -1;
+				break;
+			case 'H':
+				len = strlen(optarg) + 1;
+				bench_host = (TSS_UNICODE *)Trspi_Native_To_UNICODE((BYTE *)optarg,
+										   &len);
+				break;
+			case 's':
+				bench_srk_pass = (BYTE *)optarg;
+				break;
+			case 'k':
+				keep_key = 1;
+				break;
+			case 'h':
+				/* fall through */
+			default:
+				usage();
+				return -1;
+		}
+	}
+
+	for (op = 0, bench_weight_total = 0; op < BENCH_NUM_OPS; op++)
+		bench_weight_total += bench_ops[op].weight;
+
+	if (bench_threads < 1 || bench_procs < 1 || bench_seconds < 1 || !bench_weight_total) {
+		usage();
+		return -1;
+	}
+
+	if (bench_ops[BENCH_OP_SIGN].weight) {
+		if ((result = bench_connect(&hContext)) ||
+		    (result = bench_key_setup(hContext, keep_key))) {
+			fprintf(stderr, "creating the signing key failed: %s\n",
+				Trspi_Error_String(result));
+			if (hContext)
+				Tspi_Context_Close(hContext);
+			return -1;
+		}
+	}
+
+	if ((hist = calloc(BENCH_NUM_OPS, sizeof(struct bench_hist))) == NULL) {
+		fprintf(stderr, "malloc failed\n");
+		return -1;
+	}
+
+	if (bench_procs > 1)
+		rc = bench_run_procs(hist, &elapsed);
+	else
+		rc = bench_run(hist, &elapsed, time(NULL));
+
+	bench_report(hist, elapsed);
+
+	if (hContext) {
+		if (!keep_key)
+			Tspi_Context_UnregisterKey(hContext, TSS_PS_TYPE_SYSTEM, bench_key_uuid,
+						   &hKey);
+		Tspi_Context_Close(hContext);
+	}
+
+	free(hist);
+
+	return rc;
+}
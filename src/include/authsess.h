@@ -40,6 +40,7 @@ struct authsess {
 	TPM_NONCE nonceOddxSAP;
 	TPM_NONCE nonceEvenxSAP;
 	TPM_HMAC sharedSecret;
+	Trspi_HMACKey sharedSecretKey;
 
 	//MUTEX_DECLARE(lock);
 	//struct authsess *next;
@@ -130,6 +130,16 @@ void bi_release(void);
 /* return >0 if the library was initialized */
 int bi_is_initialized(void);
 
+/* prepare a thread other than the one that called bi_init for computing with the library.
+ With openssl this is also done on the thread's first computation, and what it allocated is
+ released when the thread exits.
+ The format functions and the random functions remain for a single thread at a time.
+ return 0 on failure */
+int bi_thread_init(void);
+
+/* release what bi_thread_init allocated for the calling thread */
+void bi_thread_release(void);
+
 /* free the list of internally allocated memory, usually used for the format functions */
 void bi_flush_memory(void);
 
@@ -352,6 +362,68 @@ bi_ptr bi_multi_mod_exp( bi_ptr result,
 			const long e[],
 			const int m);
 
+/*
+simultaneous multi-exponentiation with full size exponents
+<result> := ( <g>[0] ^ <e>[0] * ... * <g>[<n>-1] ^ <e>[<n>-1] ) mod <m>
+The squarings are shared between all the bases (Straus, or Pippenger for many bases), which
+is much cheaper than <n> bi_mod_exp. Entries with a NULL base or exponent are skipped, and
+the exponents must not be negative. Return NULL on failure.
+*/
+bi_ptr bi_mod_multi_exp( bi_ptr result,
+			const int n,
+			const bi_ptr g[],
+			const bi_ptr e[],
+			const bi_ptr m);
+
+/***********************************************************************************
+	MODULUS CONTEXT
+*************************************************************************************/
+
+/* what a backend precomputes for a modulus that many exponentiations use, the Montgomery
+ parameters for openssl */
+typedef struct _bi_mod_ctx *bi_mod_ctx_ptr;
+
+/* create the context of modulus <m>. return NULL on failure */
+bi_mod_ctx_ptr bi_mod_ctx_new( const bi_ptr m);
+
+/* free the context <mc> */
+void bi_mod_ctx_free( bi_mod_ctx_ptr mc);
+
+/* <result> := ( <g> ^ <e> ) mod m, m the modulus of <mc>, as bi_mod_exp would do it */
+bi_ptr bi_mod_exp_ctx( bi_ptr result, const bi_ptr g, const bi_ptr e, bi_mod_ctx_ptr mc);
+
+/***********************************************************************************
+	FIXED BASE EXPONENTIATION
+*************************************************************************************/
+
+/* window width of the fixed base tables, in bits */
+#define BI_FIXED_BASE_WINDOW 6
+
+/* precomputed powers of a base that is exponentiated many times with the same modulus */
+typedef struct _bi_fixed_base *bi_fixed_base_ptr;
+
+/*
+create the table of <g> mod <m> for exponents of up to <bits> bits. It takes about the time
+of one bi_mod_exp and ( <bits> / BI_FIXED_BASE_WINDOW ) numbers the size of <m>.
+return NULL on failure
+*/
+bi_fixed_base_ptr bi_fixed_base_new( const bi_ptr g, const bi_ptr m, const long bits);
+
+/* free the table <fb> */
+void bi_fixed_base_free( bi_fixed_base_ptr fb);
+
+/*
+<result> := ( base of <fb>[0] ^ <e>[0] * ... * base of <fb>[<n>-1] ^ <e>[<n>-1] ) mod m
+All the tables must have the same modulus m. This needs no squaring, which makes it several
+times cheaper than bi_mod_multi_exp. Entries with a NULL table or exponent are skipped,
+exponents longer than their table are still handled but at the cost of bi_mod_multi_exp.
+return NULL on failure
+*/
+bi_ptr bi_fixed_base_multi_exp( bi_ptr result,
+				const int n,
+				bi_fixed_base_ptr fb[],
+				const bi_ptr e[]);
+
 /***********************************************************************************
 	COMPARAISON
 *************************************************************************************/
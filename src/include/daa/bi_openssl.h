@@ -18,7 +18,16 @@ typedef struct bignum_st bi_t[1];
 
 typedef struct bignum_st *bi_ptr;
 
-extern BN_CTX *context;
+/* the calling thread's BN_CTX, only to be reached through bi_ctx */
+extern __thread BN_CTX *context;
+
+int bi_thread_init(void);
+
+/* return the calling thread's BN_CTX, created on the thread's first computation */
+INLINE_DECL BN_CTX *bi_ctx(void) {
+	if( context == NULL) bi_thread_init();
+	return context;
+}
 
 
 INLINE_DECL bi_ptr bi_new(bi_ptr result) {
@@ -76,7 +85,7 @@ INLINE_DECL bi_ptr bi_mul_si( bi_ptr result, const bi_ptr i, const long n) {
 
 /*  <result> := <i> * <n>   */
 INLINE_DECL bi_ptr bi_mul( bi_ptr result, const bi_ptr i, const bi_ptr n) {
-	BN_mul( result, i, n, context);
+	BN_mul( result, i, n, bi_ctx());
 	return result;
 }
 
@@ -108,7 +117,7 @@ INLINE_DECL bi_ptr bi_sub( bi_ptr result, const bi_ptr i, const bi_ptr n) {
 
 /*  <result> := ( <g> ^ <e> ) mod <m>  */
 INLINE_DECL bi_ptr bi_mod_exp( bi_ptr result, const bi_ptr g, const bi_ptr e, const bi_ptr m) {
-	BN_mod_exp( result, g, e, m, context);	// result := (g ^ e) mod bi_m
+	BN_mod_exp( result, g, e, m, bi_ctx());	// result := (g ^ e) mod bi_m
 	return result;
 }
 
@@ -122,7 +131,7 @@ INLINE_DECL bi_ptr bi_div_si( bi_ptr result, const bi_ptr i, const long n) {
 
 /*  <result> := <i> / <n>   */
 INLINE_DECL bi_ptr bi_div( bi_ptr result, const bi_ptr i, const bi_ptr n) {
-	BN_div( result, NULL, i, n, context);
+	BN_div( result, NULL, i, n, bi_ctx());
 	return result;
 }
 
@@ -305,14 +314,14 @@ INLINE_DECL bi_ptr bi_urandom( bi_ptr result, const long length) {
 INLINE_DECL bi_ptr bi_mod_si( bi_ptr result, const bi_ptr n, const long m) {
 	BIGNUM *mod = BN_new();
 	BN_set_word( mod, m);
-	BN_mod( result, n, mod, context);
+	BN_mod( result, n, mod, bi_ctx());
 	BN_free( mod);
 	return result;
 }
 
 /* res := <n> mod <m> */
 INLINE_DECL bi_ptr bi_mod( bi_ptr result, const bi_ptr n, const bi_ptr m) {
-	BN_mod( result, n, m, context);
+	BN_mod( result, n, m, bi_ctx());
 	if( result->neg == 1) {
 		result->neg=0;
 		BN_sub( result, m, result);
@@ -324,7 +333,7 @@ INLINE_DECL bi_ptr bi_mod( bi_ptr result, const bi_ptr n, const bi_ptr m) {
 /* if the inverse exist, return >0, otherwise 0 */
 INLINE_DECL int bi_invert_mod( bi_ptr result, const bi_ptr i, const bi_ptr m) {
 	while( ERR_get_error() != 0);
-	BN_mod_inverse( result, i, m, context);
+	BN_mod_inverse( result, i, m, bi_ctx());
 	return ERR_get_error() == 0 ? 1 : 0;
 }
 
@@ -344,7 +353,7 @@ INLINE_DECL bi_ptr bi_generate_safe_prime( bi_ptr result, const long bit_length)
 /* return in <result> the greatest common divisor of <a> and <b> */
 /* <result> := gcd( <a>, <b>) */
 INLINE_DECL bi_ptr bi_gcd( bi_ptr result, bi_ptr a, bi_ptr b) {
-	BN_gcd( result, a, b, context);
+	BN_gcd( result, a, b, bi_ctx());
 	return result;
 }
 
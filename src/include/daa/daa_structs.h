@@ -126,6 +126,26 @@ DAA_PRIVATE_KEY_internal *e_2_i_TSS_DAA_PRIVATE_KEY(
  *   TSS_DAA_PK
  ********************************************************************************************/
 
+/* the fixed base tables and the modulus contexts of an issuer public key, built the first
+ * time one of its keys needs them and kept for every later TSS_DAA_PK_internal of the same
+ * key */
+typedef struct tdTSS_DAA_PK_TABLES {
+	bi_ptr modulus;
+	bi_ptr capitalGamma;
+	bi_ptr capitalS;
+	bi_ptr capitalR0;
+	bi_ptr capitalR1;
+	bi_array_ptr capitalY;
+	bi_fixed_base_ptr fixedS;
+	bi_fixed_base_ptr fixedR0;
+	bi_fixed_base_ptr fixedR1;
+	bi_fixed_base_ptr *fixedY;
+	bi_mod_ctx_ptr modModulus;
+	bi_mod_ctx_ptr modGamma;
+	int refs;
+	struct tdTSS_DAA_PK_TABLES *next;
+} TSS_DAA_PK_TABLES;
+
 typedef struct tdTSS_DAA_PK_internal {
 	bi_ptr modulus;
 	bi_ptr capitalS;
@@ -143,6 +163,8 @@ typedef struct tdTSS_DAA_PK_internal {
  	// capitalSprime calculated at each init of this structure as :
  	//    (capitalS ^ ( 1 << DAA_PARAM_SIZE_SPLIT_EXPONENT)) % modulus
 	bi_ptr capitalSprime;
+	// NULL until get_DAA_PK_tables() is called
+	TSS_DAA_PK_TABLES *tables;
 } TSS_DAA_PK_internal;
 
 TSS_DAA_PK_internal *create_DAA_PK(
@@ -198,6 +220,51 @@ void free_TSS_DAA_PK_internal(
 	TSS_DAA_PK_internal *pk_internal
 );
 
+/*
+ * return the fixed base tables of the key, shared with every other TSS_DAA_PK_internal of
+ * the same issuer key, or NULL if they can not be built
+ */
+TSS_DAA_PK_TABLES *get_DAA_PK_tables(
+	TSS_DAA_PK_internal *pk_internal
+);
+
+/*
+ * result := ( capitalS ^ eS * capitalR0 ^ eR0 * capitalR1 ^ eR1 *
+ *		prod( capitalY[i] ^ eY[i]) ) % modulus
+ * with the fixed base tables of the key when they are available. NULL exponents are skipped,
+ * eY has eYLength entries for the first capitalY. return NULL on failure
+ */
+bi_ptr DAA_PK_fixed_base_exp(
+	bi_ptr result,
+	TSS_DAA_PK_internal *pk_internal,
+	bi_ptr eS,
+	bi_ptr eR0,
+	bi_ptr eR1,
+	int eYLength,
+	bi_ptr *eY
+);
+
+/*
+ * result := ( g ^ e ) % modulus, with the modulus context of the key when it is available
+ */
+bi_ptr DAA_PK_mod_exp(
+	bi_ptr result,
+	TSS_DAA_PK_internal *pk_internal,
+	bi_ptr g,
+	bi_ptr e
+);
+
+/*
+ * result := ( g ^ e ) % capitalGamma, with the modulus context of the key when it is
+ * available
+ */
+bi_ptr DAA_PK_gamma_mod_exp(
+	bi_ptr result,
+	TSS_DAA_PK_internal *pk_internal,
+	bi_ptr g,
+	bi_ptr e
+);
+
 void free_TSS_DAA_PK( TSS_DAA_PK *pk);
 
 BYTE *issuer_2_byte_array(
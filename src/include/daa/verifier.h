@@ -86,6 +86,37 @@ Tspi_DAA_VerifySignature
 
 #endif
 
+TSPICALL Tspi_DAA_VerifySignatures_internal
+(	TSS_HDAA hDAA,	// in
+	UINT32 signaturesLength,	// in
+	TSS_DAA_SIGNATURE *signatures,	// in
+	TSS_HKEY hPubKeyIssuer,	// in
+	TSS_DAA_SIGN_DATA *sign_data,	// in
+	UINT32 attributesLength,	// in
+	BYTE ***attributes,	// in
+	UINT32 *nonce_verifierLength,	// in
+	BYTE **nonce_verifier,	// in
+	UINT32 base_nameLength,	// in
+	BYTE *base_name,	// in
+	TSS_BOOL *isCorrect	// out
+);
+
+TSPICALL Tspi_DAA_VerifySignatures
+(
+    TSS_HDAA                      hDAA,                          // in
+    UINT32                        signaturesLength,              // in
+    TSS_DAA_SIGNATURE*            daaSignatures,                 // in
+    TSS_HKEY                      hPubKeyIssuer,                 // in (TSS_DAA_PK)
+    TSS_DAA_SIGN_DATA*            signData,                      // in
+    UINT32                        attributesLength,              // in
+    BYTE***                       attributes,                    // in
+    UINT32*                       nonceVerifierLength,           // in
+    BYTE**                        nonceVerifier,                 // in
+    UINT32                        baseNameLength,                // in
+    BYTE*                         baseName,                      // in
+    TSS_BOOL*                     isCorrect                      // out
+);
+
 BYTE *compute_sign_challenge_host(
 	int *result_length,
 	EVP_MD *digest,
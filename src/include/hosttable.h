@@ -17,20 +17,26 @@
 
 #define CONNECTION_TYPE_TCP_PERSISTANT	1
 
+/* number of hash buckets in the host table, must be a power of 2 */
+#define HOST_TABLE_BUCKETS	32
+
 struct host_table_entry {
-	struct host_table_entry *next;
+	struct host_table_entry *next;	/* next entry in the same bucket */
 	TSS_HCONTEXT tspContext;
 	TCS_CONTEXT_HANDLE tcsContext;
 	BYTE *hostname;
 	int type;
 	int socket;
 	struct tcsd_comm_data comm;
+	TSS_BOOL no_batch;	/* the TCSD rejected TCSD_ORD_BATCH */
 	MUTEX_DECLARE(lock);
 };
 
+/* Entries are hashed by TSP context. The table lock only protects the buckets, each entry's
+ * lock is held by whoever is using its connection */
 struct host_table {
-	struct host_table_entry *entries;
-	MUTEX_DECLARE(lock);
+	struct host_table_entry *entries[HOST_TABLE_BUCKETS];
+	RWLOCK_DECLARE(lock);
 };
 
 struct host_table_entry *get_table_entry(TCS_CONTEXT_HANDLE);
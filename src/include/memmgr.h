@@ -12,26 +12,58 @@
 #define _MEMMGR_H_
 
 /*
- * For each TSP context, there is one memTable, which holds a list of memEntry's,
- * each of which holds a pointer to some malloc'd memory that's been returned to
- * the user. The memTable also can point to other memTable's which would be
- * created if multiple TSP contexts were opened.
+ * For each TSP context, there is one memTable, which holds a memEntry for each piece of
+ * memory that's been returned to the user. The entries are hashed by pointer so that a
+ * single buffer can be found and freed without walking everything the context has
+ * handed out. The tables themselves are hashed by context handle.
  *
+ * Small allocations are carved out of larger arena chunks owned by the table, with the
+ * memEntry in front of the user's memory. A chunk is freed once everything allocated
+ * from it has been freed. Larger allocations get their own calloc'd block, again with the
+ * entry in front. Memory allocated elsewhere and handed to __tspi_add_mem_entry() gets a
+ * separately allocated entry.
  */
 
+#define MEM_TABLE_BUCKETS	16
+#define MEM_ENTRY_MIN_BUCKETS	64
+#define MEM_CHUNK_SIZE		8192
+#define MEM_CHUNK_MAX_ALLOC	512
+#define MEM_ALIGN		16
+#define MEM_ALIGN_UP(x)		(((x) + MEM_ALIGN - 1) & ~(MEM_ALIGN - 1))
+
+/* where the memory behind a memEntry came from */
+#define MEM_ENTRY_CHUNK		0	/* bump allocated from a memChunk */
+#define MEM_ENTRY_BLOCK		1	/* entry and memory are one calloc'd block */
+#define MEM_ENTRY_EXTERNAL	2	/* memory passed in to __tspi_add_mem_entry() */
+
+struct memChunk {
+	struct memChunk *prev, *next;
+	UINT32 used;		/* bytes handed out so far */
+	UINT32 live;		/* allocations not yet freed */
+};
+
 struct memEntry {
 	void *memPointer;
+	struct memChunk *chunk;
+	UINT32 type;
 	struct memEntry *nextEntry;
 };
 
 struct memTable {
 	TSS_HCONTEXT tspContext;
-	struct memEntry *entries;
+	MUTEX_DECLARE(lock);
+	struct memEntry **entries;
+	UINT32 numBuckets;
+	UINT32 numEntries;
+	struct memChunk *chunks;	/* the first chunk is the one being allocated from */
 	struct memTable *nextTable;
 };
 
-MUTEX_DECLARE_INIT(memtable_lock);
+/* memtable_lock protects the table hash, each table's lock protects its own entries. A
+ * reader looking up a table takes the table's lock before dropping memtable_lock, so a
+ * writer freeing the table can be sure no one is still using it */
+RWLOCK_DECLARE_INIT(memtable_lock);
 
-struct memTable *SpiMemoryTable = NULL;
+struct memTable *SpiMemoryTable[MEM_TABLE_BUCKETS];
 
 #endif
@@ -28,18 +28,31 @@
 /* When TRUE, the key has been created and cannot be altered */
 #define TSS_OBJ_FLAG_KEY_SET	0x00000020
 
+/* number of hash buckets in each object list, must be a power of 2 */
+#define OBJ_LIST_BUCKETS	64
+
 /* structures */
 struct tsp_object {
 	UINT32 handle;
 	UINT32 tspContext;
 	TSS_FLAG flags;
 	void *data;
-	struct tsp_object *next;
+	struct tsp_object *next;	/* all objects in the list */
+	struct tsp_object *hash_next;	/* objects in the same hash bucket */
+	UINT32 refs;			/* protected by the list's lock */
+	TSS_BOOL removed;		/* protected by the object's lock */
+	MUTEX_DECLARE(lock);		/* held while a caller is using the object */
 };
 
+/* The list's lock only protects membership and reference counts. A caller of
+ * obj_list_get_obj() holds just that object's lock until obj_list_put(), so unrelated
+ * objects in the same list can be used concurrently. Code walking the list under its lock
+ * must take each object's lock before touching its data. */
 struct obj_list {
 	struct tsp_object *head;
+	struct tsp_object *buckets[OBJ_LIST_BUCKETS];
 	MUTEX_DECLARE(lock);
+	pthread_key_t held;		/* the object this thread got from the list */
 };
 
 /* prototypes */
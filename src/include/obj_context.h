@@ -38,6 +38,7 @@ struct tr_context_obj {
 	TPM_TRANSPORT_PUBLIC transPub;
 	TPM_MODIFIER_INDICATOR transMod;
 	TPM_TRANSPORT_AUTH transSecret;
+	Trspi_HMACKey transSecretKey;
 	TPM_AUTH transAuth;
 	TPM_TRANSPORT_LOG_IN transLogIn;
 	TPM_TRANSPORT_LOG_OUT transLogOut;
@@ -37,6 +37,8 @@ struct tr_nvstore_obj {
 	TPM_BOOL bWriteDefine;
 	UINT32 dataSize;
 	TSS_HPOLICY policy;
+	UINT32 dataPublicSize;	/* TPM_NV_DATA_PUBLIC of nvIndex as last read from the TPM, */
+	BYTE *dataPublic;	/* or NULL */
 };
 
 /* obj_nv.c */
@@ -55,6 +57,7 @@ TSS_RESULT obj_nvstore_get_permission(TSS_HNVSTORE, UINT32 *);
 TSS_RESULT obj_nvstore_set_policy(TSS_HNVSTORE, TSS_HPOLICY);
 TSS_RESULT obj_nvstore_get_policy(TSS_HNVSTORE, UINT32, TSS_HPOLICY *);
 TSS_RESULT obj_nvstore_get_datapublic(TSS_HNVSTORE, UINT32 *, BYTE *);
+void       obj_nvstore_invalidate_datapublic(TPM_NV_INDEX);
 TSS_RESULT obj_nvstore_get_readdigestatrelease(TSS_HNVSTORE, UINT32 *, BYTE **);
 TSS_RESULT obj_nvstore_get_readpcrselection(TSS_HNVSTORE, UINT32 *, BYTE **);
 TSS_RESULT obj_nvstore_get_writedigestatrelease(TSS_HNVSTORE, UINT32 *, BYTE **);
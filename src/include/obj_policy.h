@@ -20,6 +20,7 @@ struct tr_policy_obj {
 	UINT32 SecretTimeStamp;
 	UINT32 SecretSize;
 	BYTE Secret[20];
+	Trspi_HMACKey SecretHmacKey;	/* cached key schedule for Secret, if set */
 	UINT32 type;
 	BYTE *popupString;
 	UINT32 popupStringLength;
@@ -120,6 +121,8 @@ TSS_RESULT obj_policy_get_tsp_context(TSS_HPOLICY, TSS_HCONTEXT *);
 #define TR_SECRET_CTX_NOT_NEW	FALSE
 TSS_RESULT obj_policy_get_secret(TSS_HPOLICY, TSS_BOOL, TCPA_SECRET *);
 TSS_RESULT obj_policy_flush_secret(TSS_HPOLICY);
+TSS_RESULT obj_policy_hmac_secret(TSS_HPOLICY, TSS_BOOL, UINT32, BYTE *, BYTE *);
+TSS_RESULT policy_secret_hmac(struct tr_policy_obj *, UINT32, BYTE *, BYTE *);
 TSS_RESULT obj_policy_set_secret_object(TSS_HPOLICY, TSS_FLAG, UINT32,
 					TCPA_DIGEST *, TSS_BOOL);
 TSS_RESULT obj_policy_set_secret(TSS_HPOLICY, TSS_FLAG, UINT32, BYTE *);
@@ -34,6 +34,7 @@ struct tr_rsakey_obj {
 		TPM_PCR_INFO_LONG infolong;
 	} pcrInfo;
 	UINT32 pcrInfoType;
+	Trspi_RSAPubKey pubKeyCache;	/* crypto handle for key.pubKey, built on first use */
 };
 
 /* obj_rsakey.c */
@@ -73,6 +74,8 @@ TSS_RESULT obj_rsakey_get_policies(TSS_HKEY, TSS_HPOLICY *, TSS_HPOLICY *, TSS_B
 TSS_RESULT obj_rsakey_get_blob(TSS_HKEY, UINT32 *, BYTE **);
 TSS_RESULT obj_rsakey_get_priv_blob(TSS_HKEY, UINT32 *, BYTE **);
 TSS_RESULT obj_rsakey_get_pub_blob(TSS_HKEY, UINT32 *, BYTE **);
+TSS_RESULT obj_rsakey_get_pub_handle(TSS_HKEY, Trspi_RSAPubKey *, TPM_KEY_USAGE *,
+				     TPM_ENC_SCHEME *, UINT32 *);
 TSS_RESULT obj_rsakey_get_version(TSS_HKEY, UINT32 *, BYTE **);
 TSS_RESULT obj_rsakey_get_exponent(TSS_HKEY, UINT32 *, BYTE **);
 TSS_RESULT obj_rsakey_set_exponent(TSS_HKEY, UINT32, BYTE *);
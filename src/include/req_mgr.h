@@ -17,6 +17,7 @@
 struct tpm_req_mgr
 {
 	MUTEX_DECLARE(queue_lock);
+	UINT32 open_count;	/* Tddli_GetOpenCount() as last seen */
 };
 
 TSS_RESULT req_mgr_init();
@@ -35,6 +35,24 @@ struct tcsd_comm_data {
 	struct tcsd_packet_hdr hdr;
 } STRUCTURE_PACKING_ATTRIBUTE;
 
+/* One entry of a TCSD_ORD_BATCH request. Each entry is a complete TCSD packet for an
+ * existing ordinal. A ref copies a UINT32 parameter (such as a key handle) out of the
+ * response of an earlier entry into a UINT32 parameter of this entry's request before
+ * it is dispatched. */
+struct tcsd_batch_ref {
+	UINT32 src_entry;	/* index of an earlier entry in the batch */
+	UINT32 src_parm;	/* index of the parameter in that entry's response */
+	UINT32 dst_parm;	/* index of the parameter in this entry's request */
+};
+
+struct tcsd_batch_entry {
+	struct tcsd_comm_data comm;	/* request on input, response on output */
+	UINT32 num_refs;
+	struct tcsd_batch_ref *refs;
+};
+
+#define TCSD_MAX_BATCH_ENTRIES	64
+
 #define TCSD_INIT_TXBUF_SIZE	1024
 #define TCSD_INCR_TXBUF_SIZE	4096
 
@@ -24,6 +24,7 @@ DECLARE_TCSTP_FUNC(OSAP);
 DECLARE_TCSTP_FUNC(GetCapability);
 DECLARE_TCSTP_FUNC(GetCapabilityOwner);
 DECLARE_TCSTP_FUNC(SetCapability);
+DECLARE_TCSTP_FUNC(Batch);
 
 #ifdef TSS_BUILD_RANDOM
 DECLARE_TCSTP_FUNC(GetRandom);
@@ -398,6 +399,8 @@ void initData(struct tcsd_comm_data *, int);
 int recv_from_socket(int, void *, int);
 int send_to_socket(int, void *, int);
 TSS_RESULT getTCSDPacket(struct tcsd_thread_data *);
+TSS_RESULT dispatchCommand(struct tcsd_thread_data *);
+const char *getTCSDOrdinalName(UINT32);
 
 MUTEX_DECLARE_EXTERN(tcsp_lock);
 
@@ -30,6 +30,7 @@ TSS_RESULT get_socket(struct host_table_entry *hte, int *sd);
 TSS_RESULT RPC_OpenContext_TP(struct host_table_entry *, UINT32 *, TCS_CONTEXT_HANDLE *);
 TSS_RESULT RPC_CloseContext_TP(struct host_table_entry *);
 TSS_RESULT RPC_FreeMemory_TP(struct host_table_entry *,BYTE *);
+TSS_RESULT RPC_Batch_TP(struct host_table_entry *,UINT32,struct tcsd_batch_entry *,UINT32 *);
 
 #ifdef TSS_BUILD_AUTH
 TSS_RESULT RPC_OIAP_TP(struct host_table_entry *,TCS_AUTHHANDLE *,TCPA_NONCE *);
@@ -60,6 +61,7 @@ TSS_RESULT RPC_EnumRegisteredKeys2_TP(struct host_table_entry *,TSS_UUID *,UINT3
 TSS_RESULT RPC_GetRegisteredKey_TP(struct host_table_entry *,TSS_UUID,TSS_KM_KEYINFO **);
 TSS_RESULT RPC_GetRegisteredKeyBlob_TP(struct host_table_entry *,TSS_UUID,UINT32 *,BYTE **);
 TSS_RESULT RPC_LoadKeyByUUID_TP(struct host_table_entry *,TSS_UUID,TCS_LOADKEY_INFO *,TCS_KEY_HANDLE *);
+TSS_RESULT RPC_LoadKeyByUUIDAndBlob_TP(struct host_table_entry *,TSS_UUID,TCS_LOADKEY_INFO *,TCS_KEY_HANDLE *,UINT32 *,BYTE **);
 #else
 #define RPC_GetRegisteredKeyByPublicInfo_TP(...)	TSPERR(TSS_E_INTERNAL_ERROR)
 #define RPC_RegisterKey_TP(...)				TSPERR(TSS_E_INTERNAL_ERROR)
@@ -69,6 +71,7 @@ TSS_RESULT RPC_LoadKeyByUUID_TP(struct host_table_entry *,TSS_UUID,TCS_LOADKEY_I
 #define RPC_GetRegisteredKey_TP(...)			TSPERR(TSS_E_INTERNAL_ERROR)
 #define RPC_GetRegisteredKeyBlob_TP(...)		TSPERR(TSS_E_INTERNAL_ERROR)
 #define RPC_LoadKeyByUUID_TP(...)			TSPERR(TSS_E_INTERNAL_ERROR)
+#define RPC_LoadKeyByUUIDAndBlob_TP(...)		TSPERR(TSS_E_INTERNAL_ERROR)
 #endif
 
 #ifdef TSS_BUILD_KEY
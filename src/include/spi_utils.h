@@ -148,7 +148,17 @@ TSS_RESULT __tspi_rsa_verify(TSS_HKEY, UINT32, UINT32, BYTE*, UINT32, BYTE*);
 
 TSS_RESULT Init_AuthNonce(TCS_CONTEXT_HANDLE, TSS_BOOL, TPM_AUTH *);
 TSS_BOOL validateReturnAuth(BYTE *, BYTE *, TPM_AUTH *);
+void LoadBlob_AuthHmacData(UINT64 *, BYTE *, BYTE *, TPM_AUTH *);
 void HMAC_Auth(BYTE *, BYTE *, TPM_AUTH *);
+TSS_RESULT Trspi_HMAC_KeyInit(Trspi_HMACKey *, UINT32, BYTE *);
+TSS_RESULT Trspi_HMAC_Keyed(Trspi_HMACKey *, UINT32, BYTE *, BYTE *);
+void Trspi_HMAC_KeyFree(Trspi_HMACKey *);
+TSS_RESULT Trspi_RSA_PubKeyInit(Trspi_RSAPubKey *, UINT32, BYTE *);
+TSS_RESULT Trspi_RSA_PubKeyDup(Trspi_RSAPubKey *, Trspi_RSAPubKey *);
+TSS_RESULT Trspi_RSA_PubKey_Encrypt(Trspi_RSAPubKey *, UINT32, BYTE *, UINT32 *, BYTE *);
+TSS_RESULT Trspi_RSA_PubKey_PKCS15_Encrypt(Trspi_RSAPubKey *, UINT32, BYTE *, UINT32 *, BYTE *);
+TSS_RESULT Trspi_RSA_PubKey_Verify(Trspi_RSAPubKey *, UINT32, UINT32, BYTE *, UINT32, BYTE *);
+void Trspi_RSA_PubKeyFree(Trspi_RSAPubKey *);
 TSS_RESULT OSAP_Calc(TCS_CONTEXT_HANDLE, UINT16, UINT32, BYTE *, BYTE *, BYTE *,
 			TCPA_ENCAUTH *, TCPA_ENCAUTH *, BYTE *, TPM_AUTH *);
 
@@ -184,6 +194,8 @@ TSS_RESULT RPC_FreeMemory(TSS_HCONTEXT, BYTE *);
 TSS_RESULT RPC_GetRegisteredKeyByPublicInfo(TSS_HCONTEXT, TCPA_ALGORITHM_ID, UINT32,
                                               BYTE *, UINT32 *, BYTE **);
 TSS_RESULT RPC_CloseContext(TSS_HCONTEXT);
+struct tcsd_batch_entry;
+TSS_RESULT RPC_Batch(TSS_HCONTEXT, UINT32, struct tcsd_batch_entry *, UINT32 *);
 TSS_RESULT RPC_GetCapability(TSS_HCONTEXT, TCPA_CAPABILITY_AREA, UINT32, BYTE *, UINT32 *, BYTE **);
 TSS_RESULT RPC_GetTPMCapability(TSS_HCONTEXT, TCPA_CAPABILITY_AREA, UINT32, BYTE *, UINT32 *, BYTE **);
 TSS_RESULT Transport_GetTPMCapability(TSS_HCONTEXT, TCPA_CAPABILITY_AREA, UINT32, BYTE *, UINT32 *, BYTE **);
@@ -195,6 +207,8 @@ TSS_RESULT RPC_LoadKeyByBlob(TSS_HCONTEXT, TCS_KEY_HANDLE, UINT32, BYTE *, TPM_A
 TSS_RESULT Transport_LoadKeyByBlob(TSS_HCONTEXT, TSS_HKEY, UINT32, BYTE *,
 				   TPM_AUTH *, TCS_KEY_HANDLE *, TPM_KEY_HANDLE *);
 TSS_RESULT RPC_LoadKeyByUUID(TSS_HCONTEXT, TSS_UUID, TCS_LOADKEY_INFO *, TCS_KEY_HANDLE *);
+TSS_RESULT RPC_LoadKeyByUUIDAndBlob(TSS_HCONTEXT, TSS_UUID, TCS_LOADKEY_INFO *, TCS_KEY_HANDLE *,
+				    UINT32 *, BYTE **);
 TSS_RESULT RPC_GetRegisteredKey(TSS_HCONTEXT, TSS_UUID, TSS_KM_KEYINFO **);
 TSS_RESULT RPC_GetRegisteredKeyBlob(TSS_HCONTEXT, TSS_UUID, UINT32 *, BYTE **);
 TSS_RESULT RPC_RegisterKey(TSS_HCONTEXT, TSS_UUID, TSS_UUID, UINT32, BYTE *, UINT32, BYTE *);
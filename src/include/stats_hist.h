@@ -0,0 +1,69 @@
+/*
+ * Licensed Materials - Property of IBM
+ *
+ * trousers - An open source TCG Software Stack
+ *
+ * (C) Copyright International Business Machines Corp. 2004-2007
+ *
+ */
+
+
+#ifndef _STATS_HIST_H_
+#define _STATS_HIST_H_
+
+/* Log-linear histogram buckets, as an HDR histogram uses, shared by the TCSD's statistics
+ * and tcsd-bench. With sub = 1 << sub_bits, values below 2 * sub get a bucket each, after
+ * that every power of two is split into sub buckets of equal width. So bucket i starts at i
+ * for small i and at (sub + i % sub) << (i / sub - 1) otherwise, and a value's bucket is off
+ * by at most 1/sub. The last of num_buckets buckets also holds anything larger. */
+
+static inline UINT32
+hist_bucket(UINT64 v, UINT32 sub_bits, UINT32 num_buckets)
+{
+	UINT32 msb, i;
+
+	if (v < (UINT64)2 << sub_bits)
+		return (UINT32)v;
+
+	msb = 63 - __builtin_clzll(v);
+	i = ((msb - sub_bits + 1) << sub_bits) + ((v >> (msb - sub_bits)) & ((1 << sub_bits) - 1));
+
+	return i < num_buckets ? i : num_buckets - 1;
+}
+
+/* the smallest value that lands in bucket i */
+static inline UINT64
+hist_bucket_start(UINT32 i, UINT32 sub_bits)
+{
+	UINT32 sub = 1 << sub_bits;
+
+	if (i < 2 * sub)
+		return i;
+
+	return (UINT64)(sub + i % sub) << (i / sub - 1);
+}
+
+/* the upper bound of the bucket holding the value at p / scale of the count values in
+ * buckets, but no more than max */
+static inline UINT64
+hist_percentile(UINT64 *buckets, UINT32 num_buckets, UINT32 sub_bits, UINT64 count,
+		UINT64 max, UINT32 p, UINT32 scale)
+{
+	UINT64 seen = 0, want = (count * p + scale - 1) / scale, bound;
+	UINT32 i;
+
+	for (i = 0; i < num_buckets - 1; i++) {
+		seen += buckets[i];
+		if (seen >= want)
+			break;
+	}
+
+	if (i == num_buckets - 1)
+		return max;
+
+	bound = hist_bucket_start(i + 1, sub_bits) - 1;
+
+	return bound < max ? bound : max;
+}
+
+#endif
@@ -0,0 +1,67 @@
+
+/*
+ * Licensed Materials - Property of IBM
+ *
+ * trousers - An open source TCG Software Stack
+ *
+ * (C) Copyright International Business Machines Corp. 2004-2007
+ *
+ */
+
+
+#ifndef _TCS_STATS_H_
+#define _TCS_STATS_H_
+
+/* Latencies are kept in microseconds in the log-linear buckets of stats_hist.h. The last
+ * bucket starts at about two hours and also holds anything longer. */
+#define TCS_STATS_SUB_BITS	2
+#define TCS_STATS_SUB_BUCKETS	(1 << TCS_STATS_SUB_BITS)
+#define TCS_STATS_BUCKETS	128
+
+/* format version of the TSS_TCSCAP_TROUSERS_STATS blob */
+#define TCS_STATS_VERSION	1
+
+struct tcs_stats_hist {
+	UINT64 count;
+	UINT64 total;
+	UINT64 max;
+	UINT64 buckets[TCS_STATS_BUCKETS];
+};
+
+enum tcs_stats_counter {
+	TCS_STATS_TPM_COMMANDS = 0,	/* commands sent to the TPM */
+	TCS_STATS_TPM_RETRIES,		/* resends after TPM_RETRY */
+	TCS_STATS_TPM_ERRORS,		/* commands the TPM returned an error for */
+	TCS_STATS_TDDL_ERRORS,		/* commands that failed to reach the TPM */
+	TCS_STATS_KEY_LOADS,		/* keys loaded back into the TPM by the key manager */
+	TCS_STATS_KEY_EVICTIONS,	/* keys evicted to make room for another */
+	TCS_STATS_AUTH_SWAPS,		/* auth sessions saved to make room for another */
+	TCS_STATS_AUTH_WAITS,		/* threads put to sleep waiting for an auth session */
+	TCS_STATS_NUM_COUNTERS
+};
+
+enum tcs_stats_latency {
+	TCS_STATS_QUEUE_WAIT = 0,	/* waiting for the TPM request queue */
+	TCS_STATS_TPM_TIME,		/* in the TDDL, including retries */
+	TCS_STATS_HOST_TIME,		/* the rest of handling a TCSD ordinal */
+	TCS_STATS_NUM_LATENCIES
+};
+
+/* Taken before a TCSD ordinal is handled. Marks nest, so the entries of a batch are
+ * accounted for as well as the batch itself */
+struct tcs_stats_mark {
+	UINT64 start;
+	UINT64 queue;
+	UINT64 tpm;
+};
+
+void       tcs_stats_init();
+UINT64     tcs_stats_now();
+void       tcs_stats_count(enum tcs_stats_counter);
+void       tcs_stats_tpm(UINT64 queued, UINT64 sent, UINT64 done);
+void       tcs_stats_begin(struct tcs_stats_mark *);
+void       tcs_stats_end(struct tcs_stats_mark *, UINT32 ordinal, TSS_RESULT);
+TSS_RESULT tcs_stats_get_blob(UINT32 *, BYTE **);
+void       tcs_stats_log();
+
+#endif
@@ -92,6 +92,8 @@ struct key_disk_cache
 
 #define TSS_TPM_TXBLOB_SIZE		(4096)
 #define TSS_TXBLOB_WRAPPEDCMD_OFFSET	(TSS_TPM_TXBLOB_HDR_LEN + sizeof(UINT32))
+/* handle lists of wrapped commands up to this size are mapped without an allocation */
+#define TSS_TRANSPORT_INLINE_HANDLES	(4)
 #define TSS_MAX_AUTHS_CAP		(1024)
 #define TSS_REQ_MGR_MAX_RETRIES		(5)
 
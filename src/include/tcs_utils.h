@@ -66,6 +66,9 @@ extern struct tpm_properties tpm_metrics;
 #endif
 
 TSS_RESULT get_tpm_metrics(struct tpm_properties *);
+TSS_BOOL   nv_cache_get(TCPA_CAPABILITY_AREA, UINT32, BYTE *, UINT32 *, UINT32 *, BYTE **);
+void       nv_cache_put(TCPA_CAPABILITY_AREA, UINT32, BYTE *, UINT32, UINT32, BYTE *);
+void       nv_cache_invalidate_all();
 
 TSS_RESULT auth_mgr_init();
 TSS_RESULT auth_mgr_final();
@@ -164,10 +167,12 @@ TSS_RESULT ctx_set_transport_disabled(TCS_CONTEXT_HANDLE, TCS_HANDLE *);
 #define CTX_ref_count_keys(c)	ctx_ref_count_keys(c)
 #define KEY_MGR_ref_count()	key_mgr_ref_count()
 TSS_RESULT ensureKeyIsLoaded(TCS_CONTEXT_HANDLE, TCS_KEY_HANDLE, TCPA_KEY_HANDLE *);
+TSS_RESULT ensureKeysAreLoaded(TCS_CONTEXT_HANDLE, UINT32, TCS_KEY_HANDLE *, TCPA_KEY_HANDLE *);
 #else
 #define CTX_ref_count_keys(c)
 #define KEY_MGR_ref_count()
 #define ensureKeyIsLoaded(...)	(1 /* XXX non-zero return will indicate failure */)
+#define ensureKeysAreLoaded(...)	(1 /* XXX non-zero return will indicate failure */)
 #endif
 
 
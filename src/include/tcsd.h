@@ -13,6 +13,7 @@
 #define _TCSD_H_
 
 #include <signal.h>
+#include <sys/socket.h>
 
 #include "rpc_tcstp.h"
 
@@ -25,6 +26,30 @@ struct platform_class
 	struct platform_class *next;
 };
 
+/* bitmaps of TCSD ordinals, used for the remote access control lists */
+#define TCSD_ORD_BITMAP_WORDS		((TCSD_MAX_NUM_ORDS + 31) / 32)
+#define TCSD_ORD_BITMAP_SET(map, ord)	((map)[(ord) / 32] |= (1U << ((ord) % 32)))
+#define TCSD_ORD_BITMAP_ISSET(map, ord)	((map)[(ord) / 32] & (1U << ((ord) % 32)))
+
+/* A remote_host_ops entry: ordinals allowed for remote hosts in addr/prefix_len, on top of
+ * the ones every remote host gets from remote_ops */
+struct tcsd_host_acl
+{
+	int family;		/* AF_INET or AF_INET6 */
+	BYTE addr[16];		/* network order, 4 bytes used for AF_INET */
+	unsigned int prefix_len;
+	UINT32 ops[TCSD_ORD_BITMAP_WORDS];
+	struct tcsd_host_acl *next;
+};
+
+/* A tddl_mock_latency entry: how long the mock TPM takes to execute an ordinal */
+struct tcsd_ord_latency
+{
+	UINT32 ordinal;
+	UINT32 usecs;
+	struct tcsd_ord_latency *next;
+};
+
 /* config structures */
 struct tcsd_config
 {
@@ -39,7 +64,10 @@ struct tcsd_config
 	char *platform_cred;		/* location of the platform credential */
 	char *conformance_cred;		/* location of the conformance credential */
 	char *endorsement_cred;		/* location of the endorsement credential */
-	int remote_ops[TCSD_MAX_NUM_ORDS];	/* array of ordinals executable by remote hosts */
+	UINT32 remote_ops[TCSD_ORD_BITMAP_WORDS];	/* bitmap of ordinals executable by
+							   remote hosts */
+	struct tcsd_host_acl *remote_host_acls;	/* per host additions to remote_ops */
+	int remote_ops_enabled;	/* set if any remote host may execute any ordinal */
 	unsigned int unset;	/* bitmask of options which are still unset */
 	int exclusive_transport; /* allow applications to open exclusive transport sessions with
 				    the TPM and enforce their exclusivity (possible DOS issue) */
@@ -48,8 +76,15 @@ struct tcsd_config
 							of this TCS System */
 	int disable_ipv4;
 	int disable_ipv6;
+	int tddl_backend;	/* which TDDL backend talks to the TPM */
+	UINT32 tddl_mock_latency;	/* the mock TPM's default command latency, in usecs */
+	struct tcsd_ord_latency *tddl_mock_ord_latency;	/* per ordinal mock TPM latencies */
 };
 
+#define TCSD_TDDL_BACKEND_DEVICE	0
+#define TCSD_TDDL_BACKEND_EMULATOR	1
+#define TCSD_TDDL_BACKEND_MOCK		2
+
 #define TCSD_DEFAULT_CONFIG_FILE	ETC_PREFIX "/tcsd.conf"
 extern char *tcsd_config_file;
 
@@ -65,6 +100,8 @@ extern char *tcsd_config_file;
 #define TCSD_DEFAULT_KERNEL_PCRS	0x00000000
 #define TCSD_DEFAULT_DISABLE_IPV4 0
 #define TCSD_DEFAULT_DISABLE_IPV6 0
+#define TCSD_DEFAULT_TDDL_BACKEND	TCSD_TDDL_BACKEND_DEVICE
+#define TCSD_DEFAULT_TDDL_MOCK_LATENCY	0
 
 /* This will change when a system with more than 32 PCR's exists */
 #define TCSD_MAX_PCRS			32
@@ -103,6 +140,9 @@ struct tcg_platform_spec {
 #define TCSD_OPTION_HOST_PLATFORM_CLASS	0x1000
 #define TCSD_OPTION_DISABLE_IPV4 0x2000
 #define TCSD_OPTION_DISABLE_IPV6 0x4000
+#define TCSD_OPTION_REMOTE_HOST_OPS	0x8000
+#define TCSD_OPTION_TDDL_BACKEND	0x10000
+#define TCSD_OPTION_TDDL_MOCK_LATENCY	0x20000
 
 #define TSS_TCP_RPC_MAX_DATA_LEN	1048576
 #define TSS_TCP_RPC_BAD_PACKET_TYPE	0x10000000
@@ -123,7 +163,10 @@ enum tcsd_config_option_code {
 	opt_host_platform_class,
 	opt_all_platform_classes,
 	opt_disable_ipv4,
-	opt_disable_ipv6
+	opt_disable_ipv6,
+	opt_remote_host_ops,
+	opt_tddl_backend,
+	opt_tddl_mock_latency
 };
 
 struct tcsd_config_options {
@@ -136,6 +179,7 @@ extern struct tcsd_config tcsd_options;
 TSS_RESULT conf_file_init(struct tcsd_config *);
 void	   conf_file_final(struct tcsd_config *);
 TSS_RESULT ps_dirs_init();
+void	   tcsd_peer_remote_ops(struct tcsd_config *, int, BYTE *, UINT32 *);
 void	   tcsd_signal_handler(int);
 
 /* threading structures */
@@ -145,6 +189,9 @@ struct tcsd_thread_data
 	UINT32 context;
 	THREAD_TYPE *thread_id;
 	char *hostname;
+	int is_localhost;	/* peer classification, done once at accept time */
+	UINT32 remote_ops[TCSD_ORD_BITMAP_WORDS];	/* ordinals this peer may execute
+							   if it isn't local */
 	struct tcsd_comm_data comm;
 };
 
@@ -160,7 +207,7 @@ struct tcsd_thread_mgr
 
 TSS_RESULT tcsd_threads_init();
 TSS_RESULT tcsd_threads_final();
-TSS_RESULT tcsd_thread_create(int, char *);
+TSS_RESULT tcsd_thread_create(int, char *, struct sockaddr *);
 void	   *tcsd_thread_run(void *);
 void	   thread_signal_init();
 
@@ -184,8 +184,11 @@ enum TCSD_ORD {
 	TCSD_ORD_KEYCONTROLOWNER = 121,
 	TCSD_ORD_DSAP = 122,
 
+	/* TCSD extension: execute a vector of the above in one packet */
+	TCSD_ORD_BATCH = 123,
+
 	/* Last */
-	TCSD_LAST_ORD = 123
+	TCSD_LAST_ORD = 124
 };
 #define TCSD_MAX_NUM_ORDS TCSD_LAST_ORD
 
@@ -12,6 +12,7 @@
 #ifndef _TDDL_H_
 #define _TDDL_H_
 
+#include <time.h>
 #include <threads.h>
 #include "tcsd_wrap.h"
 #include "tcsd.h"
@@ -27,6 +28,44 @@ struct tpm_device_node {
 #define TDDL_TXBUF_SIZE		2048
 #define TDDL_UNDEF		-1
 
+/* A backend moves commands between txBuffer and a TPM. submit() sends the first len bytes
+ * of txBuffer, wait() puts the response back into txBuffer and returns its size, or
+ * TDDL_E_TIMEOUT if it isn't available within timeout msecs. Backends that can't cancel a
+ * command or have nothing to poll leave cancel and get_fd NULL. */
+struct tddl_backend {
+	char *name;
+	TSS_RESULT (*open)(void);
+	void (*close)(void);
+	TSS_RESULT (*submit)(UINT32 len);
+	TSS_RESULT (*wait)(int timeout, UINT32 *size);
+	TSS_RESULT (*cancel)(void);
+	int (*get_fd)(void);
+};
+
+extern struct tddl_backend tddl_device_backend;
+extern struct tddl_backend tddl_emulator_backend;
+extern struct tddl_backend tddl_mock_backend;
+
+extern BYTE txBuffer[TDDL_TXBUF_SIZE];
+
+/* sets @deadline to usecs from now on CLOCK_MONOTONIC, for backends that wait on a clock */
+void tddl_deadline(UINT64 usecs, struct timespec *deadline);
+extern struct tcsd_config *_tcsd_options;
+
+/* command duration classes, as reported by TPM_CAP_PROP_DURATION */
+#define TDDL_DURATION_SHORT	0
+#define TDDL_DURATION_MEDIUM	1
+#define TDDL_DURATION_LONG	2
+#define TDDL_NUM_DURATIONS	3
+
+/* timeouts in msecs. The default is used until the TPM has reported its durations */
+#define TDDL_DEFAULT_TIMEOUT	120000
+#define TDDL_MIN_TIMEOUT	1000
+
+/* The TDDL doesn't reach into the TCSD's globals. The TCSD hands it its configuration,
+ * which picks the backend and the mock TPM's latencies, before opening it. */
+void	   Tddli_SetConfig(struct tcsd_config *conf);
+
 TSS_RESULT Tddli_Open(void);
 
 TSS_RESULT Tddli_TransmitData(BYTE *pTransmitBuf,
@@ -36,4 +75,25 @@ TSS_RESULT Tddli_TransmitData(BYTE *pTransmitBuf,
 
 TSS_RESULT Tddli_Close(void);
 
+/* A count that changes each time the TDDL (re)connects to the TPM, after which anything
+ * learned from the TPM before may be stale */
+UINT32	   Tddli_GetOpenCount(void);
+
+TSS_RESULT Tddli_Cancel(void);
+
+/* Asynchronous interface: a command is started with Tddli_SubmitData() and its response
+ * collected with Tddli_WaitData(), which returns TDDL_E_TIMEOUT if the response didn't
+ * arrive within the timeout. Tddli_GetFd() can be polled for POLLIN in between. Only one
+ * command may be outstanding at a time. */
+TSS_RESULT Tddli_SubmitData(BYTE *pTransmitBuf,
+			UINT32 TransmitBufLen);
+
+TSS_RESULT Tddli_WaitData(BYTE *pReceiveBuf,
+			UINT32 *pReceiveBufLen,
+			int timeout);
+
+int	   Tddli_GetFd(void);
+UINT32	   Tddli_GetTimeout(BYTE *pTransmitBuf, UINT32 TransmitBufLen);
+void	   Tddli_SetDurations(UINT32 *durations);
+
 #endif
@@ -23,6 +23,14 @@
 #define MUTEX_DECLARE_INIT(m)	pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER
 #define MUTEX_DECLARE_EXTERN(m)	extern pthread_mutex_t m
 
+/* reader/writer lock abstractions */
+#define RWLOCK_INIT(l)		pthread_rwlock_init(&l, NULL)
+#define RWLOCK_RDLOCK(l)	pthread_rwlock_rdlock(&l)
+#define RWLOCK_WRLOCK(l)	pthread_rwlock_wrlock(&l)
+#define RWLOCK_UNLOCK(l)	pthread_rwlock_unlock(&l)
+#define RWLOCK_DECLARE(l)	pthread_rwlock_t l
+#define RWLOCK_DECLARE_INIT(l)	pthread_rwlock_t l = PTHREAD_RWLOCK_INITIALIZER
+
 /* condition variable abstractions */
 #define COND_DECLARE(c)		pthread_cond_t c
 #define COND_INIT(c)		pthread_cond_init(&c, NULL)
@@ -43,6 +51,16 @@
 #define THREAD_SET_SIGNAL_MASK		pthread_sigmask
 #define THREAD_NULL			(THREAD_TYPE *)0
 
+/* most threads run_shares will split work over */
+#define THREAD_MAX_SHARES		32
+
+/* Split count items into stride shares, one per min_per_share items but no more than the
+ * online processors or THREAD_MAX_SHARES, and call fn(arg, first, stride) for each share
+ * first = 0 .. stride - 1 at once. Share 0, and any share whose thread couldn't be started,
+ * runs on the calling thread. Returns when every share is done. */
+void run_shares(void (*fn)(void *, unsigned int, unsigned int), void *arg,
+		unsigned int count, unsigned int min_per_share);
+
 #else
 
 #error No threading library defined! (Cannot find pthread.h)
@@ -200,6 +200,27 @@ TSS_RESULT Trspi_Verify(UINT32 HashType, BYTE *pHash, UINT32 iHashLength,
 			unsigned char *pModulus, int iKeyLength,
 			BYTE *pSignature, UINT32 sig_len);
 
+/* One signature to check with Trspi_Verify_Batch. The fields match the arguments of
+ * Trspi_Verify, except that if @pHash is NULL, the @data_len bytes at @pData are SHA1
+ * hashed first, which is what's needed for the rgbData of a TSS_VALIDATION returned by
+ * Tspi_TPM_Quote. @result is set to what Trspi_Verify would have returned. */
+typedef struct _Trspi_VerifyItem {
+	UINT32 HashType;
+	BYTE *pHash;
+	UINT32 iHashLength;
+	BYTE *pData;
+	UINT32 data_len;
+	unsigned char *pModulus;
+	UINT32 iKeyLength;
+	BYTE *pSignature;
+	UINT32 sig_len;
+	TSS_RESULT result;
+} Trspi_VerifyItem;
+
+/* Verify @count signatures, spread over the online processors. Items with the same
+ * modulus share one converted key. Returns the result of the first item that failed. */
+TSS_RESULT Trspi_Verify_Batch(UINT32 count, Trspi_VerifyItem *items);
+
 int Trspi_RSA_Public_Encrypt(unsigned char *in, unsigned int inlen,
 			     unsigned char *out, unsigned int *outlen,
 			     unsigned char *pubkey, unsigned int pubsize,
@@ -262,6 +283,12 @@ char *Trspi_Error_Layer(TSS_RESULT);
 /* return just the error code bits of the result */
 TSS_RESULT Trspi_Error_Code(TSS_RESULT);
 
+/* Bulk Functions */
+
+/* Tspi_Data_Bind of ulCount payloads under one key, spread over the online processors */
+TSS_RESULT Tspi_Data_BindBulk(TSS_HKEY hEncKey, UINT32 ulCount, TSS_HENCDATA *phEncData,
+			      UINT32 *pulDataLength, BYTE **prgbDataToBind);
+
 #ifdef __cplusplus
 }
 #endif
@@ -280,4 +307,13 @@ TSS_RESULT Trspi_Error_Code(TSS_RESULT);
 
 #define TSS_LOCALITY_ALL       (TPM_LOC_ZERO|TPM_LOC_ONE|TPM_LOC_TWO|TPM_LOC_THREE|TPM_LOC_FOUR)
 
+/* TrouSerS specific TCS capability: the tcsd's counters and latency histograms, with no
+ * subcap. The blob is big endian: UINT32 version (1), UINT64 uptime in microseconds,
+ * UINT32 n and n UINT64 counters, UINT32 n and n histograms (queue wait, TPM time, host
+ * time), then UINT32 n and n times UINT32 TCSD ordinal, UINT64 errors and a histogram of
+ * the ordinal's total time. A histogram is UINT64 count, total and max microseconds, then
+ * UINT32 n and n pairs of UINT32 bucket index and UINT64 bucket count. See tcs_stats.h for
+ * the bucket boundaries */
+#define TSS_TCSCAP_TROUSERS_STATS	(0x80000001)
+
 #endif
@@ -118,6 +118,17 @@ typedef struct tdTSS_KEY {
 	BYTE *encData;
 } TSS_KEY;
 
+// A SHA1 HMAC key with its padded key blocks already hashed, see Trspi_HMAC_KeyInit()
+typedef struct _Trspi_HMACKey {
+	void *inner;
+	void *outer;
+} Trspi_HMACKey;
+
+// An RSA public key in the crypto library's own form, see Trspi_RSA_PubKeyInit()
+typedef struct _Trspi_RSAPubKey {
+	void *rsa;
+} Trspi_RSAPubKey;
+
 #if (defined (__linux) || defined (linux) || defined (SOLARIS) || defined (__GLIBC__))
 #define BSD_CONST
 #elif (defined (__OpenBSD__) || defined (__FreeBSD__)) || defined (__APPLE__)
@@ -29,6 +29,7 @@
 #include "tcsd_wrap.h"
 #include "tcsd.h"
 #include "rpc_tcstp_tcs.h"
+#include "tcs_stats.h"
 
 
 /* Lock is not static because we need to reference it in the auth manager */
@@ -512,56 +513,28 @@ DispatchTable tcs_func_table[TCSD_MAX_NUM_ORDS] = {
 	{tcs_wrap_CMK_ConvertMigration,"CMK_ConvertMigration"},
 	{tcs_wrap_FlushSpecific,"FlushSpecific"}, /* 120 */
 	{tcs_wrap_KeyControlOwner, "KeyControlOwner"},
-	{tcs_wrap_DSAP, "DSAP"}
+	{tcs_wrap_DSAP, "DSAP"},
+	{tcs_wrap_Batch, "Batch"}
 };
 
 int
 access_control(struct tcsd_thread_data *thread_data)
 {
-	int i = 0;
-	int is_localhost;
-	struct sockaddr_storage sas;
-	struct sockaddr *sa;
-	socklen_t sas_len = sizeof(sas);
-
-	if (getpeername(thread_data->sock, (struct sockaddr *)&sas,
-			&sas_len) == -1) {
-		LogError("Error retrieving local socket address: %s", strerror(errno));
-		return 1;
-	}
+	UINT32 ord = thread_data->comm.hdr.u.ordinal;
 
-	sa = (struct sockaddr *)&sas;
-
-	is_localhost = 0;
-	// Check if it's localhost for both inet protocols
-	if (sa->sa_family == AF_INET) {
-		struct sockaddr_in *sa_in = (struct sockaddr_in *)sa;
-		in_addr_t nloopaddr = htonl(INADDR_LOOPBACK);
-		if (memcmp(&sa_in->sin_addr.s_addr, &nloopaddr,
-					sizeof(in_addr_t)) == 0)
-			is_localhost = 1;
-        }
-	else if (sa->sa_family == AF_INET6) {
-		struct sockaddr_in6 *sa_in6 = (struct sockaddr_in6 *)sa;
-		if (memcmp(&sa_in6->sin6_addr.s6_addr, &in6addr_loopback,
-					sizeof(struct in6_addr)) == 0)
-			is_localhost = 1;
-	}
+	/* each entry of a batch goes back through dispatchCommand() and is checked there */
+	if (ord == TCSD_ORD_BATCH)
+		return 0;
 
-	/* if the request comes from localhost, or is in the accepted ops list,
-	 * approve it */
-	if (is_localhost)
+	/* the peer was classified when its connection was accepted, so all that's left is a
+	 * lookup in its ordinal bitmap */
+	if (thread_data->is_localhost)
+		return 0;
+
+	if (TCSD_ORD_BITMAP_ISSET(thread_data->remote_ops, ord)) {
+		LogInfo("Accepted %s operation from %s", tcs_func_table[ord].name,
+			thread_data->hostname);
 		return 0;
-	else {
-		while (tcsd_options.remote_ops[i]) {
-			if ((UINT32)tcsd_options.remote_ops[i] == thread_data->comm.hdr.u.ordinal) {
-				LogInfo("Accepted %s operation from %s",
-					tcs_func_table[thread_data->comm.hdr.u.ordinal].name,
-					thread_data->hostname);
-				return 0;
-			}
-			i++;
-		}
 	}
 
 	return 1;
@@ -572,6 +545,8 @@ dispatchCommand(struct tcsd_thread_data *data)
 {
 	UINT64 offset;
 	TSS_RESULT result;
+	struct tcs_stats_mark mark;
+	UINT32 ordinal;
 
 	/* First, check the ordinal bounds */
 	if (data->comm.hdr.u.ordinal >= TCSD_MAX_NUM_ORDS) {
@@ -583,7 +558,7 @@ dispatchCommand(struct tcsd_thread_data *data)
 		 tcs_func_table[data->comm.hdr.u.ordinal].name);
 	/* We only need to check access_control if there are remote operations that are defined
 	 * in the config file, which means we allow remote connections */
-	if (tcsd_options.remote_ops[0] && access_control(data)) {
+	if (tcsd_options.remote_ops_enabled && access_control(data)) {
 		LogWarn("Denied %s operation from %s",
 			tcs_func_table[data->comm.hdr.u.ordinal].name, data->hostname);
 
@@ -601,8 +576,13 @@ dispatchCommand(struct tcsd_thread_data *data)
 		return TSS_SUCCESS;
 	}
 
-	/* Now, dispatch */
-	if ((result = tcs_func_table[data->comm.hdr.u.ordinal].Func(data)) == TSS_SUCCESS) {
+	/* Now, dispatch. The result shares the header with the ordinal, so keep a copy */
+	ordinal = data->comm.hdr.u.ordinal;
+	tcs_stats_begin(&mark);
+	result = tcs_func_table[ordinal].Func(data);
+	tcs_stats_end(&mark, ordinal, result ? result : data->comm.hdr.u.result);
+
+	if (result == TSS_SUCCESS) {
 		/* set the comm buffer */
 		offset = 0;
 		LoadBlob_UINT32(&offset, data->comm.hdr.packet_size, data->comm.buf);
@@ -618,6 +598,15 @@ dispatchCommand(struct tcsd_thread_data *data)
 
 }
 
+const char *
+getTCSDOrdinalName(UINT32 ordinal)
+{
+	if (ordinal >= TCSD_MAX_NUM_ORDS)
+		return "Unknown";
+
+	return tcs_func_table[ordinal].name;
+}
+
 TSS_RESULT
 getTCSDPacket(struct tcsd_thread_data *data)
 {
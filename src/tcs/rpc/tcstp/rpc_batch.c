@@ -0,0 +1,297 @@
+
+/*
+ * Licensed Materials - Property of IBM
+ *
+ * trousers - An open source TCG Software Stack
+ *
+ * (C) Copyright International Business Machines Corp. 2004-2007
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <syslog.h>
+#include <string.h>
+#include <netdb.h>
+
+#include "trousers/tss.h"
+#include "trousers_types.h"
+#include "tcs_tsp.h"
+#include "tcs_utils.h"
+#include "tcs_int_literals.h"
+#include "capabilities.h"
+#include "tcslog.h"
+#include "tcsd_wrap.h"
+#include "tcsd.h"
+#include "rpc_tcstp_tcs.h"
+
+
+/* Find the offset of parameter @index in @comm's parameter area. Only parameters that are
+ * preceded by fixed size types can be located, since PBYTE's carry no length of their own.
+ * Auth structures are 45 bytes going into the TCSD and 41 bytes coming out. */
+static TSS_RESULT
+batch_parm_offset(struct tcsd_comm_data *comm, UINT32 index, UINT32 auth_size, UINT64 *offset)
+{
+	TCSD_PACKET_TYPE *type;
+	UINT64 off;
+	UINT32 i;
+
+	if (index >= comm->hdr.num_parms ||
+	    comm->hdr.type_offset + comm->hdr.num_parms > comm->hdr.packet_size)
+		return TCSERR(TSS_E_BAD_PARAMETER);
+
+	type = (TCSD_PACKET_TYPE *)(comm->buf + comm->hdr.type_offset);
+	off = comm->hdr.parm_offset;
+
+	for (i = 0; i < index; i++) {
+		switch (type[i]) {
+			case TCSD_PACKET_TYPE_BYTE:
+			case TCSD_PACKET_TYPE_BOOL:
+				off += sizeof(BYTE);
+				break;
+			case TCSD_PACKET_TYPE_UINT16:
+				off += sizeof(UINT16);
+				break;
+			case TCSD_PACKET_TYPE_UINT32:
+			case TCSD_PACKET_TYPE_VERSION:
+				off += sizeof(UINT32);
+				break;
+			case TCSD_PACKET_TYPE_UINT64:
+				off += sizeof(UINT64);
+				break;
+			case TCSD_PACKET_TYPE_NONCE:
+			case TCSD_PACKET_TYPE_DIGEST:
+			case TCSD_PACKET_TYPE_ENCAUTH:
+			case TCSD_PACKET_TYPE_SECRET:
+				off += TCPA_SHA1_160_HASH_LEN;
+				break;
+			case TCSD_PACKET_TYPE_UUID:
+				off += sizeof(TSS_UUID);
+				break;
+			case TCSD_PACKET_TYPE_AUTH:
+				off += auth_size;
+				break;
+			default:
+				LogDebug("Batch reference to parm %u follows variable length parm %u",
+					 index, i);
+				return TCSERR(TSS_E_BAD_PARAMETER);
+		}
+	}
+
+	if (type[index] != TCSD_PACKET_TYPE_UINT32 ||
+	    off + sizeof(UINT32) > comm->hdr.packet_size)
+		return TCSERR(TSS_E_BAD_PARAMETER);
+
+	*offset = off;
+
+	return TSS_SUCCESS;
+}
+
+/* Load the TCSD header out of the front of a raw packet */
+static TSS_RESULT
+batch_unload_hdr(struct tcsd_comm_data *comm)
+{
+	if (comm->buf_size < sizeof(struct tcsd_packet_hdr))
+		return TCSERR(TSS_E_BAD_PARAMETER);
+
+	/* the header is packed, so decode by value rather than through member pointers */
+	comm->hdr.packet_size = Decode_UINT32(comm->buf);
+	comm->hdr.u.ordinal = Decode_UINT32(comm->buf + 4);
+	comm->hdr.num_parms = Decode_UINT32(comm->buf + 8);
+	comm->hdr.type_size = Decode_UINT32(comm->buf + 12);
+	comm->hdr.type_offset = Decode_UINT32(comm->buf + 16);
+	comm->hdr.parm_size = Decode_UINT32(comm->buf + 20);
+	comm->hdr.parm_offset = Decode_UINT32(comm->buf + 24);
+
+	if (comm->hdr.packet_size != comm->buf_size ||
+	    comm->hdr.packet_size != comm->hdr.parm_offset + comm->hdr.parm_size ||
+	    comm->hdr.type_offset + comm->hdr.type_size > comm->hdr.parm_offset) {
+		LogError("Invalid packet in TCSD batch");
+		return TCSERR(TSS_E_BAD_PARAMETER);
+	}
+
+	return TSS_SUCCESS;
+}
+
+static TSS_RESULT
+batch_apply_refs(struct tcsd_batch_entry *entries, UINT32 i)
+{
+	struct tcsd_batch_entry *e = &entries[i], *src;
+	struct tcsd_batch_ref *ref;
+	UINT64 src_off, dst_off;
+	UINT32 value, j;
+	TSS_RESULT result;
+
+	for (j = 0; j < e->num_refs; j++) {
+		ref = &e->refs[j];
+		if (ref->src_entry >= i)
+			return TCSERR(TSS_E_BAD_PARAMETER);
+
+		src = &entries[ref->src_entry];
+		if ((result = batch_parm_offset(&src->comm, ref->src_parm, 41, &src_off)))
+			return result;
+		if ((result = batch_parm_offset(&e->comm, ref->dst_parm, 45, &dst_off)))
+			return result;
+
+		UnloadBlob_UINT32(&src_off, &value, src->comm.buf);
+		LoadBlob_UINT32(&dst_off, value, e->comm.buf);
+	}
+
+	return TSS_SUCCESS;
+}
+
+static void
+batch_free_entries(struct tcsd_batch_entry *entries, UINT32 count)
+{
+	UINT32 i;
+
+	for (i = 0; i < count; i++) {
+		free(entries[i].refs);
+		free(entries[i].comm.buf);
+	}
+	free(entries);
+}
+
+TSS_RESULT
+tcs_wrap_Batch(struct tcsd_thread_data *data)
+{
+	struct tcsd_batch_entry *entries, *e;
+	struct tcsd_thread_data sub;
+	UINT32 numEntries, numDone, i, j, size;
+	int parm = 0;
+	TSS_RESULT result;
+	UINT64 offset;
+
+	if (getData(TCSD_PACKET_TYPE_UINT32, parm++, &numEntries, 0, &data->comm))
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+
+	LogDebugFn("thread %ld, %u entries", THREAD_ID, numEntries);
+
+	if (numEntries == 0 || numEntries > TCSD_MAX_BATCH_ENTRIES) {
+		initData(&data->comm, 0);
+		data->comm.hdr.u.result = TCSERR(TSS_E_BAD_PARAMETER);
+		return TSS_SUCCESS;
+	}
+
+	if ((entries = calloc(numEntries, sizeof(struct tcsd_batch_entry))) == NULL) {
+		LogError("malloc of %zu bytes failed.",
+			 numEntries * sizeof(struct tcsd_batch_entry));
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
+	/* pull every entry out of the packet before anything is dispatched, since the
+	 * dispatch reuses the thread's comm buffer for the reply */
+	for (i = 0; i < numEntries; i++) {
+		e = &entries[i];
+
+		if (getData(TCSD_PACKET_TYPE_UINT32, parm++, &e->num_refs, 0, &data->comm))
+			goto bad_packet;
+		if (e->num_refs > TCSD_MAX_NUM_ORDS)
+			goto bad_packet;
+		if (e->num_refs) {
+			e->refs = calloc(e->num_refs, sizeof(struct tcsd_batch_ref));
+			if (e->refs == NULL) {
+				LogError("malloc of %zu bytes failed.",
+					 e->num_refs * sizeof(struct tcsd_batch_ref));
+				batch_free_entries(entries, numEntries);
+				return TCSERR(TSS_E_OUTOFMEMORY);
+			}
+		}
+		for (j = 0; j < e->num_refs; j++) {
+			if (getData(TCSD_PACKET_TYPE_UINT32, parm++, &e->refs[j].src_entry, 0,
+				    &data->comm))
+				goto bad_packet;
+			if (getData(TCSD_PACKET_TYPE_UINT32, parm++, &e->refs[j].src_parm, 0,
+				    &data->comm))
+				goto bad_packet;
+			if (getData(TCSD_PACKET_TYPE_UINT32, parm++, &e->refs[j].dst_parm, 0,
+				    &data->comm))
+				goto bad_packet;
+		}
+
+		if (getData(TCSD_PACKET_TYPE_UINT32, parm++, &size, 0, &data->comm))
+			goto bad_packet;
+		if (size < sizeof(struct tcsd_packet_hdr) || size > data->comm.hdr.parm_size)
+			goto bad_packet;
+
+		if ((e->comm.buf = malloc(size)) == NULL) {
+			LogError("malloc of %u bytes failed.", size);
+			batch_free_entries(entries, numEntries);
+			return TCSERR(TSS_E_OUTOFMEMORY);
+		}
+		e->comm.buf_size = size;
+		if (getData(TCSD_PACKET_TYPE_PBYTE, parm++, e->comm.buf, size, &data->comm))
+			goto bad_packet;
+		if (batch_unload_hdr(&e->comm))
+			goto bad_packet;
+		if (e->comm.hdr.u.ordinal == TCSD_ORD_BATCH) {
+			LogError("Nested TCSD batch requests are not allowed");
+			goto bad_packet;
+		}
+	}
+
+	/* Run the entries in order, stopping at the first one that fails since later
+	 * entries may depend on its output */
+	for (numDone = 0; numDone < numEntries; numDone++) {
+		e = &entries[numDone];
+
+		if ((result = batch_apply_refs(entries, numDone))) {
+			LogDebug("Unresolvable reference in TCSD batch entry %u", numDone);
+			break;
+		}
+
+		sub = *data;
+		sub.comm = e->comm;
+
+		if ((result = dispatchCommand(&sub))) {
+			/* mirror what tcsd_thread_run does for a failed dispatch */
+			sub.comm.hdr.packet_size = sizeof(struct tcsd_packet_hdr);
+			sub.comm.hdr.u.result = result;
+			sub.comm.hdr.num_parms = 0;
+			memset(sub.comm.buf, 0, sub.comm.buf_size);
+			offset = 0;
+			LoadBlob_UINT32(&offset, sub.comm.hdr.packet_size, sub.comm.buf);
+			LoadBlob_UINT32(&offset, sub.comm.hdr.u.result, sub.comm.buf);
+		}
+
+		/* the sub-command may have opened or closed the thread's context */
+		data->context = sub.context;
+		e->comm = sub.comm;
+
+		if (e->comm.hdr.u.result != TSS_SUCCESS) {
+			numDone++;
+			break;
+		}
+	}
+
+	initData(&data->comm, 1 + (2 * numDone));
+	parm = 0;
+	if (setData(TCSD_PACKET_TYPE_UINT32, parm++, &numDone, 0, &data->comm))
+		goto internal_error;
+	for (i = 0; i < numDone; i++) {
+		e = &entries[i];
+		size = e->comm.hdr.packet_size;
+
+		if (setData(TCSD_PACKET_TYPE_UINT32, parm++, &size, 0, &data->comm))
+			goto internal_error;
+		if (setData(TCSD_PACKET_TYPE_PBYTE, parm++, e->comm.buf, size, &data->comm))
+			goto internal_error;
+	}
+
+	batch_free_entries(entries, numEntries);
+	data->comm.hdr.u.result = TSS_SUCCESS;
+
+	return TSS_SUCCESS;
+
+bad_packet:
+	batch_free_entries(entries, numEntries);
+	initData(&data->comm, 0);
+	data->comm.hdr.u.result = TCSERR(TSS_E_BAD_PARAMETER);
+
+	return TSS_SUCCESS;
+
+internal_error:
+	batch_free_entries(entries, numEntries);
+
+	return TCSERR(TSS_E_INTERNAL_ERROR);
+}
@@ -140,8 +140,9 @@ tcs_wrap_ExecuteTransport(struct tcsd_thread_data *data)
 {
 	TCS_CONTEXT_HANDLE hContext;
 	TPM_COMMAND_CODE unWrappedCommandOrdinal;
-	TCS_HANDLE *rghHandles = NULL, handles[2];
+	TCS_HANDLE *rghHandles = NULL, handles[TSS_TRANSPORT_INLINE_HANDLES];
 	UINT32 ulWrappedCmdDataInSize, pulHandleListSize, ulWrappedCmdDataOutSize, i = 0;
+	UINT32 handleParm;
 	BYTE *rgbWrappedCmdDataIn, *rgbWrappedCmdDataOut;
 	TPM_MODIFIER_INDICATOR pbLocality;
 	TPM_AUTH pWrappedCmdAuth1, pWrappedCmdAuth2, pTransAuth, *pAuth1, *pAuth2, null_auth;
@@ -176,19 +177,16 @@ tcs_wrap_ExecuteTransport(struct tcsd_thread_data *data)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	if (pulHandleListSize > 2) {
+	if (pulHandleListSize > data->comm.hdr.parm_size / sizeof(UINT32)) {
 		free(rgbWrappedCmdDataIn);
 		return TCSERR(TSS_E_BAD_PARAMETER);
 	}
 
-	if (pulHandleListSize) {
-		if (getData(TCSD_PACKET_TYPE_PBYTE, i++, handles,
-			    pulHandleListSize * sizeof(UINT32), &data->comm)) {
-			free(rgbWrappedCmdDataIn);
-			return TCSERR(TSS_E_INTERNAL_ERROR);
-		}
-	}
-	rghHandles = handles;
+	/* the handle list is only sent when it's not empty. It's read after the auths, so that
+	 * their error paths don't have to free it */
+	handleParm = i;
+	if (pulHandleListSize)
+		i++;
 
 	memset(&null_auth, 0, sizeof(TPM_AUTH));
 	memset(&pWrappedCmdAuth1, 0, sizeof(TPM_AUTH));
@@ -217,6 +215,25 @@ tcs_wrap_ExecuteTransport(struct tcsd_thread_data *data)
 	else
 		pAuth2 = &pWrappedCmdAuth2;
 
+	rghHandles = handles;
+	if (pulHandleListSize > TSS_TRANSPORT_INLINE_HANDLES) {
+		if ((rghHandles = malloc(pulHandleListSize * sizeof(UINT32))) == NULL) {
+			LogError("malloc of %zd bytes failed", pulHandleListSize * sizeof(UINT32));
+			free(rgbWrappedCmdDataIn);
+			return TCSERR(TSS_E_INTERNAL_ERROR);
+		}
+	}
+
+	if (pulHandleListSize) {
+		if (getData(TCSD_PACKET_TYPE_PBYTE, handleParm, rghHandles,
+			    pulHandleListSize * sizeof(UINT32), &data->comm)) {
+			free(rgbWrappedCmdDataIn);
+			if (rghHandles != handles)
+				free(rghHandles);
+			return TCSERR(TSS_E_INTERNAL_ERROR);
+		}
+	}
+
 	MUTEX_LOCK(tcsp_lock);
 
 	result = TCSP_ExecuteTransport_Internal(hContext, unWrappedCommandOrdinal,
@@ -233,17 +250,17 @@ tcs_wrap_ExecuteTransport(struct tcsd_thread_data *data)
 	if (result == TSS_SUCCESS) {
 		i = 0;
 		initData(&data->comm, 10);
-		if (setData(TCSD_PACKET_TYPE_UINT32, i++, &pulHandleListSize, 0, &data->comm)) {
+		if (setData(TCSD_PACKET_TYPE_UINT32, i++, &pulHandleListSize, 0, &data->comm) ||
+		    (pulHandleListSize &&
+		     setData(TCSD_PACKET_TYPE_PBYTE, i++, rghHandles,
+			     pulHandleListSize * sizeof(UINT32), &data->comm))) {
 			free(rgbWrappedCmdDataOut);
+			if (rghHandles != handles)
+				free(rghHandles);
 			return TCSERR(TSS_E_INTERNAL_ERROR);
 		}
-		if (pulHandleListSize) {
-			if (setData(TCSD_PACKET_TYPE_PBYTE, i++, rghHandles,
-				    pulHandleListSize * sizeof(UINT32), &data->comm)) {
-				free(rgbWrappedCmdDataOut);
-				return TCSERR(TSS_E_INTERNAL_ERROR);
-			}
-		}
+		if (rghHandles != handles)
+			free(rghHandles);
 		if (pAuth1) {
 			if (setData(TCSD_PACKET_TYPE_AUTH, i++, pAuth1, 0, &data->comm)) {
 				free(rgbWrappedCmdDataOut);
@@ -296,8 +313,11 @@ tcs_wrap_ExecuteTransport(struct tcsd_thread_data *data)
 			}
 		}
 		free(rgbWrappedCmdDataOut);
-	} else
+	} else {
+		if (rghHandles != handles)
+			free(rghHandles);
 done:		initData(&data->comm, 0);
+	}
 
 	data->comm.hdr.u.result = result;
 	return TSS_SUCCESS;
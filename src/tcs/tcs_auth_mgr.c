@@ -24,6 +24,7 @@
 #include "tcsd.h"
 #include "auth_mgr.h"
 #include "req_mgr.h"
+#include "tcs_stats.h"
 
 
 MUTEX_DECLARE_EXTERN(tcsp_lock);
@@ -126,8 +127,10 @@ auth_mgr_swap_out(TCS_CONTEXT_HANDLE hContext)
 	COND_VAR *cond;
 
 	/* If the TPM can do swapping and it succeeds, return, else cond wait below */
-	if (tpm_metrics.authctx_swap && !auth_mgr_save_ctx(hContext))
+	if (tpm_metrics.authctx_swap && !auth_mgr_save_ctx(hContext)) {
+		tcs_stats_count(TCS_STATS_AUTH_SWAPS);
 		return TSS_SUCCESS;
+	}
 
 	if ((cond = ctx_get_cond_var(hContext)) == NULL) {
 		LogError("Auth swap variable not found for TCS context 0x%x", hContext);
@@ -151,6 +154,7 @@ auth_mgr_swap_out(TCS_CONTEXT_HANDLE hContext)
 		/* go to sleep */
 		LogDebug("thread %lddd going to sleep until auth slot opens", THREAD_ID);
 		auth_mgr.sleeping_threads++;
+		tcs_stats_count(TCS_STATS_AUTH_WAITS);
 		COND_WAIT(cond, &tcsp_lock);
 		auth_mgr.sleeping_threads--;
 	} else if (auth_mgr.overflow_size + TSS_DEFAULT_OVERFLOW_AUTHS < UINT_MAX) {
@@ -182,6 +186,7 @@ auth_mgr_swap_out(TCS_CONTEXT_HANDLE hContext)
 		auth_mgr.of_head = (auth_mgr.of_head + 1) % auth_mgr.overflow_size;
 		LogDebug("thread %lddd going to sleep until auth slot opens", THREAD_ID);
 		auth_mgr.sleeping_threads++;
+		tcs_stats_count(TCS_STATS_AUTH_WAITS);
 		COND_WAIT(cond, &tcsp_lock);
 		auth_mgr.sleeping_threads--;
 	} else {
@@ -31,6 +31,143 @@
 #include "req_mgr.h"
 
 
+/* The TPM's list of defined NV indices only changes when the TCS sends one of the commands
+ * that invalidate the cache below, so the GetCapability answer for it is kept here. The
+ * TPM_NV_DATA_PUBLIC of an index isn't: its bReadSTClear and bWriteSTClear flags are also
+ * reset by TPM_Startup(ST_CLEAR), which may reach the TPM without going through the TCS.
+ * nv_cache_gen counts invalidations, so an answer that was read from the TPM while an index
+ * was being changed isn't kept. */
+struct nv_cache_entry {
+	TCPA_CAPABILITY_AREA capArea;
+	TPM_NV_INDEX index;		/* always 0 for TPM_CAP_NV_LIST */
+	UINT32 size;
+	BYTE *data;
+	struct nv_cache_entry *next;
+};
+
+static MUTEX_DECLARE_INIT(nv_cache_lock);
+static struct nv_cache_entry *nv_cache_head = NULL;
+static UINT32 nv_cache_gen = 0;
+
+static TSS_BOOL
+nv_cache_key(TCPA_CAPABILITY_AREA capArea, UINT32 subCapSize, BYTE *subCap, TPM_NV_INDEX *index)
+{
+	switch (capArea) {
+		case TPM_CAP_NV_LIST:
+			*index = 0;
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+/* Look up a GetCapability answer. On a hit, *resp is a copy for the caller to free. On a
+ * miss, *gen is set to the value to pass to nv_cache_put() with the TPM's answer */
+TSS_BOOL
+nv_cache_get(TCPA_CAPABILITY_AREA capArea, UINT32 subCapSize, BYTE *subCap, UINT32 *gen,
+	     UINT32 *respSize, BYTE **resp)
+{
+	struct nv_cache_entry *entry;
+	TPM_NV_INDEX index;
+	TSS_BOOL found = FALSE;
+
+	if (!nv_cache_key(capArea, subCapSize, subCap, &index))
+		return FALSE;
+
+	MUTEX_LOCK(nv_cache_lock);
+
+	for (entry = nv_cache_head; entry; entry = entry->next) {
+		if (entry->capArea == capArea && entry->index == index)
+			break;
+	}
+
+	if (entry) {
+		/* a failed malloc just means asking the TPM */
+		if ((*resp = malloc(entry->size ? entry->size : 1))) {
+			if (entry->size)
+				memcpy(*resp, entry->data, entry->size);
+			*respSize = entry->size;
+			found = TRUE;
+		}
+	}
+	*gen = nv_cache_gen;
+
+	MUTEX_UNLOCK(nv_cache_lock);
+
+	return found;
+}
+
+void
+nv_cache_put(TCPA_CAPABILITY_AREA capArea, UINT32 subCapSize, BYTE *subCap, UINT32 gen,
+	     UINT32 respSize, BYTE *resp)
+{
+	struct nv_cache_entry *entry;
+	TPM_NV_INDEX index;
+
+	if (!nv_cache_key(capArea, subCapSize, subCap, &index))
+		return;
+
+	if ((entry = calloc(1, sizeof(struct nv_cache_entry))) == NULL)
+		return;
+
+	if ((entry->data = malloc(respSize ? respSize : 1)) == NULL) {
+		free(entry);
+		return;
+	}
+	if (respSize)
+		memcpy(entry->data, resp, respSize);
+	entry->size = respSize;
+	entry->capArea = capArea;
+	entry->index = index;
+
+	MUTEX_LOCK(nv_cache_lock);
+
+	/* if the cache was invalidated since the TPM was asked, the answer may be stale. If
+	 * another thread got here first, its answer is as good as this one */
+	if (gen == nv_cache_gen) {
+		struct nv_cache_entry *e;
+
+		for (e = nv_cache_head; e; e = e->next) {
+			if (e->capArea == capArea && e->index == index)
+				break;
+		}
+		if (e == NULL) {
+			entry->next = nv_cache_head;
+			nv_cache_head = entry;
+			entry = NULL;
+		}
+	}
+
+	MUTEX_UNLOCK(nv_cache_lock);
+
+	if (entry) {
+		free(entry->data);
+		free(entry);
+	}
+}
+
+/* Drop everything, after indices were defined or released, the TPM was cleared or started,
+ * the TDDL reconnected, or an NV command went to the TPM inside a transport session */
+void
+nv_cache_invalidate_all()
+{
+	struct nv_cache_entry *entry, *next;
+
+	MUTEX_LOCK(nv_cache_lock);
+
+	nv_cache_gen++;
+	entry = nv_cache_head;
+	nv_cache_head = NULL;
+
+	MUTEX_UNLOCK(nv_cache_lock);
+
+	for (; entry; entry = next) {
+		next = entry->next;
+		free(entry->data);
+		free(entry);
+	}
+}
+
 TSS_RESULT
 get_current_version(TPM_VERSION *version)
 {
@@ -142,6 +279,34 @@ get_max_auths(UINT32 *auths)
 	return result;
 }
 
+/* Hand the TPM's command durations to the TDDL so it can time out commands that never
+ * complete. This isn't fatal, the TDDL falls back to its default timeouts. */
+void
+set_tddl_durations()
+{
+	UINT32 subCap, respSize, durations[TDDL_NUM_DURATIONS];
+	BYTE *resp;
+	UINT64 offset;
+	int i;
+
+	UINT32ToArray(TPM_CAP_PROP_DURATION, (BYTE *)&subCap);
+	if (TCSP_GetCapability_Internal(InternalContext, TPM_CAP_PROPERTY, sizeof(UINT32),
+					(BYTE *)&subCap, &respSize, &resp)) {
+		LogDebug("TPM didn't report its command durations, using TDDL defaults");
+		return;
+	}
+
+	if (respSize == sizeof(durations)) {
+		offset = 0;
+		for (i = 0; i < TDDL_NUM_DURATIONS; i++)
+			UnloadBlob_UINT32(&offset, &durations[i], resp);
+
+		Tddli_SetDurations(durations);
+	}
+
+	free(resp);
+}
+
 /* This is only called from init paths, so printing an error message is
  * appropriate if something goes wrong */
 TSS_RESULT
@@ -184,6 +349,9 @@ get_tpm_metrics(struct tpm_properties *p)
 					(UINT32 *)&p->manufacturer)))
 		goto err;
 
+	if (p->version.major == 1 && p->version.minor == 2)
+		set_tddl_durations();
+
 	result = get_max_auths(&(p->num_auths));
 
 err:
@@ -70,7 +70,11 @@ create_tcs_context()
 	struct tcs_context *ret = (struct tcs_context *)calloc(1, sizeof(struct tcs_context));
 
 	if (ret != NULL) {
-		ret->handle = getNextHandle();
+		/* The random bits are OR'd into the counter, so a handle can come around again
+		 * while its first owner is still open. Called with tcs_ctx_lock held */
+		do {
+			ret->handle = getNextHandle();
+		} while (get_context(ret->handle) != NULL);
 		COND_INIT(ret->cond);
 	}
 	return ret;
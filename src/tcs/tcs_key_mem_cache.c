@@ -25,6 +25,7 @@
 #include "tcslog.h"
 #include "tcsps.h"
 #include "req_mgr.h"
+#include "tcs_stats.h"
 
 #include "tcs_key_ps.h"
 
@@ -152,43 +153,172 @@ done:
 
 TCPA_RESULT
 ensureKeyIsLoaded(TCS_CONTEXT_HANDLE hContext, TCS_KEY_HANDLE keyHandle, TCPA_KEY_HANDLE * keySlot)
+{
+	return ensureKeysAreLoaded(hContext, 1, &keyHandle, keySlot);
+}
+
+/* The keys ensureKeysAreLoaded() is resolving, which evictFirstKey() leaves alone. Only
+ * set while mem_cache_lock is held */
+static TCS_KEY_HANDLE *mc_pinned = NULL;
+static UINT32 mc_num_pinned = 0;
+
+static TSS_BOOL
+mc_is_pinned(TCS_KEY_HANDLE tcs_handle)
+{
+	UINT32 i;
+
+	for (i = 0; i < mc_num_pinned; i++) {
+		if (mc_pinned[i] == tcs_handle)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* The key handles the TPM reported as loaded. It's fetched the first time a cached slot
+ * needs checking and then kept up to date with the keys loaded through it, so that one
+ * call into the key manager asks the TPM at most once. */
+struct mc_loaded_keys {
+	TSS_BOOL fetched;
+	TCPA_KEY_HANDLE_LIST list;
+};
+
+static TSS_RESULT load_key_shim(TCS_CONTEXT_HANDLE, TCPA_STORE_PUBKEY *, TSS_UUID *,
+				TCPA_KEY_HANDLE *, struct mc_loaded_keys *);
+
+/* same as isKeyLoaded(), but checks @loaded rather than querying the TPM every time */
+static TSS_BOOL
+mc_is_slot_loaded(struct mc_loaded_keys *loaded, TCPA_KEY_HANDLE keySlot)
+{
+	UINT32 respSize, i;
+	UINT64 offset;
+	BYTE *resp;
+
+	if (keySlot == SRK_TPM_HANDLE)
+		return TRUE;
+
+	if (!loaded->fetched) {
+		loaded->fetched = TRUE;
+		if (TCSP_GetCapability_Internal(InternalContext, TCPA_CAP_KEY_HANDLE, 0, NULL,
+						&respSize, &resp) == TSS_SUCCESS) {
+			offset = 0;
+			UnloadBlob_KEY_HANDLE_LIST(&offset, resp, &loaded->list);
+			free(resp);
+		}
+	}
+
+	for (i = 0; i < loaded->list.loaded; i++) {
+		if (loaded->list.handle[i] == keySlot)
+			return TRUE;
+	}
+
+	LogDebugFn("Key is not loaded, changing slot");
+	mc_set_slot_by_slot(keySlot, NULL_TPM_HANDLE);
+	return FALSE;
+}
+
+/* record a key that was just loaded. If there's no room, fetch the list again next time */
+static void
+mc_add_loaded_slot(struct mc_loaded_keys *loaded, TCPA_KEY_HANDLE keySlot)
+{
+	TCPA_KEY_HANDLE *handle;
+
+	if (!loaded->fetched || keySlot == NULL_TPM_HANDLE)
+		return;
+
+	handle = realloc(loaded->list.handle, (loaded->list.loaded + 1) * sizeof(TCPA_KEY_HANDLE));
+	if (handle == NULL) {
+		free(loaded->list.handle);
+		loaded->list.handle = NULL;
+		loaded->list.loaded = 0;
+		loaded->fetched = FALSE;
+		return;
+	}
+
+	handle[loaded->list.loaded++] = keySlot;
+	loaded->list.handle = handle;
+}
+
+/* Resolve the TPM slots for a set of keys in one pass, loading those that aren't in the TPM.
+ * The TPM is asked which keys it holds at most once, and only if one of the keys, or a parent
+ * that has to be loaded, has a cached slot to check. While the missing keys are loaded, the
+ * whole set is pinned so that making room for one can't evict another. A handle that
+ * appears more than once is loaded once. As with ensureKeyIsLoaded(), nothing stops
+ * another context from evicting the keys once this returns and before the caller's
+ * command reaches the TPM. */
+TCPA_RESULT
+ensureKeysAreLoaded(TCS_CONTEXT_HANDLE hContext, UINT32 numKeys, TCS_KEY_HANDLE *keyHandles,
+		    TCPA_KEY_HANDLE *keySlots)
 {
 	TCPA_RESULT result = TSS_SUCCESS;
 	TCPA_STORE_PUBKEY *myPub;
+	struct mc_loaded_keys loaded = { FALSE, { 0, NULL } };
+	UINT32 i, j;
 
-	LogDebugFn("0x%x", keyHandle);
+	for (i = 0; i < numKeys; i++) {
+		LogDebugFn("0x%x", keyHandles[i]);
 
-	if (!ctx_has_key_loaded(hContext, keyHandle))
-		return TCSERR(TCS_E_INVALID_KEY);
+		if (!ctx_has_key_loaded(hContext, keyHandles[i]))
+			return TCSERR(TCS_E_INVALID_KEY);
+	}
 
 	MUTEX_LOCK(mem_cache_lock);
 
-	*keySlot = mc_get_slot_by_handle(keyHandle);
-	LogDebug("keySlot is %08X", *keySlot);
-	if (*keySlot == NULL_TPM_HANDLE || isKeyLoaded(*keySlot) == FALSE) {
+	mc_pinned = keyHandles;
+	mc_num_pinned = numKeys;
+
+	for (i = 0; i < numKeys; i++) {
+		keySlots[i] = mc_get_slot_by_handle(keyHandles[i]);
+		LogDebug("keySlot is %08X", keySlots[i]);
+		if (keySlots[i] == NULL_TPM_HANDLE)
+			continue;
+
+		if (mc_is_slot_loaded(&loaded, keySlots[i]))
+			mc_update_time_stamp(keySlots[i]);
+		else
+			keySlots[i] = NULL_TPM_HANDLE;
+	}
+
+	for (i = 0; i < numKeys; i++) {
+		if (keySlots[i] != NULL_TPM_HANDLE)
+			continue;
+
+		/* a duplicate of a handle that's already been loaded */
+		for (j = 0; j < i; j++) {
+			if (keyHandles[j] == keyHandles[i])
+				break;
+		}
+		if (j < i) {
+			keySlots[i] = keySlots[j];
+			continue;
+		}
+
 		LogDebug("calling mc_get_pub_by_handle");
-		if ((myPub = mc_get_pub_by_handle(keyHandle)) == NULL) {
+		if ((myPub = mc_get_pub_by_handle(keyHandles[i])) == NULL) {
 			LogDebug("Failed to find pub by handle");
 			result = TCSERR(TCS_E_KM_LOADFAILED);
 			goto done;
 		}
 
-		LogDebugFn("calling LoadKeyShim");
-		if ((result = LoadKeyShim(hContext, myPub, NULL, keySlot))) {
+		LogDebugFn("calling load_key_shim");
+		if ((result = load_key_shim(hContext, myPub, NULL, &keySlots[i], &loaded))) {
 			LogDebug("Failed shim");
 			goto done;
 		}
 
-		if (*keySlot == NULL_TPM_HANDLE) {
-			LogDebug("Key slot is still invalid after ensureKeyIsLoaded");
+		if (keySlots[i] == NULL_TPM_HANDLE) {
+			LogDebug("Key slot is still invalid after ensureKeysAreLoaded");
 			result = TCSERR(TCS_E_KM_LOADFAILED);
 			goto done;
 		}
+		mc_update_time_stamp(keySlots[i]);
 	}
-	mc_update_time_stamp(*keySlot);
 
 done:
+	mc_pinned = NULL;
+	mc_num_pinned = 0;
 	MUTEX_UNLOCK(mem_cache_lock);
+	free(loaded.list.handle);
 	LogDebugFn("Exit");
 	return result;
 }
@@ -902,6 +1032,7 @@ evictFirstKey(TCS_KEY_HANDLE parent_tcs_handle)
 		if (tmp->tpm_handle != NULL_TPM_HANDLE &&	/* not already evicted */
 		    tmp->tpm_handle != SRK_TPM_HANDLE &&	/* not the srk */
 		    tmp->tcs_handle != parent_tcs_handle &&	/* not my parent */
+		    !mc_is_pinned(tmp->tcs_handle) &&		/* not in use by this load */
 		    tmp->time_stamp < smallestTimeStamp) {	/* is the smallest time
 								   stamp so far */
 			tpm_handle_to_evict = tmp->tpm_handle;
@@ -914,6 +1045,7 @@ evictFirstKey(TCS_KEY_HANDLE parent_tcs_handle)
 			return result;
 
 		LogDebugFn("Evicted key w/ TPM handle 0x%x", tpm_handle_to_evict);
+		tcs_stats_count(TCS_STATS_KEY_EVICTIONS);
 		result = mc_set_slot_by_slot(tpm_handle_to_evict, NULL_TPM_HANDLE);
 	} else
 		return TSS_SUCCESS;
@@ -963,6 +1095,19 @@ TSS_RESULT
 LoadKeyShim(TCS_CONTEXT_HANDLE hContext, TCPA_STORE_PUBKEY *pubKey,
 	    TSS_UUID *parentUuid, TCPA_KEY_HANDLE *slotOut)
 {
+	struct mc_loaded_keys loaded = { FALSE, { 0, NULL } };
+	TSS_RESULT result;
+
+	result = load_key_shim(hContext, pubKey, parentUuid, slotOut, &loaded);
+	free(loaded.list.handle);
+
+	return result;
+}
+
+static TSS_RESULT
+load_key_shim(TCS_CONTEXT_HANDLE hContext, TCPA_STORE_PUBKEY *pubKey,
+	      TSS_UUID *parentUuid, TCPA_KEY_HANDLE *slotOut, struct mc_loaded_keys *loaded)
+{
 
 	TCPA_STORE_PUBKEY *parentPub;
 	UINT32 result;
@@ -978,7 +1123,7 @@ LoadKeyShim(TCS_CONTEXT_HANDLE hContext, TCPA_STORE_PUBKEY *pubKey,
 
 	/* If I'm loaded, then no point being here.  Get the slot and return */
 	keySlot = mc_get_slot_by_pub(pubKey);
-	if (keySlot != NULL_TPM_HANDLE && isKeyLoaded(keySlot)) {
+	if (keySlot != NULL_TPM_HANDLE && mc_is_slot_loaded(loaded, keySlot)) {
 		*slotOut = keySlot;
 		return TSS_SUCCESS;
 	}
@@ -1007,8 +1152,8 @@ LoadKeyShim(TCS_CONTEXT_HANDLE hContext, TCPA_STORE_PUBKEY *pubKey,
 		return TCSERR(TCS_E_KM_LOADFAILED);
 #endif
 	} else {
-		LogDebugFn("calling LoadKeyShim");
-		if ((result = LoadKeyShim(hContext, parentPub, NULL, &parentSlot)))
+		LogDebugFn("calling load_key_shim");
+		if ((result = load_key_shim(hContext, parentPub, NULL, &parentSlot, loaded)))
 			return result;
 	}
 
@@ -1040,6 +1185,8 @@ LoadKeyShim(TCS_CONTEXT_HANDLE hContext, TCPA_STORE_PUBKEY *pubKey,
 		if (result)
 			return result;
 
+		mc_add_loaded_slot(loaded, mc_get_slot_by_handle(tcsKeyHandle));
+		tcs_stats_count(TCS_STATS_KEY_LOADS);
 		return ctx_mark_key_loaded(hContext, tcsKeyHandle);
 #if TSS_BUILD_PS
 	} else {
@@ -1058,7 +1205,9 @@ LoadKeyShim(TCS_CONTEXT_HANDLE hContext, TCPA_STORE_PUBKEY *pubKey,
 		}
 		free(uuid);
 		*slotOut = mc_get_slot_by_handle(tcsKeyHandle);
+		mc_add_loaded_slot(loaded, *slotOut);
 
+		tcs_stats_count(TCS_STATS_KEY_LOADS);
 		return ctx_mark_key_loaded(hContext, tcsKeyHandle);
 #endif
 	}
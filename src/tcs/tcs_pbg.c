@@ -47,12 +47,13 @@ tpm_rsp_parse(TPM_COMMAND_CODE ordinal, BYTE *b, UINT32 len, ...)
 	switch (ordinal) {
 	case TPM_ORD_ExecuteTransport:
 	{
-		UINT32 *val1 = va_arg(ap, UINT32 *);
-		UINT32 *val2 = va_arg(ap, UINT32 *);
+		UINT32 num_handles = va_arg(ap, UINT32);
+		UINT32 *handles = va_arg(ap, UINT32 *);
 		UINT32 *len1 = va_arg(ap, UINT32 *);
 		BYTE **blob1 = va_arg(ap, BYTE **);
 		TPM_AUTH *auth1 = va_arg(ap, TPM_AUTH *);
 		TPM_AUTH *auth2 = va_arg(ap, TPM_AUTH *);
+		UINT32 i;
 		va_end(ap);
 
 		if (auth1 && auth2) {
@@ -69,10 +70,8 @@ tpm_rsp_parse(TPM_COMMAND_CODE ordinal, BYTE *b, UINT32 len, ...)
 			offset2 = len;
 
 		offset1 = TSS_TPM_TXBLOB_HDR_LEN;
-		if (val1)
-			UnloadBlob_UINT32(&offset1, val1, b);
-		if (val2)
-			UnloadBlob_UINT32(&offset1, val2, b);
+		for (i = 0; i < num_handles; i++)
+			UnloadBlob_UINT32(&offset1, &handles[i], b);
 
 		*len1 = offset2 - offset1;
 		if (*len1) {
@@ -1024,23 +1023,22 @@ tpm_rqu_build(TPM_COMMAND_CODE ordinal, UINT64 *outOffset, BYTE *out_blob, ...)
 	}
 #endif
 #ifdef TSS_BUILD_TRANSPORT
-	/* 3 UINT32's, 1 BLOB, 2 AUTHs */
+	/* 1 UINT32, n UINT32's, 1 BLOB, 2 AUTHs */
 	case TPM_ORD_ExecuteTransport:
 	{
 		UINT32 ord1 = va_arg(ap, UINT32);
-		UINT32 *keyslot1 = va_arg(ap, UINT32 *);
-		UINT32 *keyslot2 = va_arg(ap, UINT32 *);
+		UINT32 num_slots = va_arg(ap, UINT32);
+		UINT32 *keyslots = va_arg(ap, UINT32 *);
 		UINT32 in_len1 = va_arg(ap, UINT32);
 		BYTE *in_blob1 = va_arg(ap, BYTE *);
 		TPM_AUTH *auth1 = va_arg(ap, TPM_AUTH *);
 		TPM_AUTH *auth2 = va_arg(ap, TPM_AUTH *);
+		UINT32 i;
 		va_end(ap);
 
 		*outOffset += TSS_TPM_TXBLOB_HDR_LEN;
-		if (keyslot1)
-			LoadBlob_UINT32(outOffset, *keyslot1, out_blob);
-		if (keyslot2)
-			LoadBlob_UINT32(outOffset, *keyslot2, out_blob);
+		for (i = 0; i < num_slots; i++)
+			LoadBlob_UINT32(outOffset, keyslots[i], out_blob);
 		//LoadBlob_UINT32(outOffset, in_len1, out_blob);
 		if (in_blob1)
 			LoadBlob(outOffset, in_len1, out_blob, in_blob1);
@@ -23,6 +23,7 @@
 #include "tddl.h"
 #include "req_mgr.h"
 #include "tcslog.h"
+#include "tcs_stats.h"
 
 static struct tpm_req_mgr *trm;
 
@@ -37,19 +38,39 @@ req_mgr_submit_req(BYTE *blob)
 	BYTE loc_buf[TSS_TPM_TXBLOB_SIZE];
 	UINT32 size = TSS_TPM_TXBLOB_SIZE;
 	UINT32 retry = TSS_REQ_MGR_MAX_RETRIES;
+	UINT32 ordinal = Decode_UINT32(&blob[6]);
+	UINT64 queued, sent;
 
+	queued = tcs_stats_now();
 	MUTEX_LOCK(trm->queue_lock);
+	sent = tcs_stats_now();
 
 #ifdef TSS_TPM_DEBUG
 	LogBlobData("To TPM:", Decode_UINT32(&blob[2]), blob);
 #endif
 
 	do {
+		if (retry < TSS_REQ_MGR_MAX_RETRIES)
+			tcs_stats_count(TCS_STATS_TPM_RETRIES);
 		result = Tddli_TransmitData(blob, Decode_UINT32(&blob[2]), loc_buf, &size);
+		tcs_stats_count(TCS_STATS_TPM_COMMANDS);
 	} while (!result && (Decode_UINT32(&loc_buf[6]) == TCPA_E_RETRY) && --retry);
 
-	if (!result)
+	tcs_stats_tpm(queued, sent, tcs_stats_now());
+
+	/* a TPM the TDDL reconnected to, or one that was just started, may not have the NV
+	 * indices the cache says it has */
+	if (trm->open_count != Tddli_GetOpenCount() || ordinal == TPM_ORD_Startup) {
+		trm->open_count = Tddli_GetOpenCount();
+		nv_cache_invalidate_all();
+	}
+
+	if (!result) {
+		if (Decode_UINT32(&loc_buf[6]))
+			tcs_stats_count(TCS_STATS_TPM_ERRORS);
 		memcpy(blob, loc_buf, Decode_UINT32(&loc_buf[2]));
+	} else
+		tcs_stats_count(TCS_STATS_TDDL_ERRORS);
 
 #ifdef TSS_TPM_DEBUG
 	LogBlobData("From TPM:", size, loc_buf);
@@ -63,6 +84,8 @@ req_mgr_submit_req(BYTE *blob)
 TSS_RESULT
 req_mgr_init()
 {
+	TSS_RESULT result;
+
 	if ((trm = calloc(1, sizeof(struct tpm_req_mgr))) == NULL) {
 		LogError("malloc of %zd bytes failed.", sizeof(struct tpm_req_mgr));
 		return TSS_E_OUTOFMEMORY;
@@ -70,7 +93,12 @@ req_mgr_init()
 
 	MUTEX_INIT(trm->queue_lock);
 
-	return Tddli_Open();
+	Tddli_SetConfig(&tcsd_options);
+
+	result = Tddli_Open();
+	trm->open_count = Tddli_GetOpenCount();
+
+	return result;
 }
 
 TSS_RESULT
@@ -0,0 +1,344 @@
+
+/*
+ * Licensed Materials - Property of IBM
+ *
+ * trousers - An open source TCG Software Stack
+ *
+ * (C) Copyright International Business Machines Corp. 2004-2007
+ *
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "trousers/tss.h"
+#include "trousers_types.h"
+#include "tcs_tsp.h"
+#include "tcs_utils.h"
+#include "tcs_int_literals.h"
+#include "capabilities.h"
+#include "tcslog.h"
+#include "tcsd_wrap.h"
+#include "tcsd.h"
+#include "rpc_tcstp_tcs.h"
+#include "stats_hist.h"
+#include "tcs_stats.h"
+
+/* All updates are atomic adds, so the request path never takes a lock for the statistics.
+ * Readers see each value as of some point, but not necessarily a consistent set of them */
+struct tcs_stats_ordinal {
+	UINT64 errors;
+	struct tcs_stats_hist hist;
+};
+
+static UINT64 tcs_stats_counters[TCS_STATS_NUM_COUNTERS];
+static struct tcs_stats_hist tcs_stats_latencies[TCS_STATS_NUM_LATENCIES];
+static struct tcs_stats_ordinal tcs_stats_ordinals[TCSD_MAX_NUM_ORDS];
+static UINT64 tcs_stats_start;
+
+/* The queue and TPM time spent by the current thread so far. An ordinal's host time is its
+ * total time less the growth of these over the ordinal */
+static pthread_key_t tcs_stats_key;
+static pthread_once_t tcs_stats_once = PTHREAD_ONCE_INIT;
+
+static const char *tcs_stats_latency_names[TCS_STATS_NUM_LATENCIES] = {
+	"queue wait", "TPM time", "host time"
+};
+
+static const char *tcs_stats_counter_names[TCS_STATS_NUM_COUNTERS] = {
+	"TPM commands", "TPM retries", "TPM errors", "TDDL errors", "key loads",
+	"key evictions", "auth swaps", "auth waits"
+};
+
+UINT64
+tcs_stats_now()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (UINT64)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void
+tcs_stats_key_init(void)
+{
+	pthread_key_create(&tcs_stats_key, free);
+	tcs_stats_start = tcs_stats_now();
+}
+
+void
+tcs_stats_init()
+{
+	pthread_once(&tcs_stats_once, tcs_stats_key_init);
+}
+
+static struct tcs_stats_mark *
+tcs_stats_thread()
+{
+	struct tcs_stats_mark *mark;
+
+	tcs_stats_init();
+
+	if ((mark = pthread_getspecific(tcs_stats_key)) != NULL)
+		return mark;
+
+	/* on failure this thread's queue and TPM time are counted as host time */
+	if ((mark = calloc(1, sizeof(struct tcs_stats_mark))) == NULL)
+		return NULL;
+
+	if (pthread_setspecific(tcs_stats_key, mark)) {
+		free(mark);
+		return NULL;
+	}
+
+	return mark;
+}
+
+static void
+tcs_stats_record(struct tcs_stats_hist *hist, UINT64 v)
+{
+	UINT64 max;
+
+	__sync_fetch_and_add(&hist->count, 1);
+	__sync_fetch_and_add(&hist->total, v);
+	__sync_fetch_and_add(&hist->buckets[hist_bucket(v, TCS_STATS_SUB_BITS, TCS_STATS_BUCKETS)], 1);
+
+	max = hist->max;
+	while (v > max) {
+		if (__sync_bool_compare_and_swap(&hist->max, max, v))
+			break;
+		max = hist->max;
+	}
+}
+
+void
+tcs_stats_count(enum tcs_stats_counter c)
+{
+	__sync_fetch_and_add(&tcs_stats_counters[c], 1);
+}
+
+void
+tcs_stats_tpm(UINT64 queued, UINT64 sent, UINT64 done)
+{
+	struct tcs_stats_mark *mark = tcs_stats_thread();
+
+	tcs_stats_record(&tcs_stats_latencies[TCS_STATS_QUEUE_WAIT], sent - queued);
+	tcs_stats_record(&tcs_stats_latencies[TCS_STATS_TPM_TIME], done - sent);
+
+	if (mark) {
+		mark->queue += sent - queued;
+		mark->tpm += done - sent;
+	}
+}
+
+void
+tcs_stats_begin(struct tcs_stats_mark *m)
+{
+	struct tcs_stats_mark *mark = tcs_stats_thread();
+
+	if (mark) {
+		m->queue = mark->queue;
+		m->tpm = mark->tpm;
+	} else {
+		m->queue = m->tpm = 0;
+	}
+	m->start = tcs_stats_now();
+}
+
+void
+tcs_stats_end(struct tcs_stats_mark *m, UINT32 ordinal, TSS_RESULT result)
+{
+	struct tcs_stats_mark *mark = tcs_stats_thread();
+	UINT64 total = tcs_stats_now() - m->start, waited = 0;
+
+	if (mark)
+		waited = (mark->queue - m->queue) + (mark->tpm - m->tpm);
+
+	/* a batch's entries are accounted for in their own ordinals */
+	if (ordinal != TCSD_ORD_BATCH)
+		tcs_stats_record(&tcs_stats_latencies[TCS_STATS_HOST_TIME],
+				 total > waited ? total - waited : 0);
+
+	if (ordinal >= TCSD_MAX_NUM_ORDS)
+		return;
+
+	tcs_stats_record(&tcs_stats_ordinals[ordinal].hist, total);
+	if (result)
+		__sync_fetch_and_add(&tcs_stats_ordinals[ordinal].errors, 1);
+}
+
+static void
+tcs_stats_copy(struct tcs_stats_hist *dst, struct tcs_stats_hist *src)
+{
+	UINT32 i;
+
+	dst->count = 0;
+	dst->total = src->total;
+	dst->max = src->max;
+	/* sum the buckets rather than reading count, so the copy adds up */
+	for (i = 0; i < TCS_STATS_BUCKETS; i++) {
+		dst->buckets[i] = src->buckets[i];
+		dst->count += dst->buckets[i];
+	}
+}
+
+/* the upper bound of the bucket holding the value at p percent */
+static UINT64
+tcs_stats_percentile(struct tcs_stats_hist *hist, UINT32 p)
+{
+	return hist_percentile(hist->buckets, TCS_STATS_BUCKETS, TCS_STATS_SUB_BITS, hist->count,
+			       hist->max, p, 100);
+}
+
+static void
+LoadBlob_STATS_HIST(UINT64 *offset, BYTE *blob, struct tcs_stats_hist *hist)
+{
+	UINT32 i, nonzero = 0;
+
+	for (i = 0; i < TCS_STATS_BUCKETS; i++) {
+		if (hist->buckets[i])
+			nonzero++;
+	}
+
+	LoadBlob_UINT64(offset, hist->count, blob);
+	LoadBlob_UINT64(offset, hist->total, blob);
+	LoadBlob_UINT64(offset, hist->max, blob);
+	LoadBlob_UINT32(offset, nonzero, blob);
+	for (i = 0; i < TCS_STATS_BUCKETS; i++) {
+		if (!hist->buckets[i])
+			continue;
+		LoadBlob_UINT32(offset, i, blob);
+		LoadBlob_UINT64(offset, hist->buckets[i], blob);
+	}
+}
+
+struct tcs_stats_snapshot {
+	UINT64 counters[TCS_STATS_NUM_COUNTERS];
+	struct tcs_stats_hist latencies[TCS_STATS_NUM_LATENCIES];
+	struct tcs_stats_ordinal ordinals[TCSD_MAX_NUM_ORDS];
+	UINT32 num_ordinals;
+	UINT64 uptime;
+};
+
+static void
+tcs_stats_snapshot(struct tcs_stats_snapshot *s)
+{
+	UINT32 i;
+
+	tcs_stats_init();
+
+	s->uptime = tcs_stats_now() - tcs_stats_start;
+
+	for (i = 0; i < TCS_STATS_NUM_COUNTERS; i++)
+		s->counters[i] = tcs_stats_counters[i];
+	for (i = 0; i < TCS_STATS_NUM_LATENCIES; i++)
+		tcs_stats_copy(&s->latencies[i], &tcs_stats_latencies[i]);
+
+	s->num_ordinals = 0;
+	for (i = 0; i < TCSD_MAX_NUM_ORDS; i++) {
+		s->ordinals[i].errors = tcs_stats_ordinals[i].errors;
+		tcs_stats_copy(&s->ordinals[i].hist, &tcs_stats_ordinals[i].hist);
+		if (s->ordinals[i].hist.count)
+			s->num_ordinals++;
+	}
+}
+
+static void
+LoadBlob_STATS(UINT64 *offset, BYTE *blob, struct tcs_stats_snapshot *s)
+{
+	UINT32 i;
+
+	LoadBlob_UINT32(offset, TCS_STATS_VERSION, blob);
+	LoadBlob_UINT64(offset, s->uptime, blob);
+
+	LoadBlob_UINT32(offset, TCS_STATS_NUM_COUNTERS, blob);
+	for (i = 0; i < TCS_STATS_NUM_COUNTERS; i++)
+		LoadBlob_UINT64(offset, s->counters[i], blob);
+
+	LoadBlob_UINT32(offset, TCS_STATS_NUM_LATENCIES, blob);
+	for (i = 0; i < TCS_STATS_NUM_LATENCIES; i++)
+		LoadBlob_STATS_HIST(offset, blob, &s->latencies[i]);
+
+	LoadBlob_UINT32(offset, s->num_ordinals, blob);
+	for (i = 0; i < TCSD_MAX_NUM_ORDS; i++) {
+		if (!s->ordinals[i].hist.count)
+			continue;
+		LoadBlob_UINT32(offset, i, blob);
+		LoadBlob_UINT64(offset, s->ordinals[i].errors, blob);
+		LoadBlob_STATS_HIST(offset, blob, &s->ordinals[i].hist);
+	}
+}
+
+TSS_RESULT
+tcs_stats_get_blob(UINT32 *size, BYTE **blob)
+{
+	struct tcs_stats_snapshot *s;
+	UINT64 offset = 0;
+
+	if ((s = malloc(sizeof(struct tcs_stats_snapshot))) == NULL) {
+		LogError("malloc of %zd bytes failed.", sizeof(struct tcs_stats_snapshot));
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
+	tcs_stats_snapshot(s);
+
+	LoadBlob_STATS(&offset, NULL, s);
+	if ((*blob = malloc(offset)) == NULL) {
+		LogError("malloc of %" PRIu64 " bytes failed.", offset);
+		free(s);
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
+	*size = offset;
+	offset = 0;
+	LoadBlob_STATS(&offset, *blob, s);
+	free(s);
+
+	return TSS_SUCCESS;
+}
+
+static void
+tcs_stats_log_hist(const char *name, struct tcs_stats_hist *hist)
+{
+	LogInfo("%-24s n=%" PRIu64 " mean=%" PRIu64 "us p50=%" PRIu64 "us p99=%" PRIu64
+		"us max=%" PRIu64 "us", name, hist->count, hist->total / hist->count,
+		tcs_stats_percentile(hist, 50), tcs_stats_percentile(hist, 99), hist->max);
+}
+
+void
+tcs_stats_log()
+{
+	struct tcs_stats_snapshot *s;
+	UINT32 i;
+
+	if ((s = malloc(sizeof(struct tcs_stats_snapshot))) == NULL) {
+		LogError("malloc of %zd bytes failed.", sizeof(struct tcs_stats_snapshot));
+		return;
+	}
+
+	tcs_stats_snapshot(s);
+
+	LogInfo("Statistics after %" PRIu64 " seconds:", s->uptime / 1000000);
+	for (i = 0; i < TCS_STATS_NUM_COUNTERS; i++)
+		LogInfo("%-24s %" PRIu64, tcs_stats_counter_names[i], s->counters[i]);
+	for (i = 0; i < TCS_STATS_NUM_LATENCIES; i++) {
+		if (s->latencies[i].count)
+			tcs_stats_log_hist(tcs_stats_latency_names[i], &s->latencies[i]);
+	}
+	for (i = 0; i < TCSD_MAX_NUM_ORDS; i++) {
+		if (!s->ordinals[i].hist.count)
+			continue;
+		tcs_stats_log_hist(getTCSDOrdinalName(i), &s->ordinals[i].hist);
+		if (s->ordinals[i].errors)
+			LogInfo("%-24s errors=%" PRIu64, getTCSDOrdinalName(i),
+				s->ordinals[i].errors);
+	}
+
+	free(s);
+}
@@ -133,6 +133,9 @@ TCSP_ForceClear_Internal(TCS_CONTEXT_HANDLE hContext)	/* in */
 	if ((result = req_mgr_submit_req(txBlob)))
 		return result;
 
+	/* clearing releases NV indices */
+	nv_cache_invalidate_all();
+
 	result = UnloadBlob_Header(txBlob, &paramSize);
 	LogResult("Force Clear", result);
 	return result;
@@ -15,6 +15,7 @@
 #include <inttypes.h>
 
 #include "trousers/tss.h"
+#include "trousers/trousers.h"
 #include "trousers_types.h"
 #include "tcs_tsp.h"
 #include "tcsps.h"
@@ -24,6 +25,7 @@
 #include "tcslog.h"
 #include "tcsd_wrap.h"
 #include "tcsd.h"
+#include "tcs_stats.h"
 
 extern struct tcsd_config tcsd_options;
 
@@ -234,6 +236,9 @@ internal_TCSGetCap(TCS_CONTEXT_HANDLE hContext,
 			return TCSERR(TSS_E_BAD_PARAMETER);
 		}
 		break;
+	case TSS_TCSCAP_TROUSERS_STATS:
+		LogDebug("TSS_TCSCAP_TROUSERS_STATS");
+		return tcs_stats_get_blob(respSize, resp);
 	default:
 		LogDebugFn("Bad cap area");
 		return TCSERR(TSS_E_BAD_PARAMETER);
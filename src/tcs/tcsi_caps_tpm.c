@@ -36,12 +36,15 @@ TCSP_GetCapability_Internal(TCS_CONTEXT_HANDLE hContext,	/* in */
 			    BYTE ** resp)	/* out */
 {
 	UINT64 offset = 0;
-	UINT32 paramSize;
+	UINT32 paramSize, gen;
 	TSS_RESULT result;
 	BYTE txBlob[TSS_TPM_TXBLOB_SIZE];
 
 	LogDebug("Entering Get Cap");
 
+	if (nv_cache_get(capArea, subCapSize, subCap, &gen, respSize, resp))
+		return TSS_SUCCESS;
+
 	if ((result = tpm_rqu_build(TPM_ORD_GetCapability, &offset, txBlob, capArea, subCapSize,
 				    subCap, NULL)))
 		return result;
@@ -53,6 +56,8 @@ TCSP_GetCapability_Internal(TCS_CONTEXT_HANDLE hContext,	/* in */
 	if (!result) {
 		result = tpm_rsp_parse(TPM_ORD_GetCapability, txBlob, paramSize, respSize, resp,
 				       NULL, NULL);
+		if (!result)
+			nv_cache_put(capArea, subCapSize, subCap, gen, *respSize, *resp);
 	}
 	LogResult("Get Cap", result);
 	return result;
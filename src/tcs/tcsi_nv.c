@@ -55,6 +55,8 @@ TCSP_NV_DefineOrReleaseSpace_Internal(TCS_CONTEXT_HANDLE hContext, /* in */
 	if ((result = req_mgr_submit_req(txBlob)))
 		goto done;
 
+	nv_cache_invalidate_all();
+
 	result = UnloadBlob_Header(txBlob, &paramSize);
 	LogDebug("UnloadBlob  (paramSize=%u) result=%u", paramSize, result);
 	if (!result) {
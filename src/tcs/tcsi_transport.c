@@ -128,20 +128,31 @@ TCSP_ExecuteTransport_Internal(TCS_CONTEXT_HANDLE      hContext,
 			       BYTE**                  rgbWrappedCmdParamOut)
 {
 	TSS_RESULT result;
-	UINT32 paramSize, wrappedSize, val1 = 0, val2 = 0, *pVal1 = NULL, *pVal2 = NULL;
-	TCS_HANDLE handle1 = 0, handle2 = 0;
+	UINT32 paramSize, wrappedSize, i, numSlots = 0, slotBuf[TSS_TRANSPORT_INLINE_HANDLES];
+	UINT32 *slots = slotBuf;
+	TCS_HANDLE handle1 = 0;
 	UINT64 offset, wrappedOffset = 0;
 	BYTE txBlob[TSS_TPM_TXBLOB_SIZE];
 
 
-	if (*pulHandleListSize > 2) {
-		LogDebugFn("************ EXPAND KEYSLOT SIZE *********");
-		return TCSERR(TSS_E_INTERNAL_ERROR);
-	}
-
 	if ((result = ctx_verify_context(hContext)))
 		return result;
 
+	/* the wrapped command and the auths around it have to fit in one TPM blob */
+	if ((UINT64)*pulHandleListSize * sizeof(UINT32) + ulWrappedCmdParamInSize >
+	    TSS_TPM_TXBLOB_SIZE - TSS_TXBLOB_WRAPPEDCMD_OFFSET - TSS_TPM_TXBLOB_HDR_LEN
+	    - (3 * sizeof(TPM_AUTH))) {
+		LogDebugFn("Wrapped command with %u handles is too large", *pulHandleListSize);
+		return TCSERR(TSS_E_BAD_PARAMETER);
+	}
+
+	if (*pulHandleListSize > TSS_TRANSPORT_INLINE_HANDLES) {
+		if ((slots = calloc(*pulHandleListSize, sizeof(UINT32))) == NULL) {
+			LogError("malloc of %zd bytes failed.", *pulHandleListSize * sizeof(UINT32));
+			return TCSERR(TSS_E_OUTOFMEMORY);
+		}
+	}
+
 	if (pWrappedCmdAuth1)
 		if ((result = auth_mgr_check(hContext, &pWrappedCmdAuth1->AuthHandle)))
 			goto done;
@@ -175,8 +186,8 @@ TCSP_ExecuteTransport_Internal(TCS_CONTEXT_HANDLE      hContext,
 		 * mapping done in the TCS, so pass its value straight to the TPM and jump over
 		 * the switch statement below where we assume FLushSpecific is being done on a
 		 * key */
-		handle1 = val1 = *rghHandles[0];
-		pVal1 = &val1;
+		handle1 = slots[0] = (*rghHandles)[0];
+		numSlots = 1;
 
 		goto build_command;
 	default:
@@ -184,26 +195,28 @@ TCSP_ExecuteTransport_Internal(TCS_CONTEXT_HANDLE      hContext,
 	}
 
 map_key_handles:
-	if (*pulHandleListSize == 2) {
-		handle2 = (*rghHandles)[1];
-
-		if ((result = get_slot_lite(hContext, handle2, &val2))) {
-			*pulHandleListSize = 0;
-			goto done;
+	numSlots = *pulHandleListSize;
+	*pulHandleListSize = 0;
+
+	if (numSlots) {
+		handle1 = (*rghHandles)[0];
+
+		switch (unWrappedCommandOrdinal) {
+		case TPM_ORD_EvictKey:
+		case TPM_ORD_FlushSpecific:
+			/* there's no point loading a key only to evict it */
+			for (i = 0; i < numSlots; i++) {
+				if ((result = get_slot_lite(hContext, (*rghHandles)[i], &slots[i])))
+					goto done;
+			}
+			break;
+		default:
+			/* all the keys a wrapped command uses are loaded with one pass of the
+			 * key manager */
+			if ((result = ensureKeysAreLoaded(hContext, numSlots, *rghHandles, slots)))
+				goto done;
+			break;
 		}
-
-		pVal2 = &val2;
-	}
-
-	if (*pulHandleListSize >= 1) {
-		handle1 = *rghHandles[0];
-
-		*pulHandleListSize = 0;
-
-		if ((result = get_slot_lite(hContext, handle1, &val1)))
-			goto done;
-
-		pVal1 = &val1;
 	}
 
 	switch (unWrappedCommandOrdinal) {
@@ -246,8 +259,10 @@ map_key_handles:
 		UnloadBlob_UINT32(&offset, &entityValue, rgbWrappedCmdParamIn);
 
 		if (entityType == TCPA_ET_KEYHANDLE || entityType == TCPA_ET_KEY) {
-			if (ensureKeyIsLoaded(hContext, entityValue, &newEntValue))
-				return TCSERR(TSS_E_KEY_NOT_LOADED);
+			if (ensureKeyIsLoaded(hContext, entityValue, &newEntValue)) {
+				result = TCSERR(TSS_E_KEY_NOT_LOADED);
+				goto done;
+			}
 
 			/* OSAP is never encrypted in a transport session, so changing
 			 * rgbWrappedCmdParamIn is ok here */
@@ -289,7 +304,7 @@ map_key_handles:
 build_command:
 	if ((result = tpm_rqu_build(TPM_ORD_ExecuteTransport, &wrappedOffset,
 				    &txBlob[TSS_TXBLOB_WRAPPEDCMD_OFFSET], unWrappedCommandOrdinal,
-				    pVal1, pVal2, ulWrappedCmdParamInSize, rgbWrappedCmdParamIn,
+				    numSlots, slots, ulWrappedCmdParamInSize, rgbWrappedCmdParamIn,
 				    pWrappedCmdAuth1, pWrappedCmdAuth2)))
 		goto done;
 
@@ -329,6 +344,21 @@ build_command:
 	if ((result = req_mgr_submit_req(txBlob)))
 		goto done;
 
+	/* the wrapped command's parameters may be encrypted, so any NV index may have changed */
+	switch (unWrappedCommandOrdinal) {
+	case TPM_ORD_NV_DefineSpace:
+	case TPM_ORD_NV_WriteValue:
+	case TPM_ORD_NV_WriteValueAuth:
+	case TPM_ORD_NV_ReadValue:
+	case TPM_ORD_NV_ReadValueAuth:
+	case TPM_ORD_OwnerClear:
+	case TPM_ORD_ForceClear:
+		nv_cache_invalidate_all();
+		break;
+	default:
+		break;
+	}
+
 	/* Unload the Execute Transport (outer) header */
 	if ((result = UnloadBlob_Header(txBlob, &paramSize))) {
 		LogDebugFn("UnloadBlob_Header failed: rc=0x%x", result);
@@ -370,25 +400,25 @@ build_command:
 		*pulWrappedCmdReturnCode = result;
 		*ulWrappedCmdParamOutSize = 0;
 		*rgbWrappedCmdParamOut = NULL;
-		auth_mgr_release_auth(pWrappedCmdAuth1, pWrappedCmdAuth2, hContext);
 
-		return TSS_SUCCESS;
+		result = TSS_SUCCESS;
+		goto done;
 	}
 
 	*pulWrappedCmdReturnCode = TSS_SUCCESS;
 
-	pVal1 = pVal2 = NULL;
 	switch (unWrappedCommandOrdinal) {
 		/* The commands below have 1 outgoing handle */
 		case TPM_ORD_LoadKey2:
-			pVal1 = &val1;
+			numSlots = 1;
 			break;
 		default:
+			numSlots = 0;
 			break;
 	}
 
 	result = tpm_rsp_parse(TPM_ORD_ExecuteTransport, &txBlob[wrappedOffset], paramSize,
-			       pVal1, pVal2, ulWrappedCmdParamOutSize, rgbWrappedCmdParamOut,
+			       numSlots, slots, ulWrappedCmdParamOutSize, rgbWrappedCmdParamOut,
 			       pWrappedCmdAuth1, pWrappedCmdAuth2);
 
 	offset = 0;
@@ -397,10 +427,10 @@ build_command:
 	{
 		TCS_KEY_HANDLE tcs_handle = NULL_TCS_HANDLE;
 
-		if ((result = load_key_final(hContext, handle1, &tcs_handle, NULL, val1)))
+		if ((result = load_key_final(hContext, handle1, &tcs_handle, NULL, slots[0])))
 			goto done;
 
-		*rghHandles[0] = tcs_handle;
+		(*rghHandles)[0] = tcs_handle;
 		*pulHandleListSize = 1;
 		break;
 	}
@@ -419,6 +449,8 @@ build_command:
 	}
 
 done:
+	if (slots != slotBuf)
+		free(slots);
 	auth_mgr_release_auth(pWrappedCmdAuth1, pWrappedCmdAuth2, hContext);
 	return result;
 }
@@ -39,10 +39,11 @@
 #include "tcsps.h"
 #include "tcsd.h"
 #include "req_mgr.h"
+#include "tcs_stats.h"
 
 struct tcsd_config tcsd_options;
 struct tpm_properties tpm_metrics;
-static volatile int hup = 0, term = 0;
+static volatile int hup = 0, term = 0, dump_stats = 0;
 extern char *optarg;
 char *tcsd_config_file = NULL;
 
@@ -98,6 +99,12 @@ tcsd_signal_hup(int signal)
 	hup = 1;
 }
 
+static void
+tcsd_signal_usr1(int signal)
+{
+	dump_stats = 1;
+}
+
 static TSS_RESULT
 signals_init(void)
 {
@@ -114,6 +121,10 @@ signals_init(void)
 		LogError("sigaddset: %s", strerror(errno));
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
+	if ((rc = sigaddset(&sigmask, SIGUSR1))) {
+		LogError("sigaddset: %s", strerror(errno));
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	}
 
 	if ((rc = THREAD_SET_SIGNAL_MASK(SIG_UNBLOCK, &sigmask, NULL))) {
 		LogError("Setting thread signal mask: %s", strerror(rc));
@@ -134,6 +145,12 @@ signals_init(void)
 		return TCSERR(TSS_E_INTERNAL_ERROR);
 	}
 
+	sa.sa_handler = tcsd_signal_usr1;
+	if ((rc = sigaction(SIGUSR1, &sa, NULL))) {
+		LogError("signal SIGUSR1 not registered: %s", strerror(errno));
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	}
+
 	return TSS_SUCCESS;
 }
 
@@ -150,6 +167,8 @@ tcsd_startup(void)
 	if ((result = signals_init()))
 		return result;
 
+	tcs_stats_init();
+
 	if ((result = conf_file_init(&tcsd_options)))
 		return result;
 
@@ -257,7 +276,7 @@ int setup_ipv4_socket(struct srv_sock_info ssi[])
 
 	/* If no remote_ops are defined, restrict connections to localhost
 	 * only at the socket. */
-	if (tcsd_options.remote_ops[0] == 0)
+	if (!tcsd_options.remote_ops_enabled)
 		serv_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
 	else
 		serv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -306,7 +325,7 @@ int setup_ipv6_socket(struct srv_sock_info *ssi)
 
 	/* If no remote_ops are defined, restrict connections to localhost
 	 * only at the socket. */
-	if (tcsd_options.remote_ops[0] == 0)
+	if (!tcsd_options.remote_ops_enabled)
 		serv6_addr.sin6_addr = in6addr_loopback;
 	else
 		serv6_addr.sin6_addr = in6addr_any;
@@ -495,6 +514,7 @@ main(int argc, char **argv)
 	sigemptyset(&sigmask);
 	sigaddset(&sigmask, SIGTERM);
 	sigaddset(&sigmask, SIGHUP);
+	sigaddset(&sigmask, SIGUSR1);
 
 	sigemptyset(&termmask);
 	sigaddset(&termmask, SIGTERM);
@@ -507,12 +527,12 @@ main(int argc, char **argv)
 			return -1;
 		}
 
-		// Block TERM and HUP signals to prevent race condition
+		// Block TERM, HUP and USR1 signals to prevent race condition
 		if (sigprocmask(SIG_BLOCK, &sigmask, &oldsigmask) == -1) {
 			LogError("Error setting interrupt mask before accept");
 		}
 
-		// TERM and HUP are blocked here, so its safe to test flags.
+		// TERM, HUP and USR1 are blocked here, so its safe to test flags.
 		if (hup) {
 			// Config reading can be slow, so unmask SIGTERM.
 			if (sigprocmask(SIG_UNBLOCK, &termmask, NULL) == -1) {
@@ -524,6 +544,10 @@ main(int argc, char **argv)
 				LogError("Error blocking SIGTERM after config reload");
 			}
 		}
+		if (dump_stats) {
+			dump_stats = 0;
+			tcs_stats_log();
+		}
 		if (term)
 			break;
 
@@ -559,7 +583,7 @@ main(int argc, char **argv)
 			if (hostname == NULL)
 				hostname=INVALID_ADDR_STR;
 
-			tcsd_thread_create(newsd, hostname);
+			tcsd_thread_create(newsd, hostname, (struct sockaddr *)&client_addr);
 			hostname = NULL;
 		} // for (i=0; i < MAX_IP_PROTO; i++)
 	} while (term ==0);
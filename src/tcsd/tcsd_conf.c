@@ -20,6 +20,7 @@
 #include <errno.h>
 #include <grp.h>
 #include <stdlib.h>
+#include <arpa/inet.h>
 
 #ifdef SOLARIS
 #include <libscf.h>
@@ -53,6 +54,9 @@ struct tcsd_config_options options_list[] = {
 	{"all_platform_classes", opt_all_platform_classes},
 	{"disable_ipv4", opt_disable_ipv4},
 	{"disable_ipv6", opt_disable_ipv6},
+	{"remote_host_ops", opt_remote_host_ops},
+	{"tddl_backend", opt_tddl_backend},
+	{"tddl_mock_latency", opt_tddl_mock_latency},
 	{NULL, 0}
 };
 
@@ -81,12 +85,17 @@ init_tcsd_config(struct tcsd_config *conf)
 	conf->conformance_cred = NULL;
 	conf->endorsement_cred = NULL;
 	memset(conf->remote_ops, 0, sizeof(conf->remote_ops));
+	conf->remote_host_acls = NULL;
+	conf->remote_ops_enabled = 0;
 	conf->unset = 0xffffffff;
 	conf->exclusive_transport = 0;
 	conf->host_platform_class = NULL;
 	conf->all_platform_classes = NULL;
 	conf->disable_ipv4 = 0;
 	conf->disable_ipv6 = 0;
+	conf->tddl_backend = TCSD_DEFAULT_TDDL_BACKEND;
+	conf->tddl_mock_latency = TCSD_DEFAULT_TDDL_MOCK_LATENCY;
+	conf->tddl_mock_ord_latency = NULL;
 }
 
 TSS_RESULT
@@ -172,6 +181,12 @@ config_set_defaults(struct tcsd_config *conf)
 
 	if (conf->unset & TCSD_OPTION_DISABLE_IPV6)
 		conf->disable_ipv6 = TCSD_DEFAULT_DISABLE_IPV6;
+
+	if (conf->unset & TCSD_OPTION_TDDL_BACKEND)
+		conf->tddl_backend = TCSD_DEFAULT_TDDL_BACKEND;
+
+	if (conf->unset & TCSD_OPTION_TDDL_MOCK_LATENCY)
+		conf->tddl_mock_latency = TCSD_DEFAULT_TDDL_MOCK_LATENCY;
 }
 
 int
@@ -235,34 +250,28 @@ get_file_path(char *ptr, char **dest)
 	return 0;
 }
 
-/* add an op ordinal, checking for duplicates along the way */
+/* add an op's ordinals to a bitmap */
 void
-tcsd_add_op(int *remote_ops, int *op)
+tcsd_add_op(UINT32 *remote_ops, int *op)
 {
-	int i = 0, j;
+	int i = 0;
 
 	while (op[i] != 0) {
-		j = 0;
-		while (remote_ops[j] != 0) {
-			if (remote_ops[j] == op[i]) {
-				break;
-			}
-			j++;
-		}
-		remote_ops[j] = op[i];
+		TCSD_ORD_BITMAP_SET(remote_ops, op[i]);
 		i++;
 	}
 }
 
 int
-tcsd_set_remote_op(struct tcsd_config *conf, char *op_name)
+tcsd_set_remote_op(struct tcsd_config *conf, UINT32 *remote_ops, char *op_name)
 {
 	int i = 0;
 
 	while(tcsd_ops[i]) {
 		if (!strcasecmp(tcsd_ops[i]->name, op_name)) {
 			/* match found */
-			tcsd_add_op(conf->remote_ops, tcsd_ops[i]->op);
+			tcsd_add_op(remote_ops, tcsd_ops[i]->op);
+			conf->remote_ops_enabled = 1;
 			return 0;
 		}
 		i++;
@@ -272,6 +281,179 @@ tcsd_set_remote_op(struct tcsd_config *conf, char *op_name)
 	return 1;
 }
 
+/* parse a comma separated list of op names into a bitmap */
+void
+tcsd_set_remote_op_list(struct tcsd_config *conf, UINT32 *remote_ops, char *arg,
+			const char *opt_name, int line_num)
+{
+	char *comma;
+
+	while (1) {
+		comma = rindex(arg, ',');
+
+		if (comma == NULL) {
+			comma = arg;
+
+			if (tcsd_set_remote_op(conf, remote_ops, comma)) {
+				LogError("Config option \"%s\" is invalid. %s:%d: \"%s\"",
+					 opt_name, tcsd_config_file, line_num, comma);
+			}
+			break;
+		}
+
+		*comma++ = '\0';
+		if (tcsd_set_remote_op(conf, remote_ops, comma)) {
+			LogError("Config option \"%s\" is invalid. %s:%d: \"%s\"",
+				 opt_name, tcsd_config_file, line_num, comma);
+		}
+	}
+}
+
+/* parse "<address>[/<prefix length>] <op>[,<op>...]" into a new host acl */
+TSS_RESULT
+tcsd_add_host_acl(struct tcsd_config *conf, char *arg, int line_num)
+{
+	struct tcsd_host_acl *acl;
+	char *ops, *slash, *end;
+	unsigned int max_prefix;
+	long prefix;
+
+	ops = arg;
+	while (*ops != '\0' && *ops != ' ' && *ops != '\t')
+		ops++;
+	if (*ops == '\0') {
+		LogError("Config option \"remote_host_ops\" needs an address and a list of ops."
+			 " %s:%d: \"%s\"", tcsd_config_file, line_num, arg);
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	}
+	*ops++ = '\0';
+	while (*ops == ' ' || *ops == '\t')
+		ops++;
+
+	if ((acl = calloc(1, sizeof(struct tcsd_host_acl))) == NULL) {
+		LogError("malloc of %zd bytes failed", sizeof(struct tcsd_host_acl));
+		return TCSERR(TSS_E_OUTOFMEMORY);
+	}
+
+	if ((slash = index(arg, '/')) != NULL)
+		*slash++ = '\0';
+
+	if (inet_pton(AF_INET, arg, acl->addr) == 1) {
+		acl->family = AF_INET;
+		max_prefix = 32;
+	} else if (inet_pton(AF_INET6, arg, acl->addr) == 1) {
+		acl->family = AF_INET6;
+		max_prefix = 128;
+	} else {
+		LogError("Config option \"remote_host_ops\" has an invalid address. %s:%d: \"%s\"",
+			 tcsd_config_file, line_num, arg);
+		free(acl);
+		return TCSERR(TSS_E_INTERNAL_ERROR);
+	}
+
+	acl->prefix_len = max_prefix;
+	if (slash != NULL) {
+		prefix = strtol(slash, &end, 10);
+		if (end == slash || *end != '\0' || prefix < 0 || prefix > (long)max_prefix) {
+			LogError("Config option \"remote_host_ops\" has an invalid prefix length."
+				 " %s:%d: \"%s\"", tcsd_config_file, line_num, slash);
+			free(acl);
+			return TCSERR(TSS_E_INTERNAL_ERROR);
+		}
+		acl->prefix_len = prefix;
+	}
+
+	tcsd_set_remote_op_list(conf, acl->ops, ops, "remote_host_ops", line_num);
+
+	acl->next = conf->remote_host_acls;
+	conf->remote_host_acls = acl;
+
+	return TSS_SUCCESS;
+}
+
+static int
+tcsd_host_acl_match(struct tcsd_host_acl *acl, int family, BYTE *addr)
+{
+	unsigned int bytes, bits;
+
+	if (acl->family != family)
+		return 0;
+
+	bytes = acl->prefix_len / 8;
+	bits = acl->prefix_len % 8;
+
+	if (memcmp(acl->addr, addr, bytes))
+		return 0;
+
+	if (bits && ((acl->addr[bytes] ^ addr[bytes]) & (0xff << (8 - bits))))
+		return 0;
+
+	return 1;
+}
+
+/* Compute the ordinals a remote peer at @addr may execute. This is done once per
+ * connection so that the per command access check is a single bitmap lookup. */
+void
+tcsd_peer_remote_ops(struct tcsd_config *conf, int family, BYTE *addr, UINT32 *ops)
+{
+	struct tcsd_host_acl *acl;
+	int i;
+
+	memcpy(ops, conf->remote_ops, sizeof(conf->remote_ops));
+
+	for (acl = conf->remote_host_acls; acl; acl = acl->next) {
+		if (!tcsd_host_acl_match(acl, family, addr))
+			continue;
+
+		for (i = 0; i < TCSD_ORD_BITMAP_WORDS; i++)
+			ops[i] |= acl->ops[i];
+	}
+}
+
+/* parse "<usecs>[,<ordinal>:<usecs>...]", the mock TPM's default latency followed by
+ * latencies for individual TPM ordinals */
+TSS_RESULT
+tcsd_set_mock_latency(struct tcsd_config *conf, char *arg, int line_num)
+{
+	struct tcsd_ord_latency *lat;
+	char *tok, *end;
+	unsigned long ordinal, usecs;
+
+	for (tok = strtok(arg, ","); tok; tok = strtok(NULL, ",")) {
+		if (index(tok, ':') == NULL) {
+			usecs = strtoul(tok, &end, 0);
+			if (end == tok || *end != '\0')
+				goto err;
+
+			conf->tddl_mock_latency = usecs;
+			continue;
+		}
+
+		ordinal = strtoul(tok, &end, 0);
+		if (end == tok || *end != ':')
+			goto err;
+		tok = end + 1;
+		usecs = strtoul(tok, &end, 0);
+		if (end == tok || *end != '\0')
+			goto err;
+
+		if ((lat = malloc(sizeof(struct tcsd_ord_latency))) == NULL) {
+			LogError("malloc of %zd bytes failed", sizeof(struct tcsd_ord_latency));
+			return TCSERR(TSS_E_OUTOFMEMORY);
+		}
+		lat->ordinal = ordinal;
+		lat->usecs = usecs;
+		lat->next = conf->tddl_mock_ord_latency;
+		conf->tddl_mock_ord_latency = lat;
+	}
+
+	return TSS_SUCCESS;
+err:
+	LogError("Config option \"tddl_mock_latency\" is invalid. %s:%d: \"%s\"",
+		 tcsd_config_file, line_num, tok);
+	return TCSERR(TSS_E_INTERNAL_ERROR);
+}
+
 TSS_RESULT
 read_conf_line(char *buf, int line_num, struct tcsd_config *conf)
 {
@@ -550,28 +732,14 @@ read_conf_line(char *buf, int line_num, struct tcsd_config *conf)
 		conf->unset &= ~TCSD_OPTION_REMOTE_OPS;
 		comma = rindex(arg, '\n');
 		*comma = '\0';
-		while (1) {
-			comma = rindex(arg, ',');
-
-			if (comma == NULL) {
-				comma = arg;
-
-				if (comma != NULL) {
-					if (tcsd_set_remote_op(conf, comma)) {
-						LogError("Config option \"remote_ops\" is invalid. "
-							 "%s:%d: \"%s\"", tcsd_config_file,
-							 line_num, comma);
-					}
-				}
-				break;
-			}
-
-			*comma++ = '\0';
-			if (tcsd_set_remote_op(conf, comma)) {
-				LogError("Config option \"remote_ops\" is invalid. "
-					 "%s:%d: \"%s\"", tcsd_config_file, line_num, comma);
-			}
-		}
+		tcsd_set_remote_op_list(conf, conf->remote_ops, arg, "remote_ops", line_num);
+		break;
+	case opt_remote_host_ops:
+		conf->unset &= ~TCSD_OPTION_REMOTE_HOST_OPS;
+		if ((comma = rindex(arg, '\n')) != NULL)
+			*comma = '\0';
+		if ((result = tcsd_add_host_acl(conf, arg, line_num)))
+			return result;
 		break;
         case opt_exclusive_transport:
 		tmp_int = atoi(arg);
@@ -637,6 +805,29 @@ read_conf_line(char *buf, int line_num, struct tcsd_config *conf)
 			}
 		}
 		break;
+	case opt_tddl_backend:
+		if ((comma = rindex(arg, '\n')) != NULL)
+			*comma = '\0';
+		if (!strcasecmp(arg, "device"))
+			conf->tddl_backend = TCSD_TDDL_BACKEND_DEVICE;
+		else if (!strcasecmp(arg, "emulator"))
+			conf->tddl_backend = TCSD_TDDL_BACKEND_EMULATOR;
+		else if (!strcasecmp(arg, "mock"))
+			conf->tddl_backend = TCSD_TDDL_BACKEND_MOCK;
+		else {
+			LogError("Config option \"tddl_backend\" is invalid. %s:%d: \"%s\"",
+				 tcsd_config_file, line_num, arg);
+			return TCSERR(TSS_E_INTERNAL_ERROR);
+		}
+		conf->unset &= ~TCSD_OPTION_TDDL_BACKEND;
+		break;
+	case opt_tddl_mock_latency:
+		if ((comma = rindex(arg, '\n')) != NULL)
+			*comma = '\0';
+		if ((result = tcsd_set_mock_latency(conf, arg, line_num)))
+			return result;
+		conf->unset &= ~TCSD_OPTION_TDDL_MOCK_LATENCY;
+		break;
 	case opt_disable_ipv4:
 		tmp_int = atoi(arg);
 		if (tmp_int < 0 || tmp_int > 1) {
@@ -701,6 +892,17 @@ free_platform_lists(struct platform_class *list)
 void
 conf_file_final(struct tcsd_config *conf)
 {
+	struct tcsd_host_acl *acl;
+	struct tcsd_ord_latency *lat;
+
+	while ((acl = conf->remote_host_acls) != NULL) {
+		conf->remote_host_acls = acl->next;
+		free(acl);
+	}
+	while ((lat = conf->tddl_mock_ord_latency) != NULL) {
+		conf->tddl_mock_ord_latency = lat->next;
+		free(lat);
+	}
 	free(conf->system_ps_file);
 	free(conf->system_ps_dir);
 	free(conf->kernel_log_file);
@@ -831,6 +1033,7 @@ conf_file_init(struct tcsd_config *conf)
 if (get_smf_prop("local_only", B_TRUE)) {
 		(void) memset(conf->remote_ops, 0, sizeof(conf->remote_ops));
 		conf->unset |= TCSD_OPTION_REMOTE_OPS;
+		conf->remote_ops_enabled = 0;
 	
 	}
 #endif
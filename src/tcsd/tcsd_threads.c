@@ -17,6 +17,7 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <netinet/in.h>
 
 #include "trousers/tss.h"
 #include "trousers_types.h"
@@ -84,9 +85,51 @@ tcsd_threads_init(void)
 	return TSS_SUCCESS;
 }
 
+/* Work out once, at accept time, whether a peer is local and which ordinals it may run.
+ * v4-mapped IPv6 peers are matched as the IPv4 host they really are.  TCP gives us no
+ * peer credentials, so the address is all there is to go on. */
+static void
+tcsd_thread_classify_peer(struct tcsd_thread_data *data, struct sockaddr *sa)
+{
+	in_addr_t nloopaddr = htonl(INADDR_LOOPBACK);
+	int family = AF_UNSPEC;
+	BYTE *addr = NULL;
+
+	data->is_localhost = 0;
+	memset(data->remote_ops, 0, sizeof(data->remote_ops));
+
+	if (sa == NULL)
+		return;
+
+	if (sa->sa_family == AF_INET) {
+		struct sockaddr_in *sa_in = (struct sockaddr_in *)sa;
+
+		family = AF_INET;
+		addr = (BYTE *)&sa_in->sin_addr.s_addr;
+	} else if (sa->sa_family == AF_INET6) {
+		struct sockaddr_in6 *sa_in6 = (struct sockaddr_in6 *)sa;
+
+		if (IN6_IS_ADDR_V4MAPPED(&sa_in6->sin6_addr)) {
+			family = AF_INET;
+			addr = &sa_in6->sin6_addr.s6_addr[12];
+		} else {
+			family = AF_INET6;
+			addr = sa_in6->sin6_addr.s6_addr;
+			if (IN6_IS_ADDR_LOOPBACK(&sa_in6->sin6_addr))
+				data->is_localhost = 1;
+		}
+	} else
+		return;
+
+	if (family == AF_INET && !memcmp(addr, &nloopaddr, sizeof(in_addr_t)))
+		data->is_localhost = 1;
+
+	if (!data->is_localhost)
+		tcsd_peer_remote_ops(&tcsd_options, family, addr, data->remote_ops);
+}
 
 TSS_RESULT
-tcsd_thread_create(int socket, char *hostname)
+tcsd_thread_create(int socket, char *hostname, struct sockaddr *peer)
 {
 	UINT32 thread_num = -1;
 	int rc = TCS_SUCCESS;
@@ -136,6 +179,7 @@ tcsd_thread_create(int socket, char *hostname)
 	tm->thread_data[thread_num].context = NULL_TCS_HANDLE;
 	if (hostname != NULL)
 		tm->thread_data[thread_num].hostname = hostname;
+	tcsd_thread_classify_peer(&tm->thread_data[thread_num], peer);
 
 #ifdef TCSD_SINGLE_THREAD_DEBUG
 	(void)tcsd_thread_run((void *)(&(tm->thread_data[thread_num])));
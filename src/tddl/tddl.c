@@ -9,230 +9,353 @@
  */
 
 
-#include <unistd.h>
-#include <fcntl.h>
 #include <stdio.h>
-#include <errno.h>
 #include <string.h>
-#include <sys/ioctl.h>
+#include <stdlib.h>
+#include <time.h>
 
 #include "trousers/tss.h"
 #include "trousers_types.h"
-#include "linux/tpm.h"
 #include "tcslog.h"
 #include "tddl.h"
 
-struct tpm_device_node tpm_device_nodes[] = {
-	{"/dev/tpm0", TDDL_UNDEF, TDDL_UNDEF},
-	{"/udev/tpm0", TDDL_UNDEF, TDDL_UNDEF},
-	{"/dev/tpm", TDDL_UNDEF, TDDL_UNDEF},
-	{NULL, 0, 0}
-};
-
-struct tpm_device_node *opened_device = NULL;
-
 BYTE txBuffer[TDDL_TXBUF_SIZE];
-TSS_BOOL use_in_socket = FALSE;
+
+/* the TCSD's configuration, set with Tddli_SetConfig(). NULL means the defaults */
 struct tcsd_config *_tcsd_options = NULL;
 
-#include <sys/socket.h>
-#include <sys/un.h>
-#include <netinet/in.h>
-#include <sys/types.h>
-#include <netdb.h>
-#include <fcntl.h>
+/* the backend in use, NULL while closed */
+struct tddl_backend *tddl = NULL;
 
+/* the command in flight between Tddli_SubmitData() and Tddli_WaitData() */
+TSS_BOOL tx_pending = FALSE;
 
-int
-open_device()
+/* counts the connections Tddli_Open() made to the TPM, see Tddli_GetOpenCount() */
+static UINT32 tddl_open_count = 0;
+
+UINT32 tddl_timeouts[TDDL_NUM_DURATIONS] = {
+	TDDL_DEFAULT_TIMEOUT, TDDL_DEFAULT_TIMEOUT, TDDL_DEFAULT_TIMEOUT
+};
+
+
+void
+Tddli_SetConfig(struct tcsd_config *conf)
 {
-	int i = 0, fd = -1, tcp_device_port;
-	char *tcp_device_hostname = NULL;
-	char *un_socket_device_path = NULL;
-	char *tcp_device_port_string = NULL;
-	
-	if (getenv("TCSD_USE_TCP_DEVICE")) {
-		if ((tcp_device_hostname = getenv("TCSD_TCP_DEVICE_HOSTNAME")) == NULL)
-			tcp_device_hostname = "localhost";
-		if ((un_socket_device_path = getenv("TCSD_UN_SOCKET_DEVICE_PATH")) == NULL)
-			un_socket_device_path = "/var/run/tpm/tpmd_socket:0";
-		if ((tcp_device_port_string = getenv("TCSD_TCP_DEVICE_PORT")) != NULL)
-			tcp_device_port = atoi(tcp_device_port_string);
-		else
-			tcp_device_port = 6545;
-	 
-		
-		fd = socket(AF_INET, SOCK_STREAM, 0);
-		if (fd > 0) {
-			struct hostent *host = gethostbyname(tcp_device_hostname);
-			if (host != NULL) {   
-				struct sockaddr_in addr;
-				memset(&addr, 0x0, sizeof(addr));
-				addr.sin_family = host->h_addrtype;
-				addr.sin_port   = htons(tcp_device_port);
-				memcpy(&addr.sin_addr,
-						host->h_addr,
-						host->h_length);
-				if (connect(fd,	(struct sockaddr *)&addr,
-					    sizeof(addr)) < 0) {
-					close(fd);
-					fd = -1;
-				} else
-					use_in_socket = TRUE;
-			} else {
-				close (fd);
-				fd = -1;
-			}
-		}
-	       
-		if (fd < 0) {
-			struct sockaddr_un addr;
-
-			fd = socket(AF_UNIX, SOCK_STREAM, 0);
-			if (fd >= 0) {
-				addr.sun_family = AF_UNIX;
-				strncpy(addr.sun_path, un_socket_device_path,
-						sizeof(addr.sun_path));
-				if (connect(fd, (void *)&addr, sizeof(addr)) < 0) {
-					close(fd);
-					fd = -1;
-				}
-			}
-		}
-	} 
-	
-	if (fd < 0) {
-		/* tpm_device_paths is filled out in tddl.h */
-		for (i = 0; tpm_device_nodes[i].path != NULL; i++) {
-			errno = 0;
-			if ((fd = open(tpm_device_nodes[i].path, O_RDWR)) >= 0)
-				break;
-		}
-	}
-	
-	if (fd > 0) {
-		opened_device = &(tpm_device_nodes[i]);
-		tpm_device_nodes[i].fd = fd;
-	}
-	return fd;
+	_tcsd_options = conf;
 }
 
+/* tcsd -e (TCSD_USE_TCP_DEVICE) asks for an emulator and falls back to the device if there
+ * isn't one, as it always has. Otherwise tcsd.conf's tddl_backend decides. */
 TSS_RESULT
 Tddli_Open()
 {
-	int rc;
+	struct tddl_backend *backend;
+	TSS_RESULT result;
 
-	if (opened_device != NULL) {
+	if (tddl != NULL) {
 		LogDebug("attempted to re-open the TPM driver!");
 		return TDDLERR(TDDL_E_ALREADY_OPENED);
 	}
 
-	rc = open_device();
-	if (rc < 0) {
-		LogError("Could not find a device to open!");
-		if (errno == ENOENT) {
-			/* File DNE */
-			return TDDLERR(TDDL_E_COMPONENT_NOT_FOUND);
+	if (getenv("TCSD_USE_TCP_DEVICE")) {
+		if ((result = tddl_emulator_backend.open()) == TSS_SUCCESS) {
+			tddl = &tddl_emulator_backend;
+			tddl_open_count++;
+			return TSS_SUCCESS;
+		}
+		backend = &tddl_device_backend;
+	} else {
+		switch (_tcsd_options ? _tcsd_options->tddl_backend : TCSD_DEFAULT_TDDL_BACKEND) {
+			case TCSD_TDDL_BACKEND_EMULATOR:
+				backend = &tddl_emulator_backend;
+				break;
+			case TCSD_TDDL_BACKEND_MOCK:
+				backend = &tddl_mock_backend;
+				break;
+			default:
+				backend = &tddl_device_backend;
+				break;
 		}
-
-		return TDDLERR(TDDL_E_FAIL);
 	}
 
+	if ((result = backend->open()))
+		return result;
+
+	LogDebug("Using the %s TDDL backend", backend->name);
+	tddl = backend;
+	tddl_open_count++;
+
 	return TSS_SUCCESS;
 }
 
+void
+tddl_deadline(UINT64 usecs, struct timespec *deadline)
+{
+	clock_gettime(CLOCK_MONOTONIC, deadline);
+	deadline->tv_sec += usecs / 1000000;
+	deadline->tv_nsec += (usecs % 1000000) * 1000;
+	if (deadline->tv_nsec >= 1000000000) {
+		deadline->tv_sec++;
+		deadline->tv_nsec -= 1000000000;
+	}
+}
+
+/* A backend that lost its connection to the TPM closes it, so its fd reads TDDL_UNDEF */
+static TSS_BOOL
+tddl_disconnected()
+{
+	return tddl->get_fd != NULL && tddl->get_fd() == TDDL_UNDEF;
+}
+
+UINT32
+Tddli_GetOpenCount()
+{
+	return tddl_open_count;
+}
+
 TSS_RESULT
 Tddli_Close()
 {
-	if (opened_device == NULL) {
+	if (tddl == NULL) {
 		LogDebug("attempted to re-close the TPM driver!");
 		return TDDLERR(TDDL_E_ALREADY_CLOSED);
 	}
 
-	close(opened_device->fd);
-	opened_device->fd = TDDL_UNDEF;
-	opened_device = NULL;
+	tddl->close();
+	tddl = NULL;
+	tx_pending = FALSE;
 
 	return TSS_SUCCESS;
 }
 
 TSS_RESULT
-Tddli_TransmitData(BYTE * pTransmitBuf, UINT32 TransmitBufLen, BYTE * pReceiveBuf,
-		   UINT32 * pReceiveBufLen)
+Tddli_SubmitData(BYTE * pTransmitBuf, UINT32 TransmitBufLen)
 {
-	int sizeResult;
+	TSS_RESULT result;
 
 	if (TransmitBufLen > TDDL_TXBUF_SIZE) {
 		LogError("buffer size handed to TDDL is too large! (%u bytes)", TransmitBufLen);
 		return TDDLERR(TDDL_E_FAIL);
 	}
 
+	if (tx_pending) {
+		LogError("TDDL submit while a command is already outstanding");
+		return TDDLERR(TDDL_E_FAIL);
+	}
+
+	/* a failed reset leaves nothing open, and a backend that lost its connection must
+	 * reconnect through Tddli_Open() so that Tddli_GetOpenCount() sees it */
+	if (tddl != NULL && tddl_disconnected())
+		Tddli_Close();
+	if (tddl == NULL && Tddli_Open())
+		return TDDLERR(TDDL_E_IOERROR);
+
 	memcpy(txBuffer, pTransmitBuf, TransmitBufLen);
 	LogDebug("Calling write to driver");
 
-	if (use_in_socket) {
+	result = tddl->submit(TransmitBufLen);
+	if (result && tddl_disconnected()) {
+		/* the backend dropped a connection it found dead before the command was
+		 * written out in full, so the command can't have run and is sent once more */
 		Tddli_Close();
 		if (Tddli_Open())
 			return TDDLERR(TDDL_E_IOERROR);
+		result = tddl->submit(TransmitBufLen);
 	}
+	if (result)
+		return result;
 
-	switch (opened_device->transmit) {
-		case TDDL_UNDEF:
-			/* fall through */
-		case TDDL_TRANSMIT_IOCTL:
-			errno = 0;
-			if ((sizeResult = ioctl(opened_device->fd, TPMIOC_TRANSMIT, txBuffer)) != -1) {
-				opened_device->transmit = TDDL_TRANSMIT_IOCTL;
-				break;
-			}
-			LogWarn("ioctl: (%d) %s", errno, strerror(errno));
-			LogInfo("Falling back to Read/Write device support.");
-			/* fall through */
-		case TDDL_TRANSMIT_RW:
-			if ((sizeResult = write(opened_device->fd,
-						txBuffer,
-						TransmitBufLen)) == (int)TransmitBufLen) {
-				opened_device->transmit = TDDL_TRANSMIT_RW;
-				sizeResult = read(opened_device->fd, txBuffer,
-						  TDDL_TXBUF_SIZE);
-				break;
-			} else {
-				if (sizeResult == -1) {
-					LogError("write to device %s failed: %s",
-						 opened_device->path,
-						 strerror(errno));
-				} else {
-					LogError("wrote %d bytes to %s (tried "
-						 "to write %d)", sizeResult,
-						 opened_device->path,
-						 TransmitBufLen);
-				}
-			}
-			/* fall through */
-		default:
-			return TDDLERR(TDDL_E_IOERROR);
-	}
+	tx_pending = TRUE;
 
-	if (sizeResult < 0) {
-		LogError("read from device %s failed: %s", opened_device->path, strerror(errno));
-		return TDDLERR(TDDL_E_IOERROR);
-	} else if (sizeResult == 0) {
-		LogError("Zero bytes read from device %s", opened_device->path);
-		return TDDLERR(TDDL_E_IOERROR);
+	return TSS_SUCCESS;
+}
+
+TSS_RESULT
+Tddli_WaitData(BYTE * pReceiveBuf, UINT32 * pReceiveBufLen, int timeout)
+{
+	TSS_RESULT result;
+	UINT32 size;
+
+	if (!tx_pending) {
+		LogError("TDDL wait without an outstanding command");
+		return TDDLERR(TDDL_E_FAIL);
 	}
 
-	if ((unsigned)sizeResult > *pReceiveBufLen) {
-		LogError("read %d bytes from device %s, (only room for %d)", sizeResult,
-				opened_device->path, *pReceiveBufLen);
+	result = tddl->wait(timeout, &size);
+	if (result == TDDLERR(TDDL_E_TIMEOUT))
+		return result;
+
+	tx_pending = FALSE;
+
+	if (result)
+		return result;
+
+	if (size > *pReceiveBufLen) {
+		LogError("read %u bytes from the TPM, (only room for %u)", size,
+			 *pReceiveBufLen);
 		return TDDLERR(TDDL_E_INSUFFICIENT_BUFFER);
 	}
 
-	*pReceiveBufLen = sizeResult;
+	*pReceiveBufLen = size;
 
 	memcpy(pReceiveBuf, txBuffer, *pReceiveBufLen);
 	return TSS_SUCCESS;
 }
 
+int
+Tddli_GetFd()
+{
+	if (tddl == NULL || tddl->get_fd == NULL)
+		return TDDL_UNDEF;
+
+	return tddl->get_fd();
+}
+
+/* The TPM reports its short, medium and long command durations in usecs. Some chips report
+ * msecs instead, which shows up as an implausibly short "short" duration. Give each command
+ * twice its reported duration before giving up on it. */
+void
+Tddli_SetDurations(UINT32 *durations)
+{
+	UINT32 scale = 1;
+	UINT64 msecs;
+	int i;
+
+	if (durations[TDDL_DURATION_SHORT] && durations[TDDL_DURATION_SHORT] < 1000)
+		scale = 1000;
+
+	for (i = 0; i < TDDL_NUM_DURATIONS; i++) {
+		if (durations[i] == 0)
+			continue;
+
+		/* scale before dividing so that sub-msec durations aren't truncated away */
+		msecs = (UINT64)durations[i] * scale / 1000 * 2;
+		if (msecs < TDDL_MIN_TIMEOUT)
+			msecs = TDDL_MIN_TIMEOUT;
+		else if (msecs > 0xffffffff)
+			msecs = 0xffffffff;
+		tddl_timeouts[i] = (UINT32)msecs;
+	}
+
+	LogDebug("TDDL timeouts: short %u, medium %u, long %u msecs",
+		 tddl_timeouts[TDDL_DURATION_SHORT], tddl_timeouts[TDDL_DURATION_MEDIUM],
+		 tddl_timeouts[TDDL_DURATION_LONG]);
+}
+
+/* Map a command's ordinal to its duration class. Only commands known to be quick are short;
+ * anything not listed, including NV writes, Startup, SaveState and the delegation and counter
+ * commands, gets the long timeout, since timing out a command cancels it and may reopen the
+ * device. */
+UINT32
+Tddli_GetTimeout(BYTE * pTransmitBuf, UINT32 TransmitBufLen)
+{
+	UINT32 ordinal;
+
+	if (TransmitBufLen < 10)
+		return tddl_timeouts[TDDL_DURATION_LONG];
+
+	ordinal = ((UINT32)pTransmitBuf[6] << 24) | ((UINT32)pTransmitBuf[7] << 16) |
+		  ((UINT32)pTransmitBuf[8] << 8) | (UINT32)pTransmitBuf[9];
+
+	switch (ordinal) {
+		case TPM_ORD_CreateWrapKey:
+		case TPM_ORD_CMK_CreateKey:
+		case TPM_ORD_MakeIdentity:
+		case TPM_ORD_TakeOwnership:
+		case TPM_ORD_CreateEndorsementKeyPair:
+		case TPM_ORD_CreateRevocableEK:
+		case TPM_ORD_CreateMaintenanceArchive:
+		case TPM_ORD_SelfTestFull:
+		case TPM_ORD_ContinueSelfTest:
+		case TPM_ORD_DAA_Join:
+		case TPM_ORD_DAA_Sign:
+		case TPM_ORD_ExecuteTransport:
+			return tddl_timeouts[TDDL_DURATION_LONG];
+		case TPM_ORD_Seal:
+		case TPM_ORD_Sealx:
+		case TPM_ORD_Unseal:
+		case TPM_ORD_UnBind:
+		case TPM_ORD_Sign:
+		case TPM_ORD_LoadKey:
+		case TPM_ORD_LoadKey2:
+		case TPM_ORD_Quote:
+		case TPM_ORD_Quote2:
+		case TPM_ORD_CertifyKey:
+		case TPM_ORD_CertifyKey2:
+		case TPM_ORD_ActivateIdentity:
+		case TPM_ORD_CreateMigrationBlob:
+		case TPM_ORD_ConvertMigrationBlob:
+		case TPM_ORD_ChangeAuth:
+		case TPM_ORD_ChangeAuthOwner:
+		case TPM_ORD_OwnerClear:
+		case TPM_ORD_ForceClear:
+		case TPM_ORD_GetRandom:
+			return tddl_timeouts[TDDL_DURATION_MEDIUM];
+		case TPM_ORD_OIAP:
+		case TPM_ORD_OSAP:
+		case TPM_ORD_DSAP:
+		case TPM_ORD_Extend:
+		case TPM_ORD_PcrRead:
+		case TPM_ORD_PCR_Reset:
+		case TPM_ORD_GetCapability:
+		case TPM_ORD_FlushSpecific:
+		case TPM_ORD_Terminate_Handle:
+		case TPM_ORD_EvictKey:
+		case TPM_ORD_GetPubKey:
+		case TPM_ORD_ReadPubek:
+		case TPM_ORD_OwnerReadPubek:
+		case TPM_ORD_OwnerReadInternalPub:
+		case TPM_ORD_GetTestResult:
+		case TPM_ORD_GetTicks:
+		case TPM_ORD_ReadCounter:
+		case TPM_ORD_Reset:
+		case TPM_ORD_SHA1Start:
+		case TPM_ORD_SHA1Update:
+		case TPM_ORD_StirRandom:
+			return tddl_timeouts[TDDL_DURATION_SHORT];
+		default:
+			return tddl_timeouts[TDDL_DURATION_LONG];
+	}
+}
+
+/* A command ran past its timeout. Ask the TPM to cancel it and drain the response it sends
+ * back. If that doesn't work either, the only way to get the device back is to reopen it. */
+void
+tddl_abort(BYTE * pReceiveBuf, UINT32 ReceiveBufLen)
+{
+	UINT32 len = ReceiveBufLen;
+
+	if (Tddli_Cancel() == TSS_SUCCESS &&
+	    Tddli_WaitData(pReceiveBuf, &len, tddl_timeouts[TDDL_DURATION_SHORT]) !=
+	    TDDLERR(TDDL_E_TIMEOUT))
+		return;
+
+	LogWarn("Resetting connection to the TPM (%s backend)", tddl->name);
+	Tddli_Close();
+	if (Tddli_Open())
+		LogError("Reopening the TPM failed");
+}
+
+TSS_RESULT
+Tddli_TransmitData(BYTE * pTransmitBuf, UINT32 TransmitBufLen, BYTE * pReceiveBuf,
+		   UINT32 * pReceiveBufLen)
+{
+	TSS_RESULT result;
+	UINT32 timeout;
+
+	if ((result = Tddli_SubmitData(pTransmitBuf, TransmitBufLen)))
+		return result;
+
+	timeout = Tddli_GetTimeout(pTransmitBuf, TransmitBufLen);
+	result = Tddli_WaitData(pReceiveBuf, pReceiveBufLen, timeout);
+	if (result == TDDLERR(TDDL_E_TIMEOUT)) {
+		LogError("TPM command timed out after %u msecs, cancelling it", timeout);
+		tddl_abort(pReceiveBuf, *pReceiveBufLen);
+	}
+
+	return result;
+}
+
 TSS_RESULT
 Tddli_GetStatus(UINT32 ReqStatusType, UINT32 *pStatus)
 {
@@ -255,19 +378,11 @@ Tddli_GetCapability(UINT32 CapArea, UINT32 SubCap,
 
 TSS_RESULT Tddli_Cancel(void)
 {
-	int rc;
-
-	if (opened_device->transmit == TDDL_TRANSMIT_IOCTL) {
-		if ((rc = ioctl(opened_device->fd, TPMIOC_CANCEL, NULL)) == -1) {
-			LogError("ioctl: (%d) %s", errno, strerror(errno));
-			return TDDLERR(TDDL_E_FAIL);
-		} else if (rc == -EIO) {
-			/* The driver timed out while trying to tell the chip to cancel */
-			return TDDLERR(TDDL_E_COMMAND_COMPLETED);
-		}
+	if (tddl == NULL)
+		return TDDLERR(TDDL_E_FAIL);
 
-		return TSS_SUCCESS;
-	} else {
+	if (tddl->cancel == NULL)
 		return TDDLERR(TSS_E_NOTIMPL);
-	}
+
+	return tddl->cancel();
 }
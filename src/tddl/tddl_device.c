@@ -0,0 +1,228 @@
+
+/*
+ * Licensed Materials - Property of IBM
+ *
+ * trousers - An open source TCG Software Stack
+ *
+ * (C) Copyright International Business Machines Corp. 2004, 2005
+ *
+ */
+
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+
+#include "trousers/tss.h"
+#include "trousers_types.h"
+#include "linux/tpm.h"
+#include "tcslog.h"
+#include "tddl.h"
+
+struct tpm_device_node tpm_device_nodes[] = {
+	{"/dev/tpm0", TDDL_UNDEF, TDDL_UNDEF},
+	{"/udev/tpm0", TDDL_UNDEF, TDDL_UNDEF},
+	{"/dev/tpm", TDDL_UNDEF, TDDL_UNDEF},
+	{NULL, 0, 0}
+};
+
+struct tpm_device_node *opened_device = NULL;
+
+/* the ioctl interface is synchronous, so its response is ready as soon as it's submitted */
+int tx_ioctl_result = 0;
+
+
+TSS_RESULT
+device_open()
+{
+	int i, fd = -1;
+
+	/* tpm_device_paths is filled out in tddl.h */
+	for (i = 0; tpm_device_nodes[i].path != NULL; i++) {
+		errno = 0;
+		/* non-blocking, so that drivers supporting it queue the command on write and
+		 * let us poll for the response */
+		if ((fd = open(tpm_device_nodes[i].path, O_RDWR | O_NONBLOCK)) >= 0)
+			break;
+	}
+
+	if (fd < 0) {
+		LogError("Could not find a device to open!");
+		if (errno == ENOENT) {
+			/* File DNE */
+			return TDDLERR(TDDL_E_COMPONENT_NOT_FOUND);
+		}
+
+		return TDDLERR(TDDL_E_FAIL);
+	}
+
+	opened_device = &(tpm_device_nodes[i]);
+	tpm_device_nodes[i].fd = fd;
+
+	return TSS_SUCCESS;
+}
+
+void
+device_close()
+{
+	close(opened_device->fd);
+	opened_device->fd = TDDL_UNDEF;
+	opened_device = NULL;
+}
+
+TSS_RESULT
+device_submit(UINT32 len)
+{
+	int sizeResult;
+
+	switch (opened_device->transmit) {
+		case TDDL_UNDEF:
+			/* fall through */
+		case TDDL_TRANSMIT_IOCTL:
+			errno = 0;
+			if ((sizeResult = ioctl(opened_device->fd, TPMIOC_TRANSMIT, txBuffer)) != -1) {
+				opened_device->transmit = TDDL_TRANSMIT_IOCTL;
+				tx_ioctl_result = sizeResult;
+				break;
+			}
+			LogWarn("ioctl: (%d) %s", errno, strerror(errno));
+			LogInfo("Falling back to Read/Write device support.");
+			/* fall through */
+		case TDDL_TRANSMIT_RW:
+			if ((sizeResult = write(opened_device->fd,
+						txBuffer,
+						len)) == (int)len) {
+				opened_device->transmit = TDDL_TRANSMIT_RW;
+				break;
+			} else {
+				if (sizeResult == -1) {
+					LogError("write to device %s failed: %s",
+						 opened_device->path,
+						 strerror(errno));
+				} else {
+					LogError("wrote %d bytes to %s (tried "
+						 "to write %d)", sizeResult,
+						 opened_device->path,
+						 len);
+				}
+			}
+			/* fall through */
+		default:
+			return TDDLERR(TDDL_E_IOERROR);
+	}
+
+	return TSS_SUCCESS;
+}
+
+TSS_RESULT
+device_wait(int timeout, UINT32 *size)
+{
+	struct pollfd pfd;
+	int sizeResult, rc;
+
+	if (opened_device->transmit == TDDL_TRANSMIT_IOCTL) {
+		sizeResult = tx_ioctl_result;
+	} else {
+		pfd.fd = opened_device->fd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+
+		do {
+			rc = poll(&pfd, 1, timeout);
+		} while (rc == -1 && errno == EINTR);
+
+		if (rc == 0)
+			return TDDLERR(TDDL_E_TIMEOUT);
+		else if (rc == -1) {
+			LogError("poll on device %s failed: %s", opened_device->path,
+				 strerror(errno));
+			return TDDLERR(TDDL_E_IOERROR);
+		}
+
+		sizeResult = read(opened_device->fd, txBuffer, TDDL_TXBUF_SIZE);
+	}
+
+	if (sizeResult < 0) {
+		LogError("read from device %s failed: %s", opened_device->path, strerror(errno));
+		return TDDLERR(TDDL_E_IOERROR);
+	} else if (sizeResult == 0) {
+		LogError("Zero bytes read from device %s", opened_device->path);
+		return TDDLERR(TDDL_E_IOERROR);
+	}
+
+	*size = sizeResult;
+
+	return TSS_SUCCESS;
+}
+
+/* Newer Linux drivers don't support the cancel ioctl, but export a sysfs attribute that
+ * cancels the running command when written */
+TSS_RESULT
+device_sysfs_cancel()
+{
+	char *fmts[] = { "/sys/class/tpm/%s/device/cancel",
+			 "/sys/class/misc/%s/device/cancel", NULL };
+	char path[PATH_MAX], *name;
+	int i, fd, rc;
+
+	if ((name = strrchr(opened_device->path, '/')) == NULL)
+		return TDDLERR(TSS_E_NOTIMPL);
+	name++;
+
+	for (i = 0; fmts[i]; i++) {
+		snprintf(path, sizeof(path), fmts[i], name);
+		if ((fd = open(path, O_WRONLY)) < 0)
+			continue;
+
+		rc = write(fd, "1", 1);
+		close(fd);
+		if (rc == 1)
+			return TSS_SUCCESS;
+
+		LogError("write to %s failed: %s", path, strerror(errno));
+		return TDDLERR(TDDL_E_FAIL);
+	}
+
+	return TDDLERR(TSS_E_NOTIMPL);
+}
+
+TSS_RESULT
+device_cancel()
+{
+	int rc;
+
+	if (opened_device->transmit == TDDL_TRANSMIT_IOCTL) {
+		if ((rc = ioctl(opened_device->fd, TPMIOC_CANCEL, NULL)) == -1) {
+			LogError("ioctl: (%d) %s", errno, strerror(errno));
+			return TDDLERR(TDDL_E_FAIL);
+		} else if (rc == -EIO) {
+			/* The driver timed out while trying to tell the chip to cancel */
+			return TDDLERR(TDDL_E_COMMAND_COMPLETED);
+		}
+
+		return TSS_SUCCESS;
+	} else {
+		return device_sysfs_cancel();
+	}
+}
+
+int
+device_get_fd()
+{
+	return opened_device->fd;
+}
+
+struct tddl_backend tddl_device_backend = {
+	"device",
+	device_open,
+	device_close,
+	device_submit,
+	device_wait,
+	device_cancel,
+	device_get_fd
+};
@@ -0,0 +1,285 @@
+
+/*
+ * Licensed Materials - Property of IBM
+ *
+ * trousers - An open source TCG Software Stack
+ *
+ * (C) Copyright International Business Machines Corp. 2004, 2005
+ *
+ */
+
+
+#include <unistd.h>
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netdb.h>
+
+#include "trousers/tss.h"
+#include "trousers_types.h"
+#include "tcslog.h"
+#include "tddl.h"
+
+/* The connection to a TPM emulator is kept open across commands and only re-established
+ * when the emulator has gone away. Since a stream socket has no message boundaries, the
+ * response is framed by the size field in its header. */
+int emulator_fd = TDDL_UNDEF;
+
+#define EMULATOR_EOF		-2
+#define EMULATOR_TIMEOUT	-3
+
+
+TSS_RESULT
+emulator_open()
+{
+	int fd, tcp_device_port;
+	char *tcp_device_hostname = NULL;
+	char *un_socket_device_path = NULL;
+	char *tcp_device_port_string = NULL;
+
+	if ((tcp_device_hostname = getenv("TCSD_TCP_DEVICE_HOSTNAME")) == NULL)
+		tcp_device_hostname = "localhost";
+	if ((un_socket_device_path = getenv("TCSD_UN_SOCKET_DEVICE_PATH")) == NULL)
+		un_socket_device_path = "/var/run/tpm/tpmd_socket:0";
+	if ((tcp_device_port_string = getenv("TCSD_TCP_DEVICE_PORT")) != NULL)
+		tcp_device_port = atoi(tcp_device_port_string);
+	else
+		tcp_device_port = 6545;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd > 0) {
+		struct hostent *host = gethostbyname(tcp_device_hostname);
+		if (host != NULL) {
+			struct sockaddr_in addr;
+			memset(&addr, 0x0, sizeof(addr));
+			addr.sin_family = host->h_addrtype;
+			addr.sin_port   = htons(tcp_device_port);
+			memcpy(&addr.sin_addr,
+					host->h_addr,
+					host->h_length);
+			if (connect(fd,	(struct sockaddr *)&addr,
+				    sizeof(addr)) < 0) {
+				close(fd);
+				fd = -1;
+			}
+		} else {
+			close (fd);
+			fd = -1;
+		}
+	}
+
+	if (fd < 0) {
+		struct sockaddr_un addr;
+
+		fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd >= 0) {
+			addr.sun_family = AF_UNIX;
+			strncpy(addr.sun_path, un_socket_device_path,
+					sizeof(addr.sun_path));
+			if (connect(fd, (void *)&addr, sizeof(addr)) < 0) {
+				close(fd);
+				fd = -1;
+			}
+		}
+	}
+
+	if (fd < 0) {
+		LogError("Could not connect to a TPM emulator!");
+		return TDDLERR(TDDL_E_COMPONENT_NOT_FOUND);
+	}
+
+	emulator_fd = fd;
+
+	return TSS_SUCCESS;
+}
+
+void
+emulator_close()
+{
+	if (emulator_fd != TDDL_UNDEF)
+		close(emulator_fd);
+	emulator_fd = TDDL_UNDEF;
+}
+
+int
+emulator_write(UINT32 len)
+{
+	UINT32 done = 0;
+	int rc;
+
+	while (done < len) {
+		rc = send(emulator_fd, txBuffer + done, len - done, MSG_NOSIGNAL);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		done += rc;
+	}
+
+	return 0;
+}
+
+TSS_RESULT
+emulator_submit(UINT32 len)
+{
+	struct pollfd pfd;
+
+	/* nothing should be readable between commands, if it is the emulator has closed
+	 * its end (or sent garbage) and the connection can't be reused. Either way the
+	 * command wasn't run; dropping the connection lets the TDDL reconnect and send it
+	 * again */
+	pfd.fd = emulator_fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+	if (poll(&pfd, 1, 0) != 0) {
+		LogDebug("TPM emulator connection is stale");
+		emulator_close();
+		return TDDLERR(TDDL_E_IOERROR);
+	}
+
+	if (emulator_write(len)) {
+		LogError("write to TPM emulator failed: %s", strerror(errno));
+		emulator_close();
+		return TDDLERR(TDDL_E_IOERROR);
+	}
+
+	return TSS_SUCCESS;
+}
+
+/* msecs left until @deadline, or -1 to wait forever when @deadline is NULL */
+int
+emulator_remaining(struct timespec *deadline)
+{
+	struct timespec now;
+	long msecs;
+
+	if (deadline == NULL)
+		return -1;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	msecs = (deadline->tv_sec - now.tv_sec) * 1000 +
+		(deadline->tv_nsec - now.tv_nsec) / 1000000;
+
+	return msecs < 0 ? 0 : (int)msecs;
+}
+
+/* read exactly @len bytes, giving up with EMULATOR_TIMEOUT if none have arrived by
+ * @deadline */
+int
+emulator_read_all(BYTE *buf, UINT32 len, struct timespec *deadline)
+{
+	struct pollfd pfd;
+	UINT32 done = 0;
+	int rc;
+
+	pfd.fd = emulator_fd;
+	pfd.events = POLLIN;
+
+	while (done < len) {
+		pfd.revents = 0;
+		rc = poll(&pfd, 1, emulator_remaining(deadline));
+		if (rc == 0)
+			return done ? -1 : EMULATOR_TIMEOUT;
+		else if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			LogError("poll on TPM emulator connection failed: %s", strerror(errno));
+			return -1;
+		}
+
+		rc = read(emulator_fd, buf + done, len - done);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			/* a reset means the emulator closed with our command unread */
+			return (errno == ECONNRESET && !done) ? EMULATOR_EOF : -1;
+		} else if (rc == 0)
+			return done ? -1 : EMULATOR_EOF;
+		done += rc;
+	}
+
+	return 0;
+}
+
+/* read one framed response into txBuffer, returning its size, -1 on error,
+ * EMULATOR_EOF if the emulator closed the connection without answering or
+ * EMULATOR_TIMEOUT if nothing at all arrived before @deadline */
+int
+emulator_read(struct timespec *deadline)
+{
+	UINT32 size;
+	int rc;
+
+	/* tag and paramSize */
+	if ((rc = emulator_read_all(txBuffer, 6, deadline)))
+		return rc;
+
+	size = ((UINT32)txBuffer[2] << 24) | ((UINT32)txBuffer[3] << 16) |
+	       ((UINT32)txBuffer[4] << 8) | (UINT32)txBuffer[5];
+	if (size < 10 || size > TDDL_TXBUF_SIZE) {
+		LogError("TPM emulator returned a bad response size (%u bytes)", size);
+		return -1;
+	}
+
+	/* a partial response leaves the stream out of sync, so running out of time here is
+	 * as fatal as any other error */
+	if (emulator_read_all(txBuffer + 6, size - 6, deadline))
+		return -1;
+
+	return size;
+}
+
+TSS_RESULT
+emulator_wait(int timeout, UINT32 *size)
+{
+	struct timespec deadline, *dp = NULL;
+	int sizeResult;
+
+	if (timeout >= 0) {
+		tddl_deadline((UINT64)timeout * 1000, &deadline);
+		dp = &deadline;
+	}
+
+	sizeResult = emulator_read(dp);
+	if (sizeResult == EMULATOR_TIMEOUT)
+		return TDDLERR(TDDL_E_TIMEOUT);
+
+	if (sizeResult < 0) {
+		/* the command may or may not have run before the connection went away, so it
+		 * can't be sent again. Drop the connection and let the next submit reconnect */
+		if (sizeResult == EMULATOR_EOF)
+			LogError("Lost the connection to the TPM emulator");
+		else
+			LogError("read from TPM emulator failed");
+		emulator_close();
+		return TDDLERR(TDDL_E_IOERROR);
+	}
+
+	*size = sizeResult;
+
+	return TSS_SUCCESS;
+}
+
+int
+emulator_get_fd()
+{
+	return emulator_fd;
+}
+
+struct tddl_backend tddl_emulator_backend = {
+	"emulator",
+	emulator_open,
+	emulator_close,
+	emulator_submit,
+	emulator_wait,
+	NULL,
+	emulator_get_fd
+};
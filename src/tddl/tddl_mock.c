@@ -0,0 +1,490 @@
+
+/*
+ * Licensed Materials - Property of IBM
+ *
+ * trousers - An open source TCG Software Stack
+ *
+ * (C) Copyright International Business Machines Corp. 2004, 2005
+ *
+ */
+
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+
+#include "trousers/tss.h"
+#include "trousers_types.h"
+#include "tcslog.h"
+#include "tddl.h"
+
+/* An in-process TPM for running tcsd without one. It answers the commands the TCSD needs
+ * to start up plus a few cheap ones (random numbers, PCRs, auth sessions) deterministically,
+ * after the latency configured for each ordinal with tddl_mock_latency. It has no owner,
+ * no keys and no NV storage, everything else fails with TPM_E_BAD_ORDINAL. */
+
+#define MOCK_NUM_PCRS		24
+#define MOCK_NUM_KEY_SLOTS	10
+#define MOCK_NUM_AUTHSESS	16
+#define MOCK_MANUFACTURER	0x4d4f434b	/* "MOCK" */
+
+BYTE mock_pcrs[MOCK_NUM_PCRS][TPM_SHA1_160_HASH_LEN];
+UINT32 mock_next_handle;
+UINT32 mock_rand_state;
+
+/* the outstanding command's response and when it becomes available */
+BYTE mock_resp[TDDL_TXBUF_SIZE];
+UINT32 mock_resp_size;
+struct timespec mock_ready;
+
+UINT32 mock_ordinals[] = {
+	TPM_ORD_GetCapability,
+	TPM_ORD_GetRandom,
+	TPM_ORD_PcrRead,
+	TPM_ORD_Extend,
+	TPM_ORD_OIAP,
+	TPM_ORD_OSAP,
+	TPM_ORD_Terminate_Handle,
+	TPM_ORD_FlushSpecific,
+	TPM_ORD_Startup,
+	TPM_ORD_SaveState,
+	TPM_ORD_SelfTestFull,
+	TPM_ORD_ContinueSelfTest,
+	TPM_ORD_GetTestResult,
+	0
+};
+
+
+static UINT32
+mock_get_UINT32(UINT32 offset)
+{
+	return ((UINT32)txBuffer[offset] << 24) | ((UINT32)txBuffer[offset + 1] << 16) |
+	       ((UINT32)txBuffer[offset + 2] << 8) | (UINT32)txBuffer[offset + 3];
+}
+
+static void
+mock_load_UINT32(UINT32 v)
+{
+	mock_resp[mock_resp_size++] = (BYTE)(v >> 24);
+	mock_resp[mock_resp_size++] = (BYTE)(v >> 16);
+	mock_resp[mock_resp_size++] = (BYTE)(v >> 8);
+	mock_resp[mock_resp_size++] = (BYTE)v;
+}
+
+static void
+mock_load_UINT16(UINT16 v)
+{
+	mock_resp[mock_resp_size++] = (BYTE)(v >> 8);
+	mock_resp[mock_resp_size++] = (BYTE)v;
+}
+
+static void
+mock_load_BYTE(BYTE v)
+{
+	mock_resp[mock_resp_size++] = v;
+}
+
+static void
+mock_load_BLOB(UINT32 size, BYTE *blob)
+{
+	memcpy(&mock_resp[mock_resp_size], blob, size);
+	mock_resp_size += size;
+}
+
+/* xorshift, so that a given command sequence always gets the same "random" bytes */
+static void
+mock_load_random(UINT32 size)
+{
+	UINT32 i;
+
+	for (i = 0; i < size; i++) {
+		mock_rand_state ^= mock_rand_state << 13;
+		mock_rand_state ^= mock_rand_state >> 17;
+		mock_rand_state ^= mock_rand_state << 5;
+		mock_load_BYTE((BYTE)mock_rand_state);
+	}
+}
+
+static TSS_BOOL
+mock_supports(UINT32 ordinal)
+{
+	int i;
+
+	for (i = 0; mock_ordinals[i]; i++) {
+		if (mock_ordinals[i] == ordinal)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+static UINT32
+mock_get_capability(UINT32 len)
+{
+	UINT32 capArea, subCapSize, subCap = 0, sizeOffset;
+
+	if (len < 18)
+		return TPM_E_BAD_PARAMETER;
+
+	capArea = mock_get_UINT32(10);
+	subCapSize = mock_get_UINT32(14);
+	if (subCapSize > len - 18)
+		return TPM_E_BAD_PARAMETER;
+	if (subCapSize >= sizeof(UINT32))
+		subCap = mock_get_UINT32(18);
+
+	/* respSize, filled in below */
+	sizeOffset = mock_resp_size;
+	mock_load_UINT32(0);
+
+	switch (capArea) {
+		case TPM_CAP_ORD:
+			mock_load_BYTE(mock_supports(subCap));
+			break;
+		case TPM_CAP_VERSION:
+			/* 1.2 TPMs report 1.1.0.0 here */
+			mock_load_BYTE(1);
+			mock_load_BYTE(1);
+			mock_load_BYTE(0);
+			mock_load_BYTE(0);
+			break;
+		case TPM_CAP_VERSION_VAL:
+			mock_load_UINT16(TPM_TAG_CAP_VERSION_INFO);
+			mock_load_BYTE(1);
+			mock_load_BYTE(2);
+			mock_load_BYTE(0);
+			mock_load_BYTE(0);
+			mock_load_UINT16(2);		/* specLevel */
+			mock_load_BYTE(0);		/* errataRev */
+			mock_load_UINT32(MOCK_MANUFACTURER);
+			mock_load_UINT16(0);		/* vendorSpecificSize */
+			break;
+		case TPM_CAP_KEY_HANDLE:
+		case TPM_CAP_HANDLE:
+			/* nothing is ever loaded */
+			mock_load_UINT16(0);
+			break;
+		case TPM_CAP_PROPERTY:
+			switch (subCap) {
+				case TPM_CAP_PROP_PCR:
+					mock_load_UINT32(MOCK_NUM_PCRS);
+					break;
+				case TPM_CAP_PROP_DIR:
+					mock_load_UINT32(1);
+					break;
+				case TPM_CAP_PROP_MANUFACTURER:
+					mock_load_UINT32(MOCK_MANUFACTURER);
+					break;
+				case TPM_CAP_PROP_SLOTS:
+				case TPM_CAP_PROP_MAX_KEYS:
+					mock_load_UINT32(MOCK_NUM_KEY_SLOTS);
+					break;
+				case TPM_CAP_PROP_AUTHSESS:
+				case TPM_CAP_PROP_MAX_AUTHSESS:
+				case TPM_CAP_PROP_SESSIONS:
+				case TPM_CAP_PROP_MAX_SESSIONS:
+					mock_load_UINT32(MOCK_NUM_AUTHSESS);
+					break;
+				case TPM_CAP_PROP_OWNER:
+					mock_load_BYTE(FALSE);
+					break;
+				case TPM_CAP_PROP_INPUT_BUFFER:
+					mock_load_UINT32(TDDL_TXBUF_SIZE);
+					break;
+				case TPM_CAP_PROP_DURATION:
+					/* short, medium and long, in usecs */
+					mock_load_UINT32(750000);
+					mock_load_UINT32(2000000);
+					mock_load_UINT32(60000000);
+					break;
+				default:
+					return TPM_E_BAD_MODE;
+			}
+			break;
+		default:
+			return TPM_E_BAD_MODE;
+	}
+
+	/* respSize */
+	subCapSize = mock_resp_size;
+	mock_resp_size = sizeOffset;
+	mock_load_UINT32(subCapSize - sizeOffset - sizeof(UINT32));
+	mock_resp_size = subCapSize;
+
+	return TPM_SUCCESS;
+}
+
+#define MOCK_ROL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+static void
+mock_sha1_block(UINT32 *h, const BYTE *block)
+{
+	UINT32 w[80], a, b, c, d, e, f, k, t;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = ((UINT32)block[4 * i] << 24) | ((UINT32)block[4 * i + 1] << 16) |
+		       ((UINT32)block[4 * i + 2] << 8) | (UINT32)block[4 * i + 3];
+	for (; i < 80; i++)
+		w[i] = MOCK_ROL(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+	a = h[0]; b = h[1]; c = h[2]; d = h[3]; e = h[4];
+	for (i = 0; i < 80; i++) {
+		if (i < 20) {
+			f = (b & c) | (~b & d);
+			k = 0x5a827999;
+		} else if (i < 40) {
+			f = b ^ c ^ d;
+			k = 0x6ed9eba1;
+		} else if (i < 60) {
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8f1bbcdc;
+		} else {
+			f = b ^ c ^ d;
+			k = 0xca62c1d6;
+		}
+		t = MOCK_ROL(a, 5) + f + e + k + w[i];
+		e = d; d = c; c = MOCK_ROL(b, 30); b = a; a = t;
+	}
+	h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+/* The TDDL doesn't link against a crypto library, so the mock carries the one hash it
+ * needs to extend PCRs */
+static void
+mock_sha1(const BYTE *data, UINT32 len, BYTE *digest)
+{
+	UINT32 h[5] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+	UINT64 bits = (UINT64)len * 8;
+	BYTE block[64];
+	UINT32 rem;
+	int i;
+
+	for (; len >= 64; data += 64, len -= 64)
+		mock_sha1_block(h, data);
+
+	/* pad with 0x80, zeros and the message length in bits */
+	rem = len;
+	memset(block, 0, sizeof(block));
+	memcpy(block, data, rem);
+	block[rem] = 0x80;
+	if (rem >= 56) {
+		mock_sha1_block(h, block);
+		memset(block, 0, sizeof(block));
+	}
+	for (i = 0; i < 8; i++)
+		block[63 - i] = (BYTE)(bits >> (8 * i));
+	mock_sha1_block(h, block);
+
+	for (i = 0; i < 5; i++) {
+		digest[4 * i] = (BYTE)(h[i] >> 24);
+		digest[4 * i + 1] = (BYTE)(h[i] >> 16);
+		digest[4 * i + 2] = (BYTE)(h[i] >> 8);
+		digest[4 * i + 3] = (BYTE)h[i];
+	}
+}
+
+static UINT32
+mock_extend(UINT32 len)
+{
+	BYTE buf[2 * TPM_SHA1_160_HASH_LEN];
+	UINT32 index;
+
+	if (len < 14 + TPM_SHA1_160_HASH_LEN)
+		return TPM_E_BAD_PARAMETER;
+
+	if ((index = mock_get_UINT32(10)) >= MOCK_NUM_PCRS)
+		return TPM_E_BADINDEX;
+
+	memcpy(buf, mock_pcrs[index], TPM_SHA1_160_HASH_LEN);
+	memcpy(&buf[TPM_SHA1_160_HASH_LEN], &txBuffer[14], TPM_SHA1_160_HASH_LEN);
+	mock_sha1(buf, sizeof(buf), mock_pcrs[index]);
+
+	mock_load_BLOB(TPM_SHA1_160_HASH_LEN, mock_pcrs[index]);
+
+	return TPM_SUCCESS;
+}
+
+/* run the command in txBuffer, leaving its response in mock_resp */
+static void
+mock_execute(UINT32 len)
+{
+	UINT32 ordinal, result, size;
+
+	mock_resp_size = 10;
+
+	if (len < 10) {
+		result = TPM_E_BAD_PARAMETER;
+		goto done;
+	}
+
+	ordinal = mock_get_UINT32(6);
+	switch (ordinal) {
+		case TPM_ORD_GetCapability:
+			result = mock_get_capability(len);
+			break;
+		case TPM_ORD_GetRandom:
+			if (len < 14) {
+				result = TPM_E_BAD_PARAMETER;
+				break;
+			}
+			size = mock_get_UINT32(10);
+			if (size > TDDL_TXBUF_SIZE - 14)
+				size = TDDL_TXBUF_SIZE - 14;
+			mock_load_UINT32(size);
+			mock_load_random(size);
+			result = TPM_SUCCESS;
+			break;
+		case TPM_ORD_PcrRead:
+			if (len < 14) {
+				result = TPM_E_BAD_PARAMETER;
+				break;
+			}
+			if ((size = mock_get_UINT32(10)) >= MOCK_NUM_PCRS) {
+				result = TPM_E_BADINDEX;
+				break;
+			}
+			mock_load_BLOB(TPM_SHA1_160_HASH_LEN, mock_pcrs[size]);
+			result = TPM_SUCCESS;
+			break;
+		case TPM_ORD_Extend:
+			result = mock_extend(len);
+			break;
+		case TPM_ORD_OIAP:
+			mock_load_UINT32(mock_next_handle++);
+			mock_load_random(TPM_SHA1_160_HASH_LEN);
+			result = TPM_SUCCESS;
+			break;
+		case TPM_ORD_OSAP:
+			mock_load_UINT32(mock_next_handle++);
+			mock_load_random(2 * TPM_SHA1_160_HASH_LEN);
+			result = TPM_SUCCESS;
+			break;
+		case TPM_ORD_GetTestResult:
+			mock_load_UINT32(0);
+			result = TPM_SUCCESS;
+			break;
+		case TPM_ORD_Terminate_Handle:
+		case TPM_ORD_FlushSpecific:
+		case TPM_ORD_Startup:
+		case TPM_ORD_SaveState:
+		case TPM_ORD_SelfTestFull:
+		case TPM_ORD_ContinueSelfTest:
+			result = TPM_SUCCESS;
+			break;
+		default:
+			result = TPM_E_BAD_ORDINAL;
+			break;
+	}
+
+done:
+	/* an error response carries only the header */
+	if (result != TPM_SUCCESS)
+		mock_resp_size = 10;
+
+	size = mock_resp_size;
+	mock_resp_size = 0;
+	mock_load_UINT16(TPM_TAG_RSP_COMMAND);
+	mock_load_UINT32(size);
+	mock_load_UINT32(result);
+	mock_resp_size = size;
+}
+
+static UINT32
+mock_latency(UINT32 ordinal)
+{
+	struct tcsd_ord_latency *lat;
+
+	if (_tcsd_options == NULL)
+		return 0;
+
+	for (lat = _tcsd_options->tddl_mock_ord_latency; lat; lat = lat->next) {
+		if (lat->ordinal == ordinal)
+			return lat->usecs;
+	}
+
+	return _tcsd_options->tddl_mock_latency;
+}
+
+static void
+mock_sleep(struct timespec *until)
+{
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, until, NULL) == EINTR)
+		;
+}
+
+TSS_RESULT
+mock_open()
+{
+	memset(mock_pcrs, 0, sizeof(mock_pcrs));
+	mock_next_handle = 0x02000000;
+	mock_rand_state = 0x2545f491;
+
+	LogInfo("Using the mock TPM, default latency %u usecs",
+		_tcsd_options ? _tcsd_options->tddl_mock_latency : 0);
+
+	return TSS_SUCCESS;
+}
+
+void
+mock_close()
+{
+}
+
+TSS_RESULT
+mock_submit(UINT32 len)
+{
+	UINT32 usecs;
+
+	mock_execute(len);
+
+	usecs = len >= 10 ? mock_latency(mock_get_UINT32(6)) : 0;
+
+	tddl_deadline(usecs, &mock_ready);
+
+	return TSS_SUCCESS;
+}
+
+TSS_RESULT
+mock_wait(int timeout, UINT32 *size)
+{
+	struct timespec deadline;
+
+	if (timeout >= 0) {
+		tddl_deadline((UINT64)timeout * 1000, &deadline);
+
+		if (deadline.tv_sec < mock_ready.tv_sec ||
+		    (deadline.tv_sec == mock_ready.tv_sec &&
+		     deadline.tv_nsec < mock_ready.tv_nsec)) {
+			mock_sleep(&deadline);
+			return TDDLERR(TDDL_E_TIMEOUT);
+		}
+	}
+
+	mock_sleep(&mock_ready);
+
+	memcpy(txBuffer, mock_resp, mock_resp_size);
+	*size = mock_resp_size;
+
+	return TSS_SUCCESS;
+}
+
+/* a cancelled command's response is available right away */
+TSS_RESULT
+mock_cancel()
+{
+	clock_gettime(CLOCK_MONOTONIC, &mock_ready);
+
+	return TSS_SUCCESS;
+}
+
+struct tddl_backend tddl_mock_backend = {
+	"mock",
+	mock_open,
+	mock_close,
+	mock_submit,
+	mock_wait,
+	mock_cancel,
+	NULL
+};
@@ -15,7 +15,9 @@
  *
  */
 
+#include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #include <openssl/opensslv.h>
 #include <openssl/rsa.h>  // for some reason the MGF1 prototype is in here
@@ -23,6 +25,7 @@
 #include <openssl/hmac.h>
 #include <openssl/err.h>
 #include <openssl/sha.h>
+#include <openssl/crypto.h>
 
 #include "trousers/tss.h"
 #include "trousers/trousers.h"
@@ -100,38 +103,183 @@ out:
         return rv;
 }
 
+/* Trspi_HashCtx is part of the public API and only holds a pointer, so the state behind
+ * it is kept on a per-thread free list instead of being allocated for every digest. A
+ * recycled EVP context is reset by copying an initialized prototype, which is cheaper than
+ * looking up and initializing the digest again. Parameter digests are mostly built from
+ * many small updates (marshalled UINT32s, BYTEs and so on), so updates are collected in
+ * buf and handed to the digest in larger pieces. */
+#define HASH_STATE_BUFSIZE	256
+#define HASH_CACHE_MAX_FREE	8
+
+struct hash_state {
+	EVP_MD_CTX *md_ctx;
+	UINT32 buf_len;
+	BYTE buf[HASH_STATE_BUFSIZE];
+	struct hash_state *next;
+};
+
+struct hash_cache {
+	EVP_MD_CTX *sha1_proto;
+	struct hash_state *free_list;
+	int num_free;
+};
+
+static pthread_key_t hash_cache_key;
+static pthread_once_t hash_cache_once = PTHREAD_ONCE_INIT;
+
+/* buf may hold secrets (unsealed data, data to bind). Only its first buf_len bytes are ever
+ * left uncleansed, so wiping those before the state is reused or freed is enough */
+static void
+hash_state_wipe(struct hash_state *state)
+{
+	OPENSSL_cleanse(state->buf, state->buf_len);
+	state->buf_len = 0;
+}
+
+static void
+hash_state_destroy(struct hash_state *state)
+{
+	hash_state_wipe(state);
+	EVP_MD_CTX_destroy(state->md_ctx);
+	free(state);
+}
+
+static void
+hash_cache_destroy(void *data)
+{
+	struct hash_cache *cache = (struct hash_cache *)data;
+	struct hash_state *state, *next;
+
+	for (state = cache->free_list; state; state = next) {
+		next = state->next;
+		hash_state_destroy(state);
+	}
+
+	if (cache->sha1_proto)
+		EVP_MD_CTX_destroy(cache->sha1_proto);
+	free(cache);
+}
+
+static void
+hash_cache_key_init(void)
+{
+	pthread_key_create(&hash_cache_key, hash_cache_destroy);
+}
+
+static struct hash_cache *
+hash_cache_get(void)
+{
+	struct hash_cache *cache;
+
+	pthread_once(&hash_cache_once, hash_cache_key_init);
+
+	if ((cache = pthread_getspecific(hash_cache_key)) != NULL)
+		return cache;
+
+	if ((cache = calloc(1, sizeof(struct hash_cache))) == NULL)
+		return NULL;
+
+	if ((cache->sha1_proto = EVP_MD_CTX_create()) == NULL)
+		goto err;
+
+	if (EVP_DigestInit_ex(cache->sha1_proto, EVP_sha1(), NULL) != EVP_SUCCESS) {
+		DEBUG_print_openssl_errors();
+		goto err;
+	}
+
+	if (pthread_setspecific(hash_cache_key, cache))
+		goto err;
+
+	return cache;
+err:
+	if (cache->sha1_proto)
+		EVP_MD_CTX_destroy(cache->sha1_proto);
+	free(cache);
+	return NULL;
+}
+
+static void
+hash_state_release(struct hash_state *state)
+{
+	struct hash_cache *cache = pthread_getspecific(hash_cache_key);
+
+	/* a context finished on a different thread than it was started on just joins that
+	 * thread's list */
+	if (cache == NULL || cache->num_free >= HASH_CACHE_MAX_FREE) {
+		hash_state_destroy(state);
+		return;
+	}
+
+	hash_state_wipe(state);
+	state->next = cache->free_list;
+	cache->free_list = state;
+	cache->num_free++;
+}
+
+static TSS_RESULT
+hash_state_flush(struct hash_state *state)
+{
+	if (!state->buf_len)
+		return TSS_SUCCESS;
+
+	if (EVP_DigestUpdate(state->md_ctx, state->buf, state->buf_len) != EVP_SUCCESS) {
+		DEBUG_print_openssl_errors();
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+	}
+	hash_state_wipe(state);
+
+	return TSS_SUCCESS;
+}
+
 TSS_RESULT
 Trspi_HashInit(Trspi_HashCtx *ctx, UINT32 HashType)
 {
-	int rv;
-	EVP_MD *md;
+	struct hash_cache *cache;
+	struct hash_state *state;
 
 	switch (HashType) {
 		case TSS_HASH_SHA1:
-			md = (EVP_MD *)EVP_sha1();
 			break;
 		default:
 			return TSPERR(TSS_E_BAD_PARAMETER);
 			break;
 	}
 
-	if ((ctx->ctx = EVP_MD_CTX_create()) == NULL)
+	if ((cache = hash_cache_get()) == NULL)
 		return TSPERR(TSS_E_OUTOFMEMORY);
 
-	rv = EVP_DigestInit((EVP_MD_CTX *)ctx->ctx, (const EVP_MD *)md);
+	if ((state = cache->free_list) != NULL) {
+		cache->free_list = state->next;
+		cache->num_free--;
+	} else {
+		if ((state = malloc(sizeof(struct hash_state))) == NULL)
+			return TSPERR(TSS_E_OUTOFMEMORY);
+		state->buf_len = 0;
+
+		if ((state->md_ctx = EVP_MD_CTX_create()) == NULL) {
+			free(state);
+			return TSPERR(TSS_E_OUTOFMEMORY);
+		}
+	}
 
-	if (rv != EVP_SUCCESS) {
+	if (EVP_MD_CTX_copy_ex(state->md_ctx, cache->sha1_proto) != EVP_SUCCESS) {
 		DEBUG_print_openssl_errors();
+		hash_state_destroy(state);
 		return TSPERR(TSS_E_INTERNAL_ERROR);
 	}
 
+	state->buf_len = 0;
+	state->next = NULL;
+	ctx->ctx = state;
+
 	return TSS_SUCCESS;
 }
 
 TSS_RESULT
 Trspi_HashUpdate(Trspi_HashCtx *ctx, UINT32 size, BYTE *data)
 {
-	int rv;
+	struct hash_state *state;
 
 	if (ctx == NULL || ctx->ctx == NULL)
 		return TSPERR(TSS_E_INTERNAL_ERROR);
@@ -142,35 +290,54 @@ Trspi_HashUpdate(Trspi_HashCtx *ctx, UINT32 size, BYTE *data)
 	if (!size)
 		return TSS_SUCCESS;
 
-	rv = EVP_DigestUpdate(ctx->ctx, data, size);
-	if (rv != EVP_SUCCESS) {
-		DEBUG_print_openssl_errors();
-		free(ctx->ctx);
-		ctx->ctx = NULL;
-		return TSPERR(TSS_E_INTERNAL_ERROR);
+	state = (struct hash_state *)ctx->ctx;
+
+	if (size > HASH_STATE_BUFSIZE - state->buf_len) {
+		if (hash_state_flush(state))
+			goto err;
+	}
+
+	if (size >= HASH_STATE_BUFSIZE) {
+		if (EVP_DigestUpdate(state->md_ctx, data, size) != EVP_SUCCESS) {
+			DEBUG_print_openssl_errors();
+			goto err;
+		}
+	} else {
+		memcpy(&state->buf[state->buf_len], data, size);
+		state->buf_len += size;
 	}
 
 	return TSS_SUCCESS;
+err:
+	hash_state_release(state);
+	ctx->ctx = NULL;
+	return TSPERR(TSS_E_INTERNAL_ERROR);
 }
 
 TSS_RESULT
 Trspi_HashFinal(Trspi_HashCtx *ctx, BYTE *digest)
 {
-	int rv;
-	UINT32 result_size;
+	struct hash_state *state;
+	TSS_RESULT result = TSS_SUCCESS;
+	unsigned int result_size;
 
 	if (ctx == NULL || ctx->ctx == NULL)
 		return TSPERR(TSS_E_INTERNAL_ERROR);
 
-	result_size = EVP_MD_CTX_size((EVP_MD_CTX *)ctx->ctx);
-	rv = EVP_DigestFinal(ctx->ctx, digest, &result_size);
-	if (rv != EVP_SUCCESS)
-		return TSPERR(TSS_E_INTERNAL_ERROR);
+	state = (struct hash_state *)ctx->ctx;
+
+	if (hash_state_flush(state))
+		result = TSPERR(TSS_E_INTERNAL_ERROR);
+	else {
+		result_size = EVP_MD_CTX_size(state->md_ctx);
+		if (EVP_DigestFinal_ex(state->md_ctx, digest, &result_size) != EVP_SUCCESS)
+			result = TSPERR(TSS_E_INTERNAL_ERROR);
+	}
 
-	free(ctx->ctx);
+	hash_state_release(state);
 	ctx->ctx = NULL;
 
-	return TSS_SUCCESS;
+	return result;
 }
 
 UINT32
@@ -198,6 +365,123 @@ out:
 	return rv;
 }
 
+/* Every authorization of a command HMACs with the same 20 byte secret twice, once for the
+ * request and once to check the response. Hashing the key XOR'd with ipad and opad is
+ * half of the work for such short messages, so Trspi_HMAC_KeyInit does it once and keeps
+ * the resulting digest states. Trspi_HMAC_Keyed then copies them into recycled hash state
+ * and only hashes the message and the inner digest. */
+TSS_RESULT
+Trspi_HMAC_KeyInit(Trspi_HMACKey *key, UINT32 SecretSize, BYTE *Secret)
+{
+	BYTE pad[SHA_CBLOCK], keyDigest[SHA_DIGEST_LENGTH];
+	EVP_MD_CTX *inner = NULL, *outer = NULL;
+	TSS_RESULT result = TSPERR(TSS_E_INTERNAL_ERROR);
+	UINT32 i;
+
+	if (SecretSize > SHA_CBLOCK) {
+		if ((result = Trspi_Hash(TSS_HASH_SHA1, SecretSize, Secret, keyDigest)))
+			return result;
+		Secret = keyDigest;
+		SecretSize = SHA_DIGEST_LENGTH;
+	}
+
+	if ((inner = EVP_MD_CTX_create()) == NULL ||
+	    (outer = EVP_MD_CTX_create()) == NULL) {
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto err;
+	}
+
+	memset(pad, 0x36, sizeof(pad));
+	for (i = 0; i < SecretSize; i++)
+		pad[i] ^= Secret[i];
+	if (EVP_DigestInit_ex(inner, EVP_sha1(), NULL) != EVP_SUCCESS ||
+	    EVP_DigestUpdate(inner, pad, sizeof(pad)) != EVP_SUCCESS)
+		goto err;
+
+	memset(pad, 0x5c, sizeof(pad));
+	for (i = 0; i < SecretSize; i++)
+		pad[i] ^= Secret[i];
+	if (EVP_DigestInit_ex(outer, EVP_sha1(), NULL) != EVP_SUCCESS ||
+	    EVP_DigestUpdate(outer, pad, sizeof(pad)) != EVP_SUCCESS)
+		goto err;
+
+	OPENSSL_cleanse(pad, sizeof(pad));
+	OPENSSL_cleanse(keyDigest, sizeof(keyDigest));
+
+	key->inner = inner;
+	key->outer = outer;
+
+	return TSS_SUCCESS;
+err:
+	DEBUG_print_openssl_errors();
+	OPENSSL_cleanse(pad, sizeof(pad));
+	OPENSSL_cleanse(keyDigest, sizeof(keyDigest));
+	if (inner)
+		EVP_MD_CTX_destroy(inner);
+	if (outer)
+		EVP_MD_CTX_destroy(outer);
+	return result;
+}
+
+TSS_RESULT
+Trspi_HMAC_Keyed(Trspi_HMACKey *key, UINT32 BufSize, BYTE *Buf, BYTE *hmacOut)
+{
+	Trspi_HashCtx ctx;
+	struct hash_state *state;
+	BYTE digest[SHA_DIGEST_LENGTH];
+	TSS_RESULT result;
+
+	if (key->inner == NULL)
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+
+	/* get a recycled state and overwrite its SHA1 context with the keyed ones */
+	if ((result = Trspi_HashInit(&ctx, TSS_HASH_SHA1)))
+		return result;
+	state = (struct hash_state *)ctx.ctx;
+
+	if (EVP_MD_CTX_copy_ex(state->md_ctx, key->inner) != EVP_SUCCESS) {
+		DEBUG_print_openssl_errors();
+		result = TSPERR(TSS_E_INTERNAL_ERROR);
+		goto done;
+	}
+	result = Trspi_HashUpdate(&ctx, BufSize, Buf);
+	result |= Trspi_HashFinal(&ctx, digest);
+	if (result)
+		return result;
+
+	if ((result = Trspi_HashInit(&ctx, TSS_HASH_SHA1)))
+		return result;
+	state = (struct hash_state *)ctx.ctx;
+
+	if (EVP_MD_CTX_copy_ex(state->md_ctx, key->outer) != EVP_SUCCESS) {
+		DEBUG_print_openssl_errors();
+		result = TSPERR(TSS_E_INTERNAL_ERROR);
+		goto done;
+	}
+	result = Trspi_HashUpdate(&ctx, sizeof(digest), digest);
+	result |= Trspi_HashFinal(&ctx, hmacOut);
+
+	OPENSSL_cleanse(digest, sizeof(digest));
+
+	return result;
+done:
+	OPENSSL_cleanse(digest, sizeof(digest));
+	hash_state_release(state);
+	return result;
+}
+
+/* Destroying an EVP context cleanses its digest state, which is derived from the key */
+void
+Trspi_HMAC_KeyFree(Trspi_HMACKey *key)
+{
+	if (key->inner)
+		EVP_MD_CTX_destroy(key->inner);
+	if (key->outer)
+		EVP_MD_CTX_destroy(key->outer);
+	key->inner = NULL;
+	key->outer = NULL;
+}
+
 TSS_RESULT
 Trspi_MGF1(UINT32 alg, UINT32 seedLen, BYTE *seed, UINT32 outLen, BYTE *out)
 {
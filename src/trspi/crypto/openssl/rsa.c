@@ -15,6 +15,7 @@
  *
  */
 
+#include <stdlib.h>
 #include <string.h>
 
 #include <openssl/evp.h>
@@ -64,47 +65,61 @@ RSA_set0_key(RSA *r, BIGNUM *n, BIGNUM *e, BIGNUM *d)
  */
 #define EVP_SUCCESS 1
 
-/* XXX int set to unsigned int values */
-int
-Trspi_RSA_Encrypt(unsigned char *dataToEncrypt, /* in */
-		unsigned int dataToEncryptLen,  /* in */
-		unsigned char *encryptedData,   /* out */
-		unsigned int *encryptedDataLen, /* out */
-		unsigned char *publicKey,
-		unsigned int keysize)
+/* Fewest signatures worth handing to a thread of their own in Trspi_Verify_Batch */
+#define VERIFY_BATCH_MIN_PER_THREAD	16
+
+/* build an OpenSSL public key from a TPM modulus and a big endian public exponent */
+static TSS_RESULT
+rsa_public_key(unsigned char *modulus, unsigned int size,
+	       unsigned char *exp, unsigned int exp_size, RSA **rsa_out)
 {
-	int rv;
-	unsigned char exp[] = { 0x01, 0x00, 0x01 }; /* 65537 hex */
-	unsigned char oaepPad[] = "TCPA";
-	int oaepPadLen = 4;
 	RSA *rsa = RSA_new();
-	BYTE encodedData[256];
-	int encodedDataLen;
 	BIGNUM *rsa_n = NULL, *rsa_e = NULL;
 
-	if (rsa == NULL) {
-		rv = TSPERR(TSS_E_OUTOFMEMORY);
+	if (rsa == NULL)
 		goto err;
-	}
 
 	/* set the public key value in the OpenSSL object */
-	rsa_n = BN_bin2bn(publicKey, keysize, NULL);
+	rsa_n = BN_bin2bn(modulus, size, NULL);
 	/* set the public exponent */
-	rsa_e = BN_bin2bn(exp, sizeof(exp), NULL);
+	rsa_e = BN_bin2bn(exp, exp_size, NULL);
 
 	if (rsa_n == NULL || rsa_e == NULL) {
-		rv = TSPERR(TSS_E_OUTOFMEMORY);
 		BN_free(rsa_n);
 		BN_free(rsa_e);
 		goto err;
 	}
 	if (!RSA_set0_key(rsa, rsa_n, rsa_e, NULL)) {
-		rv = TSPERR(TSS_E_FAIL);
 		BN_free(rsa_n);
 		BN_free(rsa_e);
-		goto err;
+		RSA_free(rsa);
+		DEBUG_print_openssl_errors();
+		return TSPERR(TSS_E_FAIL);
 	}
 
+	*rsa_out = rsa;
+	return TSS_SUCCESS;
+err:
+	if (rsa)
+		RSA_free(rsa);
+	DEBUG_print_openssl_errors();
+	return TSPERR(TSS_E_OUTOFMEMORY);
+}
+
+/* OAEP encrypt with the "TCPA" encoding parameter the TPM expects */
+static int
+rsa_tpm_oaep_encrypt(RSA *rsa,
+		     unsigned char *dataToEncrypt,
+		     unsigned int dataToEncryptLen,
+		     unsigned char *encryptedData,
+		     unsigned int *encryptedDataLen)
+{
+	int rv;
+	unsigned char oaepPad[] = "TCPA";
+	int oaepPadLen = 4;
+	BYTE encodedData[256];
+	int encodedDataLen;
+
 	/* padding constraint for PKCS#1 OAEP padding */
 	if ((int)dataToEncryptLen >= (RSA_size(rsa) - ((2 * SHA_DIGEST_LENGTH) + 1))) {
 		rv = TSPERR(TSS_E_INTERNAL_ERROR);
@@ -131,32 +146,19 @@ Trspi_RSA_Encrypt(unsigned char *dataToEncrypt, /* in */
 
 	/* RSA_public_encrypt returns the size of the encrypted data */
 	*encryptedDataLen = rv;
-	rv = TSS_SUCCESS;
-	goto out;
+	return TSS_SUCCESS;
 
 err:
 	DEBUG_print_openssl_errors();
-out:
-	if (rsa)
-		RSA_free(rsa);
-        return rv;
+	return rv;
 }
 
-TSS_RESULT
-Trspi_Verify(UINT32 HashType, BYTE *pHash, UINT32 iHashLength,
-	     unsigned char *pModulus, int iKeyLength,
-	     BYTE *pSignature, UINT32 sig_len)
+static TSS_RESULT
+rsa_verify(RSA *rsa, UINT32 HashType, BYTE *pHash, UINT32 iHashLength,
+	   BYTE *pSignature, UINT32 sig_len)
 {
 	int rv, nid;
-	unsigned char exp[] = { 0x01, 0x00, 0x01 }; /* The default public exponent for the TPM */
 	unsigned char buf[256];
-	RSA *rsa = RSA_new();
-	BIGNUM *rsa_n = NULL, *rsa_e = NULL;
-
-	if (rsa == NULL) {
-		rv = TSPERR(TSS_E_OUTOFMEMORY);
-		goto err;
-	}
 
 	/* We assume we're verifying data from a TPM, so there are only
 	 * two options, SHA1 data and PKCSv1.5 encoded signature data.
@@ -169,27 +171,7 @@ Trspi_Verify(UINT32 HashType, BYTE *pHash, UINT32 iHashLength,
 			nid = NID_undef;
 			break;
 		default:
-			rv = TSPERR(TSS_E_BAD_PARAMETER);
-			goto out;
-			break;
-	}
-
-	/* set the public key value in the OpenSSL object */
-	rsa_n = BN_bin2bn(pModulus, iKeyLength, NULL);
-	/* set the public exponent */
-	rsa_e = BN_bin2bn(exp, sizeof(exp), NULL);
-
-	if (rsa_n == NULL || rsa_e == NULL) {
-		rv = TSPERR(TSS_E_OUTOFMEMORY);
-		BN_free(rsa_n);
-		BN_free(rsa_e);
-		goto err;
-	}
-	if (!RSA_set0_key(rsa, rsa_n, rsa_e, NULL)) {
-		rv = TSPERR(TSS_E_FAIL);
-		BN_free(rsa_n);
-		BN_free(rsa_e);
-		goto err;
+			return TSPERR(TSS_E_BAD_PARAMETER);
 	}
 
 	/* if we don't know the structure of the data we're verifying, do a public decrypt
@@ -198,28 +180,76 @@ Trspi_Verify(UINT32 HashType, BYTE *pHash, UINT32 iHashLength,
 	 */
 	if (nid == NID_undef) {
 		rv = RSA_public_decrypt(sig_len, pSignature, buf, rsa, RSA_PKCS1_PADDING);
-		if ((UINT32)rv != iHashLength) {
-			rv = TSPERR(TSS_E_FAIL);
-			goto out;
-		} else if (memcmp(pHash, buf, iHashLength)) {
-			rv = TSPERR(TSS_E_FAIL);
-			goto out;
-		}
+		if ((UINT32)rv != iHashLength)
+			return TSPERR(TSS_E_FAIL);
+		else if (memcmp(pHash, buf, iHashLength))
+			return TSPERR(TSS_E_FAIL);
 	} else {
-		if ((rv = RSA_verify(nid, pHash, iHashLength, pSignature, sig_len, rsa)) == 0) {
-			rv = TSPERR(TSS_E_FAIL);
-			goto out;
-		}
+		if (RSA_verify(nid, pHash, iHashLength, pSignature, sig_len, rsa) == 0)
+			return TSPERR(TSS_E_FAIL);
 	}
 
-	rv = TSS_SUCCESS;
-	goto out;
+	return TSS_SUCCESS;
+}
 
-err:
-	DEBUG_print_openssl_errors();
-out:
-	if (rsa)
-		RSA_free(rsa);
+static int
+rsa_public_encrypt(RSA *rsa, unsigned char *in, unsigned int inlen,
+		   unsigned char *out, unsigned int *outlen, int padding)
+{
+	int rv;
+
+	rv = RSA_public_encrypt(inlen, in, out, rsa, padding);
+	if (rv == -1) {
+		DEBUG_print_openssl_errors();
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+	}
+
+	/* RSA_public_encrypt returns the size of the encrypted data */
+	*outlen = rv;
+	return TSS_SUCCESS;
+}
+
+/* XXX int set to unsigned int values */
+int
+Trspi_RSA_Encrypt(unsigned char *dataToEncrypt, /* in */
+		unsigned int dataToEncryptLen,  /* in */
+		unsigned char *encryptedData,   /* out */
+		unsigned int *encryptedDataLen, /* out */
+		unsigned char *publicKey,
+		unsigned int keysize)
+{
+	int rv;
+	unsigned char exp[] = { 0x01, 0x00, 0x01 }; /* 65537 hex */
+	RSA *rsa;
+
+	if ((rv = rsa_public_key(publicKey, keysize, exp, sizeof(exp), &rsa)))
+		return rv;
+
+	rv = rsa_tpm_oaep_encrypt(rsa, dataToEncrypt, dataToEncryptLen, encryptedData,
+				  encryptedDataLen);
+
+	RSA_free(rsa);
+        return rv;
+}
+
+TSS_RESULT
+Trspi_Verify(UINT32 HashType, BYTE *pHash, UINT32 iHashLength,
+	     unsigned char *pModulus, int iKeyLength,
+	     BYTE *pSignature, UINT32 sig_len)
+{
+	TSS_RESULT rv;
+	unsigned char exp[] = { 0x01, 0x00, 0x01 }; /* The default public exponent for the TPM */
+	RSA *rsa;
+
+	if (HashType != TSS_HASH_SHA1 && HashType != TSS_HASH_OTHER)
+		return TSPERR(TSS_E_BAD_PARAMETER);
+
+	if ((rv = rsa_public_key(pModulus, iKeyLength, exp, sizeof(exp), &rsa)))
+		return rv;
+
+	rv = rsa_verify(rsa, HashType, pHash, iHashLength, pSignature, sig_len);
+
+	RSA_free(rsa);
         return rv;
 }
 
@@ -231,13 +261,7 @@ Trspi_RSA_Public_Encrypt(unsigned char *in, unsigned int inlen,
 {
 	int rv, e_size = 3;
 	unsigned char exp[] = { 0x01, 0x00, 0x01 };
-	RSA *rsa = RSA_new();
-	BIGNUM *rsa_n = NULL, *rsa_e = NULL;
-
-	if (rsa == NULL) {
-		rv = TSPERR(TSS_E_OUTOFMEMORY);
-		goto err;
-	}
+	RSA *rsa;
 
 	switch (e) {
 		case 0:
@@ -253,9 +277,7 @@ Trspi_RSA_Public_Encrypt(unsigned char *in, unsigned int inlen,
 			e_size = 1;
 			break;
 		default:
-			rv = TSPERR(TSS_E_INTERNAL_ERROR);
-			goto out;
-			break;
+			return TSPERR(TSS_E_INTERNAL_ERROR);
 	}
 
 	switch (padding) {
@@ -269,44 +291,209 @@ Trspi_RSA_Public_Encrypt(unsigned char *in, unsigned int inlen,
 			padding = RSA_NO_PADDING;
 			break;
 		default:
-			rv = TSPERR(TSS_E_INTERNAL_ERROR);
-			goto out;
-			break;
+			return TSPERR(TSS_E_INTERNAL_ERROR);
 	}
 
-	/* set the public key value in the OpenSSL object */
-	rsa_n = BN_bin2bn(pubkey, pubsize, NULL);
-	/* set the public exponent */
-	rsa_e = BN_bin2bn(exp, e_size, NULL);
+	if ((rv = rsa_public_key(pubkey, pubsize, exp, e_size, &rsa)))
+		return rv;
 
-	if (rsa_n == NULL || rsa_e == NULL) {
-		rv = TSPERR(TSS_E_OUTOFMEMORY);
-                BN_free(rsa_n);
-                BN_free(rsa_e);
-                goto err;
-        }
-        if (!RSA_set0_key(rsa, rsa_n, rsa_e, NULL)) {
-                rv = TSPERR(TSS_E_FAIL);
-                BN_free(rsa_n);
-                BN_free(rsa_e);
-		goto err;
+	rv = rsa_public_encrypt(rsa, in, inlen, out, outlen, padding);
+
+	RSA_free(rsa);
+        return rv;
+}
+
+/* Building the OpenSSL key converts the modulus and, on first use, computes its Montgomery
+ * context. Trspi_RSA_PubKeyInit does that once for callers that use the same TPM key over
+ * and over; the Trspi_RSA_PubKey_* functions then work like their one shot counterparts
+ * above, with the TPM's default public exponent. OpenSSL reference counts the key, so a
+ * handle can be shared with Trspi_RSA_PubKeyDup and used from several threads at once. */
+TSS_RESULT
+Trspi_RSA_PubKeyInit(Trspi_RSAPubKey *key, UINT32 size, BYTE *modulus)
+{
+	unsigned char exp[] = { 0x01, 0x00, 0x01 };
+	RSA *rsa;
+	TSS_RESULT result;
+
+	if ((result = rsa_public_key(modulus, size, exp, sizeof(exp), &rsa)))
+		return result;
+
+	key->rsa = rsa;
+
+	return TSS_SUCCESS;
+}
+
+TSS_RESULT
+Trspi_RSA_PubKeyDup(Trspi_RSAPubKey *dst, Trspi_RSAPubKey *src)
+{
+	if (src->rsa == NULL || RSA_up_ref((RSA *)src->rsa) != EVP_SUCCESS)
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+
+	dst->rsa = src->rsa;
+
+	return TSS_SUCCESS;
+}
+
+TSS_RESULT
+Trspi_RSA_PubKey_Encrypt(Trspi_RSAPubKey *key, UINT32 inLen, BYTE *in, UINT32 *outLen, BYTE *out)
+{
+	if (key->rsa == NULL)
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+
+	return rsa_tpm_oaep_encrypt((RSA *)key->rsa, in, inLen, out, outLen);
+}
+
+TSS_RESULT
+Trspi_RSA_PubKey_PKCS15_Encrypt(Trspi_RSAPubKey *key, UINT32 inLen, BYTE *in, UINT32 *outLen,
+				BYTE *out)
+{
+	if (key->rsa == NULL)
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+
+	return rsa_public_encrypt((RSA *)key->rsa, in, inLen, out, outLen, RSA_PKCS1_PADDING);
+}
+
+TSS_RESULT
+Trspi_RSA_PubKey_Verify(Trspi_RSAPubKey *key, UINT32 HashType, UINT32 hashLen, BYTE *hash,
+			UINT32 sigLen, BYTE *sig)
+{
+	if (key->rsa == NULL)
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+
+	return rsa_verify((RSA *)key->rsa, HashType, hash, hashLen, sig, sigLen);
+}
+
+void
+Trspi_RSA_PubKeyFree(Trspi_RSAPubKey *key)
+{
+	if (key->rsa)
+		RSA_free((RSA *)key->rsa);
+	key->rsa = NULL;
+}
+
+struct verify_batch {
+	Trspi_VerifyItem *items;
+	UINT32 count;
+	Trspi_RSAPubKey *keys;	/* one per item, shared by items with the same modulus */
+};
+
+static void
+verify_batch_item(Trspi_VerifyItem *item, Trspi_RSAPubKey *key)
+{
+	BYTE digest[TPM_SHA1_160_HASH_LEN];
+
+	if (key->rsa == NULL)
+		return;
+
+	if (item->pHash == NULL) {
+		if ((item->result = Trspi_Hash(TSS_HASH_SHA1, item->data_len, item->pData,
+					       digest)))
+			return;
+
+		item->result = rsa_verify((RSA *)key->rsa, TSS_HASH_SHA1, digest, sizeof(digest),
+					  item->pSignature, item->sig_len);
+	} else
+		item->result = rsa_verify((RSA *)key->rsa, item->HashType, item->pHash,
+					  item->iHashLength, item->pSignature, item->sig_len);
+}
+
+static void
+verify_batch_share(void *arg, unsigned int first, unsigned int stride)
+{
+	struct verify_batch *batch = (struct verify_batch *)arg;
+	UINT32 i;
+
+	for (i = first; i < batch->count; i += stride)
+		verify_batch_item(&batch->items[i], &batch->keys[i]);
+}
+
+static int
+verify_batch_modulus_cmp(const void *a, const void *b)
+{
+	Trspi_VerifyItem *x = *(Trspi_VerifyItem **)a, *y = *(Trspi_VerifyItem **)b;
+
+	if (x->iKeyLength != y->iKeyLength)
+		return x->iKeyLength < y->iKeyLength ? -1 : 1;
+
+	return memcmp(x->pModulus, y->pModulus, x->iKeyLength);
+}
+
+/* Sorting the items by modulus puts the ones signed by the same key next to each other, so
+ * each distinct modulus is converted once and the key is shared with Trspi_RSA_PubKeyDup. */
+static void
+verify_batch_keys(Trspi_VerifyItem *items, UINT32 count, Trspi_VerifyItem **sorted,
+		  Trspi_RSAPubKey *keys)
+{
+	UINT32 i, n = 0, prev = 0;
+	TSS_RESULT result = TSS_SUCCESS;
+
+	for (i = 0; i < count; i++) {
+		if (items[i].pModulus == NULL || items[i].pSignature == NULL ||
+		    (items[i].pHash == NULL && items[i].pData == NULL) ||
+		    (items[i].pHash != NULL && items[i].HashType != TSS_HASH_SHA1 &&
+		     items[i].HashType != TSS_HASH_OTHER)) {
+			items[i].result = TSPERR(TSS_E_BAD_PARAMETER);
+			continue;
+		}
+		items[i].result = TSS_SUCCESS;
+		sorted[n++] = &items[i];
 	}
 
-	rv = RSA_public_encrypt(inlen, in, out, rsa, padding);
-	if (rv == -1) {
-		rv = TSPERR(TSS_E_INTERNAL_ERROR);
-		goto err;
+	qsort(sorted, n, sizeof(Trspi_VerifyItem *), verify_batch_modulus_cmp);
+
+	for (i = 0; i < n; i++) {
+		Trspi_RSAPubKey *key = &keys[sorted[i] - items];
+
+		if (i == 0 || verify_batch_modulus_cmp(&sorted[prev], &sorted[i])) {
+			prev = i;
+			result = Trspi_RSA_PubKeyInit(key, sorted[i]->iKeyLength,
+						      sorted[i]->pModulus);
+		} else if (result == TSS_SUCCESS)
+			result = Trspi_RSA_PubKeyDup(key, &keys[sorted[prev] - items]);
+
+		if (result)
+			sorted[i]->result = result;
 	}
+}
 
-	/* RSA_public_encrypt returns the size of the encrypted data */
-	*outlen = rv;
-	rv = TSS_SUCCESS;
-	goto out;
+TSS_RESULT
+Trspi_Verify_Batch(UINT32 count, Trspi_VerifyItem *items)
+{
+	struct verify_batch batch;
+	Trspi_VerifyItem **sorted;
+	UINT32 i;
+	TSS_RESULT result;
+
+	if (count == 0)
+		return TSS_SUCCESS;
+
+	if (items == NULL)
+		return TSPERR(TSS_E_BAD_PARAMETER);
+
+	batch.items = items;
+	batch.count = count;
+	batch.keys = calloc(count, sizeof(Trspi_RSAPubKey));
+	sorted = malloc(count * sizeof(Trspi_VerifyItem *));
+	if (batch.keys == NULL || sorted == NULL) {
+		LogError("malloc of %zu bytes failed.",
+			 count * (sizeof(Trspi_RSAPubKey) + sizeof(Trspi_VerifyItem *)));
+		free(batch.keys);
+		free(sorted);
+		return TSPERR(TSS_E_OUTOFMEMORY);
+	}
 
-err:
-	DEBUG_print_openssl_errors();
-out:
-	if (rsa)
-		RSA_free(rsa);
-        return rv;
+	verify_batch_keys(items, count, sorted, batch.keys);
+	free(sorted);
+
+	run_shares(verify_batch_share, &batch, count, VERIFY_BATCH_MIN_PER_THREAD);
+
+	result = TSS_SUCCESS;
+	for (i = 0; i < count; i++) {
+		Trspi_RSA_PubKeyFree(&batch.keys[i]);
+		if (result == TSS_SUCCESS)
+			result = items[i].result;
+	}
+	free(batch.keys);
+
+	return result;
 }
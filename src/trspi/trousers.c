@@ -2809,3 +2809,57 @@ Trspi_UnloadBlob_NV_DATA_PUBLIC(UINT64 *offset, BYTE *blob, TPM_NV_DATA_PUBLIC *
 
 	return TSS_SUCCESS;
 }
+
+struct run_share {
+	void (*fn)(void *, unsigned int, unsigned int);
+	void *arg;
+	unsigned int first, stride;
+};
+
+static void *
+run_share_thread(void *p)
+{
+	struct run_share *share = (struct run_share *)p;
+
+	share->fn(share->arg, share->first, share->stride);
+
+	return NULL;
+}
+
+void
+run_shares(void (*fn)(void *, unsigned int, unsigned int), void *arg, unsigned int count,
+	   unsigned int min_per_share)
+{
+	struct run_share shares[THREAD_MAX_SHARES];
+	THREAD_TYPE threads[THREAD_MAX_SHARES];
+	unsigned int i, started = 0, stride;
+	long ncpus;
+
+	ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	stride = count / min_per_share;
+	if (ncpus > 0 && stride > (unsigned int)ncpus)
+		stride = ncpus;
+	if (stride > THREAD_MAX_SHARES)
+		stride = THREAD_MAX_SHARES;
+	if (stride < 1)
+		stride = 1;
+
+	/* the calling thread takes the first share itself */
+	for (i = 1; i < stride; i++) {
+		shares[i].fn = fn;
+		shares[i].arg = arg;
+		shares[i].first = i;
+		shares[i].stride = stride;
+		if (THREAD_CREATE(&threads[i], NULL, run_share_thread, &shares[i]) != 0)
+			break;
+		started++;
+	}
+	/* if a thread couldn't be started, the calling thread picks up its share */
+	for (i = 0; i < stride; i++) {
+		if (i != 0 && i <= started)
+			continue;
+		fn(arg, i, stride);
+	}
+	for (i = 1; i <= started; i++)
+		THREAD_JOIN(threads[i], NULL);
+}
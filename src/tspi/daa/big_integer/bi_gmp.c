@@ -101,6 +101,338 @@ bi_ptr bi_multi_mod_exp( bi_ptr result,
 	return result;
 }
 
+/* window width of the interleaved (Straus) multi-exponentiation, in bits, for exponents of
+ * <bits> bits. Every base gets a table of 2^width - 1 powers */
+static int multi_exp_window( long bits) {
+	if( bits > 671) return 6;
+	if( bits > 239) return 5;
+	if( bits > 79) return 4;
+	if( bits > 23) return 3;
+	return 1;
+}
+
+/* the <width> bits of <e> starting at bit <bit> */
+static int multi_exp_digit( mpz_t e, long bit, int width) {
+	int digit = 0;
+
+	while( width-- > 0) digit = ( digit << 1) | mpz_tstbit( e, bit + width);
+	return digit;
+}
+
+/* acc := ( acc * x) mod m */
+static void multi_exp_mul( mpz_t acc, mpz_t x, mpz_t m) {
+	mpz_mul( acc, acc, x);
+	mpz_mod( acc, acc, m);
+}
+
+/* the window width Pippenger would use for <n> bases, or 0 if Straus is cheaper */
+static int multi_exp_pippenger_window( const int n, long bits) {
+	long cost, best;
+	int width, best_width = 0;
+
+	// multiplications, counting a squaring as one
+	width = multi_exp_window( bits);
+	best = ( ( bits + width - 1) / width) * ( width + n) + (long)n * ( ( 1 << width) - 2);
+	for( width = 1; width <= 16; width++) {
+		cost = ( ( bits + width - 1) / width) * ( width + n + ( 2 << width));
+		if( cost < best) {
+			best = cost;
+			best_width = width;
+		}
+	}
+	return best_width;
+}
+
+/* Straus: every base gets a table of its powers g^1 .. g^(2^w - 1), then the exponents are
+ * walked together from the top, one window at a time, so the squarings are shared */
+static int multi_exp_straus( mpz_t acc,
+			const int n,
+			const bi_ptr g[],
+			const bi_ptr e[],
+			long bits,
+			mpz_t m) {
+	int i, j, digit, width, size;
+	long bit;
+	mpz_t *table;
+
+	width = multi_exp_window( bits);
+	size = ( 1 << width) - 1;
+	table = (mpz_t *)malloc( n * size * sizeof( mpz_t));
+	if( table == NULL) {
+		LogError("malloc of %d bytes failed", n * size * sizeof( mpz_t));
+		return 0;
+	}
+	for( i = 0; i < n; i++) {
+		// table[i][j] = g[i] ^ (j + 1)
+		mpz_init( table[ i * size]);
+		mpz_mod( table[ i * size], g[i], m);
+		for( j = 1; j < size; j++) {
+			mpz_init( table[ i * size + j]);
+			mpz_mul( table[ i * size + j], table[ i * size + j - 1], table[ i * size]);
+			mpz_mod( table[ i * size + j], table[ i * size + j], m);
+		}
+	}
+	bit = ( ( bits + width - 1) / width) * width;
+	while( bit > 0) {
+		bit -= width;
+		for( j = 0; j < width; j++) multi_exp_mul( acc, acc, m);
+		for( i = 0; i < n; i++) {
+			digit = multi_exp_digit( e[i], bit, width);
+			if( digit != 0) multi_exp_mul( acc, table[ i * size + digit - 1], m);
+		}
+	}
+	for( i = 0; i < n * size; i++) mpz_clear( table[i]);
+	free( table);
+	return 1;
+}
+
+/* Pippenger: for each window of the exponents, the bases are sorted into one bucket per
+ * digit value, then prod( bucket[d] ^ d) is taken with running products */
+static int multi_exp_pippenger( mpz_t acc,
+			const int n,
+			const bi_ptr g[],
+			const bi_ptr e[],
+			long bits,
+			int width,
+			mpz_t m) {
+	int i, j, digit, size;
+	long bit;
+	mpz_t *bucket, running, sum;
+	char *used;
+
+	size = 1 << width;
+	bucket = (mpz_t *)malloc( size * sizeof( mpz_t));
+	used = (char *)malloc( size);
+	if( bucket == NULL || used == NULL) {
+		LogError("malloc of %d bytes failed", size * sizeof( mpz_t));
+		free( bucket);
+		free( used);
+		return 0;
+	}
+	for( j = 0; j < size; j++) mpz_init( bucket[j]);
+	mpz_init( running);
+	mpz_init( sum);
+	bit = ( ( bits + width - 1) / width) * width;
+	while( bit > 0) {
+		bit -= width;
+		for( j = 0; j < width; j++) multi_exp_mul( acc, acc, m);
+		memset( used, 0, size);
+		for( i = 0; i < n; i++) {
+			digit = multi_exp_digit( e[i], bit, width);
+			if( digit == 0) continue;
+			if( used[ digit] == 0) {
+				mpz_mod( bucket[ digit], g[i], m);
+				used[ digit] = 1;
+			} else multi_exp_mul( bucket[ digit], g[i], m);
+		}
+		// sum = prod( bucket[d] ^ d) = prod over d of ( prod of the buckets >= d)
+		mpz_set_ui( running, 1);
+		mpz_set_ui( sum, 1);
+		for( digit = size - 1; digit > 0; digit--) {
+			if( used[ digit]) multi_exp_mul( running, bucket[ digit], m);
+			multi_exp_mul( sum, running, m);
+		}
+		multi_exp_mul( acc, sum, m);
+	}
+	for( j = 0; j < size; j++) mpz_clear( bucket[j]);
+	mpz_clear( running);
+	mpz_clear( sum);
+	free( bucket);
+	free( used);
+	return 1;
+}
+
+/* simultaneous multi-exponentiation with full size exponents */
+/* <result> := ( <g>[0] ^ <e>[0] * ... * <g>[<n>-1] ^ <e>[<n>-1] ) mod <m> */
+bi_ptr bi_mod_multi_exp( bi_ptr result,
+			const int n,
+			const bi_ptr g[],
+			const bi_ptr e[],
+			const bi_ptr m) {
+	bi_ptr *base, *exp, ret = NULL;
+	mpz_t acc;
+	long bits = 0;
+	int i, width, k = 0;
+
+	base = (bi_ptr *)calloc( n, sizeof( bi_ptr));
+	exp = (bi_ptr *)calloc( n, sizeof( bi_ptr));
+	if( base == NULL || exp == NULL) {
+		LogError("malloc of %d bytes failed", n * sizeof( bi_ptr));
+		goto done;
+	}
+	// entries with a zero exponent are dropped
+	for( i = 0; i < n; i++) {
+		if( g[i] == NULL || e[i] == NULL || mpz_sgn( e[i]) == 0) continue;
+		base[k] = g[i];
+		exp[k] = e[i];
+		if( (long)mpz_sizeinbase( e[i], 2) > bits) bits = mpz_sizeinbase( e[i], 2);
+		k++;
+	}
+	mpz_init_set_ui( acc, 1);
+	if( k > 0) {
+		if( ( width = multi_exp_pippenger_window( k, bits)) == 0) {
+			if( !multi_exp_straus( acc, k, base, exp, bits, m)) goto clear;
+		} else {
+			if( !multi_exp_pippenger( acc, k, base, exp, bits, width, m)) goto clear;
+		}
+	}
+	mpz_mod( result, acc, m);
+	ret = result;
+clear:
+	mpz_clear( acc);
+done:
+	free( base);
+	free( exp);
+	return ret;
+}
+
+/* mpz_powm has nothing to keep between calls but the modulus */
+struct _bi_mod_ctx {
+	mpz_t modulus;
+};
+
+bi_mod_ctx_ptr bi_mod_ctx_new( const bi_ptr m) {
+	bi_mod_ctx_ptr mc;
+
+	mc = (bi_mod_ctx_ptr)malloc( sizeof( struct _bi_mod_ctx));
+	if( mc == NULL) {
+		LogError("malloc of %d bytes failed", sizeof( struct _bi_mod_ctx));
+		return NULL;
+	}
+	mpz_init_set( mc->modulus, m);
+	return mc;
+}
+
+void bi_mod_ctx_free( bi_mod_ctx_ptr mc) {
+	if( mc == NULL) return;
+	mpz_clear( mc->modulus);
+	free( mc);
+}
+
+bi_ptr bi_mod_exp_ctx( bi_ptr result, const bi_ptr g, const bi_ptr e, bi_mod_ctx_ptr mc) {
+	mpz_powm( result, g, e, mc->modulus);
+	return result;
+}
+
+/* a fixed base g mod m: g ^ ( 2 ^ ( BI_FIXED_BASE_WINDOW * j)) for every window j of an
+ * exponent of up to <bits> bits */
+struct _bi_fixed_base {
+	mpz_t modulus;
+	mpz_t base;
+	mpz_t *powers;
+	int length;
+};
+
+bi_fixed_base_ptr bi_fixed_base_new( const bi_ptr g, const bi_ptr m, const long bits) {
+	bi_fixed_base_ptr fb;
+	int i;
+
+	fb = (bi_fixed_base_ptr)malloc( sizeof( struct _bi_fixed_base));
+	if( fb == NULL) {
+		LogError("malloc of %d bytes failed", sizeof( struct _bi_fixed_base));
+		return NULL;
+	}
+	fb->length = ( bits + BI_FIXED_BASE_WINDOW - 1) / BI_FIXED_BASE_WINDOW;
+	if( fb->length < 1) fb->length = 1;
+	fb->powers = (mpz_t *)malloc( fb->length * sizeof( mpz_t));
+	if( fb->powers == NULL) {
+		LogError("malloc of %d bytes failed", fb->length * sizeof( mpz_t));
+		free( fb);
+		return NULL;
+	}
+	mpz_init_set( fb->modulus, m);
+	mpz_init( fb->base);
+	mpz_mod( fb->base, g, m);
+	for( i = 0; i < fb->length; i++) {
+		mpz_init( fb->powers[i]);
+		if( i == 0) mpz_set( fb->powers[0], fb->base);
+		else mpz_powm_ui( fb->powers[i], fb->powers[ i - 1],
+				1UL << BI_FIXED_BASE_WINDOW, m);
+	}
+	return fb;
+}
+
+void bi_fixed_base_free( bi_fixed_base_ptr fb) {
+	int i;
+
+	if( fb == NULL) return;
+	for( i = 0; i < fb->length; i++) mpz_clear( fb->powers[i]);
+	free( fb->powers);
+	mpz_clear( fb->base);
+	mpz_clear( fb->modulus);
+	free( fb);
+}
+
+/* <result> := ( <fb>[0] ^ <e>[0] * ... * <fb>[<n>-1] ^ <e>[<n>-1] ) mod m */
+/* Every precomputed power goes to the bucket of its digit, then prod( bucket[d] ^ d) is taken
+ * with running products, so the cost is one multiplication per non zero window plus
+ * 2 ^ ( BI_FIXED_BASE_WINDOW + 1), and no squaring at all */
+bi_ptr bi_fixed_base_multi_exp( bi_ptr result,
+				const int n,
+				bi_fixed_base_ptr fb[],
+				const bi_ptr e[]) {
+	mpz_t bucket[ 1 << BI_FIXED_BASE_WINDOW], running, sum, temp;
+	char used[ 1 << BI_FIXED_BASE_WINDOW];
+	bi_ptr *base, *exp, modulus = NULL, ret = NULL;
+	int i, j, digit, windows, k = 0;
+
+	base = (bi_ptr *)calloc( n, sizeof( bi_ptr));
+	exp = (bi_ptr *)calloc( n, sizeof( bi_ptr));
+	if( base == NULL || exp == NULL) {
+		LogError("malloc of %d bytes failed", n * sizeof( bi_ptr));
+		free( base);
+		free( exp);
+		return NULL;
+	}
+	memset( used, 0, sizeof( used));
+	for( digit = 0; digit < ( 1 << BI_FIXED_BASE_WINDOW); digit++) mpz_init( bucket[ digit]);
+	mpz_init_set_ui( running, 1);
+	mpz_init_set_ui( sum, 1);
+	mpz_init( temp);
+	for( i = 0; i < n; i++) {
+		if( fb[i] == NULL || e[i] == NULL || mpz_sgn( e[i]) == 0) continue;
+		modulus = fb[i]->modulus;
+		// exponents longer than the table are left to bi_mod_multi_exp
+		windows = ( mpz_sizeinbase( e[i], 2) + BI_FIXED_BASE_WINDOW - 1) /
+			BI_FIXED_BASE_WINDOW;
+		if( windows > fb[i]->length) {
+			base[k] = fb[i]->base;
+			exp[k++] = e[i];
+			continue;
+		}
+		for( j = 0; j < windows; j++) {
+			digit = multi_exp_digit( e[i], (long)j * BI_FIXED_BASE_WINDOW,
+						BI_FIXED_BASE_WINDOW);
+			if( digit == 0) continue;
+			if( used[ digit] == 0) {
+				mpz_set( bucket[ digit], fb[i]->powers[j]);
+				used[ digit] = 1;
+			} else multi_exp_mul( bucket[ digit], fb[i]->powers[j], modulus);
+		}
+	}
+	if( modulus != NULL) {
+		// sum = prod( bucket[d] ^ d) = prod over d of ( prod of the buckets >= d)
+		for( digit = ( 1 << BI_FIXED_BASE_WINDOW) - 1; digit > 0; digit--) {
+			if( used[ digit]) multi_exp_mul( running, bucket[ digit], modulus);
+			multi_exp_mul( sum, running, modulus);
+		}
+	}
+	if( k > 0) {
+		if( bi_mod_multi_exp( temp, k, base, exp, modulus) == NULL) goto done;
+		multi_exp_mul( sum, temp, modulus);
+	}
+	mpz_set( result, sum);
+	ret = result;
+done:
+	for( digit = 0; digit < ( 1 << BI_FIXED_BASE_WINDOW); digit++) mpz_clear( bucket[ digit]);
+	mpz_clear( running);
+	mpz_clear( sum);
+	mpz_clear( temp);
+	free( base);
+	free( exp);
+	return ret;
+}
+
 /***********************************************************************************
 	NUMBER THEORIE OPERATION
 *************************************************************************************/
@@ -258,4 +590,12 @@ int bi_is_initialized(void) {
 	return initialized;
 }
 
+/* gmp keeps no state per thread, only the random state is shared */
+int bi_thread_init(void) {
+	return 1;
+}
+
+void bi_thread_release(void) {
+}
+
 #endif
@@ -24,9 +24,15 @@
 #define INLINE_DECL
 
 #include <string.h>
+#include <pthread.h>
 #include <openssl/rand.h>
 
-BN_CTX *context;
+/* every thread computing with the library needs its own BN_CTX. It is created by
+ bi_thread_init, called through bi_ctx on the thread's first computation, and freed by
+ bi_thread_release or by context_key's destructor when the thread exits */
+__thread BN_CTX *context;
+static pthread_key_t context_key;
+static pthread_once_t context_key_once = PTHREAD_ONCE_INIT;
 static int initialized = 0;
 
 void * (*bi_alloc)(size_t size);
@@ -41,7 +47,7 @@ INLINE_DECL int bi_is_probable_prime( const bi_ptr i) {
 	*	0 if the number is composite
 	*	1 if it is prime with an error probability of less than 0.25^checks, and on error.
 	*/
-	return BN_is_prime_fasttest( i, BN_prime_checks, NULL, context, NULL, 1);
+	return BN_is_prime_fasttest( i, BN_prime_checks, NULL, bi_ctx(), NULL, 1);
 }
 
 /*  <result> := ( <g> ^ <e> ) mod <m>  */
@@ -56,7 +62,7 @@ INLINE_DECL bi_ptr bi_mod_exp_si( bi_ptr result, const bi_ptr g, const bi_ptr e,
 		BN_bn2dec( e),
 		BN_bn2dec( bi_tmp));
 #endif
-	BN_mod_exp( result, g, e, bi_tmp, context);	// result := (g ^ e) mod bi_tmp9
+	BN_mod_exp( result, g, e, bi_tmp, bi_ctx());	// result := (g ^ e) mod bi_tmp9
 #ifdef BI_DEBUG
 	printf("[bi_mod_exp] res=%s\n", BN_bn2dec( result));
 #endif
@@ -80,15 +86,15 @@ bi_ptr bi_multi_mod_exp( bi_ptr result,
 	BN_set_word( bi_m, m);
 	BN_set_word( bi_e, e[0]);
 	// result := (g[0] ^ e[0]) mod bi_m
-	BN_mod_exp( result, g[0], bi_e, bi_m, context);
+	BN_mod_exp( result, g[0], bi_e, bi_m, bi_ctx());
 	for( i=1; i<n; i++) {
 		BN_set_word( bi_e, e[i]);
 		// temp := (g[i] ^ e[i]) mod bi_m
-		BN_mod_exp( temp, g[i], bi_e, bi_m, context);
+		BN_mod_exp( temp, g[i], bi_e, bi_m, bi_ctx());
 		// result := result * temp
-		BN_mul( result, result, temp, context);
+		BN_mul( result, result, temp, bi_ctx());
 	}
-	BN_mod( result, result, bi_m, context);
+	BN_mod( result, result, bi_m, bi_ctx());
 	BN_free(bi_e);
 	BN_free(bi_m);
 	BN_free(temp);
@@ -96,6 +102,423 @@ bi_ptr bi_multi_mod_exp( bi_ptr result,
 }
 
 
+/* window width of the interleaved (Straus) multi-exponentiation, in bits, for exponents of
+ * <bits> bits. Every base gets a table of 2^width - 1 powers */
+static int multi_exp_window( long bits) {
+	if( bits > 671) return 6;
+	if( bits > 239) return 5;
+	if( bits > 79) return 4;
+	if( bits > 23) return 3;
+	return 1;
+}
+
+/* the <width> bits of <e> starting at bit <bit> */
+static int multi_exp_digit( const BIGNUM *e, int bit, int width) {
+	int digit = 0;
+
+	while( width-- > 0) digit = ( digit << 1) | BN_is_bit_set( e, bit + width);
+	return digit;
+}
+
+/* Straus: every base gets a table of its powers g^1 .. g^(2^w - 1), then the exponents are
+ * walked together from the top, one window at a time, so the squarings are shared */
+static int multi_exp_straus( BIGNUM *acc,
+			const int n,
+			BIGNUM *g[],
+			const bi_ptr e[],
+			long bits,
+			BN_MONT_CTX *mont,
+			BN_CTX *ctx
+) {
+	int i, j, digit, width, size, bit, ret = 0;
+	BIGNUM **table;
+
+	width = multi_exp_window( bits);
+	size = ( 1 << width) - 1;
+	table = (BIGNUM **)calloc( n * size, sizeof( BIGNUM *));
+	if( table == NULL) {
+		LogError("malloc of %d bytes failed", n * size * sizeof( BIGNUM *));
+		return 0;
+	}
+	for( i = 0; i < n; i++) {
+		for( j = 0; j < size; j++) {
+			if( ( table[ i * size + j] = BN_new()) == NULL) goto done;
+		}
+		// table[i][j] = g[i] ^ (j + 1)
+		if( BN_copy( table[ i * size], g[i]) == NULL) goto done;
+		for( j = 1; j < size; j++) {
+			if( !BN_mod_mul_montgomery( table[ i * size + j],
+						table[ i * size + j - 1], g[i], mont, ctx))
+				goto done;
+		}
+	}
+	bit = ( ( bits + width - 1) / width) * width;
+	while( bit > 0) {
+		bit -= width;
+		for( j = 0; j < width; j++) {
+			if( !BN_mod_mul_montgomery( acc, acc, acc, mont, ctx)) goto done;
+		}
+		for( i = 0; i < n; i++) {
+			digit = multi_exp_digit( e[i], bit, width);
+			if( digit != 0 && !BN_mod_mul_montgomery( acc, acc,
+							table[ i * size + digit - 1], mont, ctx))
+				goto done;
+		}
+	}
+	ret = 1;
+done:
+	for( i = 0; i < n * size; i++) BN_free( table[i]);
+	free( table);
+	return ret;
+}
+
+/* Pippenger: for each window of the exponents, the bases are sorted into one bucket per
+ * digit value, then prod( bucket[d] ^ d) is taken with running products. The cost per window
+ * is about n + 2^(w+1) multiplications and there is no table, which beats Straus once n is
+ * in the hundreds */
+static int multi_exp_pippenger( BIGNUM *acc,
+			const int n,
+			BIGNUM *g[],
+			const bi_ptr e[],
+			long bits,
+			int width,
+			BIGNUM *one,
+			BN_MONT_CTX *mont,
+			BN_CTX *ctx
+) {
+	int i, j, digit, size, bit, ret = 0;
+	BIGNUM **bucket, *running, *sum;
+	char *used;
+
+	size = 1 << width;
+	bucket = (BIGNUM **)calloc( size, sizeof( BIGNUM *));
+	used = (char *)malloc( size);
+	running = BN_new();
+	sum = BN_new();
+	if( bucket == NULL || used == NULL || running == NULL || sum == NULL) {
+		LogError("malloc of %d bytes failed", size * sizeof( BIGNUM *));
+		goto done;
+	}
+	for( j = 0; j < size; j++) {
+		if( ( bucket[j] = BN_new()) == NULL) goto done;
+	}
+	bit = ( ( bits + width - 1) / width) * width;
+	while( bit > 0) {
+		bit -= width;
+		for( j = 0; j < width; j++) {
+			if( !BN_mod_mul_montgomery( acc, acc, acc, mont, ctx)) goto done;
+		}
+		memset( used, 0, size);
+		for( i = 0; i < n; i++) {
+			digit = multi_exp_digit( e[i], bit, width);
+			if( digit == 0) continue;
+			if( used[ digit] == 0) {
+				if( BN_copy( bucket[ digit], g[i]) == NULL) goto done;
+				used[ digit] = 1;
+			} else if( !BN_mod_mul_montgomery( bucket[ digit], bucket[ digit], g[i],
+							mont, ctx))
+				goto done;
+		}
+		// sum = prod( bucket[d] ^ d) = prod over d of ( prod of the buckets >= d)
+		if( BN_copy( running, one) == NULL || BN_copy( sum, one) == NULL) goto done;
+		for( digit = size - 1; digit > 0; digit--) {
+			if( used[ digit] && !BN_mod_mul_montgomery( running, running,
+								bucket[ digit], mont, ctx))
+				goto done;
+			if( !BN_mod_mul_montgomery( sum, sum, running, mont, ctx)) goto done;
+		}
+		if( !BN_mod_mul_montgomery( acc, acc, sum, mont, ctx)) goto done;
+	}
+	ret = 1;
+done:
+	if( bucket != NULL) {
+		for( j = 0; j < size; j++) BN_free( bucket[j]);
+		free( bucket);
+	}
+	free( used);
+	BN_free( running);
+	BN_free( sum);
+	return ret;
+}
+
+/* the window width Pippenger would use for <n> bases, or 0 if Straus is cheaper */
+static int multi_exp_pippenger_window( const int n, long bits) {
+	long cost, best;
+	int width, best_width = 0;
+
+	// multiplications, counting a squaring as one
+	width = multi_exp_window( bits);
+	best = ( ( bits + width - 1) / width) * ( width + n) + (long)n * ( ( 1 << width) - 2);
+	for( width = 1; width <= 16; width++) {
+		cost = ( ( bits + width - 1) / width) * ( width + n + ( 2 << width));
+		if( cost < best) {
+			best = cost;
+			best_width = width;
+		}
+	}
+	return best_width;
+}
+
+/* simultaneous multi-exponentiation with full size exponents */
+/* <result> := ( <g>[0] ^ <e>[0] * ... * <g>[<n>-1] ^ <e>[<n>-1] ) mod <m> */
+bi_ptr bi_mod_multi_exp( bi_ptr result,
+			const int n,
+			const bi_ptr g[],
+			const bi_ptr e[],
+			const bi_ptr m
+) {
+	BN_MONT_CTX *mont = NULL;
+	BIGNUM **base = NULL, *acc = NULL, *one = NULL;
+	bi_ptr *exp = NULL, ret = NULL;
+	long bits = 0;
+	int i, width, k = 0;
+
+	base = (BIGNUM **)calloc( n, sizeof( BIGNUM *));
+	exp = (bi_ptr *)calloc( n, sizeof( bi_ptr));
+	mont = BN_MONT_CTX_new();
+	acc = BN_new();
+	one = BN_new();
+	if( base == NULL || exp == NULL || mont == NULL || acc == NULL || one == NULL) {
+		LogError("malloc of %d bytes failed", n * sizeof( BIGNUM *));
+		goto done;
+	}
+	if( !BN_is_odd( m)) {
+		// Montgomery needs an odd modulus, which every DAA modulus is
+		BN_one( acc);
+		for( i = 0; i < n; i++) {
+			if( g[i] == NULL || e[i] == NULL) continue;
+			if( !BN_mod_exp( one, g[i], e[i], m, bi_ctx()) ||
+			    !BN_mod_mul( acc, acc, one, m, bi_ctx()))
+				goto done;
+		}
+		if( BN_copy( result, acc) != NULL) ret = result;
+		goto done;
+	}
+	if( !BN_MONT_CTX_set( mont, m, bi_ctx())) goto done;
+	// the bases go to the Montgomery domain once, entries with a zero exponent are dropped
+	for( i = 0; i < n; i++) {
+		if( g[i] == NULL || e[i] == NULL || BN_is_zero( e[i])) continue;
+		if( ( base[k] = BN_new()) == NULL) goto done;
+		if( !BN_nnmod( base[k], g[i], m, bi_ctx()) ||
+		    !BN_to_montgomery( base[k], base[k], mont, bi_ctx()))
+			goto done;
+		exp[k] = e[i];
+		if( BN_num_bits( e[i]) > bits) bits = BN_num_bits( e[i]);
+		k++;
+	}
+	if( !BN_to_montgomery( one, BN_value_one(), mont, bi_ctx()) ||
+	    BN_copy( acc, one) == NULL)
+		goto done;
+	if( k > 0) {
+		if( ( width = multi_exp_pippenger_window( k, bits)) == 0) {
+			if( !multi_exp_straus( acc, k, base, exp, bits, mont, bi_ctx())) goto done;
+		} else {
+			if( !multi_exp_pippenger( acc, k, base, exp, bits, width, one, mont,
+						  bi_ctx()))
+				goto done;
+		}
+	}
+	if( !BN_from_montgomery( result, acc, mont, bi_ctx())) goto done;
+	ret = result;
+done:
+	if( base != NULL) {
+		for( i = 0; i < n; i++) BN_free( base[i]);
+		free( base);
+	}
+	free( exp);
+	BN_MONT_CTX_free( mont);
+	BN_free( acc);
+	BN_free( one);
+	return ret;
+}
+
+/* a modulus with its Montgomery parameters, which BN_mod_exp would compute on every call */
+struct _bi_mod_ctx {
+	BN_MONT_CTX *mont;
+	BIGNUM *modulus;
+};
+
+bi_mod_ctx_ptr bi_mod_ctx_new( const bi_ptr m) {
+	bi_mod_ctx_ptr mc;
+
+	mc = (bi_mod_ctx_ptr)calloc( 1, sizeof( struct _bi_mod_ctx));
+	if( mc == NULL) {
+		LogError("malloc of %d bytes failed", sizeof( struct _bi_mod_ctx));
+		return NULL;
+	}
+	if( ( mc->modulus = BN_dup( m)) == NULL) goto error;
+	// Montgomery needs an odd modulus, BN_mod_exp is used for the others
+	if( BN_is_odd( m)) {
+		if( ( mc->mont = BN_MONT_CTX_new()) == NULL ||
+		    !BN_MONT_CTX_set( mc->mont, m, bi_ctx()))
+			goto error;
+	}
+	return mc;
+error:
+	bi_mod_ctx_free( mc);
+	return NULL;
+}
+
+void bi_mod_ctx_free( bi_mod_ctx_ptr mc) {
+	if( mc == NULL) return;
+	BN_MONT_CTX_free( mc->mont);
+	BN_free( mc->modulus);
+	free( mc);
+}
+
+bi_ptr bi_mod_exp_ctx( bi_ptr result, const bi_ptr g, const bi_ptr e, bi_mod_ctx_ptr mc) {
+	if( mc->mont == NULL)
+		BN_mod_exp( result, g, e, mc->modulus, bi_ctx());
+	else
+		BN_mod_exp_mont( result, g, e, mc->modulus, bi_ctx(), mc->mont);
+	return result;
+}
+
+/* a fixed base g mod m: g ^ ( 2 ^ ( BI_FIXED_BASE_WINDOW * j)) for every window j of an
+ * exponent of up to <bits> bits, in the Montgomery domain */
+struct _bi_fixed_base {
+	BN_MONT_CTX *mont;
+	BIGNUM *modulus;
+	BIGNUM *base;
+	BIGNUM **powers;
+	int length;
+};
+
+bi_fixed_base_ptr bi_fixed_base_new( const bi_ptr g, const bi_ptr m, const long bits) {
+	bi_fixed_base_ptr fb;
+	int i, j;
+
+	// Montgomery needs an odd modulus, which every DAA modulus is
+	if( !BN_is_odd( m)) return NULL;
+	fb = (bi_fixed_base_ptr)calloc( 1, sizeof( struct _bi_fixed_base));
+	if( fb == NULL) {
+		LogError("malloc of %d bytes failed", sizeof( struct _bi_fixed_base));
+		return NULL;
+	}
+	fb->length = ( bits + BI_FIXED_BASE_WINDOW - 1) / BI_FIXED_BASE_WINDOW;
+	if( fb->length < 1) fb->length = 1;
+	fb->mont = BN_MONT_CTX_new();
+	fb->modulus = BN_dup( m);
+	fb->base = BN_new();
+	fb->powers = (BIGNUM **)calloc( fb->length, sizeof( BIGNUM *));
+	if( fb->mont == NULL || fb->modulus == NULL || fb->base == NULL || fb->powers == NULL) {
+		LogError("malloc of %d bytes failed", fb->length * sizeof( BIGNUM *));
+		goto error;
+	}
+	if( !BN_MONT_CTX_set( fb->mont, m, bi_ctx()) ||
+	    !BN_nnmod( fb->base, g, m, bi_ctx()))
+		goto error;
+	for( i = 0; i < fb->length; i++) {
+		if( ( fb->powers[i] = BN_new()) == NULL) goto error;
+		if( i == 0) {
+			if( !BN_to_montgomery( fb->powers[0], fb->base, fb->mont, bi_ctx()))
+				goto error;
+			continue;
+		}
+		if( BN_copy( fb->powers[i], fb->powers[ i - 1]) == NULL) goto error;
+		for( j = 0; j < BI_FIXED_BASE_WINDOW; j++) {
+			if( !BN_mod_mul_montgomery( fb->powers[i], fb->powers[i], fb->powers[i],
+							fb->mont, bi_ctx()))
+				goto error;
+		}
+	}
+	return fb;
+error:
+	bi_fixed_base_free( fb);
+	return NULL;
+}
+
+void bi_fixed_base_free( bi_fixed_base_ptr fb) {
+	int i;
+
+	if( fb == NULL) return;
+	if( fb->powers != NULL) {
+		for( i = 0; i < fb->length; i++) BN_free( fb->powers[i]);
+		free( fb->powers);
+	}
+	BN_free( fb->base);
+	BN_free( fb->modulus);
+	BN_MONT_CTX_free( fb->mont);
+	free( fb);
+}
+
+/* <result> := ( <fb>[0] ^ <e>[0] * ... * <fb>[<n>-1] ^ <e>[<n>-1] ) mod m */
+/* Every precomputed power goes to the bucket of its digit, then prod( bucket[d] ^ d) is taken
+ * with running products, so the cost is one multiplication per non zero window plus
+ * 2 ^ ( BI_FIXED_BASE_WINDOW + 1), and no squaring at all */
+bi_ptr bi_fixed_base_multi_exp( bi_ptr result,
+				const int n,
+				bi_fixed_base_ptr fb[],
+				const bi_ptr e[]
+) {
+	BIGNUM *bucket[ 1 << BI_FIXED_BASE_WINDOW], *running = NULL, *sum = NULL;
+	BIGNUM *temp = NULL, *modulus = NULL;
+	bi_ptr *base = NULL, *exp = NULL, ret = NULL;
+	BN_MONT_CTX *mont = NULL;
+	int i, j, digit, windows, k = 0;
+
+	memset( bucket, 0, sizeof( bucket));
+	base = (bi_ptr *)calloc( n, sizeof( bi_ptr));
+	exp = (bi_ptr *)calloc( n, sizeof( bi_ptr));
+	running = BN_new();
+	sum = BN_new();
+	temp = BN_new();
+	if( base == NULL || exp == NULL || running == NULL || sum == NULL || temp == NULL) {
+		LogError("malloc of %d bytes failed", n * sizeof( bi_ptr));
+		goto done;
+	}
+	for( i = 0; i < n; i++) {
+		if( fb[i] == NULL || e[i] == NULL || BN_is_zero( e[i])) continue;
+		modulus = fb[i]->modulus;
+		// exponents longer than the table are left to bi_mod_multi_exp
+		windows = ( BN_num_bits( e[i]) + BI_FIXED_BASE_WINDOW - 1) / BI_FIXED_BASE_WINDOW;
+		if( windows > fb[i]->length) {
+			base[k] = fb[i]->base;
+			exp[k++] = e[i];
+			continue;
+		}
+		mont = fb[i]->mont;
+		for( j = 0; j < windows; j++) {
+			digit = multi_exp_digit( e[i], j * BI_FIXED_BASE_WINDOW,
+						BI_FIXED_BASE_WINDOW);
+			if( digit == 0) continue;
+			if( bucket[ digit] == NULL) {
+				if( ( bucket[ digit] = BN_dup( fb[i]->powers[j])) == NULL) goto done;
+			} else if( !BN_mod_mul_montgomery( bucket[ digit], bucket[ digit],
+							fb[i]->powers[j], mont, bi_ctx()))
+				goto done;
+		}
+	}
+	BN_one( temp);
+	if( mont != NULL) {
+		// sum = prod( bucket[d] ^ d) = prod over d of ( prod of the buckets >= d)
+		if( !BN_to_montgomery( running, BN_value_one(), mont, bi_ctx()) ||
+		    BN_copy( sum, running) == NULL)
+			goto done;
+		for( digit = ( 1 << BI_FIXED_BASE_WINDOW) - 1; digit > 0; digit--) {
+			if( bucket[ digit] != NULL && !BN_mod_mul_montgomery( running, running,
+								bucket[ digit], mont, bi_ctx()))
+				goto done;
+			if( !BN_mod_mul_montgomery( sum, sum, running, mont, bi_ctx())) goto done;
+		}
+		if( !BN_from_montgomery( temp, sum, mont, bi_ctx())) goto done;
+	}
+	if( k > 0) {
+		if( bi_mod_multi_exp( sum, k, base, exp, modulus) == NULL ||
+		    !BN_mod_mul( temp, temp, sum, modulus, bi_ctx()))
+			goto done;
+	}
+	if( BN_copy( result, temp) != NULL) ret = result;
+done:
+	for( digit = 0; digit < ( 1 << BI_FIXED_BASE_WINDOW); digit++) BN_free( bucket[ digit]);
+	free( base);
+	free( exp);
+	BN_free( running);
+	BN_free( sum);
+	BN_free( temp);
+	return ret;
+}
+
 /***********************************************************************************
   					          INIT/RELEASE LIBRARY
 ************************************************************************************/
@@ -120,7 +543,7 @@ void bi_init( void * (*bi_alloc_p)(size_t size)) {
 	}
 	LogDebug("bi_init() -> openssl lib\n");
 	LogDebug("bi_init() -> seed status = %d\n", RAND_status());
-	context = BN_CTX_new();
+	bi_thread_init();
 	if( RAND_status() != 1) {
 		LogError("! PRNG has not been seeded with enough data\n");
 #ifdef INTERACTIVE
@@ -148,7 +571,7 @@ void bi_release(void) {
 		bi_free( bi_0);
 		bi_free( bi_1);
 		bi_free( bi_2);
-		BN_CTX_free( context);
+		bi_thread_release();
 		initialized = 0;
 	}
 }
@@ -178,4 +601,35 @@ int bi_is_initialized(void) {
 	return initialized;
 }
 
+static void context_free( void *ctx) {
+	BN_CTX_free( ctx);
+}
+
+static void context_key_create(void) {
+	if( pthread_key_create( &context_key, context_free) != 0)
+		LogError("pthread_key_create failed");
+}
+
+int bi_thread_init(void) {
+	if( context == NULL) {
+		pthread_once( &context_key_once, context_key_create);
+		context = BN_CTX_new();
+		if( context == NULL) {
+			LogError("BN_CTX_new failed");
+			return 0;
+		}
+		// hand the context to the key's destructor for threads that just exit
+		pthread_setspecific( context_key, context);
+	}
+	return 1;
+}
+
+void bi_thread_release(void) {
+	if( context != NULL) {
+		pthread_setspecific( context_key, NULL);
+		BN_CTX_free( context);
+		context = NULL;
+	}
+}
+
 #endif
@@ -91,6 +91,7 @@ load_DAA_PK_internal(FILE *file)
         pk_internal->issuerBaseName = malloc( pk_internal->issuerBaseNameLength);
         memcpy( pk_internal->issuerBaseName, read_buffer, pk_internal->issuerBaseNameLength);
         compute_capitalSprime( pk_internal);
+        pk_internal->tables = NULL;
         return pk_internal;
 }
 
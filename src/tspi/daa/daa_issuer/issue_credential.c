@@ -242,7 +242,7 @@ compute_credential_proof( TSS_DAA_PK_internal *pk_intern,
 	bi_urandom( random_E, bi_length( productPQprime) + DAA_PARAM_SAFETY_MARGIN * 8);
 	bi_mod( random_E, random_E, productPQprime);
 	bi_inc( random_E);
-	bi_mod_exp( capital_Atilde, fraction_A, random_E, pk_intern->modulus);
+	DAA_PK_mod_exp( capital_Atilde, pk_intern, fraction_A, random_E);
 	compute_join_challenge_issuer( pk_intern,
 								v_prime_prime,
 								capital_A,
@@ -425,17 +425,17 @@ TSPICALL Tspi_DAA_IssueCredential_internal
 	// capitalU_hat_prime = capitalU_prime ~% n
 	bi_invert_mod( capitalU_hat_prime, capitalU_prime, n);
 	// capitalU_hat_prime = ( capitalU_hat_prime ^ c ) % n
-	bi_mod_exp( capitalU_hat_prime, capitalU_hat_prime, c, n);
+	DAA_PK_mod_exp( capitalU_hat_prime, pk_intern, capitalU_hat_prime, c);
 	// capitalU_hat_prime = ( capitalU_hat_prime * ( capitalR0 ^ sf0)) % n
-	bi_mod_exp( tmp1, capitalR0, sf0, n);
+	DAA_PK_mod_exp( tmp1, pk_intern, capitalR0, sf0);
 	bi_mul( capitalU_hat_prime, capitalU_hat_prime, tmp1);
 	bi_mod( capitalU_hat_prime, capitalU_hat_prime, n);
 	// capitalU_hat_prime = ( capitalU_hat_prime * ( capitalR1 ^ sf1)) % n
-	bi_mod_exp( tmp1, capitalR1, sf1, n);
+	DAA_PK_mod_exp( tmp1, pk_intern, capitalR1, sf1);
 	bi_mul( capitalU_hat_prime, capitalU_hat_prime, tmp1);
 	bi_mod( capitalU_hat_prime, capitalU_hat_prime, n);
 	// capitalU_hat_prime = ( capitalU_hat_prime * ( capitalS ^ sv_prime)) % n
-	bi_mod_exp( tmp1, capitalS, sv_prime, n);
+	DAA_PK_mod_exp( tmp1, pk_intern, capitalS, sv_prime);
 	bi_mul( capitalU_hat_prime, capitalU_hat_prime, tmp1);
 	bi_mod( capitalU_hat_prime, capitalU_hat_prime, n);
 	// verify blinded encoded attributes of the Receiver
@@ -449,7 +449,7 @@ TSPICALL Tspi_DAA_IssueCredential_internal
 			result = TSPERR(TSS_E_OUTOFMEMORY);
 			goto close;
 		}
-		bi_mod_exp( tmp1, pk_intern->capitalRReceiver->array[i], sa_i, n);
+		DAA_PK_mod_exp( tmp1, pk_intern, pk_intern->capitalRReceiver->array[i], sa_i);
 		bi_mul( product_attr_receiver, product_attr_receiver, tmp1);
 		bi_mod( product_attr_receiver, product_attr_receiver, n);
 		bi_free_ptr( sa_i);
@@ -466,9 +466,9 @@ TSPICALL Tspi_DAA_IssueCredential_internal
 	// capitalU_hat = capitalU_prime / capitalU
 	bi_mod( capitalU_hat, capitalU_hat, n);
 	// capital_Uhat = ( (capital_Uhat ^ c ) % n
-	bi_mod_exp( capitalU_hat, capitalU_hat, c, n);
+	DAA_PK_mod_exp( capitalU_hat, pk_intern, capitalU_hat, c);
 	// capital_Uhat = ( capital_Uhat * ( capitalS ^ sv_tilde_prime) % n ) % n
-	bi_mod_exp( tmp1, pk_intern->capitalS, sv_tilde_prime, n);
+	DAA_PK_mod_exp( tmp1, pk_intern, pk_intern->capitalS, sv_tilde_prime);
 	bi_mul( capitalU_hat, capitalU_hat, tmp1);
 	bi_mod( capitalU_hat, capitalU_hat, n);
 	bi_mul( capitalU_hat, capitalU_hat, product_attr_receiver);
@@ -476,7 +476,7 @@ TSPICALL Tspi_DAA_IssueCredential_internal
 	// capital_Nhat_i = (( capital_Ni ~% pk_intern->capitalGamma ) ^ c ) % pk_intern->capitalGamma
 	capitalN_hat_i = bi_new_ptr();
 	bi_invert_mod( capitalN_hat_i, capital_ni, pk_intern->capitalGamma);
-	bi_mod_exp( capitalN_hat_i, capitalN_hat_i, c, pk_intern->capitalGamma);
+	DAA_PK_gamma_mod_exp( capitalN_hat_i, pk_intern, capitalN_hat_i, c);
 	// exp = sf1 << (DAA_PARAM_SIZE_F_I) + sf0
 	exp = bi_new_ptr();
 	if( exp == NULL) {
@@ -491,7 +491,7 @@ TSPICALL Tspi_DAA_IssueCredential_internal
 					pk_intern);
 	// capital_Nhat_i = ( capital_Nhat_i *
 	//			( ( issuer.zeta ^ exp) % pk->capitalGamma) ) % pk->capitalGamma
-	bi_mod_exp( tmp1, zeta, exp, pk_intern->capitalGamma);
+	DAA_PK_gamma_mod_exp( tmp1, pk_intern, zeta, exp);
 	bi_mul( capitalN_hat_i, capitalN_hat_i, tmp1);
 	bi_mod( capitalN_hat_i, capitalN_hat_i, pk_intern->capitalGamma);
 
@@ -626,7 +626,7 @@ TSPICALL Tspi_DAA_IssueCredential_internal
 		result = TSPERR(TSS_E_OUTOFMEMORY);
 		goto close;
 	}
-	bi_mod_exp( fraction_A, pk_intern->capitalS, v_prime_prime, n);
+	DAA_PK_mod_exp( fraction_A, pk_intern, pk_intern->capitalS, v_prime_prime);
 	bi_mul( fraction_A, fraction_A, capitalU);
 	bi_mod( fraction_A, fraction_A, n);
 
@@ -641,7 +641,7 @@ TSPICALL Tspi_DAA_IssueCredential_internal
 	bi_set( product_attr_issuer, bi_1);
 	for( i=0; i< attributesIssuerLength; i++) {
 		tmp1 = bi_set_as_nbin( DAA_PARAM_SIZE_F_I / 8, attributesIssuer[i]); // allocation
-		bi_mod_exp( tmp2, pk_intern->capitalRIssuer->array[i], tmp1, n);
+		DAA_PK_mod_exp( tmp2, pk_intern, pk_intern->capitalRIssuer->array[i], tmp1);
 		bi_mul( product_attr_issuer, product_attr_issuer, tmp2);
 		bi_mod( product_attr_issuer, product_attr_issuer, n);
 		bi_free_ptr( tmp1);
@@ -688,7 +688,7 @@ TSPICALL Tspi_DAA_IssueCredential_internal
 	LogDebug("eInverse[%ld]=%s", bi_nbin_size( eInverse), bi_2_hex_char( eInverse));
 	LogDebug("e[%ld]=%s", bi_nbin_size( e), bi_2_hex_char( e));
 	LogDebug("n[%ld]=%s", bi_nbin_size( n), bi_2_hex_char( n));
-	bi_mod_exp( capitalA, fraction_A, eInverse, n);
+	DAA_PK_mod_exp( capitalA, pk_intern, fraction_A, eInverse);
 
 	compute_credential_proof( pk_intern,
 				capitalA,
@@ -22,7 +22,7 @@ static const int ELEMENT = 0;
 static const int EXPONENT = 1;
 
 extern void prime_init();
-extern void compute_safe_prime(bi_ptr result, int bit_length, int prime_certainty);
+extern bi_ptr compute_safe_prime(bi_ptr result, int bit_length);
 
 bi_ptr
 compute_random_number_star( bi_ptr result, const bi_ptr element)
@@ -135,18 +135,11 @@ generate_key_pair(UINT32                         num_attributes_issuer,
 	n = bi_new_ptr();
 
 	do {
-		// FUTURE USAGE
-		/* compute_safe_prime( p, length_mod / 2);
+		compute_safe_prime(p, length_mod / 2);
 		do {
-			compute_safe_prime( q,
-							length_mod - (length_mod >> 1));
-		} while( bi_cmp( p, q) ==0);
-		} else */
-		{
-			bi_generate_safe_prime(p, length_mod / 2);
-			bi_generate_safe_prime(q, length_mod - (length_mod / 2));
-			LogDebug(".");
-		}
+			compute_safe_prime(q, length_mod - (length_mod >> 1));
+		} while (bi_cmp(p, q) == 0);
+		LogDebug(".");
 		// n = p*q
 		bi_mul(n, p, q);
 	} while(bi_length(n) != length_mod);
@@ -11,9 +11,17 @@
 #include <stdio.h>
 #include <string.h>
 
+#include <unistd.h>
+
 #include "bi.h"
 #include "list.h"
 #include "tsplog.h"
+#include "threads.h"
+
+/* candidates sieved at once, p_dash = base + 2 * k for k < SAFE_PRIME_SIEVE_LENGTH */
+#define SAFE_PRIME_SIEVE_LENGTH	16384
+/* upper bound of the worker threads of compute_safe_prime */
+#define SAFE_PRIME_MAX_THREADS	16
 
 static unsigned long *primes;
 static int primes_length;
@@ -111,45 +119,43 @@ generate_small_primes(int prime_bound, int starting_prime)
 void
 prime_init()
 {
+	if (primes != NULL)
+		return;
 	generate_small_primes(16384, 3);
 }
 
-/* Test whether the provided pDash or p = 2*pDash + 1 are divisible by any of the small primes
- * saved in the listOfSmallPrimes. A limit for the largest prime to be tested against can be
- * specified, but it will be ignored if it exeeds the number of precalculated primes.
+/* Sieves the SAFE_PRIME_SIEVE_LENGTH candidates p_dash = base + 2 * k, k the index in sieve,
+ * against the small primes. Candidates where p_dash or p = 2 * p_dash + 1 is divisible by one of
+ * them get sieve[k] set. One reduction of base per small prime is enough for the whole interval.
  *
- * p_dash: the number to be tested (p_dash)
- * prime_bound: the limit for the small primes to be tested against.
+ * base: the first candidate, odd and larger than the small primes
+ * sieve: SAFE_PRIME_SIEVE_LENGTH flags
  */
-static int
-test_small_prime_factors(const bi_ptr p_dash, const unsigned long prime_bound)
+static void
+sieve_safe_prime_candidates(const bi_ptr base, char *sieve)
 {
-	int sievePassed = 1;
-	unsigned long r;
-	unsigned long small_prime;
+	unsigned long r, small_prime, inv_2, k;
 	bi_t temp; bi_new(temp);
+	int i;
 
-	small_prime = 1;
-	int i = 0;
-	while (i < primes_length && small_prime < prime_bound ) {
-		small_prime = primes[i++];
-		// r = p_dash % small_prime
-		bi_mod_si(temp, p_dash, small_prime);
+	memset(sieve, 0, SAFE_PRIME_SIEVE_LENGTH);
+	for (i = 0; i < primes_length; i++) {
+		small_prime = primes[i];
+		inv_2 = (small_prime + 1) >> 1;
+		// r = base % small_prime
+		bi_mod_si(temp, base, small_prime);
 		r = bi_get_si(temp);
-		// test if pDash = 0 (mod smallPrime)
-		if (r == 0) {
-			sievePassed = 0;
-			break;
-		}
-		// test if p = 0 (mod smallPrime) (or r == smallPrime - r - 1)
-		if (r == (small_prime - r - 1)) {
-			sievePassed = 0;
-			break;
-		}
+		// p_dash = 0 (mod small_prime) for k = -r / 2 (mod small_prime)
+		k = ((small_prime - r) * inv_2) % small_prime;
+		for (; k < SAFE_PRIME_SIEVE_LENGTH; k += small_prime)
+			sieve[k] = 1;
+		// p = 0 (mod small_prime) for p_dash = -1 / 2 = (small_prime - 1) / 2,
+		// so for k = ((small_prime - 1) / 2 - r) / 2
+		k = (((small_prime - 1) / 2 + small_prime - r) * inv_2) % small_prime;
+		for (; k < SAFE_PRIME_SIEVE_LENGTH; k += small_prime)
+			sieve[k] = 1;
 	}
 	bi_free(temp);
-
-	return sievePassed;
 }
 
 /* Tests if a is a Miller-Rabin witness for n
@@ -169,6 +175,7 @@ is_miller_rabin_witness(const bi_ptr a, const bi_ptr n)
 	bi_t x1;
 	int t = -1;
 	int i;
+	int witness;
 
 	bi_new(n_1);
 	bi_new(temp);
@@ -210,14 +217,12 @@ is_miller_rabin_witness(const bi_ptr a, const bi_ptr n)
 		}
 	}
 
+	witness = !bi_equals(x1, bi_1);
 	bi_free(x0);
 	bi_free(x1);
 	bi_free(n_1);
 
-	if (!bi_equals(x1, bi_1))
-		return 1;
-
-	return 0;
+	return witness;
 }
 
 bi_ptr
@@ -237,6 +242,121 @@ compute_trivial_safe_prime(bi_ptr result, int bit_length)
 	return result;
 }
 
+struct safe_prime_search {
+	MUTEX_DECLARE(lock);
+	int found;		/* a worker found a safe prime, the others stop */
+	int bit_length;
+	bi_ptr p;
+};
+
+static int
+safe_prime_search_done(struct safe_prime_search *search)
+{
+	int found;
+
+	MUTEX_LOCK(search->lock);
+	found = search->found;
+	MUTEX_UNLOCK(search->lock);
+
+	return found;
+}
+
+/* Tests if p_dash and p = 2*p_dash + 1 are both primes, p_dash having passed the sieve. The
+ * cheap tests come first, as most candidates fail them.
+ */
+static int
+is_safe_prime_candidate(const bi_ptr p_dash, bi_ptr p, bi_ptr temp_p, bi_ptr p_minus_1)
+{
+	if (is_miller_rabin_witness(bi_2, p_dash))
+		return 0;
+
+	/* test if 2^(pDash) = +1/-1 (mod p)
+	 * bi can not handle negative operation, we compare to (p-1) instead of -1
+	 * calculate p = 2*pDash+1 -> (pDash << 1) + 1
+	 */
+	bi_shift_left(p, p_dash, 1);
+	bi_add(p, p, bi_1);
+
+	// p_minus_1:= p - 1
+	bi_sub(p_minus_1, p, bi_1);
+
+	//  temp_p := ( 2 ^ p_dash ) mod p
+	bi_mod_exp(temp_p, bi_2, p_dash, p);
+	if (!bi_equals_si(temp_p, 1)  && !bi_equals(temp_p, p_minus_1))
+		return 0;
+
+	// test the library dependent probable_prime
+	return bi_is_probable_prime(p_dash);
+}
+
+/* One worker of compute_safe_prime. It sieves random intervals of candidates and tests what
+ * is left, until it or another worker finds a safe prime.
+ */
+static void *
+safe_prime_worker(void *arg)
+{
+	struct safe_prime_search *search = (struct safe_prime_search *)arg;
+	char *sieve;
+	bi_ptr base, p_dash, p, temp_p, p_minus_1;
+	unsigned long k;
+
+	if (!bi_thread_init())
+		return NULL;
+
+	sieve = malloc(SAFE_PRIME_SIEVE_LENGTH);
+	if (sieve == NULL) {
+		LogError("malloc of %d bytes failed", SAFE_PRIME_SIEVE_LENGTH);
+		bi_thread_release();
+		return NULL;
+	}
+	base = bi_new_ptr();
+	p_dash = bi_new_ptr();
+	p = bi_new_ptr();
+	temp_p = bi_new_ptr();
+	p_minus_1 = bi_new_ptr();
+
+	while (!safe_prime_search_done(search)) {
+		/* base = generated random with basic bit settings (odd), the random state of
+		 * the library is shared by the workers */
+		MUTEX_LOCK(search->lock);
+		random_odd_bi(base, search->bit_length - 1);
+		MUTEX_UNLOCK(search->lock);
+
+		sieve_safe_prime_candidates(base, sieve);
+		for (k = 0; k < SAFE_PRIME_SIEVE_LENGTH; k++) {
+			if (sieve[k])
+				continue;
+			if (safe_prime_search_done(search))
+				break;
+
+			// p_dash = base + 2 * k
+			bi_add_si(p_dash, base, 2 * k);
+			if (bi_length(p_dash) != search->bit_length - 1)
+				break;
+			if (!is_safe_prime_candidate(p_dash, p, temp_p, p_minus_1))
+				continue;
+
+			MUTEX_LOCK(search->lock);
+			if (!search->found) {
+				bi_set(search->p, p);
+				search->found = 1;
+			}
+			MUTEX_UNLOCK(search->lock);
+			break;
+		}
+	}
+
+	bi_free_ptr(p_minus_1);
+	bi_free_ptr(temp_p);
+	bi_free_ptr(p);
+	bi_free_ptr(p_dash);
+	bi_free_ptr(base);
+	free(sieve);
+	bi_thread_release();
+
+	return NULL;
+}
+
 /* The main method to compute a random safe prime of the specified bit length.
  * IMPORTANT: The computer prime will have two first bits and the last bit set to 1 !!
  * i.e. > (2^(bitLength-1)+2^(bitLength-2)+1). This is done to be sure that if two primes of
@@ -244,82 +364,47 @@ compute_trivial_safe_prime(bi_ptr result, int bit_length)
  * implementation uses the algorithm proposed by Ronald Cramer and Victor Shoup in "Signature
  * Schemes Based on the strong RSA Assumption" May 9, 2000.
  *
+ * Candidates are taken from random intervals that are first sieved for p_dash and p at once,
+ * the search runs on one worker thread per online processor and stops as soon as one of them
+ * finds a safe prime.
+ *
  * bitLength: the bit length of the safe prime to be computed.
  * return: a number which is considered to be safe prime
  */
 bi_ptr
 compute_safe_prime(bi_ptr p, int bit_length)
 {
-	bi_ptr p_dash;
-	bi_ptr temp_p;
-	bi_ptr p_minus_1;
-	int stop;
-	unsigned long prime_bound;
+	struct safe_prime_search search;
+	THREAD_TYPE threads[SAFE_PRIME_MAX_THREADS];
+	long num_threads;
+	int i, started = 0;
 
 	LogDebug("compute Safe Prime: length: %d bits\n", bit_length);
 
-	p_dash = bi_new_ptr();
-	temp_p = bi_new_ptr();
-	p_minus_1 = bi_new_ptr();
-
-	/* some heuristic checks to limit the number of small primes to check against and the
-	 * number of Miller-Rabin primality tests at the end */
-	if (bit_length <= 256) {
-		prime_bound = 768;
-	} else if (bit_length <= 512) {
-		prime_bound = 3072;
-	} else if (bit_length <= 768) {
-		prime_bound = 6144;
-	} else if (bit_length <= 1024) {
-		prime_bound = 1024;
-	} else {
-		prime_bound = 16384;
-	}
+	MUTEX_INIT(search.lock);
+	search.found = 0;
+	search.bit_length = bit_length;
+	search.p = p;
 
-	do {
-		stop = 0;
-		/* p_dash = generated random with basic bit settings (odd) */
-		random_odd_bi(p_dash, bit_length - 1);
+	num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (num_threads < 1)
+		num_threads = 1;
+	else if (num_threads > SAFE_PRIME_MAX_THREADS)
+		num_threads = SAFE_PRIME_MAX_THREADS;
 
-		if (test_small_prime_factors(p_dash, prime_bound) == 0)  {
-			LogDebugFn("1");
-			continue;
-		}
-		/* test if p_dash or p are divisible by some small primes */
-		if (is_miller_rabin_witness(bi_2, p_dash)) {
-			LogDebugFn("2");
-			continue;
-		}
-		/* test if 2^(pDash) = +1/-1 (mod p)
-		 * bi can not handle negative operation, we compare to (p-1) instead of -1
-		 * calculate p = 2*pDash+1 -> (pDash << 1) + 1
-		 */
-		bi_shift_left(p, p_dash, 1);
-		bi_add(p, p, bi_1);
-
-		// p_minus_1:= p - 1
-		bi_sub(p_minus_1, p, bi_1);
-
-		//  temp_p := ( 2 ^ p_dash ) mod p
-		bi_mod_exp(temp_p, bi_2, p_dash, p);
-		if (!bi_equals_si(temp_p, 1)  && !bi_equals(temp_p, p_minus_1) ) {
-			LogDebugFn("3");
-			continue;
+	for (i = 0; i < num_threads; i++) {
+		if (THREAD_CREATE(&threads[started], NULL, safe_prime_worker, &search) != 0) {
+			LogError("Thread creation failed, %d workers started", started);
+			break;
 		}
+		started++;
+	}
+	for (i = 0; i < started; i++)
+		THREAD_JOIN(threads[i], NULL);
 
-		// test if pDash or p are divisible by some small primes
-		if (is_miller_rabin_witness(bi_2, p_dash)) {
-			LogDebugFn("4");
-			continue;
-		}
-		// test the library dependent probable_prime
-		if (bi_is_probable_prime(p_dash))
-			stop = 1;
-	} while (stop == 0);
-
-	bi_free(p_minus_1);
-	bi_free(temp_p);
-	bi_free(p_dash);
+	/* no worker could be started or run, search in this thread */
+	if (!search.found)
+		safe_prime_worker(&search);
 
 	LogDebug("found Safe Prime: %s bits", bi_2_hex_char(p));
 
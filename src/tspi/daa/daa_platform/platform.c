@@ -31,6 +31,7 @@
 #include <spi_utils.h>
 #include <obj.h>
 #include "tsplog.h"
+#include "threads.h"
 #include "tss/tcs.h"
 #include "platform.h"
 #include "issuer.h"
@@ -265,6 +266,64 @@ Tcsip_TPM_DAA_Join_encapsulate(TCS_CONTEXT_HANDLE tcsContext, // in
 	return result;
 }
 
+/*
+ * The DAA stages cannot be sent to tcsd as one batch: every stage is authorized with a
+ * fresh OIAP session whose even nonce only comes back from the TPM, and the TPM keeps
+ * the DAA state of the session between the stages.  What can be overlapped is the host
+ * side work that needs none of the TPM outputs, which a daa_precompute runs on its own
+ * thread while the TPM works through the stages in front of it.
+ */
+struct daa_precompute {
+	int started;
+	THREAD_TYPE thread;
+	TSS_RESULT (*run)(void *);
+	void *arg;
+	TSS_RESULT result;
+};
+
+static void *
+daa_precompute_thread(void *p)
+{
+	struct daa_precompute *pre = (struct daa_precompute *)p;
+
+	if (!bi_thread_init()) {
+		pre->result = TSPERR(TSS_E_OUTOFMEMORY);
+		return NULL;
+	}
+	pre->result = pre->run(pre->arg);
+	bi_thread_release();
+
+	return NULL;
+}
+
+static void
+daa_precompute_start(struct daa_precompute *pre, TSS_RESULT (*run)(void *), void *arg)
+{
+	pre->run = run;
+	pre->arg = arg;
+	pre->result = TSS_SUCCESS;
+#ifndef TSS_DEBUG
+	/* the debug logging of both threads would share the buffers of dump_byte_array()
+	 * and bi_2_hex_char(), so debug builds do the work up front */
+	if (THREAD_CREATE(&pre->thread, NULL, daa_precompute_thread, pre) == 0) {
+		pre->started = 1;
+		return;
+	}
+#endif
+	pre->result = run(arg);
+}
+
+/* wait for the work of <pre>, safe to call more than once */
+static TSS_RESULT
+daa_precompute_finish(struct daa_precompute *pre)
+{
+	if (pre->started) {
+		THREAD_JOIN(pre->thread, NULL);
+		pre->started = 0;
+	}
+	return pre->result;
+}
+
 #if 0
 /* from TSS.java */
 /* openssl RSA (struct rsa_st) could manage RSA Key */
@@ -881,6 +940,113 @@ err:
 	return TSPERR(TSS_E_INTERNAL_ERROR);
 }
 
+/* host side values of the credential request, computed while the TPM runs Join 8 - 12 */
+struct join_precompute {
+	TSS_DAA_PK_internal *pk_internal;
+	bi_ptr n;
+	UINT32 attributesPlatformLength;
+	BYTE **attributesPlatform;
+	UINT32 capitalUPrimeLength;
+	BYTE *capitalUPrime;
+	bi_ptr v_tilde_prime;
+	bi_ptr rv_tilde_prime;
+	bi_array_ptr ra;
+	bi_ptr capitalU;	// out
+	bi_ptr capital_utilde;	// out
+	bi_ptr zeta;		// out, allocation
+};
+
+static TSS_RESULT
+join_precompute_run(void *arg)
+{
+	struct join_precompute *jp = (struct join_precompute *)arg;
+	TSS_DAA_PK_internal *pk_internal = jp->pk_internal;
+	bi_ptr tmp1 = bi_new_ptr();
+	bi_ptr tmp2 = bi_new_ptr();
+	bi_ptr product_attributes = bi_new_ptr();
+	bi_ptr attributePlatform = NULL;
+	bi_ptr *multi_base = NULL;
+	bi_ptr *multi_exp = NULL;
+	TSS_RESULT result = TSS_SUCCESS;
+	UINT32 i;
+
+	if( tmp1 == NULL || tmp2 == NULL || product_attributes == NULL) {
+		LogError("malloc of bi(s) failed");
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	// encode plateform attributes (the one visible only by the receiver)
+	bi_set( product_attributes, bi_1);
+	for( i=0; i<jp->attributesPlatformLength; i++) {
+		attributePlatform = bi_set_as_nbin( DAA_PARAM_SIZE_F_I / 8,
+							jp->attributesPlatform[i]); // allocation
+		if( attributePlatform == NULL) {
+			LogError("malloc of bi <%s> failed", "attributePlatform");
+			result = TSPERR(TSS_E_OUTOFMEMORY);
+			goto close;
+		}
+		// bi_tmp1 = ( capitalRReceiver[i] ^ attributesPlatform ) % n
+		DAA_PK_mod_exp( tmp1, pk_internal, pk_internal->capitalRReceiver->array[i],
+				attributePlatform);
+		// bi_tmp1 = bi_tmp1 * product_attributes
+		bi_mul( tmp1, tmp1, product_attributes);
+		// product_attributes = bi_tmp1 % n
+		bi_mod( product_attributes, tmp1, jp->n);
+		bi_free_ptr( attributePlatform);
+	}
+	// tmp1 = capitalUPrime * capitalS
+	bi_free_ptr( tmp1);
+	tmp1 = bi_set_as_nbin( jp->capitalUPrimeLength, jp->capitalUPrime); // allocation
+	if( tmp1 == NULL) {
+		LogError("malloc of %d bytes failed", jp->capitalUPrimeLength);
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	// U = ( U' * ( ( pk->S ^ v~' ) % n) ) % n
+	// tmp2 = ( pk->S ^ v~') % n
+	DAA_PK_mod_exp( tmp2, pk_internal, pk_internal->capitalS, jp->v_tilde_prime);
+	// U = tmp1( U') * tmp2
+	bi_mul( jp->capitalU, tmp1, tmp2);
+	bi_mod( jp->capitalU, jp->capitalU, jp->n);
+	// U = ( U * product_attributes ) % n
+	bi_mul( jp->capitalU, jp->capitalU, product_attributes);
+	bi_mod( jp->capitalU, jp->capitalU, jp->n);
+	// pseudonym with respect to the DAA Issuer
+	jp->zeta = compute_zeta( pk_internal->issuerBaseNameLength,
+				pk_internal->issuerBaseName,
+				pk_internal); // allocation
+	if( jp->zeta == NULL) {
+		LogError("malloc of bi <%s> failed", "zeta");
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	multi_base = (bi_ptr *)calloc( jp->attributesPlatformLength + 1, sizeof( bi_ptr));
+	multi_exp = (bi_ptr *)calloc( jp->attributesPlatformLength + 1, sizeof( bi_ptr));
+	if( multi_base == NULL || multi_exp == NULL) {
+		LogError("malloc of %d bytes failed",
+			(jp->attributesPlatformLength + 1) * sizeof( bi_ptr));
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	// capital_utilde = ( capitalS ^ rv_tilde_prime * prod( capitalYplatform[i] ^ ra[i])) % n
+	multi_base[0] = pk_internal->capitalS;
+	multi_exp[0] = jp->rv_tilde_prime;
+	for( i=0; i < jp->attributesPlatformLength; i++) {
+		multi_base[ i + 1] = pk_internal->capitalRReceiver->array[i];
+		multi_exp[ i + 1] = jp->ra->array[i];
+	}
+	if( bi_mod_multi_exp( jp->capital_utilde, jp->attributesPlatformLength + 1,
+				multi_base, multi_exp, jp->n) == NULL)
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+close:
+	free( multi_base);
+	free( multi_exp);
+	FREE_BI( tmp1);
+	FREE_BI( tmp2);
+	FREE_BI( product_attributes);
+	return result;
+}
+
 /*
 This is the second out of 3 functions to execute in order to receive a DAA Credential. It
 computes the credential request for the DAA Issuer, which also includes the Platforms & DAA
@@ -910,7 +1076,6 @@ Tspi_TPM_DAA_JoinCreateDaaPubKey_internal(
 	bi_ptr v_tilde_prime = bi_new_ptr();
 	bi_ptr rv_tilde_prime = bi_new_ptr();
 	bi_ptr capitalU = bi_new_ptr();
-	bi_ptr product_attributes = bi_new_ptr();
 	bi_ptr capital_ni = NULL;
 	bi_ptr capital_utilde_prime = NULL;
 	bi_ptr capital_ni_tilde = NULL;
@@ -927,6 +1092,8 @@ Tspi_TPM_DAA_JoinCreateDaaPubKey_internal(
 	bi_ptr sv_prime2 = NULL;
 	bi_array_ptr ra = NULL;
 	bi_array_ptr sa = NULL;
+	struct join_precompute jp = { 0 };
+	struct daa_precompute precompute = { 0 };
 	TSS_DAA_PK* pk_extern = (TSS_DAA_PK *)joinSession->issuerPk;
 	TSS_DAA_PK_internal* pk_internal = e_2_i_TSS_DAA_PK( pk_extern);
 	UINT32 i, outputSize, authentication_proofLength, nonce_tpmLength;
@@ -940,7 +1107,7 @@ Tspi_TPM_DAA_JoinCreateDaaPubKey_internal(
 
 	if( tmp1 == NULL || tmp2 == NULL || capital_utilde == NULL ||
 		v_tilde_prime == NULL || rv_tilde_prime == NULL ||
-		capitalU == NULL || product_attributes == NULL) {
+		capitalU == NULL) {
 		LogError("malloc of bi(s) failed");
 		result = TSPERR(TSS_E_OUTOFMEMORY);
 		goto close;
@@ -970,44 +1137,42 @@ Tspi_TPM_DAA_JoinCreateDaaPubKey_internal(
 		goto close;
 	}
 	// compute second part of the credential request
-	// encode plateform attributes (the one visible only by the receiver)
-	bi_set( product_attributes, bi_1);
-	for( i=0; i<attributesPlatformLength; i++) {
-		attributePlatform = bi_set_as_nbin( DAA_PARAM_SIZE_F_I / 8,
-									attributesPlatform[i]); // allocation
-		if( attributePlatform == NULL) {
-			LogError("malloc of bi <%s> failed", "attributePlatform");
-			result = TSPERR(TSS_E_OUTOFMEMORY);
-			goto close;
-		}
-		// bi_tmp1 = ( capitalRReceiver[i] ^ attributesPlatform ) % n
-		bi_mod_exp( tmp1, pk_internal->capitalRReceiver->array[i], attributePlatform, n);
-		// bi_tmp1 = bi_tmp1 * product_attributes
-		bi_mul( tmp1, tmp1, product_attributes);
-		// product_attributes = bi_tmp1 % n
-		bi_mod( product_attributes, tmp1, n);
-		bi_free_ptr( attributePlatform);
-	}
 	bi_urandom( v_tilde_prime, DAA_PARAM_SIZE_RSA_MODULUS +
 							DAA_PARAM_SAFETY_MARGIN);
-	// tmp1 = capitalUPrime * capitalS
-	bi_free_ptr( tmp1);
-	tmp1 = bi_set_as_nbin( joinSession->capitalUPrimeLength,
-						joinSession->capitalUPrime); // allocation
-	if( tmp1 == NULL) {
-		LogError("malloc of %d bytes failed", joinSession->capitalUPrimeLength);
+	// randomize/blind attributesReceiver
+	size_bits = DAA_PARAM_SIZE_RANDOMIZED_ATTRIBUTES;
+	ra = (bi_array_ptr)malloc( sizeof( struct _bi_array));
+	if( ra == NULL) {
+		LogError("malloc of %d bytes failed", sizeof( struct _bi_array));
 		result = TSPERR(TSS_E_OUTOFMEMORY);
 		goto close;
 	}
-	// U = ( U' * ( ( pk->S ^ v~' ) % n) ) % n
-	// tmp2 = ( pk->S ^ v~') % n
-	bi_mod_exp( tmp2, pk_internal->capitalS, v_tilde_prime, n);
-	// U = tmp1( U') * tmp2
-	bi_mul( capitalU, tmp1, tmp2);
-	bi_mod( capitalU, capitalU, n);
-	// U = ( U * product_attributes ) % n
-	bi_mul( capitalU, capitalU, product_attributes);
-	bi_mod( capitalU, capitalU, n);
+	bi_new_array( ra, attributesPlatformLength);
+	if( ra->array == NULL) {
+		LogError("malloc of bi_array <%s> failed", "ra");
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	for( i=0; i < attributesPlatformLength; i++) {
+		bi_urandom( ra->array[i], size_bits);
+		LogDebug("ra[i]=%s size=%d", bi_2_hex_char( ra->array[i]), size_bits);
+	}
+	size_bits = DAA_PARAM_SIZE_F_I+2*DAA_PARAM_SAFETY_MARGIN+DAA_PARAM_SIZE_MESSAGE_DIGEST;
+	bi_urandom( rv_tilde_prime, size_bits);
+	// U, U~ and zeta need none of the TPM outputs, compute them while the TPM works
+	// through Join 8 - 12
+	jp.pk_internal = pk_internal;
+	jp.n = n;
+	jp.attributesPlatformLength = attributesPlatformLength;
+	jp.attributesPlatform = attributesPlatform;
+	jp.capitalUPrimeLength = joinSession->capitalUPrimeLength;
+	jp.capitalUPrime = joinSession->capitalUPrime;
+	jp.v_tilde_prime = v_tilde_prime;
+	jp.rv_tilde_prime = rv_tilde_prime;
+	jp.ra = ra;
+	jp.capitalU = capitalU;
+	jp.capital_utilde = capital_utilde;
+	daa_precompute_start( &precompute, join_precompute_run, &jp);
 	// 2  : call the TPM to compute authentication proof with U'
 	result = Tcsip_TPM_DAA_Join_encapsulate( tcsContext, hDAA,
 		8,
@@ -1069,16 +1234,9 @@ Tspi_TPM_DAA_JoinCreateDaaPubKey_internal(
 		goto close;
 	}
 	free( outputData);
-	// 4 compute pseudonym with respect to the DAA Issuer
-	// allocation
-	zeta = compute_zeta( pk_internal->issuerBaseNameLength,
-					pk_internal->issuerBaseName,
-					pk_internal);
-	if( zeta == NULL) {
-		LogError("malloc of bi <%s> failed", "zeta");
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
+	// 4 pseudonym with respect to the DAA Issuer
+	if( (result = daa_precompute_finish( &precompute)) != TSS_SUCCESS) goto close;
+	zeta = jp.zeta;
 	buffer = (BYTE *)malloc( TPM_DAA_SIZE_w);
 	if( buffer == NULL) {
 		LogError("malloc of %d bytes failed", TPM_DAA_SIZE_w);
@@ -1131,37 +1289,6 @@ Tspi_TPM_DAA_JoinCreateDaaPubKey_internal(
 
 	// 5 : compute the second part of the correctness proof of the credential request
 	// (with attributes not visible to issuer)
-	// randomize/blind attributesReceiver
-	size_bits = DAA_PARAM_SIZE_RANDOMIZED_ATTRIBUTES;
-	bi_set( product_attributes, bi_1);
-	ra = (bi_array_ptr)malloc( sizeof( struct _bi_array));
-	if( ra == NULL) {
-		LogError("malloc of %d bytes failed", sizeof( struct _bi_array));
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
-	bi_new_array( ra, attributesPlatformLength);
-	if( ra->array == NULL) {
-		LogError("malloc of bi_array <%s> failed", "ra");
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
-	for( i=0; i < attributesPlatformLength; i++) {
-		bi_urandom( ra->array[i], size_bits);
-		LogDebug("ra[i]=%s size=%d", bi_2_hex_char( ra->array[i]), size_bits);
-		// product_attributes=(((capitalYplatform ^ ra[i]) % n)*<product_attributes-1>)%n
-		bi_mod_exp( tmp1, pk_internal->capitalRReceiver->array[i], ra->array[i], n);
-		bi_mul( tmp1, tmp1, product_attributes);
-		bi_mod( product_attributes, tmp1, n);
-	}
-	size_bits = DAA_PARAM_SIZE_F_I+2*DAA_PARAM_SAFETY_MARGIN+DAA_PARAM_SIZE_MESSAGE_DIGEST;
-	bi_urandom( rv_tilde_prime, size_bits);
-	// capital_utilde = ( capitalS ^ rv_tilde_prime) % n
-	bi_mod_exp( capital_utilde, pk_internal->capitalS, rv_tilde_prime, n);
-	// capital_utilde = capital_utilde * product_attributes
-	bi_mul( capital_utilde, capital_utilde, product_attributes);
-	// capital_utilde = capital_utilde % n
-	bi_mod( capital_utilde, capital_utilde, n);
 	// 5e
 	capital_Uprime = bi_set_as_nbin( joinSession->capitalUPrimeLength,
 					joinSession->capitalUPrime); // allocation
@@ -1173,7 +1300,6 @@ Tspi_TPM_DAA_JoinCreateDaaPubKey_internal(
 	LogDebug("calculation UTilde:                capitalS:%s\n", bi_2_hex_char( pk_internal->capitalS));
 	LogDebug("calculation UTilde:       rv_tilde_prime:%s\n", bi_2_hex_char( rv_tilde_prime));
 	LogDebug("calculation UTilde:                          n:%s\n", bi_2_hex_char( n));
-	LogDebug("calculation UTilde: product_attributes:%s\n", bi_2_hex_char( product_attributes));
 	LogDebug("calculation NItilde:                     ntilde:%s\n", bi_2_hex_char( capital_ni_tilde));
 
 	result = compute_join_challenge_host(
@@ -1487,6 +1613,7 @@ Tspi_TPM_DAA_JoinCreateDaaPubKey_internal(
 	}
 	credentialRequest->sALength = sa->length;
 close:
+	daa_precompute_finish( &precompute);
 	EVP_MD_CTX_destroy(mdctx);
 	if( capitalSprime_byte_array!=NULL) free( capitalSprime_byte_array);
 	if( ch!=NULL) free( ch);
@@ -1511,7 +1638,7 @@ close:
 	FREE_BI( n);
 	FREE_BI( attributePlatform);
 	FREE_BI( c);
-	FREE_BI( zeta);
+	FREE_BI( jp.zeta);
 	FREE_BI( capital_Uprime);
 	FREE_BI( sv_tilde_prime);
 	FREE_BI( s_f0);
@@ -1519,7 +1646,6 @@ close:
 	FREE_BI( sv_prime);
 	FREE_BI( sv_prime1);
 	FREE_BI( sv_prime2);
-	FREE_BI( product_attributes);
 	free_TSS_DAA_PK_internal( pk_internal);
 	return result;
 }
@@ -1553,6 +1679,8 @@ TSPICALL Tspi_TPM_DAA_JoinStoreCredential_internal
 	bi_ptr v_tilde_prime = NULL;
 	bi_ptr v_prime_prime0 = NULL;
 	bi_ptr v_prime_prime1 = NULL;
+	bi_ptr *multi_base = NULL;
+	bi_ptr *multi_exp = NULL;
 	TSS_DAA_PK *daa_pk_extern;
 	TSS_DAA_PK_internal *pk_intern = NULL;
 	TSS_DAA_CREDENTIAL *daaCredential;
@@ -1653,19 +1781,31 @@ TSPICALL Tspi_TPM_DAA_JoinStoreCredential_internal
 		result = TSPERR(TSS_E_OUTOFMEMORY);
 		goto close;
 	}
-	bi_mod_exp( fraction_A, pk_intern->capitalS, v_prime_prime, n);
-	bi_mul( fraction_A, fraction_A, capital_U);
-	bi_mod( fraction_A, fraction_A, n);
 	LogDebug("encode attributes");
 	product_attributes = bi_new_ptr();
-	bi_set( product_attributes, bi_1);
+	multi_base = (bi_ptr *)calloc( attributes_issuer->length + 1, sizeof( bi_ptr));
+	multi_exp = (bi_ptr *)calloc( attributes_issuer->length + 1, sizeof( bi_ptr));
+	if( product_attributes == NULL || multi_base == NULL || multi_exp == NULL) {
+		LogError("malloc of %d bytes failed",
+			(attributes_issuer->length + 1) * sizeof( bi_ptr));
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	// product_attributes = ( capitalS ^ v_prime_prime *
+	//	prod( capitalRIssuer[i] ^ attributes_issuer[i])) % n
+	multi_base[0] = pk_intern->capitalS;
+	multi_exp[0] = v_prime_prime;
 	for( i=0; i<(UINT32)attributes_issuer->length; i++) {
-		bi_mod_exp( tmp1, pk_intern->capitalRIssuer->array[i],
-					attributes_issuer->array[i], n);
-		bi_mul( product_attributes, tmp1, product_attributes);
-		bi_mod( product_attributes, product_attributes, n);
+		multi_base[ i + 1] = pk_intern->capitalRIssuer->array[i];
+		multi_exp[ i + 1] = attributes_issuer->array[i];
 	}
-	bi_mul( fraction_A, fraction_A, product_attributes);
+	if( bi_mod_multi_exp( product_attributes, attributes_issuer->length + 1,
+				multi_base, multi_exp, n) == NULL) {
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	// fraction_A = ( product_attributes * capital_U) % n
+	bi_mul( fraction_A, product_attributes, capital_U);
 	bi_mod( fraction_A, fraction_A, n);
 	capital_Atilde = bi_new_ptr();
 	if( capital_Atilde == NULL) {
@@ -1682,7 +1822,7 @@ TSPICALL Tspi_TPM_DAA_JoinStoreCredential_internal
 		result = TSPERR(TSS_E_OUTOFMEMORY);
 		goto close;
 	}
-	bi_mod_exp( capital_Atilde, capital_Atilde, s_e, n);
+	DAA_PK_mod_exp( capital_Atilde, pk_intern, capital_Atilde, s_e);
 	c_prime = bi_set_as_nbin( credIssuer.cPrimeLength, credIssuer.cPrime); // allocation
 	if( c_prime == NULL) {
 		LogError("malloc of bi <%s> failed", "c_prime");
@@ -1695,7 +1835,7 @@ TSPICALL Tspi_TPM_DAA_JoinStoreCredential_internal
 		result = TSPERR(TSS_E_OUTOFMEMORY);
 		goto close;
 	}
-	bi_mod_exp( tmp1, capital_A, c_prime, n);
+	DAA_PK_mod_exp( tmp1, pk_intern, capital_A, c_prime);
 	bi_mul( capital_Atilde, capital_Atilde, tmp1);
 	bi_mod( capital_Atilde, capital_Atilde, n);
 
@@ -1726,7 +1866,7 @@ TSPICALL Tspi_TPM_DAA_JoinStoreCredential_internal
 		result = TSPERR(TSS_E_OUTOFMEMORY);
 		goto close;
 	}
-	bi_mod_exp( product, capital_A, e, n);
+	DAA_PK_mod_exp( product, pk_intern, capital_A, e);
 	bi_mul( product, product, fraction_A);
 	bi_mod( product, product, n);
 	if( bi_equals( pk_intern->capitalZ, product) == 0) {
@@ -1896,6 +2036,8 @@ close:
 	FREE_BI( c_prime);
 	FREE_BI( s_e);
 	FREE_BI( capital_Atilde);
+	free( multi_base);
+	free( multi_exp);
 	FREE_BI( product_attributes);
 	FREE_BI( capital_U);
 	FREE_BI( v_prime_prime);
@@ -1912,6 +2054,68 @@ static void add_splitet( bi_ptr result, bi_ptr a, bi_ptr b) {
 	bi_add( result, result, a);
 }
 
+/* host side values of the signature, computed while the TPM runs Sign 0 - 5 */
+struct sign_precompute {
+	TSS_DAA_PK_internal *pk_intern;
+	bi_ptr n;
+	bi_ptr r;		// random base of zeta, NULL to derive zeta from the base name
+	UINT32 baseNameLength;
+	BYTE *baseName;
+	bi_ptr capital_A;
+	bi_ptr w;
+	bi_ptr r_E;
+	bi_ptr r_V;
+	UINT32 r_ALength;
+	bi_ptr *r_A;
+	bi_ptr zeta;		// out, allocation
+	bi_ptr capital_T;	// out
+	bi_ptr product_R;	// out
+};
+
+static TSS_RESULT
+sign_precompute_run(void *arg)
+{
+	struct sign_precompute *sp = (struct sign_precompute *)arg;
+	TSS_DAA_PK_internal *pk_intern = sp->pk_intern;
+	bi_ptr tmp = bi_new_ptr();
+	TSS_RESULT result = TSS_SUCCESS;
+
+	if( tmp == NULL) {
+		LogError("malloc of bi <%s> failed", "tmp");
+		return TSPERR(TSS_E_OUTOFMEMORY);
+	}
+	if( sp->r != NULL)
+		sp->zeta = project_into_group_gamma( sp->r, pk_intern); // allocation
+	else
+		sp->zeta = compute_zeta( sp->baseNameLength, sp->baseName, pk_intern); // allocation
+	if( sp->zeta == NULL) {
+		LogError("malloc of bi <%s> failed", "zeta");
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	// capital_T = ( capital_A * capitalS ^ w) % n
+	if( DAA_PK_fixed_base_exp( tmp, pk_intern, sp->w, NULL, NULL, 0, NULL) == NULL) {
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	bi_mul( sp->capital_T, sp->capital_A, tmp);
+	bi_mod( sp->capital_T, sp->capital_T, sp->n);
+	// product_R = ( capitalS ^ r_V * prod( capital_R[i] ^ r_A[i])) % n, over the attributes
+	// not revealed, with the issuer key's fixed base tables
+	if( DAA_PK_fixed_base_exp( sp->product_R, pk_intern, sp->r_V, NULL, NULL,
+				sp->r_ALength, sp->r_A) == NULL) {
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	// product_R = ( product_R * capital_T ^ r_E) % n
+	DAA_PK_mod_exp( tmp, pk_intern, sp->capital_T, sp->r_E);
+	bi_mul( sp->product_R, sp->product_R, tmp);
+	bi_mod( sp->product_R, sp->product_R, sp->n);
+close:
+	bi_free_ptr( tmp);
+	return result;
+}
+
 /* code influenced by TSS.java (signStep) */
 TSS_RESULT Tspi_TPM_DAA_Sign_internal
 (
@@ -1975,6 +2179,8 @@ TSS_RESULT Tspi_TPM_DAA_Sign_internal
 	TSS_DAA_PSEUDONYM_PLAIN *pseudonym_plain = NULL;
 	TSS_DAA_PSEUDONYM_PLAIN *pseudonym_plain_tilde = NULL;
 	TSS_DAA_ATTRIB_COMMIT *signed_commitments;
+	struct sign_precompute sp = { 0 };
+	struct daa_precompute precompute = { 0 };
 
 	if( (result = obj_tpm_is_connected(  hTPM, &tcsContext)) != TSS_SUCCESS)
 		return result;
@@ -2031,21 +2237,105 @@ TSS_RESULT Tspi_TPM_DAA_Sign_internal
 	bi_set( gamma, pk_intern->gamma);
 	if( verifierBaseNameLength == 0 || verifierBaseName == NULL) {
 		r = bi_new_ptr();
-		compute_random_number( r, capital_gamma);
-		zeta = project_into_group_gamma( r, pk_intern); // allocation
-		if( zeta == NULL) {
-			LogError("malloc of bi <%s> failed", "zeta");
-			result = TSPERR(TSS_E_OUTOFMEMORY);
-			goto close;
-		}
-	} else {
-		zeta = compute_zeta( verifierBaseNameLength, verifierBaseName, pk_intern);
-		if( zeta == NULL) {
-			LogError("malloc of bi <%s> failed", "zeta");
+		if( r == NULL) {
+			LogError("malloc of bi <%s> failed", "r");
 			result = TSPERR(TSS_E_OUTOFMEMORY);
 			goto close;
 		}
+		compute_random_number( r, capital_gamma);
+	}
+	size_bits = DAA_PARAM_SIZE_RSA_MODULUS + DAA_PARAM_SAFETY_MARGIN;
+	w = bi_new_ptr();
+	if( w == NULL) {
+		LogError("malloc of bi <%s> failed", "w");
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	bi_urandom( w, size_bits);
+	capital_A = bi_set_as_nbin( daaCredential->capitalALength,
+					daaCredential->capitalA); // allocation
+	if( capital_A == NULL) {
+		LogError("malloc of bi <%s> failed", "capital_A");
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
 	}
+	capital_T = bi_new_ptr();
+	if( capital_T == NULL) {
+		LogError("malloc of bi <%s> failed", "capital_T");
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	size_bits = DAA_PARAM_SIZE_INTERVAL_EXPONENT_CERTIFICATE +
+		DAA_PARAM_SAFETY_MARGIN + DAA_PARAM_SIZE_MESSAGE_DIGEST;
+	r_E = bi_new_ptr();
+	if( r_E == NULL) {
+		LogError("malloc of bi <%s> failed", "r_E");
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	bi_urandom( r_E, size_bits);
+	size_bits = DAA_PARAM_SIZE_EXPONENT_CERTIFICATE + DAA_PARAM_SIZE_RSA_MODULUS +
+		2 * DAA_PARAM_SAFETY_MARGIN + DAA_PARAM_SIZE_MESSAGE_DIGEST + 1;
+	r_V = bi_new_ptr();
+	if( r_V == NULL) {
+		LogError("malloc of bi <%s> failed", "r_V");
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	bi_urandom( r_V, size_bits);
+	capital_T_tilde = bi_new_ptr();
+	if( capital_T_tilde == NULL) {
+		LogError("malloc of bi <%s> failed", "capital_T_tilde");
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+
+	// attributes extension
+	size_bits = DAA_PARAM_SIZE_F_I +
+			DAA_PARAM_SAFETY_MARGIN +
+			DAA_PARAM_SIZE_MESSAGE_DIGEST;
+	capital_R = pk_intern->capitalY;
+	r_A = (bi_array_ptr)malloc( sizeof( struct _bi_array));
+	if( r_A == NULL) {
+		LogError("malloc of %d bytes failed", sizeof( struct _bi_array));
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	bi_new_array2( r_A, revealAttributes.indicesListLength);
+	product_R = bi_new_ptr();
+	if( product_R == NULL) {
+		LogError("malloc of bi <%s> failed", "product_R");
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
+	for( i=0; i<(int)revealAttributes.indicesListLength; i++) {
+		if( revealAttributes.indicesList[i] == 0) {
+			// only non selected
+			r_A->array[i] = bi_new_ptr();
+			if( r_A->array[i] == NULL) {
+				LogError("malloc of bi <%s> failed", "r_A->array[i]");
+				result = TSPERR(TSS_E_OUTOFMEMORY);
+				goto close;
+			}
+			bi_urandom( r_A->array[i] , size_bits);
+		} else r_A->array[i] = NULL;
+	}
+	// zeta, T and the host part of T~ need none of the TPM outputs, compute them
+	// while the TPM works through Sign 0 - 5
+	sp.pk_intern = pk_intern;
+	sp.n = n;
+	sp.r = r;
+	sp.baseNameLength = verifierBaseNameLength;
+	sp.baseName = verifierBaseName;
+	sp.capital_A = capital_A;
+	sp.w = w;
+	sp.r_E = r_E;
+	sp.r_V = r_V;
+	sp.r_ALength = revealAttributes.indicesListLength;
+	sp.r_A = r_A->array;
+	sp.capital_T = capital_T;
+	sp.product_R = product_R;
+	daa_precompute_start( &precompute, sign_precompute_run, &sp);
 	issuer_settings = issuer_2_byte_array( tpm_daa_issuer,
 						&issuer_settingsLength); // allocation
 	if( issuer_settings == NULL) {
@@ -2125,6 +2415,8 @@ TSS_RESULT Tspi_TPM_DAA_Sign_internal
 	}
 	free( outputData);
 	// first precomputation until here possible (verifier independent)
+	if( (result = daa_precompute_finish( &precompute)) != TSS_SUCCESS) goto close;
+	zeta = sp.zeta;
 	length = TPM_DAA_SIZE_w;
 	buffer = (BYTE *)malloc( length);
 	if( buffer == NULL) {
@@ -2177,97 +2469,7 @@ TSS_RESULT Tspi_TPM_DAA_Sign_internal
 	// TODO  Step 6 c,d - anonymity revocation
 
 	// Second precomputation until here possible (verifier dependent)
-	size_bits = DAA_PARAM_SIZE_RSA_MODULUS + DAA_PARAM_SAFETY_MARGIN;
-	w = bi_new_ptr();
-	if( w == NULL) {
-		LogError("malloc of bi <%s> failed", "w");
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
-	bi_urandom( w, size_bits);
-	capital_A = bi_set_as_nbin( daaCredential->capitalALength,
-					daaCredential->capitalA); // allocation
-	if( capital_A == NULL) {
-		LogError("malloc of bi <%s> failed", "capital_A");
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
-	capital_T = bi_new_ptr();
-	if( capital_T == NULL) {
-		LogError("malloc of bi <%s> failed", "capital_T");
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
-	bi_mod_exp( tmp1, pk_intern->capitalS, w, n);
-	bi_mul( capital_T, capital_A, tmp1);
-	bi_mod( capital_T, capital_T, n);
-	size_bits = DAA_PARAM_SIZE_INTERVAL_EXPONENT_CERTIFICATE +
-		DAA_PARAM_SAFETY_MARGIN + DAA_PARAM_SIZE_MESSAGE_DIGEST;
-	r_E = bi_new_ptr();
-	if( r_E == NULL) {
-		LogError("malloc of bi <%s> failed", "r_E");
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
-	bi_urandom( r_E, size_bits);
-	size_bits = DAA_PARAM_SIZE_EXPONENT_CERTIFICATE + DAA_PARAM_SIZE_RSA_MODULUS +
-		2 * DAA_PARAM_SAFETY_MARGIN + DAA_PARAM_SIZE_MESSAGE_DIGEST + 1;
-	r_V = bi_new_ptr();
-	if( r_V == NULL) {
-		LogError("malloc of bi <%s> failed", "r_V");
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
-	bi_urandom( r_V, size_bits);
-	capital_T_tilde = bi_new_ptr();
-	if( capital_T_tilde == NULL) {
-		LogError("malloc of bi <%s> failed", "capital_T_tilde");
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
-	bi_mod_exp( tmp1, capital_T, r_E, n);
-	bi_mul( capital_T_tilde, t_tilde_T, tmp1);
-	bi_mod( capital_T_tilde, capital_T_tilde, n);
-
-	bi_mod_exp( tmp1, pk_intern->capitalS, r_V, n);
-	bi_mul( capital_T_tilde, capital_T_tilde, tmp1);
-	bi_mod( capital_T_tilde, capital_T_tilde, n);
-
-	// attributes extension
-	size_bits = DAA_PARAM_SIZE_F_I +
-			DAA_PARAM_SAFETY_MARGIN +
-			DAA_PARAM_SIZE_MESSAGE_DIGEST;
-	capital_R = pk_intern->capitalY;
-	r_A = (bi_array_ptr)malloc( sizeof( struct _bi_array));
-	if( r_A == NULL) {
-		LogError("malloc of %d bytes failed", sizeof( struct _bi_array));
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
-	bi_new_array2( r_A, revealAttributes.indicesListLength);
-	product_R = bi_new_ptr();
-	if( product_R == NULL) {
-		LogError("malloc of bi <%s> failed", "product_R");
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
-	bi_set( product_R, bi_1);
-	for( i=0; i<(int)revealAttributes.indicesListLength; i++) {
-		if( revealAttributes.indicesList[i] == 0) {
-			// only non selected
-			r_A->array[i] = bi_new_ptr();
-			if( r_A->array[i] == NULL) {
-				LogError("malloc of bi <%s> failed", "r_A->array[i]");
-				result = TSPERR(TSS_E_OUTOFMEMORY);
-				goto close;
-			}
-			bi_urandom( r_A->array[i] , size_bits);
-			bi_mod_exp( tmp1, capital_R->array[i], r_A->array[i], n);
-			bi_mul( product_R, product_R, tmp1);
-			bi_mod( product_R, product_R, n);
-		} else r_A->array[i] = NULL;
-	}
-	bi_mul( capital_T_tilde, capital_T_tilde, product_R);
+	bi_mul( capital_T_tilde, t_tilde_T, product_R);
 	bi_mod( capital_T_tilde, capital_T_tilde, n);
 	//TODO Step 8 - Commitments
 	// compute commitment to attributes not revealed to the verifier
@@ -2608,6 +2810,7 @@ TSS_RESULT Tspi_TPM_DAA_Sign_internal
 	daaSignature->attributeCommitmentsLength = 0;
 	daaSignature->signedPseudonym = signature_pseudonym;
 close:
+	daa_precompute_finish( &precompute);
 	bi_free_ptr( tmp1);
 	if( c_bytes != NULL) free( c_bytes);
 	if( ch != NULL) free( ch);
@@ -2641,7 +2844,7 @@ close:
 	FREE_BI( n);
 	FREE_BI( capital_gamma);
 	FREE_BI( gamma);
-	FREE_BI( zeta);
+	FREE_BI( sp.zeta);
 	FREE_BI( r);
 	free_TSS_DAA_PK_internal( pk_intern);
 	free_TPM_DAA_ISSUER( tpm_daa_issuer);
@@ -30,6 +30,7 @@ for example to use calloc_tspi, or a "normal" malloc.
 #include "daa_parameter.h"
 #include "daa_structs.h"
 #include "tcslog.h"
+#include "threads.h"
 
 #define DUMP_DAA_PK_FIELD( field) \
 do { \
@@ -471,6 +472,7 @@ create_DAA_PK(const bi_ptr modulus,
 	pk_internal->issuerBaseNameLength = issuerBaseNameLength;
 	pk_internal->issuerBaseName = issuerBaseName;
 	compute_capitalSprime( pk_internal);
+	pk_internal->tables = NULL;
 
 	LogDebug("<- create_DAA_PK");
 
@@ -767,12 +769,255 @@ e_2_i_TSS_DAA_PK( TSS_DAA_PK *pk)
 		pk->issuerBaseName,
 		pk_internal->issuerBaseName);
 	compute_capitalSprime( pk_internal); // allocation
+	pk_internal->tables = NULL;
 	return pk_internal;
 }
 
+/* the fixed base tables of the issuer keys in use, most recently used first. Tables nobody
+ * refers to are kept for the next key conversion, up to DAA_PK_TABLES_MAX keys */
+#define DAA_PK_TABLES_MAX	8
+/* exponents of capitalS go up to the size of sV, the others up to the size of an sF or sA */
+#define DAA_PK_TABLES_BITS_S	(DAA_PARAM_SIZE_EXPONENT_CERTIFICATE + \
+				 DAA_PARAM_SIZE_RSA_MODULUS + 2 * DAA_PARAM_SAFETY_MARGIN + \
+				 DAA_PARAM_SIZE_MESSAGE_DIGEST + 2)
+#define DAA_PK_TABLES_BITS_R	(DAA_PARAM_SIZE_F_I + 2 * DAA_PARAM_SAFETY_MARGIN + \
+				 DAA_PARAM_SIZE_MESSAGE_DIGEST + 2)
+
+static TSS_DAA_PK_TABLES *pk_tables = NULL;
+MUTEX_DECLARE_INIT(pk_tables_lock);
+
+static void
+free_TSS_DAA_PK_TABLES(TSS_DAA_PK_TABLES *tables)
+{
+	int i;
+
+	if( tables->fixedY != NULL) {
+		for( i = 0; i < tables->capitalY->length; i++)
+			bi_fixed_base_free( tables->fixedY[i]);
+		free( tables->fixedY);
+	}
+	bi_mod_ctx_free( tables->modGamma);
+	bi_mod_ctx_free( tables->modModulus);
+	bi_fixed_base_free( tables->fixedR1);
+	bi_fixed_base_free( tables->fixedR0);
+	bi_fixed_base_free( tables->fixedS);
+	if( tables->capitalY != NULL) {
+		bi_free_array( tables->capitalY);
+		free( tables->capitalY);
+	}
+	FREE_BI( tables->capitalR1);
+	FREE_BI( tables->capitalR0);
+	FREE_BI( tables->capitalS);
+	FREE_BI( tables->capitalGamma);
+	FREE_BI( tables->modulus);
+	free( tables);
+}
+
+static int
+match_TSS_DAA_PK_TABLES(TSS_DAA_PK_TABLES *tables, TSS_DAA_PK_internal *pk_internal)
+{
+	int i;
+
+	if( !bi_equals( tables->modulus, pk_internal->modulus) ||
+	    !bi_equals( tables->capitalGamma, pk_internal->capitalGamma) ||
+	    !bi_equals( tables->capitalS, pk_internal->capitalS) ||
+	    !bi_equals( tables->capitalR0, pk_internal->capitalR0) ||
+	    !bi_equals( tables->capitalR1, pk_internal->capitalR1) ||
+	    tables->capitalY->length != pk_internal->capitalY->length)
+		return 0;
+	for( i = 0; i < tables->capitalY->length; i++) {
+		if( !bi_equals( tables->capitalY->array[i], pk_internal->capitalY->array[i]))
+			return 0;
+	}
+	return 1;
+}
+
+static TSS_DAA_PK_TABLES *
+create_TSS_DAA_PK_TABLES(TSS_DAA_PK_internal *pk_internal)
+{
+	TSS_DAA_PK_TABLES *tables;
+	int i, length = pk_internal->capitalY->length;
+
+	tables = (TSS_DAA_PK_TABLES *)calloc( 1, sizeof( TSS_DAA_PK_TABLES));
+	if( tables == NULL) {
+		LogError("malloc of %d bytes failed", sizeof( TSS_DAA_PK_TABLES));
+		return NULL;
+	}
+	if( ( tables->modulus = bi_new_ptr()) == NULL ||
+	    ( tables->capitalGamma = bi_new_ptr()) == NULL ||
+	    ( tables->capitalS = bi_new_ptr()) == NULL ||
+	    ( tables->capitalR0 = bi_new_ptr()) == NULL ||
+	    ( tables->capitalR1 = bi_new_ptr()) == NULL ||
+	    ( tables->capitalY = ALLOC_BI_ARRAY()) == NULL)
+		goto error;
+	bi_set( tables->modulus, pk_internal->modulus);
+	bi_set( tables->capitalGamma, pk_internal->capitalGamma);
+	bi_set( tables->capitalS, pk_internal->capitalS);
+	bi_set( tables->capitalR0, pk_internal->capitalR0);
+	bi_set( tables->capitalR1, pk_internal->capitalR1);
+	bi_new_array( tables->capitalY, length);
+	if( tables->capitalY->array == NULL) {
+		free( tables->capitalY);
+		tables->capitalY = NULL;
+		goto error;
+	}
+	for( i = 0; i < length; i++) {
+		if( tables->capitalY->array[i] == NULL) goto error;
+		bi_set( tables->capitalY->array[i], pk_internal->capitalY->array[i]);
+	}
+	tables->fixedS = bi_fixed_base_new( pk_internal->capitalS, pk_internal->modulus,
+					DAA_PK_TABLES_BITS_S);
+	tables->fixedR0 = bi_fixed_base_new( pk_internal->capitalR0, pk_internal->modulus,
+					DAA_PK_TABLES_BITS_R);
+	tables->fixedR1 = bi_fixed_base_new( pk_internal->capitalR1, pk_internal->modulus,
+					DAA_PK_TABLES_BITS_R);
+	tables->fixedY = (bi_fixed_base_ptr *)calloc( length + 1, sizeof( bi_fixed_base_ptr));
+	tables->modModulus = bi_mod_ctx_new( pk_internal->modulus);
+	tables->modGamma = bi_mod_ctx_new( pk_internal->capitalGamma);
+	if( tables->fixedS == NULL || tables->fixedR0 == NULL || tables->fixedR1 == NULL ||
+	    tables->fixedY == NULL || tables->modModulus == NULL || tables->modGamma == NULL)
+		goto error;
+	for( i = 0; i < length; i++) {
+		tables->fixedY[i] = bi_fixed_base_new( pk_internal->capitalY->array[i],
+							pk_internal->modulus,
+							DAA_PK_TABLES_BITS_R);
+		if( tables->fixedY[i] == NULL) goto error;
+	}
+	return tables;
+error:
+	free_TSS_DAA_PK_TABLES( tables);
+	return NULL;
+}
+
+TSS_DAA_PK_TABLES *
+get_DAA_PK_tables(TSS_DAA_PK_internal *pk_internal)
+{
+	TSS_DAA_PK_TABLES *tables, **prev, **unused = NULL;
+	int count = 0;
+
+	if( pk_internal->tables != NULL) return pk_internal->tables;
+
+	MUTEX_LOCK(pk_tables_lock);
+	for( prev = &pk_tables; ( tables = *prev) != NULL; prev = &tables->next) {
+		if( match_TSS_DAA_PK_TABLES( tables, pk_internal)) {
+			// move it to the front
+			*prev = tables->next;
+			goto found;
+		}
+		if( tables->refs == 0) unused = prev;
+		count++;
+	}
+	// the tables are built with the lock held, so that two threads converting the same
+	// key do not both build them
+	if( ( tables = create_TSS_DAA_PK_TABLES( pk_internal)) == NULL) {
+		MUTEX_UNLOCK(pk_tables_lock);
+		return NULL;
+	}
+	// make room by dropping the least recently used tables nobody refers to
+	if( count >= DAA_PK_TABLES_MAX && unused != NULL) {
+		TSS_DAA_PK_TABLES *old = *unused;
+
+		*unused = old->next;
+		free_TSS_DAA_PK_TABLES( old);
+	}
+found:
+	tables->next = pk_tables;
+	pk_tables = tables;
+	tables->refs++;
+	MUTEX_UNLOCK(pk_tables_lock);
+
+	pk_internal->tables = tables;
+	return tables;
+}
+
+static void
+put_DAA_PK_tables(TSS_DAA_PK_TABLES *tables)
+{
+	MUTEX_LOCK(pk_tables_lock);
+	tables->refs--;
+	MUTEX_UNLOCK(pk_tables_lock);
+}
+
+bi_ptr
+DAA_PK_fixed_base_exp(bi_ptr result,
+		      TSS_DAA_PK_internal *pk_internal,
+		      bi_ptr eS,
+		      bi_ptr eR0,
+		      bi_ptr eR1,
+		      int eYLength,
+		      bi_ptr *eY)
+{
+	TSS_DAA_PK_TABLES *tables = get_DAA_PK_tables( pk_internal);
+	int i, length = pk_internal->capitalY->length;
+	bi_fixed_base_ptr *fixed = NULL;
+	bi_ptr *base = NULL, *exp = NULL, ret = NULL;
+
+	exp = (bi_ptr *)calloc( length + 3, sizeof( bi_ptr));
+	if( exp == NULL) {
+		LogError("malloc of %d bytes failed", ( length + 3) * sizeof( bi_ptr));
+		return NULL;
+	}
+	exp[0] = eS;
+	exp[1] = eR0;
+	exp[2] = eR1;
+	for( i = 0; i < eYLength && i < length; i++) exp[ i + 3] = eY[i];
+
+	if( tables != NULL) {
+		fixed = (bi_fixed_base_ptr *)calloc( length + 3, sizeof( bi_fixed_base_ptr));
+		if( fixed == NULL) {
+			LogError("malloc of %d bytes failed",
+				 ( length + 3) * sizeof( bi_fixed_base_ptr));
+			goto done;
+		}
+		fixed[0] = tables->fixedS;
+		fixed[1] = tables->fixedR0;
+		fixed[2] = tables->fixedR1;
+		for( i = 0; i < length; i++) fixed[ i + 3] = tables->fixedY[i];
+		ret = bi_fixed_base_multi_exp( result, length + 3, fixed, exp);
+	} else {
+		// the tables could not be built, use the bases themselves
+		base = (bi_ptr *)calloc( length + 3, sizeof( bi_ptr));
+		if( base == NULL) {
+			LogError("malloc of %d bytes failed", ( length + 3) * sizeof( bi_ptr));
+			goto done;
+		}
+		base[0] = pk_internal->capitalS;
+		base[1] = pk_internal->capitalR0;
+		base[2] = pk_internal->capitalR1;
+		for( i = 0; i < length; i++) base[ i + 3] = pk_internal->capitalY->array[i];
+		ret = bi_mod_multi_exp( result, length + 3, base, exp, pk_internal->modulus);
+	}
+done:
+	free( fixed);
+	free( base);
+	free( exp);
+	return ret;
+}
+
+bi_ptr
+DAA_PK_mod_exp(bi_ptr result, TSS_DAA_PK_internal *pk_internal, bi_ptr g, bi_ptr e)
+{
+	TSS_DAA_PK_TABLES *tables = get_DAA_PK_tables( pk_internal);
+
+	if( tables == NULL)
+		return bi_mod_exp( result, g, e, pk_internal->modulus);
+	return bi_mod_exp_ctx( result, g, e, tables->modModulus);
+}
+
+bi_ptr
+DAA_PK_gamma_mod_exp(bi_ptr result, TSS_DAA_PK_internal *pk_internal, bi_ptr g, bi_ptr e)
+{
+	TSS_DAA_PK_TABLES *tables = get_DAA_PK_tables( pk_internal);
+
+	if( tables == NULL)
+		return bi_mod_exp( result, g, e, pk_internal->capitalGamma);
+	return bi_mod_exp_ctx( result, g, e, tables->modGamma);
+}
+
 void
 free_TSS_DAA_PK_internal(TSS_DAA_PK_internal *pk_internal)
 {
+	if( pk_internal->tables != NULL) put_DAA_PK_tables( pk_internal->tables);
 	bi_free_ptr( pk_internal->capitalSprime);
 	free( pk_internal->issuerBaseName);
 	free( pk_internal->capitalY);
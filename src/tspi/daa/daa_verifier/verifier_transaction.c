@@ -118,7 +118,7 @@ bi_ptr project_into_group_gamma( bi_ptr base, TSS_DAA_PK_internal *issuer_pk) {
 	LogDebug("project_into_group_gamma: capitalGamma[%ld]:%s",
 		bi_nbin_size( capital_gamma),
 		bi_2_hex_char( capital_gamma));
-	bi_mod_exp( zeta, base, exponent, capital_gamma);
+	DAA_PK_gamma_mod_exp( zeta, issuer_pk, base, exponent);
 	LogDebug("project_into_group_gamma: result:%s", bi_2_hex_char( zeta));
 	bi_free( exponent);
 	return zeta;
@@ -370,40 +370,37 @@ inline int is_element_gamma( bi_ptr capital_nv, TSS_DAA_PK_internal *issuer_pk)
 	int result;
 
 	//	( ( capital_nv ^ issuer_pk->rho ) % issuer_pk->capitalGamma ) == 1
-	result = bi_equals( bi_mod_exp( tmp1,
-					capital_nv,
-					issuer_pk->rho,
-					issuer_pk->capitalGamma),
+	result = bi_equals( DAA_PK_gamma_mod_exp( tmp1, issuer_pk, capital_nv, issuer_pk->rho),
 				bi_1);
 	bi_free_ptr( tmp1);
 	return result;
 }
 
-/* implementation  derived from isValid (VerifierTransaction.java) */
-TSPICALL Tspi_DAA_VerifySignature_internal
-(	TSS_HDAA hDAA,	// in
-	TSS_DAA_SIGNATURE signature_ext, // in
-	TSS_HKEY hPubKeyIssuer,	// in
-	TSS_DAA_SIGN_DATA sign_data,	// in
-	UINT32 attributesLength,	// in
-	BYTE **attributes,	// in
-	UINT32 nonce_verifierLength,	// out
-	BYTE *nonce_verifier,	// out
-	UINT32 base_nameLength,	// out
-	BYTE *base_name,	// out
-	TSS_BOOL *isCorrect	// out
-) {
+/* Verifies one signature against an issuer key that is already converted. zeta_2_verify is
+ * the zeta of the verifier's base name, or NULL for a random base name. zeta_tested tells that
+ * the caller already found zeta_2_verify to be an element of <gamma>, the signature's zeta then
+ * isn't tested again since it has to equal zeta_2_verify. */
+static TSS_RESULT
+verify_signature( TSS_DAA_PK_internal *issuer_pk,
+		  TSS_DAA_SIGNATURE *signature_ext,
+		  TSS_DAA_SIGN_DATA *sign_data,
+		  UINT32 attributesLength,
+		  BYTE **attributes,
+		  UINT32 nonce_verifierLength,
+		  BYTE *nonce_verifier,
+		  bi_ptr zeta_2_verify,
+		  TSS_BOOL zeta_tested,
+		  TSS_BOOL *isCorrect)
+{
 	int i, j;
 	DAA_VERIFIER_TRANSACTION *verifier_transaction = NULL;
 	TSS_DAA_ATTRIB_COMMIT *commitments;
-	TSS_DAA_PK_internal *issuer_pk;
 	TSS_DAA_SIGNATURE_internal *signature = NULL;
 	bi_ptr tmp1;
 	bi_array_ptr sA;
 	bi_ptr n = NULL;
 	bi_ptr c = NULL;
 	bi_ptr capital_gamma = NULL;
-	bi_ptr zeta_2_verify = NULL;
 	bi_ptr capital_z = NULL;
 	bi_array_ptr capital_R = NULL;
 	bi_ptr product_r = NULL;
@@ -420,6 +417,8 @@ TSPICALL Tspi_DAA_VerifySignature_internal
 	bi_ptr delta_tilde3 = NULL;
 	bi_ptr delta_tilde4 = NULL;
 	bi_ptr attribute_i;
+	bi_ptr *attribute_values = NULL;
+	bi_ptr *hidden_sA = NULL;
 	TSS_DAA_PSEUDONYM_PLAIN *pseudonym_plain;
 	CS_ENCRYPTION_RESULT *pseudonym_enc = NULL;
 	CS_ENCRYPTION_RESULT *pseudonym_encryption_proof = NULL;
@@ -427,37 +426,27 @@ TSPICALL Tspi_DAA_VerifySignature_internal
 	CS_ENCRYPTION_RESULT_RANDOMNESS *result_random = NULL;
 	CS_ENCRYPTION_RESULT *encryption_result = NULL;
 	TSS_DAA_ATTRIB_COMMIT_internal **commitment_proofs = NULL;
-	TCS_CONTEXT_HANDLE tcsContext;
 	TSS_RESULT result = TSS_SUCCESS;
-	EVP_MD_CTX *mdctx;
+	EVP_MD_CTX *mdctx = NULL;
 	int length_ch, len_hash, bits;
 	BYTE *ch = NULL, *hash = NULL;
 	TSS_BOOL *indices;
 
+	*isCorrect = FALSE;
 	tmp1 = bi_new_ptr();
 	if( tmp1 == NULL) {
 		LogError("malloc of BI <%s> failed", "tmp1");
 		result = TSPERR(TSS_E_OUTOFMEMORY);
 		goto close;
 	}
-	*isCorrect = FALSE;
-	if( (result = obj_daa_get_tsp_context( hDAA, &tcsContext)) != TSS_SUCCESS)
-		goto close;
-	// allocation of issuer_pk
-	issuer_pk = e_2_i_TSS_DAA_PK( (TSS_DAA_PK *)hPubKeyIssuer);
-	if( issuer_pk == NULL) {
-		LogError("malloc of TSS_DAA_PK_internal failed");
-		result = TSPERR(TSS_E_OUTOFMEMORY);
-		goto close;
-	}
 	// allocation of signature
-	signature = e_2_i_TSS_DAA_SIGNATURE( &signature_ext);
+	signature = e_2_i_TSS_DAA_SIGNATURE( signature_ext);
 	if( signature == NULL) {
 		LogError("malloc of TSS_DAA_SIGNATURE_internal failed");
 		result = TSPERR(TSS_E_OUTOFMEMORY);
 		goto close;
 	}
-	commitments = signature_ext.attributeCommitments;
+	commitments = signature_ext->attributeCommitments;
 	// TODO verify consistency of sig.getSA() with selectedAttributes,..
 	sA = signature->sA;
 	if( sA->length != (int)attributesLength) {
@@ -483,8 +472,7 @@ TSPICALL Tspi_DAA_VerifySignature_internal
 	n = issuer_pk->modulus;
 	c = bi_set_as_nbin( signature->challenge_length, signature->challenge);
 	capital_gamma = issuer_pk->capitalGamma;
-	if( base_name != NULL) { // isRandomBaseName
-		zeta_2_verify = compute_zeta( base_nameLength, base_name, issuer_pk);
+	if( zeta_2_verify != NULL) { // isRandomBaseName
 		if( bi_equals( signature->zeta, zeta_2_verify) == 0) {
 			LogError("Verifier Error: Verification of zeta failed - Step 1");
 			result = TSS_E_INTERNAL_ERROR;
@@ -500,7 +488,13 @@ TSPICALL Tspi_DAA_VerifySignature_internal
 		result = TSPERR(TSS_E_OUTOFMEMORY);
 		goto close;
 	}
-	bi_set( product_r, bi_1); // product_r = 1
+	hidden_sA = (bi_ptr *)calloc( attributesLength + 1, sizeof( bi_ptr));
+	attribute_values = (bi_ptr *)calloc( attributesLength + 1, sizeof( bi_ptr));
+	if( hidden_sA == NULL || attribute_values == NULL) {
+		LogError("malloc of %d bytes failed", (attributesLength + 1) * sizeof( bi_ptr));
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
 	for( i=0; i<(int)attributesLength; i++) {
 		if( attributes[i] != NULL) {
 			 // allocation
@@ -510,15 +504,15 @@ TSPICALL Tspi_DAA_VerifySignature_internal
 				result = TSPERR(TSS_E_OUTOFMEMORY);
 				goto close;
 			}
-			// tmp1 = (capital_R[i] ^ attributes[i]) mod n
-			bi_mod_exp( tmp1, capital_R->array[i], attribute_i, n);
-			// product_r = product_r * tmp1
-			bi_mul( product_r, product_r, tmp1);
-			// product_r = product_r mod n
-			bi_mod( product_r, product_r, n);
-			bi_free_ptr( attribute_i);
+			attribute_values[i] = attribute_i;
 		}
 	}
+	// product_r = prod( capital_R[i] ^ attributes[i]) mod n, over the revealed attributes
+	if( DAA_PK_fixed_base_exp( product_r, issuer_pk, NULL, NULL, NULL,
+					attributesLength, attribute_values) == NULL) {
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
 	exp = bi_new_ptr();
 	if( exp == NULL) {
 		LogError("malloc of BI <%s> failed", "product_r");
@@ -533,45 +527,30 @@ TSPICALL Tspi_DAA_VerifySignature_internal
 	// capital_THat = capital_THat % n
 	bi_mod( capital_THat, capital_THat, n);
 	// capital_THat = (capital_THat ^ (-c)) mod n = ( 1 / (capital_That ^ c) ) % n
-	bi_mod_exp( capital_THat, capital_THat, c, n);
+	DAA_PK_mod_exp( capital_THat, issuer_pk, capital_THat, c);
 	bi_invert_mod( capital_THat, capital_THat, n);
 	// tmp1 = c << (SizeExponentCertificate - 1)
 	bi_shift_left( tmp1, c, DAA_PARAM_SIZE_EXPONENT_CERTIFICATE - 1);
 	// exp = signature->sE + tmp1
 	bi_add( exp, signature->sE, tmp1);
 	// tmp1 = (signature->capitalT ^ exp) mod n
-	bi_mod_exp( tmp1, signature->capitalT, exp, n);
-	//  capital_THat = ( capital_THat * tmp1 ) % n
-	bi_mul( capital_THat, capital_THat, tmp1);
-	bi_mod( capital_THat, capital_THat, n);
-	// tmp1=( issuer_pk->capitalR0 ^ signature->sF0) %  n
-	bi_mod_exp( tmp1, issuer_pk->capitalR0, signature->sF0, n);
+	DAA_PK_mod_exp( tmp1, issuer_pk, signature->capitalT, exp);
 	//  capital_THat = ( capital_THat * tmp1 ) % n
 	bi_mul( capital_THat, capital_THat, tmp1);
 	bi_mod( capital_THat, capital_THat, n);
-	// tmp1=( issuer_pk->capitalR1 ^ signature->sF1) %  n
-	bi_mod_exp( tmp1, issuer_pk->capitalR1, signature->sF1, n);
-	//  capital_THat = ( capital_THat * tmp1 ) % n
-	bi_mul( capital_THat, capital_THat, tmp1);
-	bi_mod( capital_THat, capital_THat, n);
-	// tmp1=( issuer_pk->capitalS ^ signature->sV) %  n
-	bi_mod_exp( tmp1, issuer_pk->capitalS, signature->sV, n);
+	// tmp1 = ( issuer_pk->capitalS ^ signature->sV * issuer_pk->capitalR0 ^ signature->sF0 *
+	//	issuer_pk->capitalR1 ^ signature->sF1 * prod( capital_R[i] ^ sA[i])) mod n,
+	//	over the attributes not revealed, with the issuer key's fixed base tables
+	for( i=0; i<(int)attributesLength; i++)
+		hidden_sA[i] = attributes[i] == NULL ? sA->array[i] : NULL;
+	if( DAA_PK_fixed_base_exp( tmp1, issuer_pk, signature->sV, signature->sF0,
+					signature->sF1, attributesLength, hidden_sA) == NULL) {
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto close;
+	}
 	//  capital_THat = ( capital_THat * tmp1 ) % n
 	bi_mul( capital_THat, capital_THat, tmp1);
 	bi_mod( capital_THat, capital_THat, n);
-
-	bi_set( product_r, bi_1);	// product_r = 1
-	for( i=0; i<(int)attributesLength; i++) {
-		if( attributes[i] == NULL) {
-			// tmp1=(capital_R->array[i] ^ sA->array[i]) %  n
-			bi_mod_exp( tmp1, capital_R->array[i], sA->array[i], n);
-			//  product_r = ( product_r * tmp1 ) % n
-			bi_mul( product_r, product_r, tmp1);
-			bi_mod( product_r, product_r, n);
-		}
-	}
-	// capital_THat = (capital_THat * product_r) % n
-	bi_mod( capital_THat, bi_mul( tmp1, capital_THat, product_r), n);
 	LogDebug("Step 3 - Commitments");
 
 	//TODO when enabling the commitment feature, verifier_transaction should be set
@@ -661,20 +640,20 @@ and issuer_pk are not consistent (%d)\n",
 	bi_add( exp, signature->sF0, tmp1);
 	pseudonym_projected = bi_new_ptr();
 	// pseudonym_projected = (signature->zeta ^ exp) % capital_gamma
-	bi_mod_exp( pseudonym_projected, signature->zeta, exp, capital_gamma);
+	DAA_PK_gamma_mod_exp( pseudonym_projected, issuer_pk, signature->zeta, exp);
 	pseudonym_enc = NULL;
 	pseudonym_encryption_proof = NULL;
 	//TODO when enabling the commitment feature, verifier_transaction should be set
 	if( verifier_transaction == NULL ||
 		verifier_transaction->is_anonymity_revocation_enabled ==0) {
 		// anonymity revocation not enabled
-		pseudonym_plain = (TSS_DAA_PSEUDONYM_PLAIN *)signature_ext.signedPseudonym;
+		pseudonym_plain = (TSS_DAA_PSEUDONYM_PLAIN *)signature_ext->signedPseudonym;
 		capital_nv = bi_set_as_nbin( pseudonym_plain->capitalNvLength,
 							pseudonym_plain->capitalNv);
 //TODO
 		// capital_ntilde_v = ( capital_nv ^ ( - c) ) % capital_gamma
 		//		= ( 1 / (capital_nv ^ c) % capital_gamma) % capital_gamma
-		bi_mod_exp( tmp1, capital_nv, c, capital_gamma);
+		DAA_PK_gamma_mod_exp( tmp1, issuer_pk, capital_nv, c);
 		bi_invert_mod( capital_ntilde_v, tmp1, capital_gamma);
 		// capital_ntilde_v = ( capital_ntilde_v * pseudonym_projected ) % capital_gamma
 		bi_mul(capital_ntilde_v, capital_ntilde_v, pseudonym_projected);
@@ -748,10 +727,10 @@ and issuer_pk are not consistent (%d)\n",
 	LogDebug("calculation of c: nonce_tpm[%d]%s",
 			signature->nonce_tpm_length,
 			dump_byte_array( signature->nonce_tpm_length, signature->nonce_tpm));
-	LogDebug("calculation of c: sign_data.payloadFlag[%d]%x", 1, sign_data.payloadFlag);
+	LogDebug("calculation of c: sign_data.payloadFlag[%d]%x", 1, sign_data->payloadFlag);
 	LogDebug("calculation of c: signdata.payload[%d]%s",
-			sign_data.payloadLength,
-			dump_byte_array( sign_data.payloadLength, sign_data.payload));
+			sign_data->payloadLength,
+			dump_byte_array( sign_data->payloadLength, sign_data->payload));
 	mdctx = EVP_MD_CTX_create();
 	EVP_DigestInit_ex(mdctx, DAA_PARAM_get_message_digest(), NULL);
 	EVP_DigestUpdate(mdctx, ch, length_ch);
@@ -766,8 +745,8 @@ and issuer_pk are not consistent (%d)\n",
 	EVP_DigestFinal_ex(mdctx, hash, NULL);
 	EVP_DigestInit_ex(mdctx, DAA_PARAM_get_message_digest(), NULL);
 	EVP_DigestUpdate(mdctx, hash, EVP_MD_size( DAA_PARAM_get_message_digest()));
-	EVP_DigestUpdate(mdctx, &sign_data.payloadFlag, 1);
-	EVP_DigestUpdate(mdctx,  sign_data.payload, sign_data.payloadLength);
+	EVP_DigestUpdate(mdctx, &sign_data->payloadFlag, 1);
+	EVP_DigestUpdate(mdctx,  sign_data->payload, sign_data->payloadLength);
 	len_hash = EVP_MD_size( DAA_PARAM_get_message_digest());
 	free( hash);
 	hash = (BYTE *)malloc( len_hash);// allocation
@@ -793,7 +772,7 @@ and issuer_pk are not consistent (%d)\n",
 	if( verifier_transaction == NULL ||
 		 !verifier_transaction->is_anonymity_revocation_enabled) {
 		// Nv element <gamma> ?
-		if( !is_element_gamma( capital_nv, issuer_pk)	) {
+		if( !is_element_gamma( capital_nv, issuer_pk)) {
 			LogError( "Verification of Nv failed - Step 4.b.i");
 			result = TSS_E_INTERNAL_ERROR;
 			goto close;
@@ -810,7 +789,7 @@ and issuer_pk are not consistent (%d)\n",
 		}
 	}
 	// zeta element <gamma>
-	if( !is_element_gamma( signature->zeta, issuer_pk)) {
+	if( !zeta_tested && !is_element_gamma( signature->zeta, issuer_pk)) {
 		LogError( "Verification of zeta failed - Step 4.b/c.i");
 		result = TSS_E_INTERNAL_ERROR;
 		goto close;
@@ -846,19 +825,22 @@ and issuer_pk are not consistent (%d)\n",
 	// TODO: implement revocation list
 	*isCorrect = TRUE;
 close:
-	EVP_MD_CTX_destroy(mdctx);
-	bi_free_ptr( tmp1);
+	if( mdctx != NULL) EVP_MD_CTX_destroy(mdctx);
+	FREE_BI( tmp1);
 	if( ch != NULL) free( ch);
 	if( hash != NULL) free( hash);
-	free_TSS_DAA_PK_internal( issuer_pk);
-	free_TSS_DAA_SIGNATURE_internal( signature);
+	if( signature != NULL) free_TSS_DAA_SIGNATURE_internal( signature);
 	// n not allocated, refere to issuer_pk->modulus
 	FREE_BI( c);
 	// capital_gamma not allocated, refere to issuer_pk->capitalGamma
-	FREE_BI( zeta_2_verify);
 	// capital_z not allocated, refere to issuer_pk->capitalZ
 	// capital_R not allocated, refere to issuer_pk->capitalY
 	FREE_BI( product_r);
+	if( attribute_values != NULL) {
+		for( i=0; i<(int)attributesLength; i++) FREE_BI( attribute_values[i]);
+		free( attribute_values);
+	}
+	free( hidden_sA);
 	FREE_BI( exp);
 	FREE_BI( capital_THat);
 	// beta_tilde kept on TSS_DAA_ATTRIB_COMMIT
@@ -873,3 +855,122 @@ close:
 	// delta_tilde4 kept on CS_ENCRYPTION_RESULT
 	return result;
 }
+
+/* implementation  derived from isValid (VerifierTransaction.java) */
+TSPICALL Tspi_DAA_VerifySignature_internal
+(	TSS_HDAA hDAA,	// in
+	TSS_DAA_SIGNATURE signature_ext, // in
+	TSS_HKEY hPubKeyIssuer,	// in
+	TSS_DAA_SIGN_DATA sign_data,	// in
+	UINT32 attributesLength,	// in
+	BYTE **attributes,	// in
+	UINT32 nonce_verifierLength,	// out
+	BYTE *nonce_verifier,	// out
+	UINT32 base_nameLength,	// out
+	BYTE *base_name,	// out
+	TSS_BOOL *isCorrect	// out
+) {
+	TSS_DAA_PK_internal *issuer_pk = NULL;
+	bi_ptr zeta_2_verify = NULL;
+	TCS_CONTEXT_HANDLE tcsContext;
+	TSS_RESULT result;
+
+	*isCorrect = FALSE;
+	if( (result = obj_daa_get_tsp_context( hDAA, &tcsContext)) != TSS_SUCCESS)
+		return result;
+	// allocation of issuer_pk
+	issuer_pk = e_2_i_TSS_DAA_PK( (TSS_DAA_PK *)hPubKeyIssuer);
+	if( issuer_pk == NULL) {
+		LogError("malloc of TSS_DAA_PK_internal failed");
+		return TSPERR(TSS_E_OUTOFMEMORY);
+	}
+	if( base_name != NULL) { // isRandomBaseName
+		zeta_2_verify = compute_zeta( base_nameLength, base_name, issuer_pk);
+		if( zeta_2_verify == NULL) {
+			LogError("malloc of BI <%s> failed", "zeta_2_verify");
+			result = TSPERR(TSS_E_OUTOFMEMORY);
+			goto close;
+		}
+	}
+	result = verify_signature( issuer_pk, &signature_ext, &sign_data, attributesLength,
+				attributes, nonce_verifierLength, nonce_verifier,
+				zeta_2_verify, FALSE, isCorrect);
+close:
+	FREE_BI( zeta_2_verify);
+	free_TSS_DAA_PK_internal( issuer_pk);
+	return result;
+}
+
+/* Verifies signaturesLength signatures made under the same issuer key and base name, entry i
+ * of signatures, sign_data, attributes, nonce_verifierLength and nonce_verifier belonging to
+ * signature i. isCorrect[i] tells whether signature i is valid, an invalid signature doesn't
+ * make the others fail. The issuer key is converted and zeta computed and tested once for the
+ * whole batch. The rest is verified signature by signature: the Fiat-Shamir challenge hashes
+ * T-hat and Ntilde_v, and the tests of Nv (and zeta for a random base name) being elements of
+ * <gamma> can't be batched soundly with small exponents, since capitalGamma - 1 = rho * r with
+ * an even cofactor r lets an element with an order 2 part outside <gamma> pass such a batch
+ * half of the time. */
+TSPICALL Tspi_DAA_VerifySignatures_internal
+(	TSS_HDAA hDAA,	// in
+	UINT32 signaturesLength,	// in
+	TSS_DAA_SIGNATURE *signatures,	// in
+	TSS_HKEY hPubKeyIssuer,	// in
+	TSS_DAA_SIGN_DATA *sign_data,	// in
+	UINT32 attributesLength,	// in
+	BYTE ***attributes,	// in
+	UINT32 *nonce_verifierLength,	// in
+	BYTE **nonce_verifier,	// in
+	UINT32 base_nameLength,	// in
+	BYTE *base_name,	// in
+	TSS_BOOL *isCorrect	// out
+) {
+	TSS_DAA_PK_internal *issuer_pk = NULL;
+	bi_ptr zeta_2_verify = NULL;
+	TCS_CONTEXT_HANDLE tcsContext;
+	TSS_RESULT result;
+	UINT32 i;
+
+	for( i=0; i<signaturesLength; i++)
+		isCorrect[i] = FALSE;
+	if( (result = obj_daa_get_tsp_context( hDAA, &tcsContext)) != TSS_SUCCESS)
+		return result;
+	if( signaturesLength == 0)
+		return TSS_SUCCESS;
+	// allocation of issuer_pk
+	issuer_pk = e_2_i_TSS_DAA_PK( (TSS_DAA_PK *)hPubKeyIssuer);
+	if( issuer_pk == NULL) {
+		LogError("malloc of TSS_DAA_PK_internal failed");
+		return TSPERR(TSS_E_OUTOFMEMORY);
+	}
+	if( base_name != NULL) { // isRandomBaseName
+		zeta_2_verify = compute_zeta( base_nameLength, base_name, issuer_pk);
+		if( zeta_2_verify == NULL) {
+			LogError("malloc of BI <%s> failed", "zeta_2_verify");
+			result = TSPERR(TSS_E_OUTOFMEMORY);
+			goto close;
+		}
+		// every signature has to carry this zeta
+		if( !is_element_gamma( zeta_2_verify, issuer_pk)) {
+			LogError( "Verification of zeta failed - Step 4.b/c.i");
+			goto close;
+		}
+	}
+	for( i=0; i<signaturesLength; i++) {
+		result = verify_signature( issuer_pk, &signatures[i], &sign_data[i],
+					attributesLength, attributes[i],
+					nonce_verifierLength[i], nonce_verifier[i],
+					zeta_2_verify, base_name != NULL, &isCorrect[i]);
+		if( result == TSPERR(TSS_E_OUTOFMEMORY))
+			goto close;
+		// any other failure only rejects this signature
+		result = TSS_SUCCESS;
+	}
+close:
+	if( result != TSS_SUCCESS) {
+		for( i=0; i<signaturesLength; i++)
+			isCorrect[i] = FALSE;
+	}
+	FREE_BI( zeta_2_verify);
+	free_TSS_DAA_PK_internal( issuer_pk);
+	return result;
+}
@@ -39,11 +39,15 @@ NVSTORE_LIST_DECLARE;
 DELFAMILY_LIST_DECLARE;
 MIGDATA_LIST_DECLARE;
 
+#define obj_list_bucket(list, handle)	((list)->buckets[(handle) & (OBJ_LIST_BUCKETS - 1)])
+
 static void
 tspi_list_init(struct obj_list *list)
 {
 	list->head = NULL;
+	memset(list->buckets, 0, sizeof(list->buckets));
 	MUTEX_INIT(list->lock);
+	pthread_key_create(&list->held, NULL);
 }
 
 void
@@ -79,8 +83,81 @@ obj_get_next_handle()
 	return nextObjectHandle;
 }
 
+/* drop a reference to @obj, freeing it if it was the last. The list holds one reference
+ * for as long as the object is on it */
+static void
+obj_unref(struct obj_list *list, struct tsp_object *obj)
+{
+	UINT32 refs;
+
+	MUTEX_LOCK(list->lock);
+	refs = --obj->refs;
+	MUTEX_UNLOCK(list->lock);
+
+	if (refs == 0)
+		free(obj);
+}
+
+/* take a reference to @obj, which must be on the list, unlock the list and wait for the
+ * object. Returns NULL if the object was removed while waiting for it */
+static struct tsp_object *
+obj_list_acquire(struct obj_list *list, struct tsp_object *obj)
+{
+	obj->refs++;
+	MUTEX_UNLOCK(list->lock);
+
+	MUTEX_LOCK(obj->lock);
+	if (obj->removed) {
+		MUTEX_UNLOCK(obj->lock);
+		obj_unref(list, obj);
+		return NULL;
+	}
+
+	pthread_setspecific(list->held, obj);
+
+	return obj;
+}
+
+/* take @obj off the list so that no new lookups find it. The list must be locked, and
+ * the list's reference passes to the caller */
+static void
+obj_list_unlink(struct obj_list *list, struct tsp_object *obj)
+{
+	struct tsp_object **pobj;
+
+	for (pobj = &list->head; *pobj; pobj = &(*pobj)->next) {
+		if (*pobj == obj) {
+			*pobj = obj->next;
+			break;
+		}
+	}
+
+	for (pobj = &obj_list_bucket(list, obj->handle); *pobj; pobj = &(*pobj)->hash_next) {
+		if (*pobj == obj) {
+			*pobj = obj->hash_next;
+			break;
+		}
+	}
+
+	obj->next = NULL;
+	obj->hash_next = NULL;
+}
+
+/* free an unlinked object's data once anyone using it is done with it */
+static void
+obj_list_destroy(struct obj_list *list, struct tsp_object *obj, void (*freeFcn)(void *))
+{
+	MUTEX_LOCK(obj->lock);
+	(*freeFcn)(obj->data);
+	obj->data = NULL;
+	obj->removed = TRUE;
+	MUTEX_UNLOCK(obj->lock);
+
+	obj_unref(list, obj);
+}
+
 /* search through the provided list for an object with handle matching
- * @handle. If found, return a pointer to the object with the list
+ * @handle. If found, return a pointer to the object with the object
  * locked, else return NULL.  To release the lock, caller should
  * call obj_list_put() after manipulating the object.
  */
@@ -91,20 +168,22 @@ obj_list_get_obj(struct obj_list *list, UINT32 handle)
 
 	MUTEX_LOCK(list->lock);
 
-	for (obj = list->head; obj; obj = obj->next) {
+	for (obj = obj_list_bucket(list, handle); obj; obj = obj->hash_next) {
 		if (obj->handle == handle)
 			break;
 	}
 
-	if (obj == NULL)
+	if (obj == NULL) {
 		MUTEX_UNLOCK(list->lock);
+		return NULL;
+	}
 
-	return obj;
+	return obj_list_acquire(list, obj);
 }
 
 /* search through the provided list for an object with TSP context
  * matching @tspContext. If found, return a pointer to the object
- * with the list locked, else return NULL.  To release the lock,
+ * with the object locked, else return NULL.  To release the lock,
  * caller should call obj_list_put() after manipulating the object.
  */
 struct tsp_object *
@@ -119,21 +198,36 @@ obj_list_get_tspcontext(struct obj_list *list, UINT32 tspContext)
 			break;
 	}
 
-	return obj;
+	if (obj == NULL) {
+		MUTEX_UNLOCK(list->lock);
+		return NULL;
+	}
+
+	return obj_list_acquire(list, obj);
 }
 
-/* release a list whose handle was returned by obj_list_get_obj() */
+/* release an object returned by obj_list_get_obj(). A thread only ever has one object
+ * from a list at a time, so the list is enough to find it */
 void
 obj_list_put(struct obj_list *list)
 {
-	MUTEX_UNLOCK(list->lock);
+	struct tsp_object *obj = pthread_getspecific(list->held);
+
+	if (obj == NULL) {
+		LogDebugFn("No object held from this list");
+		return;
+	}
+
+	pthread_setspecific(list->held, NULL);
+	MUTEX_UNLOCK(obj->lock);
+	obj_unref(list, obj);
 }
 
 TSS_RESULT
 obj_list_add(struct obj_list *list, UINT32 tsp_context, TSS_FLAG flags, void *data,
 	     TSS_HOBJECT *phObject)
 {
-        struct tsp_object *new_obj, *tmp;
+        struct tsp_object *new_obj;
 
         new_obj = calloc(1, sizeof(struct tsp_object));
         if (new_obj == NULL) {
@@ -144,6 +238,8 @@ obj_list_add(struct obj_list *list, UINT32 tsp_context, TSS_FLAG flags, void *da
         new_obj->handle = obj_get_next_handle();
 	new_obj->flags = flags;
         new_obj->data = data;
+	new_obj->refs = 1;
+	MUTEX_INIT(new_obj->lock);
 
 	if (list == &context_list)
 		new_obj->tspContext = new_obj->handle;
@@ -152,13 +248,10 @@ obj_list_add(struct obj_list *list, UINT32 tsp_context, TSS_FLAG flags, void *da
 
         MUTEX_LOCK(list->lock);
 
-        if (list->head == NULL) {
-                list->head = new_obj;
-        } else {
-                tmp = list->head;
-                list->head = new_obj;
-                new_obj->next = tmp;
-        }
+	new_obj->next = list->head;
+	list->head = new_obj;
+	new_obj->hash_next = obj_list_bucket(list, new_obj->handle);
+	obj_list_bucket(list, new_obj->handle) = new_obj;
 
         MUTEX_UNLOCK(list->lock);
 
@@ -170,25 +263,20 @@ obj_list_add(struct obj_list *list, UINT32 tsp_context, TSS_FLAG flags, void *da
 TSS_RESULT
 obj_list_remove(struct obj_list *list, void (*freeFcn)(void *), TSS_HOBJECT hObject, TSS_HCONTEXT tspContext)
 {
-	struct tsp_object *obj, *prev = NULL;
+	struct tsp_object *obj;
 
 	MUTEX_LOCK(list->lock);
 
-	for (obj = list->head; obj; prev = obj, obj = obj->next) {
+	for (obj = obj_list_bucket(list, hObject); obj; obj = obj->hash_next) {
 		if (obj->handle == hObject) {
 			/* validate tspContext */
 			if (obj->tspContext != tspContext)
 				break;
 
-			(*freeFcn)(obj->data);
-
-			if (prev)
-				prev->next = obj->next;
-			else
-				list->head = obj->next;
-			free(obj);
-
+			obj_list_unlink(list, obj);
 			MUTEX_UNLOCK(list->lock);
+
+			obj_list_destroy(list, obj, freeFcn);
 			return TSS_SUCCESS;
 		}
 	}
@@ -205,32 +293,25 @@ obj_list_close(struct obj_list *list, void (*freeFcn)(void *), TSS_HCONTEXT tspC
 {
 	struct tsp_object *index;
 	struct tsp_object *next = NULL;
-	struct tsp_object *toKill;
-	struct tsp_object *prev = NULL;
+	struct tsp_object *toKill = NULL;
 
 	MUTEX_LOCK(list->lock);
 
-	for (index = list->head; index; ) {
+	for (index = list->head; index; index = next) {
 		next = index->next;
 		if (index->tspContext == tspContext) {
+			obj_list_unlink(list, index);
+			index->next = toKill;
 			toKill = index;
-			if (prev == NULL) {
-				list->head = toKill->next;
-			} else {
-				prev->next = toKill->next;
-			}
-
-			(*freeFcn)(toKill->data);
-			free(toKill);
-
-			index = next;
-		} else {
-			prev = index;
-			index = next;
 		}
 	}
 
 	MUTEX_UNLOCK(list->lock);
+
+	for (index = toKill; index; index = next) {
+		next = index->next;
+		obj_list_destroy(list, index, freeFcn);
+	}
 }
 
 void
@@ -276,9 +357,11 @@ obj_tcskey_get_pubkeyhash(TCS_KEY_HANDLE hKey, BYTE *pubKeyHash)
 	MUTEX_LOCK(list->lock);
 
 	for (obj = list->head; obj; obj = obj->next) {
+		MUTEX_LOCK(obj->lock);
 		rsakey = (struct tr_rsakey_obj *)obj->data;
 		if (rsakey->tcsHandle == hKey)
 			break;
+		MUTEX_UNLOCK(obj->lock);
 	}
 
 	if (obj == NULL || rsakey == NULL) {
@@ -291,6 +374,7 @@ obj_tcskey_get_pubkeyhash(TCS_KEY_HANDLE hKey, BYTE *pubKeyHash)
 	if ((result |= Trspi_HashFinal(&hashCtx, pubKeyHash)))
 		result = TSPERR(TSS_E_INTERNAL_ERROR);
 
+	MUTEX_UNLOCK(obj->lock);
 	MUTEX_UNLOCK(list->lock);
 
 	return result;
@@ -99,6 +99,9 @@ __tspi_obj_context_free(void *data)
 {
 	struct tr_context_obj *context = (struct tr_context_obj *)data;
 
+#ifdef TSS_BUILD_TRANSPORT
+	Trspi_HMAC_KeyFree(&context->transSecretKey);
+#endif
 	free(context->machineName);
 	free(context);
 }
@@ -134,6 +137,7 @@ obj_context_close(TSS_HCONTEXT tspContext)
 
 		__tspi_memset(&context->transPub, 0, sizeof(TPM_TRANSPORT_PUBLIC));
 		__tspi_memset(&context->transMod, 0, sizeof(TPM_MODIFIER_INDICATOR));
+		Trspi_HMAC_KeyFree(&context->transSecretKey);
 		__tspi_memset(&context->transSecret, 0, sizeof(TPM_TRANSPORT_AUTH));
 		__tspi_memset(&context->transAuth, 0, sizeof(TPM_AUTH));
 		__tspi_memset(&context->transLogIn, 0, sizeof(TPM_TRANSPORT_LOG_IN));
@@ -354,9 +358,11 @@ obj_context_has_popups(TSS_HCONTEXT tspContext)
 
 	for (obj = list->head; obj; obj = obj->next) {
 		if (obj->tspContext == tspContext) {
+			MUTEX_LOCK(obj->lock);
 			policy = (struct tr_policy_obj *)obj->data;
 			if (policy->SecretMode == TSS_SECRET_MODE_POPUP)
 				ret = TRUE;
+			MUTEX_UNLOCK(obj->lock);
 			break;
 		}
 	}
@@ -714,6 +720,46 @@ done:
 	return result;
 }
 
+/* Every command wrapped in a transport session is authorized with the session secret and
+ * its response checked with it, so the secret's HMAC key schedule is set up on first use
+ * and kept until the session ends */
+static TSS_RESULT
+transport_hmac(struct tr_context_obj *context, BYTE *digest, TPM_AUTH *auth, BYTE *hmacOut)
+{
+	TSS_RESULT result;
+	UINT64 offset;
+	BYTE blob[61];
+
+	if (context->transSecretKey.inner == NULL &&
+	    (result = Trspi_HMAC_KeyInit(&context->transSecretKey, TPM_SHA1_160_HASH_LEN,
+					 context->transSecret.authData.authdata)))
+		return result;
+
+	offset = 0;
+	LoadBlob_AuthHmacData(&offset, blob, digest, auth);
+
+	return Trspi_HMAC_Keyed(&context->transSecretKey, offset, blob, hmacOut);
+}
+
+static TSS_BOOL
+transport_validate_auth(struct tr_context_obj *context, BYTE *digest, TPM_AUTH *auth)
+{
+	BYTE hmac[TPM_SHA1_160_HASH_LEN];
+
+	/* auth is expected to have both nonces and the digest from the TPM */
+	if (transport_hmac(context, digest, auth, hmac))
+		return TRUE;
+
+	return ((TSS_BOOL) (memcmp(hmac, &auth->HMAC, sizeof(hmac)) != 0));
+}
+
+static void
+transport_free_secret(struct tr_context_obj *context)
+{
+	Trspi_HMAC_KeyFree(&context->transSecretKey);
+	__tspi_memset(&context->transSecret, 0, sizeof(TPM_TRANSPORT_AUTH));
+}
+
 TSS_RESULT
 obj_context_transport_establish(TSS_HCONTEXT tspContext, struct tr_context_obj *context)
 {
@@ -734,6 +780,7 @@ obj_context_transport_establish(TSS_HCONTEXT tspContext, struct tr_context_obj *
 
 
 	context->transPub.tag = TPM_TAG_TRANSPORT_PUBLIC;
+	transport_free_secret(context);
 	context->transSecret.tag = TPM_TAG_TRANSPORT_AUTH;
 
 	if ((result = get_local_random(tspContext, FALSE, TPM_SHA1_160_HASH_LEN,
@@ -1202,7 +1249,9 @@ obj_context_transport_execute(TSS_HCONTEXT     tspContext,
 	}
 
 	/* TPM Commands spec rev106 step 7.b */
-	HMAC_Auth(context->transSecret.authData.authdata, etDigest.digest, pTransAuth);
+	if ((result = transport_hmac(context, etDigest.digest, pTransAuth,
+				     (BYTE *)&pTransAuth->HMAC)))
+		goto done;
 
 	if ((result = RPC_ExecuteTransport(tspContext, ordinal, encLen, pEnc, handlesLen, handles,
 					   pAuth1, pAuth2, pTransAuth, &currentTicks,
@@ -1277,8 +1326,7 @@ obj_context_transport_execute(TSS_HCONTEXT     tspContext,
 	if ((result |= Trspi_HashFinal(&hashCtx, etDigest.digest)))
 		goto done;
 
-	if (validateReturnAuth(context->transSecret.authData.authdata, etDigest.digest,
-			       pTransAuth)) {
+	if (transport_validate_auth(context, etDigest.digest, pTransAuth)) {
 		result = TSPERR(TSS_E_TSP_TRANS_AUTHFAIL);
 		goto done;
 	}
@@ -1364,7 +1412,9 @@ obj_context_transport_close(TSS_HCONTEXT   tspContext,
 		pAuth = NULL;
 
 	/* continue the auth session established in obj_context_transport_establish */
-	HMAC_Auth(context->transSecret.authData.authdata, digest.digest, &context->transAuth);
+	if ((result = transport_hmac(context, digest.digest, &context->transAuth,
+				     (BYTE *)&context->transAuth.HMAC)))
+		goto done;
 
 	if ((result = RPC_ReleaseTransportSigned(tspContext, tcsKey, &signInfo->replay, pAuth,
 						 &context->transAuth,
@@ -1389,8 +1439,7 @@ obj_context_transport_close(TSS_HCONTEXT   tspContext,
 	}
 
 	/* validate again using the transport session's auth */
-	if ((result = validateReturnAuth(context->transSecret.authData.authdata, digest.digest,
-					 &context->transAuth))) {
+	if ((result = transport_validate_auth(context, digest.digest, &context->transAuth))) {
 		result = TSPERR(TSS_E_TSP_TRANS_AUTHFAIL);
 		goto done_disabled;
 	}
@@ -1430,7 +1479,7 @@ obj_context_transport_close(TSS_HCONTEXT   tspContext,
 	/* destroy all transport session info, except the key handle */
 	__tspi_memset(&context->transPub, 0, sizeof(TPM_TRANSPORT_PUBLIC));
 	__tspi_memset(&context->transMod, 0, sizeof(TPM_MODIFIER_INDICATOR));
-	__tspi_memset(&context->transSecret, 0, sizeof(TPM_TRANSPORT_AUTH));
+	transport_free_secret(context);
 	__tspi_memset(&context->transAuth, 0, sizeof(TPM_AUTH));
 	__tspi_memset(&context->transLogIn, 0, sizeof(TPM_TRANSPORT_LOG_IN));
 	__tspi_memset(&context->transLogOut, 0, sizeof(TPM_TRANSPORT_LOG_OUT));
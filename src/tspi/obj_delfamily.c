@@ -106,11 +106,14 @@ obj_delfamily_find_by_familyid(TSS_HOBJECT hObject, UINT32 familyID, TSS_HDELFAM
 		if (obj->tspContext != hContext)
 			continue;
 
+		pthread_mutex_lock(&obj->lock);
 		delfamily = (struct tr_delfamily_obj *)obj->data;
-		if (delfamily->familyID == familyID) {
+		if (delfamily->familyID == familyID)
 			*hFamily = obj->handle;
+		pthread_mutex_unlock(&obj->lock);
+
+		if (*hFamily != NULL_HDELFAMILY)
 			break;
-		}
 	}
 
 	pthread_mutex_unlock(&list->lock);
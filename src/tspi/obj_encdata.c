@@ -442,9 +442,11 @@ obj_encdata_remove_policy_refs(TSS_HPOLICY hPolicy, TSS_HCONTEXT tspContext)
 		if (obj->tspContext != tspContext)
 			continue;
 
+		pthread_mutex_lock(&obj->lock);
 		encdata = (struct tr_encdata_obj *)obj->data;
 		if (encdata->usagePolicy == hPolicy)
 			encdata->usagePolicy = NULL_HPOLICY;
+		pthread_mutex_unlock(&obj->lock);
 	}
 
 	pthread_mutex_unlock(&list->lock);
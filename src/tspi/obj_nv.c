@@ -22,6 +22,11 @@
 #include "tsplog.h"
 #include "obj.h"
 
+/* Counts calls to obj_nvstore_invalidate_datapublic(), so that a TPM_NV_DATA_PUBLIC read
+ * while its index was being defined or released isn't kept */
+static MUTEX_DECLARE_INIT(nvstore_datapublic_lock);
+static UINT32 nvstore_datapublic_gen = 0;
+
 TSS_RESULT
 obj_nvstore_add(TSS_HCONTEXT tspContext, TSS_HOBJECT *phObject)
 {
@@ -60,6 +65,7 @@ nvstore_free(void *data)
 {
 	struct tr_nvstore_obj *nvstore = (struct tr_nvstore_obj *)data;
 
+	free(nvstore->dataPublic);
 	free(nvstore);
 }
 
@@ -101,6 +107,10 @@ obj_nvstore_set_index(TSS_HNVSTORE hNvstore, UINT32 index)
 
 	nvstore = (struct tr_nvstore_obj *)obj->data;
 
+	if (nvstore->nvIndex != index) {
+		free(nvstore->dataPublic);
+		nvstore->dataPublic = NULL;
+	}
 	nvstore->nvIndex = index;
 
 	obj_list_put(&nvstore_list);
@@ -184,6 +194,142 @@ obj_nvstore_set_permission(TSS_HNVSTORE hNvstore, UINT32 permission)
 	return result;
 }
 
+/* Copy the index's TPM_NV_DATA_PUBLIC to @nv_data_public. Only its bReadSTClear,
+ * bWriteSTClear and bWriteDefine flags change while the index is defined, so callers that
+ * don't look at those can pass @cached and skip asking the TPM again */
+static TSS_RESULT
+nvstore_get_datapublic(TSS_HNVSTORE hNvstore, TSS_BOOL cached, UINT32 *size,
+		       BYTE *nv_data_public)
+{
+	struct tsp_object *obj;
+	TSS_HCONTEXT  hContext;
+	TSS_HTPM hTpm;
+	TSS_RESULT result;
+	struct tr_nvstore_obj *nvstore;
+	UINT32 uiResultLen;
+	BYTE *pResult;
+	UINT32 i, nvIndex, gen;
+	TPM_BOOL defined_index = FALSE;
+
+	if ((obj = obj_list_get_obj(&nvstore_list, hNvstore)) == NULL)
+		return TSPERR(TSS_E_INVALID_HANDLE);
+
+	hContext = obj->tspContext;
+	nvstore = (struct tr_nvstore_obj *)obj->data;
+	nvIndex = nvstore->nvIndex;
+
+	if (cached && nvstore->dataPublic) {
+		if (nvstore->dataPublicSize > *size)
+			result = TSPERR(TSS_E_INTERNAL_ERROR);
+		else {
+			*size = nvstore->dataPublicSize;
+			memcpy(nv_data_public, nvstore->dataPublic, nvstore->dataPublicSize);
+			result = TSS_SUCCESS;
+		}
+		obj_list_put(&nvstore_list);
+		return result;
+	}
+
+	/* don't hold the object while waiting for the TPM */
+	obj_list_put(&nvstore_list);
+
+	MUTEX_LOCK(nvstore_datapublic_lock);
+	gen = nvstore_datapublic_gen;
+	MUTEX_UNLOCK(nvstore_datapublic_lock);
+
+	if ((result = obj_tpm_get(hContext, &hTpm)))
+		return result;
+
+	if ((result = Tspi_TPM_GetCapability(hTpm, TSS_TPMCAP_NV_LIST, 0,
+				 NULL, &uiResultLen, &pResult))) {
+		return result;
+	}
+
+	for (i = 0; i < uiResultLen/sizeof(UINT32); i++) {
+		if (nvIndex == Decode_UINT32(pResult + i * sizeof(UINT32))) {
+			defined_index = TRUE;
+			break;
+		}
+	}
+
+	free_tspi(hContext, pResult);
+
+	if (!defined_index)
+		return TSPERR(TPM_E_BADINDEX);
+
+	if ((result = Tspi_TPM_GetCapability(hTpm, TSS_TPMCAP_NV_INDEX,
+					     sizeof(UINT32), (BYTE *)(&nvIndex),
+					     &uiResultLen, &pResult))) {
+		LogDebug("get the index capability error");
+		return result;
+	}
+
+	if (uiResultLen > *size) {
+		free_tspi(hContext, pResult);
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+	}
+	*size = uiResultLen;
+	memcpy(nv_data_public, pResult, uiResultLen);
+	free_tspi(hContext, pResult);
+
+	/* keep it unless the index was changed or invalidated in the meantime */
+	if ((obj = obj_list_get_obj(&nvstore_list, hNvstore)) == NULL)
+		return TSS_SUCCESS;
+
+	nvstore = (struct tr_nvstore_obj *)obj->data;
+
+	MUTEX_LOCK(nvstore_datapublic_lock);
+	if (nvstore->nvIndex == nvIndex && gen == nvstore_datapublic_gen) {
+		BYTE *copy = malloc(uiResultLen);
+
+		if (copy) {
+			memcpy(copy, nv_data_public, uiResultLen);
+			free(nvstore->dataPublic);
+			nvstore->dataPublic = copy;
+			nvstore->dataPublicSize = uiResultLen;
+		}
+	}
+	MUTEX_UNLOCK(nvstore_datapublic_lock);
+
+	obj_list_put(&nvstore_list);
+
+	return TSS_SUCCESS;
+}
+
+TSS_RESULT
+obj_nvstore_get_datapublic(TSS_HNVSTORE hNvstore, UINT32 *size, BYTE *nv_data_public)
+{
+	return nvstore_get_datapublic(hNvstore, FALSE, size, nv_data_public);
+}
+
+/* forget what's known about @nvIndex after it was defined or released, or after an access
+ * to it failed, which could mean another process redefined it */
+void
+obj_nvstore_invalidate_datapublic(TPM_NV_INDEX nvIndex)
+{
+	struct obj_list *list = &nvstore_list;
+	struct tsp_object *obj;
+	struct tr_nvstore_obj *nvstore;
+
+	MUTEX_LOCK(nvstore_datapublic_lock);
+	nvstore_datapublic_gen++;
+	MUTEX_UNLOCK(nvstore_datapublic_lock);
+
+	MUTEX_LOCK(list->lock);
+
+	for (obj = list->head; obj; obj = obj->next) {
+		MUTEX_LOCK(obj->lock);
+		nvstore = (struct tr_nvstore_obj *)obj->data;
+		if (nvstore && nvstore->nvIndex == nvIndex) {
+			free(nvstore->dataPublic);
+			nvstore->dataPublic = NULL;
+		}
+		MUTEX_UNLOCK(obj->lock);
+	}
+
+	MUTEX_UNLOCK(list->lock);
+}
+
 TSS_RESULT
 obj_nvstore_get_permission_from_tpm(TSS_HNVSTORE hNvstore, UINT32 * permission)
 {
@@ -196,7 +342,7 @@ obj_nvstore_get_permission_from_tpm(TSS_HNVSTORE hNvstore, UINT32 * permission)
 	TSS_HCONTEXT tspContext;
 	TSS_RESULT result;
 
-	if((result = obj_nvstore_get_datapublic(hNvstore, &data_public_size, nv_data_public)))
+	if((result = nvstore_get_datapublic(hNvstore, TRUE, &data_public_size, nv_data_public)))
 		return result;
 
 	if ((result = obj_nvstore_get_tsp_context(hNvstore, &tspContext)))
@@ -295,68 +441,6 @@ obj_nvstore_get_policy(TSS_HNVSTORE hNvstore, UINT32 policyType, TSS_HPOLICY *ph
 	return result;
 }
 
-TSS_RESULT
-obj_nvstore_get_datapublic(TSS_HNVSTORE hNvstore, UINT32 *size, BYTE *nv_data_public)
-{
-	struct tsp_object *obj;
-	TSS_HCONTEXT  hContext;
-	TSS_HTPM hTpm;
-	TSS_RESULT result;
-	struct tr_nvstore_obj *nvstore;
-	UINT32 uiResultLen;
-	BYTE *pResult;
-	UINT32 i;
-	TPM_BOOL defined_index = FALSE;
-
-	if ((obj = obj_list_get_obj(&nvstore_list, hNvstore)) == NULL)
-		return TSPERR(TSS_E_INVALID_HANDLE);
-
-	hContext = obj->tspContext;
-	nvstore = (struct tr_nvstore_obj *)obj->data;
-
-	if ((result = obj_tpm_get(hContext, &hTpm)))
-		goto out;
-
-	if ((result = Tspi_TPM_GetCapability(hTpm, TSS_TPMCAP_NV_LIST, 0,
-				 NULL, &uiResultLen, &pResult))) {
-		goto out;
-	}
-
-	for (i = 0; i < uiResultLen/sizeof(UINT32); i++) {
-		if (nvstore->nvIndex == Decode_UINT32(pResult + i * sizeof(UINT32))) {
-			defined_index = TRUE;
-			break;
-		}
-	}
-
-	free_tspi(hContext, pResult);
-
-	if (!defined_index) {
-		result = TSPERR(TPM_E_BADINDEX);
-		goto out;
-	}
-
-	if ((result = Tspi_TPM_GetCapability(hTpm, TSS_TPMCAP_NV_INDEX,
-					     sizeof(UINT32), (BYTE *)(&(nvstore->nvIndex)),
-					     &uiResultLen, &pResult))) {
-		LogDebug("get the index capability error");
-		goto out;
-	}
-
-	if (uiResultLen > *size) {
-		free_tspi(hContext, pResult);
-		result = TSPERR(TSS_E_INTERNAL_ERROR);
-		goto out;
-	}
-	*size = uiResultLen;
-	memcpy(nv_data_public, pResult, uiResultLen);
-	free_tspi(hContext, pResult);
-
-out:
-	obj_list_put(&nvstore_list);
-	return result;
-}
-
 TSS_RESULT
 obj_nvstore_get_readdigestatrelease(TSS_HNVSTORE hNvstore, UINT32 *size, BYTE **data)
 {
@@ -367,7 +451,7 @@ obj_nvstore_get_readdigestatrelease(TSS_HNVSTORE hNvstore, UINT32 *size, BYTE **
 	TSS_HCONTEXT tspContext;
 	TSS_RESULT result;
 
-	if((result = obj_nvstore_get_datapublic(hNvstore, &data_public_size, nv_data_public)))
+	if((result = nvstore_get_datapublic(hNvstore, TRUE, &data_public_size, nv_data_public)))
 		return result;
 
 	if ((result = obj_nvstore_get_tsp_context(hNvstore, &tspContext)))
@@ -399,7 +483,7 @@ obj_nvstore_get_readpcrselection(TSS_HNVSTORE hNvstore, UINT32 *size, BYTE **dat
 	TSS_HCONTEXT tspContext;
 	TSS_RESULT result;
 
-	if((result = obj_nvstore_get_datapublic(hNvstore, &data_public_size, nv_data_public)))
+	if((result = nvstore_get_datapublic(hNvstore, TRUE, &data_public_size, nv_data_public)))
 		return result;
 
 	if ((result = obj_nvstore_get_tsp_context(hNvstore, &tspContext)))
@@ -431,7 +515,7 @@ obj_nvstore_get_writedigestatrelease(TSS_HNVSTORE hNvstore, UINT32 *size, BYTE *
 	TSS_HCONTEXT tspContext;
 	TSS_RESULT result;
 
-	if ((result = obj_nvstore_get_datapublic(hNvstore, &data_public_size, nv_data_public)))
+	if ((result = nvstore_get_datapublic(hNvstore, TRUE, &data_public_size, nv_data_public)))
 		return result;
 
 	if ((result = obj_nvstore_get_tsp_context(hNvstore, &tspContext)))
@@ -469,7 +553,7 @@ obj_nvstore_get_writepcrselection(TSS_HNVSTORE hNvstore, UINT32 *size, BYTE **da
 	TSS_HCONTEXT tspContext;
 	TSS_RESULT result;
 
-	if((result = obj_nvstore_get_datapublic(hNvstore, &data_public_size, nv_data_public)))
+	if((result = nvstore_get_datapublic(hNvstore, TRUE, &data_public_size, nv_data_public)))
 		return result;
 
 	if ((result = obj_nvstore_get_tsp_context(hNvstore, &tspContext)))
@@ -605,7 +689,7 @@ obj_nvstore_get_readlocalityatrelease(TSS_HNVSTORE hNvstore, UINT32 * readlocali
 	TPM_LOCALITY_SELECTION locality_value;
 	TSS_RESULT result;
 
-	if ((result = obj_nvstore_get_datapublic(hNvstore, &data_public_size, nv_data_public)))
+	if ((result = nvstore_get_datapublic(hNvstore, TRUE, &data_public_size, nv_data_public)))
 		return result;
 
 	offset = sizeof(TPM_STRUCTURE_TAG)+ sizeof(TPM_NV_INDEX);
@@ -628,7 +712,7 @@ obj_nvstore_get_writelocalityatrelease(TSS_HNVSTORE hNvstore, UINT32 * writeloca
 	TPM_LOCALITY_SELECTION locality_value;
 	TSS_RESULT result;
 
-	if ((result = obj_nvstore_get_datapublic(hNvstore, &data_public_size, nv_data_public)))
+	if ((result = nvstore_get_datapublic(hNvstore, TRUE, &data_public_size, nv_data_public)))
 		return result;
 
 	offset = sizeof(TPM_STRUCTURE_TAG)+ sizeof(TPM_NV_INDEX);
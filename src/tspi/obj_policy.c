@@ -65,6 +65,7 @@ __tspi_policy_free(void *data)
 {
 	struct tr_policy_obj *policy = (struct tr_policy_obj *)data;
 
+	Trspi_HMAC_KeyFree(&policy->SecretHmacKey);
 	free(policy->popupString);
 #ifdef TSS_BUILD_DELEGATION
 	free(policy->delegationBlob);
@@ -182,20 +183,11 @@ obj_policy_do_hmac(TSS_HPOLICY hPolicy, TSS_HOBJECT hAuthorizedObject,
 	return result;
 }
 
-TSS_RESULT
-obj_policy_get_secret(TSS_HPOLICY hPolicy, TSS_BOOL ctx, TCPA_SECRET *secret)
+/* Make sure the policy's secret can be used, prompting for it if need be */
+static TSS_RESULT
+policy_check_secret(struct tr_policy_obj *policy, TSS_BOOL ctx)
 {
-	struct tsp_object *obj;
-	struct tr_policy_obj *policy;
-	TSS_RESULT result = TSS_SUCCESS;
-	TCPA_SECRET null_secret;
-
-	if ((obj = obj_list_get_obj(&policy_list, hPolicy)) == NULL)
-		return TSPERR(TSS_E_INVALID_HANDLE);
-
-	policy = (struct tr_policy_obj *)obj->data;
-
-	__tspi_memset(&null_secret, 0, sizeof(TCPA_SECRET));
+	TSS_RESULT result;
 
 	switch (policy->SecretMode) {
 		case TSS_SECRET_MODE_POPUP:
@@ -205,25 +197,41 @@ obj_policy_get_secret(TSS_HPOLICY hPolicy, TSS_BOOL ctx, TCPA_SECRET *secret)
 							      policy->hashMode,
 							      policy->popupString,
 							      policy->Secret)))
-					break;
+					return result;
 			}
 			policy->SecretSet = TRUE;
 			/* fall through */
 		case TSS_SECRET_MODE_PLAIN:
 		case TSS_SECRET_MODE_SHA1:
-			if (policy->SecretSet == FALSE) {
-				result = TSPERR(TSS_E_POLICY_NO_SECRET);
-				break;
-			}
-
-			memcpy(secret, policy->Secret, sizeof(TCPA_SECRET));
+			if (policy->SecretSet == FALSE)
+				return TSPERR(TSS_E_POLICY_NO_SECRET);
 			break;
 		case TSS_SECRET_MODE_NONE:
-			memcpy(secret, &null_secret, sizeof(TCPA_SECRET));
 			break;
 		default:
-			result = TSPERR(TSS_E_POLICY_NO_SECRET);
-			break;
+			return TSPERR(TSS_E_POLICY_NO_SECRET);
+	}
+
+	return TSS_SUCCESS;
+}
+
+TSS_RESULT
+obj_policy_get_secret(TSS_HPOLICY hPolicy, TSS_BOOL ctx, TCPA_SECRET *secret)
+{
+	struct tsp_object *obj;
+	struct tr_policy_obj *policy;
+	TSS_RESULT result = TSS_SUCCESS;
+
+	if ((obj = obj_list_get_obj(&policy_list, hPolicy)) == NULL)
+		return TSPERR(TSS_E_INVALID_HANDLE);
+
+	policy = (struct tr_policy_obj *)obj->data;
+
+	if ((result = policy_check_secret(policy, ctx)) == TSS_SUCCESS) {
+		if (policy->SecretMode == TSS_SECRET_MODE_NONE)
+			__tspi_memset(secret, 0, sizeof(TCPA_SECRET));
+		else
+			memcpy(secret, policy->Secret, sizeof(TCPA_SECRET));
 	}
 #ifdef TSS_DEBUG
 	if (!result) {
@@ -236,6 +244,58 @@ obj_policy_get_secret(TSS_HPOLICY hPolicy, TSS_BOOL ctx, TCPA_SECRET *secret)
 	return result;
 }
 
+/* HMAC @data with the policy's secret. The HMAC key schedule is computed the first time a
+ * secret is used and kept with the policy until the secret is changed or flushed. The
+ * policy list must be locked */
+TSS_RESULT
+policy_secret_hmac(struct tr_policy_obj *policy, UINT32 size, BYTE *data, BYTE *hmacOut)
+{
+	TSS_RESULT result;
+
+	/* the secret's contents aren't settled until it's been set */
+	if (policy->SecretSet == FALSE)
+		return Trspi_HMAC(TSS_HASH_SHA1, sizeof(policy->Secret), policy->Secret, size,
+				  data, hmacOut);
+
+	if (policy->SecretHmacKey.inner == NULL &&
+	    (result = Trspi_HMAC_KeyInit(&policy->SecretHmacKey, sizeof(policy->Secret),
+					 policy->Secret)))
+		return result;
+
+	return Trspi_HMAC_Keyed(&policy->SecretHmacKey, size, data, hmacOut);
+}
+
+/* Like obj_policy_get_secret() followed by an HMAC with the secret, without copying the
+ * secret out of the policy */
+TSS_RESULT
+obj_policy_hmac_secret(TSS_HPOLICY hPolicy, TSS_BOOL ctx, UINT32 size, BYTE *data,
+		       BYTE *hmacOut)
+{
+	struct tsp_object *obj;
+	struct tr_policy_obj *policy;
+	TSS_RESULT result;
+	TCPA_SECRET null_secret;
+
+	if ((obj = obj_list_get_obj(&policy_list, hPolicy)) == NULL)
+		return TSPERR(TSS_E_INVALID_HANDLE);
+
+	policy = (struct tr_policy_obj *)obj->data;
+
+	if ((result = policy_check_secret(policy, ctx)))
+		goto done;
+
+	if (policy->SecretMode == TSS_SECRET_MODE_NONE) {
+		__tspi_memset(&null_secret, 0, sizeof(TCPA_SECRET));
+		result = Trspi_HMAC(TSS_HASH_SHA1, sizeof(TCPA_SECRET), null_secret.authdata, size,
+				    data, hmacOut);
+	} else
+		result = policy_secret_hmac(policy, size, data, hmacOut);
+done:
+	obj_list_put(&policy_list);
+
+	return result;
+}
+
 TSS_RESULT
 obj_policy_flush_secret(TSS_HPOLICY hPolicy)
 {
@@ -248,6 +308,7 @@ obj_policy_flush_secret(TSS_HPOLICY hPolicy)
 	policy = (struct tr_policy_obj *)obj->data;
 
 	__tspi_memset(&policy->Secret, 0, policy->SecretSize);
+	Trspi_HMAC_KeyFree(&policy->SecretHmacKey);
 	policy->SecretSet = FALSE;
 
 	obj_list_put(&policy_list);
@@ -292,6 +353,7 @@ obj_policy_set_secret_object(TSS_HPOLICY hPolicy, TSS_FLAG mode, UINT32 size,
 	}
 
 	memcpy(policy->Secret, digest, size);
+	Trspi_HMAC_KeyFree(&policy->SecretHmacKey);
 	policy->SecretMode = mode;
 	policy->SecretSize = size;
 	policy->SecretSet = set;
@@ -1187,6 +1187,7 @@ obj_rsakey_set_modulus(TSS_HKEY hKey, UINT32 size, BYTE *data)
 	}
 	rsakey->key.pubKey.keyLength = size;
 	memcpy(rsakey->key.pubKey.key, data, size);
+	Trspi_RSA_PubKeyFree(&rsakey->pubKeyCache);
 
 done:
 	obj_list_put(&rsakey_list);
@@ -1242,6 +1243,53 @@ done:
 	return result;
 }
 
+/* Return a reference to the key's public key in the crypto library's form, along with the
+ * parts of the key parameters needed to use it. The handle is built the first time it's
+ * asked for and kept until the public key changes; the caller frees its reference with
+ * Trspi_RSA_PubKeyFree(). keyUsage and encScheme may be NULL. */
+TSS_RESULT
+obj_rsakey_get_pub_handle(TSS_HKEY hKey, Trspi_RSAPubKey *handle, TPM_KEY_USAGE *keyUsage,
+			  TPM_ENC_SCHEME *encScheme, UINT32 *keyLength)
+{
+	struct tsp_object *obj;
+	struct tr_rsakey_obj *rsakey;
+	TSS_RESULT result = TSS_SUCCESS;
+
+	if ((obj = obj_list_get_obj(&rsakey_list, hKey)) == NULL)
+		return TSPERR(TSS_E_INVALID_HANDLE);
+
+	rsakey = (struct tr_rsakey_obj *)obj->data;
+
+	/* as in obj_rsakey_get_pub_blob, don't hand out an unset SRK public key */
+	if (rsakey->tcsHandle == TPM_KEYHND_SRK) {
+		BYTE zeroBlob[2048] = { 0, };
+
+		if (!memcmp(rsakey->key.pubKey.key, zeroBlob, rsakey->key.pubKey.keyLength)) {
+			result = TSPERR(TSS_E_BAD_PARAMETER);
+			goto done;
+		}
+	}
+
+	if (rsakey->pubKeyCache.rsa == NULL &&
+	    (result = Trspi_RSA_PubKeyInit(&rsakey->pubKeyCache, rsakey->key.pubKey.keyLength,
+					   rsakey->key.pubKey.key)))
+		goto done;
+
+	if ((result = Trspi_RSA_PubKeyDup(handle, &rsakey->pubKeyCache)))
+		goto done;
+
+	if (keyUsage)
+		*keyUsage = rsakey->key.keyUsage;
+	if (encScheme)
+		*encScheme = rsakey->key.algorithmParms.encScheme;
+	*keyLength = rsakey->key.pubKey.keyLength;
+
+done:
+	obj_list_put(&rsakey_list);
+
+	return result;
+}
+
 TSS_RESULT
 obj_rsakey_get_version(TSS_HKEY hKey, UINT32 *size, BYTE **data)
 {
@@ -1482,6 +1530,7 @@ obj_rsakey_set_tcpakey(TSS_HKEY hKey, UINT32 size, BYTE *data)
 	rsakey = (struct tr_rsakey_obj *)obj->data;
 
 	free_key_refs(&rsakey->key);
+	Trspi_RSA_PubKeyFree(&rsakey->pubKeyCache);
 
 	offset = 0;
 	if ((result = UnloadBlob_TSS_KEY(&offset, data, &rsakey->key)))
@@ -1690,6 +1739,7 @@ rsakey_set_pubkey(struct tr_rsakey_obj *rsakey, BYTE *pubkey)
 
 	memcpy(&rsakey->key.pubKey, &pub.pubKey, sizeof(TPM_STORE_PUBKEY));
 	memcpy(&rsakey->key.algorithmParms, &pub.algorithmParms, sizeof(TPM_KEY_PARMS));
+	Trspi_RSA_PubKeyFree(&rsakey->pubKeyCache);
 
 	return TSS_SUCCESS;
 }
@@ -1730,14 +1780,17 @@ obj_rsakey_set_srk_pubkey(BYTE *pubkey)
 	MUTEX_LOCK(list->lock);
 
 	for (obj = list->head; obj; obj = obj->next) {
+		MUTEX_LOCK(obj->lock);
 		rsakey = (struct tr_rsakey_obj *)obj->data;
 
 		/* we found the SRK, set this data as its public key */
 		if (rsakey->tcsHandle == TPM_KEYHND_SRK) {
 			result = rsakey_set_pubkey(rsakey, pubkey);
+			MUTEX_UNLOCK(obj->lock);
 			MUTEX_UNLOCK(list->lock);
 			return result;
 		}
+		MUTEX_UNLOCK(obj->lock);
 	}
 
 	MUTEX_UNLOCK(list->lock);
@@ -1824,6 +1877,7 @@ __tspi_rsakey_free(void *data)
 	free(rsakey->key.encData);
 	free(rsakey->key.PCRInfo);
 	free(rsakey->key.pubKey.key);
+	Trspi_RSA_PubKeyFree(&rsakey->pubKeyCache);
 	free(rsakey);
 }
 
@@ -1851,13 +1905,16 @@ obj_rsakey_get_by_pub(UINT32 pub_size, BYTE *pub, TSS_HKEY *hKey)
 	MUTEX_LOCK(list->lock);
 
 	for (obj = list->head; obj; obj = obj->next) {
+		MUTEX_LOCK(obj->lock);
 		rsakey = (struct tr_rsakey_obj *)obj->data;
 
 		if (rsakey->key.pubKey.keyLength == pub_size &&
 		    !memcmp(&rsakey->key.pubKey.key, pub, pub_size)) {
 			*hKey = obj->handle;
+			MUTEX_UNLOCK(obj->lock);
 			goto done;
 		}
+		MUTEX_UNLOCK(obj->lock);
 	}
 
 	*hKey = 0;
@@ -1878,12 +1935,15 @@ obj_rsakey_get_by_uuid(TSS_UUID *uuid, TSS_HKEY *hKey)
 	MUTEX_LOCK(list->lock);
 
 	for (obj = list->head; obj; obj = obj->next) {
+		MUTEX_LOCK(obj->lock);
 		rsakey = (struct tr_rsakey_obj *)obj->data;
 
 		if (!memcmp(&rsakey->uuid, uuid, sizeof(TSS_UUID))) {
 			*hKey = obj->handle;
+			MUTEX_UNLOCK(obj->lock);
 			goto done;
 		}
+		MUTEX_UNLOCK(obj->lock);
 	}
 
 	result = TSPERR(TSS_E_PS_KEY_NOTFOUND);
@@ -1906,12 +1966,14 @@ obj_rsakey_remove_policy_refs(TSS_HPOLICY hPolicy, TSS_HCONTEXT tspContext)
 		if (obj->tspContext != tspContext)
 			continue;
 
+		MUTEX_LOCK(obj->lock);
 		rsakey = (struct tr_rsakey_obj *)obj->data;
 		if (rsakey->usagePolicy == hPolicy)
 			rsakey->usagePolicy = NULL_HPOLICY;
 
 		if (rsakey->migPolicy == hPolicy)
 			rsakey->migPolicy = NULL_HPOLICY;
+		MUTEX_UNLOCK(obj->lock);
 	}
 
 	MUTEX_UNLOCK(list->lock);
@@ -353,7 +353,7 @@ obj_tpm_get_cred(TSS_HTPM hTpm, TSS_FLAG type, UINT32 *CredSize, BYTE **CredData
 		default:
 			result = TSPERR(TSS_E_BAD_PARAMETER);
 			*CredSize = 0;
-			free(*CredData);
+			free_tspi(obj->tspContext, *CredData);
 			*CredData = NULL;
 			break;
 	}
@@ -469,6 +469,7 @@ obj_tpm_remove_policy_refs(TSS_HPOLICY hPolicy, TSS_HCONTEXT tspContext)
 		if (obj->tspContext != tspContext)
 			continue;
 
+		pthread_mutex_lock(&obj->lock);
 		tpm = (struct tr_tpm_obj *)obj->data;
 		if (tpm->policy == hPolicy)
 			tpm->policy = NULL_HPOLICY;
@@ -476,6 +477,7 @@ obj_tpm_remove_policy_refs(TSS_HPOLICY hPolicy, TSS_HCONTEXT tspContext)
 		if (tpm->operatorPolicy == hPolicy)
 			tpm->operatorPolicy = NULL_HPOLICY;
 #endif
+		pthread_mutex_unlock(&obj->lock);
 	}
 
 	pthread_mutex_unlock(&list->lock);
@@ -21,6 +21,8 @@
 
 static struct host_table *ht = NULL;
 
+#define host_table_bucket(ctx)	ht->entries[(ctx) & (HOST_TABLE_BUCKETS - 1)]
+
 TSS_RESULT
 host_table_init()
 {
@@ -30,7 +32,7 @@ host_table_init()
 		return TSPERR(TSS_E_OUTOFMEMORY);
 	}
 
-	MUTEX_INIT(ht->lock);
+	RWLOCK_INIT(ht->lock);
 
 	return TSS_SUCCESS;
 }
@@ -50,20 +52,22 @@ void
 host_table_final()
 {
 	struct host_table_entry *hte, *next = NULL;
+	int i;
 
-	MUTEX_LOCK(ht->lock);
+	RWLOCK_WRLOCK(ht->lock);
 
-	for (hte = ht->entries; hte; hte = next) {
-		if (hte)
+	for (i = 0; i < HOST_TABLE_BUCKETS; i++) {
+		for (hte = ht->entries[i]; hte; hte = next) {
 			next = hte->next;
-		if (hte->hostname)
-			free(hte->hostname);
-		if (hte->comm.buf)
-			free(hte->comm.buf);
-		free(hte);
+			if (hte->hostname)
+				free(hte->hostname);
+			if (hte->comm.buf)
+				free(hte->comm.buf);
+			free(hte);
+		}
 	}
 
-	MUTEX_UNLOCK(ht->lock);
+	RWLOCK_UNLOCK(ht->lock);
 
 	free(ht);
 	ht = NULL;
@@ -112,12 +116,12 @@ __tspi_add_table_entry(TSS_HCONTEXT tspContext, BYTE *host, int type, struct hos
     }
     MUTEX_INIT(entry->lock);
 
-	MUTEX_LOCK(ht->lock);
+	RWLOCK_WRLOCK(ht->lock);
 
-	for (tmp = ht->entries; tmp; tmp = tmp->next) {
+	for (tmp = host_table_bucket(tspContext); tmp; tmp = tmp->next) {
 		if (tmp->tspContext == tspContext) {
 			LogError("Tspi_Context_Connect attempted on an already connected context!");
-			MUTEX_UNLOCK(ht->lock);
+			RWLOCK_UNLOCK(ht->lock);
 			free(entry->hostname);
 			free(entry->comm.buf);
 			free(entry);
@@ -125,14 +129,9 @@ __tspi_add_table_entry(TSS_HCONTEXT tspContext, BYTE *host, int type, struct hos
 		}
 	}
 
-	if( ht->entries == NULL ) {
-		ht->entries = entry;
-	} else {
-		for (tmp = ht->entries; tmp->next; tmp = tmp->next)
-			;
-		tmp->next = entry;
-	}
-	MUTEX_UNLOCK(ht->lock);
+	entry->next = host_table_bucket(tspContext);
+	host_table_bucket(tspContext) = entry;
+	RWLOCK_UNLOCK(ht->lock);
 
 	*ret = entry;
 
@@ -142,16 +141,18 @@ __tspi_add_table_entry(TSS_HCONTEXT tspContext, BYTE *host, int type, struct hos
 void
 remove_table_entry(TSS_HCONTEXT tspContext)
 {
-	struct host_table_entry *hte, *prev = NULL;
+	struct host_table_entry *hte, **phte;
 
-	MUTEX_LOCK(ht->lock);
+	RWLOCK_WRLOCK(ht->lock);
 
-	for (hte = ht->entries; hte; prev = hte, hte = hte->next) {
+	for (phte = &host_table_bucket(tspContext); (hte = *phte); phte = &hte->next) {
 		if (hte->tspContext == tspContext) {
-			if (prev != NULL)
-				prev->next = hte->next;
-			else
-				ht->entries = hte->next;
+			*phte = hte->next;
+
+			/* wait for anyone still using the connection */
+			MUTEX_LOCK(hte->lock);
+			MUTEX_UNLOCK(hte->lock);
+
 			if (hte->hostname)
 				free(hte->hostname);
 			free(hte->comm.buf);
@@ -160,17 +161,19 @@ remove_table_entry(TSS_HCONTEXT tspContext)
 		}
 	}
 
-	MUTEX_UNLOCK(ht->lock);
+	RWLOCK_UNLOCK(ht->lock);
 }
 
+/* Look up the connection of @tspContext and return it locked. Lookups only need the table
+ * for reading, so RPCs on different contexts don't contend for it */
 struct host_table_entry *
 get_table_entry(TSS_HCONTEXT tspContext)
 {
 	struct host_table_entry *index = NULL;
 
-	MUTEX_LOCK(ht->lock);
+	RWLOCK_RDLOCK(ht->lock);
 
-	for (index = ht->entries; index; index = index->next) {
+	for (index = host_table_bucket(tspContext); index; index = index->next) {
 		if (index->tspContext == tspContext)
 			break;
 	}
@@ -178,7 +181,7 @@ get_table_entry(TSS_HCONTEXT tspContext)
 	if (index)
 		MUTEX_LOCK(index->lock);
 
-	MUTEX_UNLOCK(ht->lock);
+	RWLOCK_UNLOCK(ht->lock);
 
 	return index;
 }
@@ -99,17 +99,18 @@ TSS_RESULT RPC_CloseContext(TSS_HCONTEXT tspContext)	/* in */
 
 	switch (entry->type) {
 		case CONNECTION_TYPE_TCP_PERSISTANT:
-			if ((result = RPC_CloseContext_TP(entry)) == TSS_SUCCESS) {
+			if ((result = RPC_CloseContext_TP(entry)) == TSS_SUCCESS)
 				close(entry->socket);
-				remove_table_entry(tspContext);
-			}
 			break;
 		default:
 			break;
 	}
 
-	if (result != TSS_SUCCESS)
-		put_table_entry(entry);
+	/* remove_table_entry() waits for the entry to be released */
+	put_table_entry(entry);
+
+	if (result == TSS_SUCCESS)
+		remove_table_entry(tspContext);
 
 	return result;
 }
@@ -136,6 +137,30 @@ TSS_RESULT RPC_FreeMemory(TSS_HCONTEXT tspContext,	/* in */
 	return result;
 }
 
+TSS_RESULT RPC_Batch(TSS_HCONTEXT tspContext,	/* in */
+		     UINT32 numEntries,	/* in */
+		     struct tcsd_batch_entry *entries,	/* in, out */
+		     UINT32 *numDone)	/* out */
+{
+	TSS_RESULT result = (TSS_E_INTERNAL_ERROR | TSS_LAYER_TSP);
+	struct host_table_entry *entry = get_table_entry(tspContext);
+
+	if (entry == NULL)
+		return TSPERR(TSS_E_NO_CONNECTION);
+
+	switch (entry->type) {
+		case CONNECTION_TYPE_TCP_PERSISTANT:
+			result = RPC_Batch_TP(entry, numEntries, entries, numDone);
+			break;
+		default:
+			break;
+	}
+
+	put_table_entry(entry);
+
+	return result;
+}
+
 TSS_RESULT RPC_LogPcrEvent(TSS_HCONTEXT tspContext,	/* in */
 			   TSS_PCR_EVENT Event,	/* in */
 			   UINT32 * pNumber)	/* out */
@@ -434,6 +459,33 @@ TSS_RESULT RPC_LoadKeyByUUID(TSS_HCONTEXT tspContext,	/* in */
 	return result;
 }
 
+TSS_RESULT RPC_LoadKeyByUUIDAndBlob(TSS_HCONTEXT tspContext,	/* in */
+				    TSS_UUID KeyUUID,	/* in */
+				    TCS_LOADKEY_INFO * pLoadKeyInfo,	/* in, out */
+				    TCS_KEY_HANDLE * phKeyTCSI,	/* out */
+				    UINT32 * pcKeySize,	/* out */
+				    BYTE ** prgbKey)	/* out */
+{
+	TSS_RESULT result = (TSS_E_INTERNAL_ERROR | TSS_LAYER_TSP);
+	struct host_table_entry *entry = get_table_entry(tspContext);
+
+	if (entry == NULL)
+		return TSPERR(TSS_E_NO_CONNECTION);
+
+	switch (entry->type) {
+		case CONNECTION_TYPE_TCP_PERSISTANT:
+			result = RPC_LoadKeyByUUIDAndBlob_TP(entry, KeyUUID, pLoadKeyInfo, phKeyTCSI,
+							     pcKeySize, prgbKey);
+			break;
+		default:
+			break;
+	}
+
+	put_table_entry(entry);
+
+	return result;
+}
+
 TSS_RESULT RPC_EvictKey(TSS_HCONTEXT tspContext,	/* in */
 			TCS_KEY_HANDLE hKey)	/* in */
 {
@@ -0,0 +1,163 @@
+
+/*
+ * Licensed Materials - Property of IBM
+ *
+ * trousers - An open source TCG Software Stack
+ *
+ * (C) Copyright International Business Machines Corp. 2004-2007
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "trousers/tss.h"
+#include "trousers/trousers.h"
+#include "trousers_types.h"
+#include "spi_utils.h"
+#include "tsplog.h"
+#include "hosttable.h"
+#include "tcsd_wrap.h"
+#include "rpc_tcstp_tsp.h"
+
+
+/* Each entry's comm struct is built by the caller with initData()/setData() exactly as
+ * for a single RPC and its ordinal set in hdr.u.ordinal. The TCS context (parameter 0 of
+ * every TCSD ordinal but OpenContext) is filled in here from the connection.  On return,
+ * the first *numDone entries hold the TCSD's responses and can be read with getData().
+ * The TCSD stops at the first entry that fails, so the last completed entry's
+ * hdr.u.result tells the caller whether the whole batch went through.
+ *
+ * TCSDs that predate the batch ordinal answer it with TSS_E_FAIL. That is remembered for
+ * the connection and reported as TSS_E_NOTIMPL, on which callers should fall back to
+ * sending the entries' ordinals one at a time. */
+TSS_RESULT
+RPC_Batch_TP(struct host_table_entry *hte,
+	     UINT32 numEntries,			/* in */
+	     struct tcsd_batch_entry *entries,	/* in, out */
+	     UINT32 *numDone)			/* out */
+{
+	TSS_RESULT result;
+	struct tcsd_batch_entry *e;
+	UINT32 i, j, size;
+	UINT64 offset;
+	int parm_count, parm;
+
+	if (numEntries == 0 || numEntries > TCSD_MAX_BATCH_ENTRIES)
+		return TSPERR(TSS_E_BAD_PARAMETER);
+
+	if (hte->no_batch)
+		return TSPERR(TSS_E_NOTIMPL);
+
+	/* numEntries, then per entry num_refs, the refs, the packet size and the packet */
+	parm_count = 1;
+	for (i = 0; i < numEntries; i++)
+		parm_count += 3 + (3 * entries[i].num_refs);
+
+	initData(&hte->comm, parm_count);
+	hte->comm.hdr.u.ordinal = TCSD_ORD_BATCH;
+	LogDebugFn("TCS Context: 0x%x, %u entries", hte->tcsContext, numEntries);
+
+	parm = 0;
+	if (setData(TCSD_PACKET_TYPE_UINT32, parm++, &numEntries, 0, &hte->comm))
+		return TSPERR(TSS_E_INTERNAL_ERROR);
+
+	for (i = 0; i < numEntries; i++) {
+		e = &entries[i];
+
+		/* put the platform header on the front of the sub-packet */
+		offset = 0;
+		Trspi_LoadBlob_UINT32(&offset, e->comm.hdr.packet_size, e->comm.buf);
+		Trspi_LoadBlob_UINT32(&offset, e->comm.hdr.u.ordinal, e->comm.buf);
+		Trspi_LoadBlob_UINT32(&offset, e->comm.hdr.num_parms, e->comm.buf);
+		Trspi_LoadBlob_UINT32(&offset, e->comm.hdr.type_size, e->comm.buf);
+		Trspi_LoadBlob_UINT32(&offset, e->comm.hdr.type_offset, e->comm.buf);
+		Trspi_LoadBlob_UINT32(&offset, e->comm.hdr.parm_size, e->comm.buf);
+		Trspi_LoadBlob_UINT32(&offset, e->comm.hdr.parm_offset, e->comm.buf);
+
+		if (e->comm.hdr.u.ordinal != TCSD_ORD_OPENCONTEXT && e->comm.hdr.num_parms > 0 &&
+		    e->comm.buf[e->comm.hdr.type_offset] == TCSD_PACKET_TYPE_UINT32) {
+			offset = e->comm.hdr.parm_offset;
+			Trspi_LoadBlob_UINT32(&offset, hte->tcsContext, e->comm.buf);
+		}
+
+		if (setData(TCSD_PACKET_TYPE_UINT32, parm++, &e->num_refs, 0, &hte->comm))
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+		for (j = 0; j < e->num_refs; j++) {
+			if (setData(TCSD_PACKET_TYPE_UINT32, parm++, &e->refs[j].src_entry, 0,
+				    &hte->comm))
+				return TSPERR(TSS_E_INTERNAL_ERROR);
+			if (setData(TCSD_PACKET_TYPE_UINT32, parm++, &e->refs[j].src_parm, 0,
+				    &hte->comm))
+				return TSPERR(TSS_E_INTERNAL_ERROR);
+			if (setData(TCSD_PACKET_TYPE_UINT32, parm++, &e->refs[j].dst_parm, 0,
+				    &hte->comm))
+				return TSPERR(TSS_E_INTERNAL_ERROR);
+		}
+
+		size = e->comm.hdr.packet_size;
+		if (setData(TCSD_PACKET_TYPE_UINT32, parm++, &size, 0, &hte->comm))
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+		if (setData(TCSD_PACKET_TYPE_PBYTE, parm++, e->comm.buf, size, &hte->comm))
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+	}
+
+	result = sendTCSDPacket(hte);
+
+	if (result == TSS_SUCCESS)
+		result = hte->comm.hdr.u.result;
+
+	if (result == TCSERR(TSS_E_FAIL)) {
+		LogDebug("TCSD does not support batched requests");
+		hte->no_batch = TRUE;
+		return TSPERR(TSS_E_NOTIMPL);
+	}
+
+	if (result == TSS_SUCCESS) {
+		parm = 0;
+		if (getData(TCSD_PACKET_TYPE_UINT32, parm++, numDone, 0, &hte->comm))
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+		if (*numDone > numEntries)
+			return TSPERR(TSS_E_INTERNAL_ERROR);
+
+		for (i = 0; i < *numDone; i++) {
+			e = &entries[i];
+
+			if (getData(TCSD_PACKET_TYPE_UINT32, parm++, &size, 0, &hte->comm))
+				return TSPERR(TSS_E_INTERNAL_ERROR);
+			if (size < sizeof(struct tcsd_packet_hdr) || size > hte->comm.hdr.parm_size)
+				return TSPERR(TSS_E_INTERNAL_ERROR);
+
+			if (size > e->comm.buf_size) {
+				BYTE *buffer;
+
+				if ((buffer = realloc(e->comm.buf, size)) == NULL) {
+					LogError("realloc of %u bytes failed.", size);
+					return TSPERR(TSS_E_OUTOFMEMORY);
+				}
+				e->comm.buf = buffer;
+				e->comm.buf_size = size;
+			}
+
+			if (getData(TCSD_PACKET_TYPE_PBYTE, parm++, e->comm.buf, size, &hte->comm))
+				return TSPERR(TSS_E_INTERNAL_ERROR);
+
+			/* create a platform version of the tcsd header. The header is packed, so
+			 * decode by value rather than through member pointers */
+			e->comm.hdr.packet_size = Decode_UINT32(e->comm.buf);
+			e->comm.hdr.u.result = Decode_UINT32(e->comm.buf + 4);
+			e->comm.hdr.num_parms = Decode_UINT32(e->comm.buf + 8);
+			e->comm.hdr.type_size = Decode_UINT32(e->comm.buf + 12);
+			e->comm.hdr.type_offset = Decode_UINT32(e->comm.buf + 16);
+			e->comm.hdr.parm_size = Decode_UINT32(e->comm.buf + 20);
+			e->comm.hdr.parm_offset = Decode_UINT32(e->comm.buf + 24);
+
+			if (e->comm.hdr.packet_size != size)
+				return TSPERR(TSS_E_INTERNAL_ERROR);
+		}
+	}
+
+	return result;
+}
@@ -161,7 +161,7 @@ RPC_GetPcrEventsByPcr_TP(struct host_table_entry *hte,
 			i = 1;
 			for (j = 0; j < (*pEventCount); j++) {
 				if (getData(TCSD_PACKET_TYPE_PCR_EVENT, i++, &((*ppEvents)[j]), 0, &hte->comm)) {
-					free(*ppEvents);
+					free_tspi(hte->tspContext, *ppEvents);
 					*ppEvents = NULL;
 					result = TSPERR(TSS_E_INTERNAL_ERROR);
 					goto done;
@@ -215,7 +215,7 @@ RPC_GetPcrEventLog_TP(struct host_table_entry *hte,
 			i = 1;
 			for (j = 0; (UINT32)j < (*pEventCount); j++) {
 				if (getData(TCSD_PACKET_TYPE_PCR_EVENT, i++, &((*ppEvents)[j]), 0, &hte->comm)) {
-					free(*ppEvents);
+					free_tspi(hte->tspContext, *ppEvents);
 					*ppEvents = NULL;
 					result = TSPERR(TSS_E_INTERNAL_ERROR);
 					goto done;
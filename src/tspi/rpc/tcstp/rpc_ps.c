@@ -345,6 +345,116 @@ RPC_LoadKeyByUUID_TP(struct host_table_entry *hte,
 	return result;
 }
 
+/* Fetch a system PS key's blob and load the key in a single TCSD round trip. On success and
+ * on TCS_E_KM_LOADFAILED (when the caller is expected to supply auth and retry the load)
+ * *prgbKey holds the blob, which the caller frees. On any other error it is NULL. */
+TSS_RESULT
+RPC_LoadKeyByUUIDAndBlob_TP(struct host_table_entry *hte,
+			    TSS_UUID KeyUUID,			/* in */
+			    TCS_LOADKEY_INFO * pLoadKeyInfo,	/* in, out */
+			    TCS_KEY_HANDLE * phKeyTCSI,		/* out */
+			    UINT32 * pcKeySize,			/* out */
+			    BYTE ** prgbKey)			/* out */
+{
+	struct tcsd_batch_entry entries[2];
+	UINT32 numDone, i;
+	TSS_RESULT result;
+
+	*prgbKey = NULL;
+
+	__tspi_memset(entries, 0, sizeof(entries));
+	for (i = 0; i < 2; i++) {
+		entries[i].comm.buf_size = TCSD_INIT_TXBUF_SIZE;
+		if ((entries[i].comm.buf = calloc(1, TCSD_INIT_TXBUF_SIZE)) == NULL) {
+			LogError("malloc of %u bytes failed.", TCSD_INIT_TXBUF_SIZE);
+			result = TSPERR(TSS_E_OUTOFMEMORY);
+			goto done;
+		}
+	}
+
+	/* the TCS context in parameter 0 of each entry is filled in by RPC_Batch_TP */
+	initData(&entries[0].comm, 2);
+	entries[0].comm.hdr.u.ordinal = TCSD_ORD_GETREGISTEREDKEYBLOB;
+	if (setData(TCSD_PACKET_TYPE_UINT32, 0, &hte->tcsContext, 0, &entries[0].comm) ||
+	    setData(TCSD_PACKET_TYPE_UUID, 1, &KeyUUID, 0, &entries[0].comm)) {
+		result = TSPERR(TSS_E_INTERNAL_ERROR);
+		goto done;
+	}
+
+	initData(&entries[1].comm, 3);
+	entries[1].comm.hdr.u.ordinal = TCSD_ORD_LOADKEYBYUUID;
+	if (setData(TCSD_PACKET_TYPE_UINT32, 0, &hte->tcsContext, 0, &entries[1].comm) ||
+	    setData(TCSD_PACKET_TYPE_UUID, 1, &KeyUUID, 0, &entries[1].comm)) {
+		result = TSPERR(TSS_E_INTERNAL_ERROR);
+		goto done;
+	}
+	if (pLoadKeyInfo != NULL) {
+		if (setData(TCSD_PACKET_TYPE_LOADKEY_INFO, 2, pLoadKeyInfo, 0, &entries[1].comm)) {
+			result = TSPERR(TSS_E_INTERNAL_ERROR);
+			goto done;
+		}
+	}
+
+	result = RPC_Batch_TP(hte, 2, entries, &numDone);
+	if (result == TSPERR(TSS_E_NOTIMPL)) {
+		/* an older TCSD, send the two ordinals separately */
+		if ((result = RPC_GetRegisteredKeyBlob_TP(hte, KeyUUID, pcKeySize, prgbKey))) {
+			*prgbKey = NULL;
+			goto done;
+		}
+
+		result = RPC_LoadKeyByUUID_TP(hte, KeyUUID, pLoadKeyInfo, phKeyTCSI);
+		goto done;
+	} else if (result)
+		goto done;
+
+	if (numDone == 0) {
+		result = TSPERR(TSS_E_INTERNAL_ERROR);
+		goto done;
+	}
+
+	/* the blob */
+	if ((result = entries[0].comm.hdr.u.result))
+		goto done;
+
+	if (getData(TCSD_PACKET_TYPE_UINT32, 0, pcKeySize, 0, &entries[0].comm)) {
+		result = TSPERR(TSS_E_INTERNAL_ERROR);
+		goto done;
+	}
+	if ((*prgbKey = malloc(*pcKeySize)) == NULL) {
+		LogError("malloc of %u bytes failed.", *pcKeySize);
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto done;
+	}
+	if (getData(TCSD_PACKET_TYPE_PBYTE, 1, *prgbKey, *pcKeySize, &entries[0].comm) ||
+	    numDone != 2) {
+		result = TSPERR(TSS_E_INTERNAL_ERROR);
+		goto done;
+	}
+
+	/* the load */
+	result = entries[1].comm.hdr.u.result;
+	if (result == TSS_SUCCESS) {
+		if (getData(TCSD_PACKET_TYPE_UINT32, 0, phKeyTCSI, 0, &entries[1].comm))
+			result = TSPERR(TSS_E_INTERNAL_ERROR);
+
+		LogDebugFn("TCS key handle: 0x%x", *phKeyTCSI);
+	} else if (pLoadKeyInfo && (result == (TCS_E_KM_LOADFAILED | TSS_LAYER_TCS))) {
+		if (getData(TCSD_PACKET_TYPE_LOADKEY_INFO, 0, pLoadKeyInfo, 0, &entries[1].comm))
+			result = TSPERR(TSS_E_INTERNAL_ERROR);
+	}
+
+done:
+	if (result && result != (TCS_E_KM_LOADFAILED | TSS_LAYER_TCS)) {
+		free(*prgbKey);
+		*prgbKey = NULL;
+	}
+	for (i = 0; i < 2; i++)
+		free(entries[i].comm.buf);
+
+	return result;
+}
+
 void
 LoadBlob_LOADKEY_INFO(UINT64 *offset, BYTE *blob, TCS_LOADKEY_INFO *info)
 {
@@ -30,49 +30,30 @@ __tspi_rsa_encrypt(TSS_HKEY key,
 	    UINT32*  outDataLen,
 	    BYTE*    outData)
 {
-	BYTE *blob;
-	UINT32 blobLen;
-	UINT64 offset;
 	TSS_RESULT result;
-	TSS_HCONTEXT tspContext;
-	TPM_PUBKEY pubKey;
+	Trspi_RSAPubKey pubKey;
+	TPM_ENC_SCHEME encScheme;
+	UINT32 keyLength;
 
 	if (!inData || !outDataLen || !outData)
 		return TSPERR(TSS_E_INTERNAL_ERROR);
 
-	if ((result = obj_rsakey_get_tsp_context(key, &tspContext)))
+	if ((result = obj_rsakey_get_pub_handle(key, &pubKey, NULL, &encScheme, &keyLength)))
 		return result;
 
-	if ((result = obj_rsakey_get_pub_blob(key, &blobLen, &blob)))
-		return result;
-
-	offset = 0;
-	if ((result = Trspi_UnloadBlob_PUBKEY(&offset, blob, &pubKey))) {
-		free_tspi(tspContext, blob);
-		return result;
-	}
-	free_tspi(tspContext, blob);
-
-	if (pubKey.pubKey.keyLength < inDataLen) {
+	if (keyLength < inDataLen) {
 		result = TSPERR(TSS_E_ENC_INVALID_LENGTH);
 		goto done;
 	}
 
-	if (pubKey.algorithmParms.encScheme == TPM_ES_RSAESPKCSv15 ||
-	    pubKey.algorithmParms.encScheme == TSS_ES_RSAESPKCSV15) {
-		if ((result = Trspi_RSA_PKCS15_Encrypt(inData, inDataLen, outData, outDataLen,
-						       pubKey.pubKey.key, pubKey.pubKey.keyLength)))
-			goto done;
-	} else {
-		if ((result = Trspi_TPM_RSA_OAEP_Encrypt(inData, inDataLen, outData, outDataLen,
-							 pubKey.pubKey.key,
-							 pubKey.pubKey.keyLength)))
-			goto done;
-	}
+	if (encScheme == TPM_ES_RSAESPKCSv15 || encScheme == TSS_ES_RSAESPKCSV15)
+		result = Trspi_RSA_PubKey_PKCS15_Encrypt(&pubKey, inDataLen, inData, outDataLen,
+							 outData);
+	else
+		result = Trspi_RSA_PubKey_Encrypt(&pubKey, inDataLen, inData, outDataLen, outData);
 
 done:
-	free(pubKey.pubKey.key);
-	free(pubKey.algorithmParms.parms);
+	Trspi_RSA_PubKeyFree(&pubKey);
 	return result;
 }
 
@@ -84,34 +65,19 @@ __tspi_rsa_verify(TSS_HKEY key,
 	   UINT32   sigLen,
 	   BYTE*    sig)
 {
-	BYTE *blob;
-	UINT32 blobLen;
-	UINT64 offset;
 	TSS_RESULT result;
-	TSS_HCONTEXT tspContext;
-	TPM_PUBKEY pubKey;
+	Trspi_RSAPubKey pubKey;
+	UINT32 keyLength;
 
 	if (!hash || !sig)
 		return TSPERR(TSS_E_INTERNAL_ERROR);
 
-	if ((result = obj_rsakey_get_tsp_context(key, &tspContext)))
+	if ((result = obj_rsakey_get_pub_handle(key, &pubKey, NULL, NULL, &keyLength)))
 		return result;
 
-	if ((result = obj_rsakey_get_pub_blob(key, &blobLen, &blob)))
-		return result;
-
-	offset = 0;
-	if ((result = Trspi_UnloadBlob_PUBKEY(&offset, blob, &pubKey))) {
-		free_tspi(tspContext, blob);
-		return result;
-	}
-	free_tspi(tspContext, blob);
-
-	result = Trspi_Verify(type, hash, hashLen, pubKey.pubKey.key, pubKey.pubKey.keyLength,
-			      sig, sigLen);
+	result = Trspi_RSA_PubKey_Verify(&pubKey, type, hashLen, hash, sigLen, sig);
 
-	free(pubKey.pubKey.key);
-	free(pubKey.algorithmParms.parms);
+	Trspi_RSA_PubKeyFree(&pubKey);
 
 	return result;
 }
@@ -38,7 +38,8 @@ secret_PerformAuth_OIAP(TSS_HOBJECT hAuthorizedObject,
 	TSS_RESULT result;
 	TSS_BOOL bExpired;
 	UINT32 mode;
-	TCPA_SECRET secret;
+	UINT64 offset;
+	BYTE Blob[61];
 	TSS_HCONTEXT tspContext;
 	TSS_RESULT (*OIAP)(TSS_HCONTEXT, TCS_AUTHHANDLE *, TPM_NONCE *); // XXX hack
 	TSS_RESULT (*TerminateHandle)(TSS_HCONTEXT, TCS_HANDLE); // XXX hack
@@ -101,11 +102,10 @@ secret_PerformAuth_OIAP(TSS_HOBJECT hAuthorizedObject,
 		case TSS_SECRET_MODE_SHA1:
 		case TSS_SECRET_MODE_PLAIN:
 		case TSS_SECRET_MODE_POPUP:
-			if ((result = obj_policy_get_secret(hPolicy, TR_SECRET_CTX_NOT_NEW,
-							    &secret)))
-				break;
-
-			HMAC_Auth(secret.authdata, hashDigest->digest, auth);
+			offset = 0;
+			LoadBlob_AuthHmacData(&offset, Blob, hashDigest->digest, auth);
+			result = obj_policy_hmac_secret(hPolicy, TR_SECRET_CTX_NOT_NEW, offset, Blob,
+							(BYTE *)&auth->HMAC);
 			break;
 		case TSS_SECRET_MODE_NONE:
 			/* fall through */
@@ -362,6 +362,16 @@ validateReturnAuth(BYTE *secret, BYTE *hash, TPM_AUTH *auth)
 	return ((TSS_BOOL) (memcmp(digest, &auth->HMAC, 20) != 0));
 }
 
+/* The data HMAC'd for an authorization: the param digest, both nonces and the continue flag */
+void
+LoadBlob_AuthHmacData(UINT64 *offset, BYTE *Blob, BYTE *Digest, TPM_AUTH *auth)
+{
+	Trspi_LoadBlob(offset, 20, Blob, Digest);
+	Trspi_LoadBlob(offset, 20, Blob, auth->NonceEven.nonce);
+	Trspi_LoadBlob(offset, 20, Blob, auth->NonceOdd.nonce);
+	Blob[(*offset)++] = auth->fContinueAuthSession;
+}
+
 void
 HMAC_Auth(BYTE * secret, BYTE * Digest, TPM_AUTH * auth)
 {
@@ -369,10 +379,7 @@ HMAC_Auth(BYTE * secret, BYTE * Digest, TPM_AUTH * auth)
 	BYTE Blob[61];
 
 	offset = 0;
-	Trspi_LoadBlob(&offset, 20, Blob, Digest);
-	Trspi_LoadBlob(&offset, 20, Blob, auth->NonceEven.nonce);
-	Trspi_LoadBlob(&offset, 20, Blob, auth->NonceOdd.nonce);
-	Blob[offset++] = auth->fContinueAuthSession;
+	LoadBlob_AuthHmacData(&offset, Blob, Digest, auth);
 
 	Trspi_HMAC(TSS_HASH_SHA1, 20, secret, offset, Blob, (BYTE *)&auth->HMAC);
 }
@@ -453,6 +460,9 @@ obj_policy_validate_auth_oiap(TSS_HPOLICY hPolicy, TCPA_DIGEST *hashDigest, TPM_
 	struct tsp_object *obj;
 	struct tr_policy_obj *policy;
 	BYTE wellKnown[TCPA_SHA1_160_HASH_LEN] = TSS_WELL_KNOWN_SECRET;
+	TPM_AUTHDATA hmac;
+	UINT64 offset;
+	BYTE Blob[61];
 
 	if ((obj = obj_list_get_obj(&policy_list, hPolicy)) == NULL)
 		return TSPERR(TSS_E_INVALID_HANDLE);
@@ -477,7 +487,11 @@ obj_policy_validate_auth_oiap(TSS_HPOLICY hPolicy, TCPA_DIGEST *hashDigest, TPM_
 		case TSS_SECRET_MODE_SHA1:
 		case TSS_SECRET_MODE_PLAIN:
 		case TSS_SECRET_MODE_POPUP:
-			if (validateReturnAuth(policy->Secret, hashDigest->digest, auth))
+			offset = 0;
+			LoadBlob_AuthHmacData(&offset, Blob, hashDigest->digest, auth);
+			if ((result = policy_secret_hmac(policy, offset, Blob, hmac.authdata)))
+				break;
+			if (memcmp(hmac.authdata, auth->HMAC.authdata, sizeof(TPM_AUTHDATA)))
 				result = TSPERR(TSS_E_TSP_AUTHFAIL);
 			break;
 		case TSS_SECRET_MODE_NONE:
@@ -746,14 +760,20 @@ authsess_callback_hmac(PVOID lpAppData,
 	Trspi_LoadBlob(&offset, ulSizeNonces, Blob, rgbNonceOdd);
 	Blob[offset++] = ContinueUse;
 
+	/* the shared secret is used for both the command and its response */
+	if (sess->sharedSecretKey.inner == NULL &&
+	    (result = Trspi_HMAC_KeyInit(&sess->sharedSecretKey, ulSizeDigestHmac,
+					 sess->sharedSecret.digest)))
+		return result;
+
 	if (ReturnOrVerify) {
-		Trspi_HMAC(TSS_HASH_SHA1, ulSizeDigestHmac, sess->sharedSecret.digest, offset, Blob,
-			   rgbHmacData);
+		result = Trspi_HMAC_Keyed(&sess->sharedSecretKey, offset, Blob, rgbHmacData);
 	} else {
 		TPM_HMAC hmacVerify;
 
-		Trspi_HMAC(TSS_HASH_SHA1, ulSizeDigestHmac, sess->sharedSecret.digest, offset, Blob,
-			   hmacVerify.digest);
+		if ((result = Trspi_HMAC_Keyed(&sess->sharedSecretKey, offset, Blob,
+					       hmacVerify.digest)))
+			return result;
 		result = memcmp(rgbHmacData, hmacVerify.digest, ulSizeDigestHmac);
 		if (result)
 			result = TPM_E_AUTHFAIL;
@@ -1130,6 +1150,8 @@ authsess_free(struct authsess *xsap)
 		if (xsap->auth.AuthHandle && xsap->auth.fContinueAuthSession)
 			(void)__tspi_free_resource(xsap->tspContext, xsap->auth.AuthHandle, TPM_RT_AUTH);
 
+		Trspi_HMAC_KeyFree(&xsap->sharedSecretKey);
+		__tspi_memset(&xsap->sharedSecret, 0, sizeof(TPM_HMAC));
 		free(xsap->entityValue);
 		free(xsap);
 		xsap = NULL;
@@ -21,8 +21,24 @@
 #include "tsplog.h"
 #include "obj.h"
 
+#define MEM_TABLE_BUCKET(ctx)	SpiMemoryTable[(ctx) & (MEM_TABLE_BUCKETS - 1)]
+#define MEM_ENTRY_SIZE		MEM_ALIGN_UP(sizeof(struct memEntry))
+#define MEM_CHUNK_HDR_SIZE	MEM_ALIGN_UP(sizeof(struct memChunk))
+
+static UINT32
+__tspi_hashPointer(struct memTable *table, void *pointer)
+{
+	unsigned long p = (unsigned long)pointer;
+
+	p ^= p >> 16;
+	p *= 0x45d9f3b;
+	p ^= p >> 16;
+
+	return (UINT32)p & (table->numBuckets - 1);
+}
+
 static struct memTable *
-__tspi_createTable()
+__tspi_createTable(TSS_HCONTEXT tspContext)
 {
 	struct memTable *table = NULL;
 	/*
@@ -34,122 +50,256 @@ __tspi_createTable()
 		LogError("malloc of %zd bytes failed.", sizeof(struct memTable));
 		return NULL;
 	}
+
+	table->entries = calloc(MEM_ENTRY_MIN_BUCKETS, sizeof(struct memEntry *));
+	if (table->entries == NULL) {
+		LogError("malloc of %zd bytes failed.",
+			 MEM_ENTRY_MIN_BUCKETS * sizeof(struct memEntry *));
+		free(table);
+		return NULL;
+	}
+
+	table->numBuckets = MEM_ENTRY_MIN_BUCKETS;
+	table->tspContext = tspContext;
+	MUTEX_INIT(table->lock);
+
 	return (table);
 }
 
-/* caller needs to lock memtable lock */
-struct memTable *
-getTable(TSS_HCONTEXT tspContext)
+/* caller needs to hold memtable lock */
+static struct memTable *
+__tspi_findTable(TSS_HCONTEXT tspContext)
 {
 	struct memTable *tmp;
 
-	for (tmp = SpiMemoryTable; tmp; tmp = tmp->nextTable)
+	for (tmp = MEM_TABLE_BUCKET(tspContext); tmp; tmp = tmp->nextTable)
 		if (tmp->tspContext == tspContext)
 			return tmp;
 
 	return NULL;
 }
 
-/* caller needs to lock memtable lock */
-static void
-__tspi_addTable(struct memTable *new)
+/* Return the table for @tspContext with its lock held, creating it if asked to. Call
+ * putTable() when done with it */
+static struct memTable *
+getTable(TSS_HCONTEXT tspContext, TSS_BOOL create)
 {
-	struct memTable *tmp = SpiMemoryTable;
+	struct memTable *table;
 
-	/* base case, this is the first table */
-	if (SpiMemoryTable == NULL) {
-		SpiMemoryTable = new;
-		return;
+	RWLOCK_RDLOCK(memtable_lock);
+	if ((table = __tspi_findTable(tspContext)) != NULL) {
+		MUTEX_LOCK(table->lock);
+		RWLOCK_UNLOCK(memtable_lock);
+		return table;
 	}
+	RWLOCK_UNLOCK(memtable_lock);
 
-	/* else add @new onto the end */
-	for (; tmp; tmp = tmp->nextTable)
-		if (tmp->nextTable == NULL) {
-			tmp->nextTable = new;
-			break;
+	if (!create)
+		return NULL;
+
+	RWLOCK_WRLOCK(memtable_lock);
+	/* someone may have beaten us to it */
+	if ((table = __tspi_findTable(tspContext)) == NULL) {
+		if ((table = __tspi_createTable(tspContext)) == NULL) {
+			RWLOCK_UNLOCK(memtable_lock);
+			return NULL;
 		}
+		table->nextTable = MEM_TABLE_BUCKET(tspContext);
+		MEM_TABLE_BUCKET(tspContext) = table;
+	}
+	MUTEX_LOCK(table->lock);
+	RWLOCK_UNLOCK(memtable_lock);
+
+	return table;
 }
 
-/* caller needs to lock memtable lock and be sure the context mem slot for
- * @tspContext exists before calling.
- */
-void
-__tspi_addEntry(TSS_HCONTEXT tspContext, struct memEntry *new)
+static void
+putTable(struct memTable *table)
 {
-	struct memTable *tmp = getTable(tspContext);
-	struct memEntry *tmp_entry;
-
-	if (tmp == NULL) {
-		if ((tmp = __tspi_createTable()) == NULL)
-			return;
-		tmp->tspContext = tspContext;
-		__tspi_addTable(tmp);
-	}
+	MUTEX_UNLOCK(table->lock);
+}
 
-	tmp_entry = tmp->entries;
+/* double the number of hash buckets once the chains get long. Failing to grow just
+ * leaves the chains longer */
+static void
+__tspi_growTable(struct memTable *table)
+{
+	struct memEntry **old = table->entries, *entry, *next;
+	UINT32 i, oldBuckets = table->numBuckets, bucket;
 
-	if (tmp->entries == NULL) {
-		tmp->entries = new;
+	if ((table->entries = calloc(oldBuckets * 2, sizeof(struct memEntry *))) == NULL) {
+		table->entries = old;
 		return;
 	}
+	table->numBuckets = oldBuckets * 2;
+
+	for (i = 0; i < oldBuckets; i++) {
+		for (entry = old[i]; entry; entry = next) {
+			next = entry->nextEntry;
+			bucket = __tspi_hashPointer(table, entry->memPointer);
+			entry->nextEntry = table->entries[bucket];
+			table->entries[bucket] = entry;
+		}
+	}
 
-	/* else tack @new onto the end */
-	for (; tmp_entry; tmp_entry = tmp_entry->nextEntry) {
-		if (tmp_entry->nextEntry == NULL) {
-			tmp_entry->nextEntry = new;
-			break;
+	free(old);
+}
+
+/* caller needs to hold the table's lock */
+static void
+__tspi_addEntry(struct memTable *table, struct memEntry *new)
+{
+	UINT32 bucket;
+
+	if (table->numEntries >= 2 * table->numBuckets)
+		__tspi_growTable(table);
+
+	bucket = __tspi_hashPointer(table, new->memPointer);
+	new->nextEntry = table->entries[bucket];
+	table->entries[bucket] = new;
+	table->numEntries++;
+}
+
+/* caller needs to hold the table's lock */
+static void
+__tspi_freeChunk(struct memTable *table, struct memChunk *chunk)
+{
+	if (chunk->prev)
+		chunk->prev->next = chunk->next;
+	else
+		table->chunks = chunk->next;
+	if (chunk->next)
+		chunk->next->prev = chunk->prev;
+
+	free(chunk);
+}
+
+/* Carve @howMuch zeroed bytes plus a memEntry out of the table's current arena chunk,
+ * starting a new chunk if it's full. Caller needs to hold the table's lock */
+static struct memEntry *
+__tspi_chunkAlloc(struct memTable *table, UINT32 howMuch)
+{
+	struct memChunk *chunk = table->chunks;
+	struct memEntry *entry;
+	UINT32 size = MEM_ENTRY_SIZE + MEM_ALIGN_UP(howMuch);
+
+	if (chunk == NULL || chunk->used + size > MEM_CHUNK_SIZE) {
+		if ((chunk = malloc(MEM_CHUNK_HDR_SIZE + MEM_CHUNK_SIZE)) == NULL) {
+			LogError("malloc of %zd bytes failed.", MEM_CHUNK_HDR_SIZE + MEM_CHUNK_SIZE);
+			return NULL;
 		}
+		chunk->used = 0;
+		chunk->live = 0;
+		chunk->prev = NULL;
+		chunk->next = table->chunks;
+		if (table->chunks)
+			table->chunks->prev = chunk;
+		table->chunks = chunk;
+	}
+
+	entry = (struct memEntry *)((BYTE *)chunk + MEM_CHUNK_HDR_SIZE + chunk->used);
+	memset(entry, 0, size);
+	entry->memPointer = (BYTE *)entry + MEM_ENTRY_SIZE;
+	entry->chunk = chunk;
+	entry->type = MEM_ENTRY_CHUNK;
+
+	chunk->used += size;
+	chunk->live++;
+
+	return entry;
+}
+
+/* caller needs to hold the table's lock */
+static void
+__tspi_releaseEntry(struct memTable *table, struct memEntry *entry)
+{
+	struct memChunk *chunk;
+
+	switch (entry->type) {
+		case MEM_ENTRY_CHUNK:
+			chunk = entry->chunk;
+			if (--chunk->live)
+				break;
+
+			/* keep allocating from the current chunk, just start it over */
+			if (chunk == table->chunks)
+				chunk->used = 0;
+			else
+				__tspi_freeChunk(table, chunk);
+			break;
+		case MEM_ENTRY_EXTERNAL:
+			free(entry->memPointer);
+			/* fall through */
+		default:
+			free(entry);
+			break;
 	}
 }
 
-/* caller needs to lock memtable lock */
 TSS_RESULT
 __tspi_freeTable(TSS_HCONTEXT tspContext)
 {
-	struct memTable *prev = NULL, *index = NULL, *next = NULL;
+	struct memTable **pindex, *index = NULL;
 	struct memEntry *entry = NULL, *entry_next = NULL;
+	struct memChunk *chunk, *chunk_next;
+	UINT32 i;
 
-	for(index = SpiMemoryTable; index; index = index->nextTable) {
-		next = index->nextTable;
-		if (index->tspContext == tspContext) {
-			for (entry = index->entries; entry; entry = entry_next) {
-				/* this needs to be set before we do free(entry) */
-				entry_next = entry->nextEntry;
-				free(entry->memPointer);
-				free(entry);
-			}
-
-			if (prev != NULL)
-				prev->nextTable = next;
-			else
-				SpiMemoryTable = NULL;
+	RWLOCK_WRLOCK(memtable_lock);
 
-			free(index);
+	for (pindex = &MEM_TABLE_BUCKET(tspContext); *pindex; pindex = &(*pindex)->nextTable) {
+		if ((*pindex)->tspContext == tspContext) {
+			index = *pindex;
+			*pindex = index->nextTable;
 			break;
 		}
-		prev = index;
 	}
 
+	if (index == NULL) {
+		RWLOCK_UNLOCK(memtable_lock);
+		return TSS_SUCCESS;
+	}
+
+	/* wait for anyone who looked the table up before it was unlinked */
+	MUTEX_LOCK(index->lock);
+	MUTEX_UNLOCK(index->lock);
+	RWLOCK_UNLOCK(memtable_lock);
+
+	for (i = 0; i < index->numBuckets; i++) {
+		for (entry = index->entries[i]; entry; entry = entry_next) {
+			/* this needs to be set before we do free(entry) */
+			entry_next = entry->nextEntry;
+			if (entry->type == MEM_ENTRY_EXTERNAL)
+				free(entry->memPointer);
+			if (entry->type != MEM_ENTRY_CHUNK)
+				free(entry);
+		}
+	}
+
+	for (chunk = index->chunks; chunk; chunk = chunk_next) {
+		chunk_next = chunk->next;
+		free(chunk);
+	}
+
+	free(index->entries);
+	free(index);
+
 	return TSS_SUCCESS;
 }
 
+/* caller needs to hold the table's lock */
 TSS_RESULT
 __tspi_freeEntry(struct memTable *table, void *pointer)
 {
-	struct memEntry *index = NULL;
-	struct memEntry *prev = NULL;
-	struct memEntry *toKill = NULL;
-
-	for (index = table->entries; index; prev = index, index = index->nextEntry) {
-		if (index->memPointer == pointer) {
-			toKill = index;
-			if (prev == NULL)
-				table->entries = toKill->nextEntry;
-			else
-				prev->nextEntry = toKill->nextEntry;
+	struct memEntry **pentry, *toKill;
+
+	for (pentry = &table->entries[__tspi_hashPointer(table, pointer)]; *pentry;
+	     pentry = &(*pentry)->nextEntry) {
+		if ((*pentry)->memPointer == pointer) {
+			toKill = *pentry;
+			*pentry = toKill->nextEntry;
+			table->numEntries--;
 
-			free(pointer);
-			free(toKill);
+			__tspi_releaseEntry(table, toKill);
 			return TSS_SUCCESS;
 		}
 	}
@@ -160,6 +310,7 @@ __tspi_freeEntry(struct memTable *table, void *pointer)
 TSS_RESULT
 __tspi_add_mem_entry(TSS_HCONTEXT tspContext, void *allocd_mem)
 {
+	struct memTable *table;
 	struct memEntry *newEntry = calloc(1, sizeof(struct memEntry));
 	if (newEntry == NULL) {
 		LogError("malloc of %zd bytes failed.", sizeof(struct memEntry));
@@ -167,12 +318,16 @@ __tspi_add_mem_entry(TSS_HCONTEXT tspContext, void *allocd_mem)
 	}
 
 	newEntry->memPointer = allocd_mem;
+	newEntry->type = MEM_ENTRY_EXTERNAL;
 
-	MUTEX_LOCK(memtable_lock);
+	if ((table = getTable(tspContext, TRUE)) == NULL) {
+		free(newEntry);
+		return TSPERR(TSS_E_OUTOFMEMORY);
+	}
 
-	__tspi_addEntry(tspContext, newEntry);
+	__tspi_addEntry(table, newEntry);
 
-	MUTEX_UNLOCK(memtable_lock);
+	putTable(table);
 
 	return TSS_SUCCESS;
 }
@@ -187,39 +342,31 @@ calloc_tspi(TSS_HCONTEXT tspContext, UINT32 howMuch)
 	struct memTable *table = NULL;
 	struct memEntry *newEntry = NULL;
 
-	MUTEX_LOCK(memtable_lock);
+	if ((table = getTable(tspContext, TRUE)) == NULL)
+		return NULL;
 
-	table = getTable(tspContext);
-	if (table == NULL) {
-		if ((table = __tspi_createTable()) == NULL) {
-			MUTEX_UNLOCK(memtable_lock);
+	if (howMuch <= MEM_CHUNK_MAX_ALLOC) {
+		if ((newEntry = __tspi_chunkAlloc(table, howMuch)) == NULL) {
+			putTable(table);
 			return NULL;
 		}
-		table->tspContext = tspContext;
-		__tspi_addTable(table);
-	}
-
-	newEntry = calloc(1, sizeof(struct memEntry));
-	if (newEntry == NULL) {
-		LogError("malloc of %zd bytes failed.", sizeof(struct memEntry));
-		MUTEX_UNLOCK(memtable_lock);
-		return NULL;
-	}
-
-	newEntry->memPointer = calloc(1, howMuch);
-	if (newEntry->memPointer == NULL) {
-		LogError("malloc of %d bytes failed.", howMuch);
-		free(newEntry);
-		MUTEX_UNLOCK(memtable_lock);
-		return NULL;
+	} else {
+		newEntry = calloc(1, MEM_ENTRY_SIZE + howMuch);
+		if (newEntry == NULL) {
+			LogError("malloc of %zd bytes failed.", MEM_ENTRY_SIZE + howMuch);
+			putTable(table);
+			return NULL;
+		}
+		newEntry->memPointer = (BYTE *)newEntry + MEM_ENTRY_SIZE;
+		newEntry->type = MEM_ENTRY_BLOCK;
 	}
 
-	/* this call must happen inside the lock or else another thread could
+	/* this call must happen with the table locked or else another thread could
 	 * remove the context mem slot, causing a segfault
 	 */
-	__tspi_addEntry(tspContext, newEntry);
+	__tspi_addEntry(table, newEntry);
 
-	MUTEX_UNLOCK(memtable_lock);
+	putTable(table);
 
 	return newEntry->memPointer;
 }
@@ -234,16 +381,10 @@ free_tspi(TSS_HCONTEXT tspContext, void *memPointer)
 	struct memTable *index;
 	TSS_RESULT result;
 
-	MUTEX_LOCK(memtable_lock);
-
-	if (memPointer == NULL) {
-		result = __tspi_freeTable(tspContext);
-		MUTEX_UNLOCK(memtable_lock);
-		return result;
-	}
+	if (memPointer == NULL)
+		return __tspi_freeTable(tspContext);
 
-	if ((index = getTable(tspContext)) == NULL) {
-		MUTEX_UNLOCK(memtable_lock);
+	if ((index = getTable(tspContext, FALSE)) == NULL) {
 		/* Tspi_Context_FreeMemory checks that the TSP context is good before calling us,
 		 * so we can be sure that the problem is with memPointer */
 		return TSPERR(TSS_E_INVALID_RESOURCE);
@@ -252,7 +393,7 @@ free_tspi(TSS_HCONTEXT tspContext, void *memPointer)
 	/* just free one entry */
 	result = __tspi_freeEntry(index, memPointer);
 
-	MUTEX_UNLOCK(memtable_lock);
+	putTable(index);
 
 	return result;
 }
@@ -20,8 +20,82 @@
 #include "capabilities.h"
 #include "tsplog.h"
 #include "obj.h"
+#include "threads.h"
 
 
+/* Fewest payloads worth handing to a thread of their own in Tspi_Data_BindBulk */
+#define BIND_BULK_MIN_PER_THREAD	16
+/* largest encrypted blob, for a 2048 bit key */
+#define BIND_ENCDATA_SIZE		256
+
+/* what binding needs from the key object, fetched once per call */
+struct bind_key {
+	Trspi_RSAPubKey pubKey;
+	TPM_KEY_USAGE keyUsage;
+	TPM_ENC_SCHEME encScheme;
+	UINT32 keyLength;
+};
+
+static TSS_RESULT
+bind_key_get(TSS_HKEY hEncKey, struct bind_key *key)
+{
+	TSS_RESULT result;
+
+	if ((result = obj_rsakey_get_pub_handle(hEncKey, &key->pubKey, &key->keyUsage,
+						&key->encScheme, &key->keyLength)))
+		return result;
+
+	if (key->keyUsage != TPM_KEY_BIND &&
+	    key->keyUsage != TPM_KEY_LEGACY) {
+		Trspi_RSA_PubKeyFree(&key->pubKey);
+		return TSPERR(TSS_E_INVALID_KEYUSAGE);
+	}
+
+	/* the encrypted blob is as long as the modulus */
+	if (key->keyLength > BIND_ENCDATA_SIZE) {
+		Trspi_RSA_PubKeyFree(&key->pubKey);
+		return TSPERR(TSS_E_ENC_INVALID_LENGTH);
+	}
+
+	return TSS_SUCCESS;
+}
+
+/* encrypt one payload into encData, which holds BIND_ENCDATA_SIZE bytes */
+static TSS_RESULT
+bind_data(struct bind_key *key, UINT32 ulDataLength, BYTE *rgbDataToBind,
+	  UINT32 *encDataLength, BYTE *encData)
+{
+	TCPA_BOUND_DATA boundData;
+	UINT64 offset;
+	BYTE bdblob[256];
+
+	if (key->keyLength < ulDataLength)
+		return TSPERR(TSS_E_ENC_INVALID_LENGTH);
+
+	if (key->encScheme == TCPA_ES_RSAESPKCSv15 &&
+	    key->keyUsage == TPM_KEY_LEGACY)
+		return Trspi_RSA_PubKey_PKCS15_Encrypt(&key->pubKey, ulDataLength, rgbDataToBind,
+						       encDataLength, encData);
+
+	/* the payload is only read while it's marshalled */
+	boundData.payload = TCPA_PT_BIND;
+	memcpy(&boundData.ver, &VERSION_1_1, sizeof(TCPA_VERSION));
+	boundData.payloadData = rgbDataToBind;
+
+	/* version and payload type come before the payload */
+	if (ulDataLength > sizeof(bdblob) - sizeof(TCPA_VERSION) - 1)
+		return TSPERR(TSS_E_ENC_INVALID_LENGTH);
+
+	offset = 0;
+	Trspi_LoadBlob_BOUND_DATA(&offset, boundData, ulDataLength, bdblob);
+
+	if (key->encScheme == TCPA_ES_RSAESPKCSv15)
+		return Trspi_RSA_PubKey_PKCS15_Encrypt(&key->pubKey, offset, bdblob,
+						       encDataLength, encData);
+
+	return Trspi_RSA_PubKey_Encrypt(&key->pubKey, offset, bdblob, encDataLength, encData);
+}
+
 TSS_RESULT
 Tspi_Data_Bind(TSS_HENCDATA hEncData,	/* in */
 	       TSS_HKEY hEncKey,	/* in */
@@ -29,15 +103,9 @@ Tspi_Data_Bind(TSS_HENCDATA hEncData,	/* in */
 	       BYTE *rgbDataToBind)	/* in */
 {
 	UINT32 encDataLength;
-	BYTE encData[256];
-	BYTE *keyData;
-	UINT32 keyDataLength;
-	TCPA_BOUND_DATA boundData;
-	UINT64 offset;
-	BYTE bdblob[256];
+	BYTE encData[BIND_ENCDATA_SIZE];
 	TCPA_RESULT result;
-	TSS_KEY keyContainer;
-	TSS_HCONTEXT tspContext;
+	struct bind_key key;
 
 	if (rgbDataToBind == NULL)
 		return TSPERR(TSS_E_BAD_PARAMETER);
@@ -45,93 +113,108 @@ Tspi_Data_Bind(TSS_HENCDATA hEncData,	/* in */
 	if (!obj_is_encdata(hEncData))
 		return TSPERR(TSS_E_INVALID_HANDLE);
 
-	if ((result = obj_rsakey_get_tsp_context(hEncKey, &tspContext)))
-		return result;
-
-	/* XXX Just get the pubkey here */
-	if ((result = obj_rsakey_get_blob(hEncKey, &keyDataLength, &keyData)))
-		return result;
-
-	offset = 0;
-	if ((result = UnloadBlob_TSS_KEY(&offset, keyData, &keyContainer))) {
-		free_tspi(tspContext, keyData);
+	if ((result = bind_key_get(hEncKey, &key)))
 		return result;
-	}
-	free_tspi(tspContext, keyData);
 
-	if (keyContainer.keyUsage != TPM_KEY_BIND &&
-	    keyContainer.keyUsage != TPM_KEY_LEGACY) {
-		result = TSPERR(TSS_E_INVALID_KEYUSAGE);
+	if ((result = bind_data(&key, ulDataLength, rgbDataToBind, &encDataLength, encData)))
 		goto done;
-	}
 
-	if (keyContainer.pubKey.keyLength < ulDataLength) {
-		result = TSPERR(TSS_E_ENC_INVALID_LENGTH);
+	if ((result = obj_encdata_set_data(hEncData, encDataLength, encData))) {
+		LogError("Error in calling SetAttribData on the encrypted data object.");
+		result = TSPERR(TSS_E_INTERNAL_ERROR);
 		goto done;
 	}
+done:
+	Trspi_RSA_PubKeyFree(&key.pubKey);
+	return result;
+}
 
-	if (keyContainer.algorithmParms.encScheme == TCPA_ES_RSAESPKCSv15 &&
-	    keyContainer.keyUsage == TPM_KEY_LEGACY) {
-		if ((result = Trspi_RSA_PKCS15_Encrypt(rgbDataToBind, ulDataLength, encData,
-						       &encDataLength, keyContainer.pubKey.key,
-						       keyContainer.pubKey.keyLength)))
-			goto done;
-	} else if (keyContainer.algorithmParms.encScheme == TCPA_ES_RSAESPKCSv15 &&
-		   keyContainer.keyUsage == TPM_KEY_BIND) {
-		boundData.payload = TCPA_PT_BIND;
-
-		memcpy(&boundData.ver, &VERSION_1_1, sizeof(TCPA_VERSION));
-
-		boundData.payloadData = malloc(ulDataLength);
-		if (boundData.payloadData == NULL) {
-			result = TSPERR(TSS_E_OUTOFMEMORY);
-			goto done;
-		}
-		memcpy(boundData.payloadData, rgbDataToBind, ulDataLength);
+struct bind_bulk {
+	struct bind_key *key;
+	UINT32 ulCount;
+	UINT32 *pulDataLength;
+	BYTE **prgbDataToBind;
+	UINT32 *encDataLength;
+	BYTE *encData;		/* ulCount slots of BIND_ENCDATA_SIZE bytes */
+	TSS_RESULT *results;
+};
+
+static void
+bind_bulk_share(void *arg, unsigned int first, unsigned int stride)
+{
+	struct bind_bulk *bulk = (struct bind_bulk *)arg;
+	UINT32 i;
 
-		offset = 0;
-		Trspi_LoadBlob_BOUND_DATA(&offset, boundData, ulDataLength, bdblob);
+	for (i = first; i < bulk->ulCount; i += stride)
+		bulk->results[i] = bind_data(bulk->key, bulk->pulDataLength[i],
+					     bulk->prgbDataToBind[i], &bulk->encDataLength[i],
+					     &bulk->encData[i * BIND_ENCDATA_SIZE]);
+}
 
-		if ((result = Trspi_RSA_PKCS15_Encrypt(bdblob, offset, encData,
-						       &encDataLength, keyContainer.pubKey.key,
-						       keyContainer.pubKey.keyLength))) {
-			free(boundData.payloadData);
-			goto done;
-		}
-		free(boundData.payloadData);
-	} else {
-		boundData.payload = TCPA_PT_BIND;
+/* Bind each of ulCount payloads to hEncKey, leaving the result in the matching data object.
+ * The key object is read once and the RSA operations are spread over the online processors.
+ * Every payload is attempted; on error the data objects of the payloads that failed are left
+ * alone and the result of the first failure is returned. */
+TSS_RESULT
+Tspi_Data_BindBulk(TSS_HKEY hEncKey,		/* in */
+		   UINT32 ulCount,		/* in */
+		   TSS_HENCDATA *phEncData,	/* in */
+		   UINT32 *pulDataLength,	/* in */
+		   BYTE **prgbDataToBind)	/* in */
+{
+	TSS_RESULT result;
+	struct bind_key key;
+	struct bind_bulk bulk;
+	UINT32 i;
 
-		memcpy(&boundData.ver, &VERSION_1_1, sizeof(TCPA_VERSION));
+	if (ulCount == 0)
+		return TSS_SUCCESS;
 
-		boundData.payloadData = malloc(ulDataLength);
-		if (boundData.payloadData == NULL) {
-			LogError("malloc of %u bytes failed.", ulDataLength);
-			result = TSPERR(TSS_E_OUTOFMEMORY);
-			goto done;
-		}
-		memcpy(boundData.payloadData, rgbDataToBind, ulDataLength);
+	if (phEncData == NULL || pulDataLength == NULL || prgbDataToBind == NULL)
+		return TSPERR(TSS_E_BAD_PARAMETER);
 
-		offset = 0;
-		Trspi_LoadBlob_BOUND_DATA(&offset, boundData, ulDataLength, bdblob);
+	for (i = 0; i < ulCount; i++) {
+		if (prgbDataToBind[i] == NULL)
+			return TSPERR(TSS_E_BAD_PARAMETER);
+		if (!obj_is_encdata(phEncData[i]))
+			return TSPERR(TSS_E_INVALID_HANDLE);
+	}
 
-		if ((result = Trspi_RSA_Encrypt(bdblob, offset, encData, &encDataLength,
-						keyContainer.pubKey.key,
-						keyContainer.pubKey.keyLength))) {
-			free(boundData.payloadData);
-			goto done;
-		}
+	if ((result = bind_key_get(hEncKey, &key)))
+		return result;
 
-		free(boundData.payloadData);
+	bulk.key = &key;
+	bulk.ulCount = ulCount;
+	bulk.pulDataLength = pulDataLength;
+	bulk.prgbDataToBind = prgbDataToBind;
+	bulk.encDataLength = calloc(ulCount, sizeof(UINT32));
+	bulk.encData = malloc((size_t)ulCount * BIND_ENCDATA_SIZE);
+	bulk.results = calloc(ulCount, sizeof(TSS_RESULT));
+	if (bulk.encDataLength == NULL || bulk.encData == NULL || bulk.results == NULL) {
+		LogError("malloc of %zu bytes failed.",
+			 (size_t)ulCount * (BIND_ENCDATA_SIZE + sizeof(UINT32) + sizeof(TSS_RESULT)));
+		result = TSPERR(TSS_E_OUTOFMEMORY);
+		goto done;
 	}
 
-	if ((result = obj_encdata_set_data(hEncData, encDataLength, encData))) {
-		LogError("Error in calling SetAttribData on the encrypted data object.");
-		result = TSPERR(TSS_E_INTERNAL_ERROR);
-		goto done;
+	run_shares(bind_bulk_share, &bulk, ulCount, BIND_BULK_MIN_PER_THREAD);
+
+	result = TSS_SUCCESS;
+	for (i = 0; i < ulCount; i++) {
+		if (bulk.results[i] == TSS_SUCCESS &&
+		    obj_encdata_set_data(phEncData[i], bulk.encDataLength[i],
+					 &bulk.encData[i * BIND_ENCDATA_SIZE])) {
+			LogError("Error in calling SetAttribData on the encrypted data object.");
+			bulk.results[i] = TSPERR(TSS_E_INTERNAL_ERROR);
+		}
+		if (result == TSS_SUCCESS)
+			result = bulk.results[i];
 	}
 done:
-	free_key_refs(&keyContainer);
+	free(bulk.encDataLength);
+	free(bulk.encData);
+	free(bulk.results);
+	Trspi_RSA_PubKeyFree(&key.pubKey);
 	return result;
 }
 
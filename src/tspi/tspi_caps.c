@@ -74,6 +74,7 @@ Tspi_Context_GetCapability(TSS_HCONTEXT tspContext,	/* in */
 		case TSS_TCSCAP_MANUFACTURER:
 		case TSS_TCSCAP_TRANSPORT:
 		case TSS_TCSCAP_PLATFORM_CLASS:
+		case TSS_TCSCAP_TROUSERS_STATS:
 			result = RPC_GetCapability(tspContext, capArea, ulSubCapLength, rgbSubCap,
 						   pulRespDataLength, prgbRespData);
 			break;
@@ -489,6 +489,56 @@ Tspi_DAA_VerifySignature(TSS_HDAA           hDAA,		// in
 }
 
 
+/**
+This function is part of the DAA Verifier component. It does what Tspi_DAA_VerifySignature
+does for signaturesLength signatures made under the same issuer key and base name, entry i of
+daaSignatures, signData, attributes, nonceVerifierLength and nonceVerifier belonging to
+signature i. isCorrect[i] tells whether signature i is correct. The issuer key is converted
+and the base name's zeta computed once for all signatures, which makes it cheaper than
+verifying the signatures one by one.
+This is an optional function and does not require a TPM or a TCS.
+*/
+TSPICALL
+Tspi_DAA_VerifySignatures(TSS_HDAA           hDAA,		// in
+			  UINT32             signaturesLength,	// in
+			  TSS_DAA_SIGNATURE* daaSignatures,	// in
+			  TSS_HKEY           hPubKeyIssuer,	// in (TSS_DAA_PK)
+			  TSS_DAA_SIGN_DATA* signData,		// in
+			  UINT32             attributesLength,	// in
+			  BYTE***            attributes,	// in
+			  UINT32*            nonceVerifierLength,// in
+			  BYTE**             nonceVerifier,	// in
+			  UINT32             baseNameLength,	// in
+			  BYTE*              baseName,		// in
+			  TSS_BOOL*          isCorrect)		// out
+{
+	TSS_RESULT result;
+#ifdef TSS_DEBUG
+	int before = mallinfo().uordblks;
+#endif
+
+	LogDebug("Tspi_DAA_VerifySignatures hDAA=%d signatures=%u", (int)hDAA,
+		 signaturesLength);
+	result = Tspi_DAA_VerifySignatures_internal( hDAA,
+						signaturesLength,
+						daaSignatures,
+						hPubKeyIssuer,
+						signData,
+						attributesLength,
+						attributes,
+						nonceVerifierLength,
+						nonceVerifier,
+						baseNameLength,
+						baseName,
+						isCorrect);
+	bi_flush_memory();
+#ifdef TSS_DEBUG
+	LogDebug("Tspi_DAA_VerifySignatures ALLOC DELTA:%d", mallinfo().uordblks-before);
+#endif
+	return result;
+}
+
+
 /**
 This function is part of the DAA Issuer component. It is the last function out of 2 in
 order to issue a DAA Credential for a TCG Platform. It detects rogue TPM according
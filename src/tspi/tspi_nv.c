@@ -132,10 +132,12 @@ Tspi_NV_DefineSpace(TSS_HNVSTORE hNvstore,	/* in */
 	if ((result = authsess_xsap_hmac(xsap, &digest)))
 		goto error;
 
-	if ((result = TCS_API(tspContext)->NV_DefineOrReleaseSpace(tspContext, NVPublic_DataSize,
-								   NVPublicData, xsap->encAuthUse,
-								   xsap->pAuth)))
-			goto error;
+	result = TCS_API(tspContext)->NV_DefineOrReleaseSpace(tspContext, NVPublic_DataSize,
+							      NVPublicData, xsap->encAuthUse,
+							      xsap->pAuth);
+	obj_nvstore_invalidate_datapublic(nv_data_public.nvIndex);
+	if (result)
+		goto error;
 
 	result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 	result |= Trspi_Hash_UINT32(&hashCtx, TPM_SUCCESS);
@@ -240,9 +242,11 @@ Tspi_NV_ReleaseSpace(TSS_HNVSTORE hNvstore)	/* in */
 	if ((result = authsess_xsap_hmac(xsap, &digest)))
 		goto error;
 
-	if ((result = TCS_API(tspContext)->NV_DefineOrReleaseSpace(tspContext, NVPublic_DataSize,
-								   NVPublicData, xsap->encAuthUse,
-								   xsap->pAuth)))
+	result = TCS_API(tspContext)->NV_DefineOrReleaseSpace(tspContext, NVPublic_DataSize,
+							      NVPublicData, xsap->encAuthUse,
+							      xsap->pAuth);
+	obj_nvstore_invalidate_datapublic(nv_data_public.nvIndex);
+	if (result)
 		goto error;
 
 	result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
@@ -321,8 +325,11 @@ Tspi_NV_WriteValue(TSS_HNVSTORE hNvstore,	/* in */
 				if ((result = TCS_API(tspContext)->NV_WriteValue(tspContext,
 									nv_data_public.nvIndex,
 									offset, ulDataLength,
-									rgbDataToWrite, &auth)))
+									rgbDataToWrite, &auth))) {
+					/* the permissions used may be stale */
+					obj_nvstore_invalidate_datapublic(nv_data_public.nvIndex);
 					return result;
+				}
 
 				result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 				result |= Trspi_Hash_UINT32(&hashCtx, result);
@@ -353,8 +360,11 @@ Tspi_NV_WriteValue(TSS_HNVSTORE hNvstore,	/* in */
 				if ((result = TCS_API(tspContext)->NV_WriteValueAuth(tspContext,
 									nv_data_public.nvIndex,
 									offset, ulDataLength,
-									rgbDataToWrite, &auth)))
+									rgbDataToWrite, &auth))) {
+					/* the permissions used may be stale */
+					obj_nvstore_invalidate_datapublic(nv_data_public.nvIndex);
 					return result;
+				}
 
 				result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 				result |= Trspi_Hash_UINT32(&hashCtx, result);
@@ -370,8 +380,11 @@ Tspi_NV_WriteValue(TSS_HNVSTORE hNvstore,	/* in */
 			if ((result = TCS_API(tspContext)->NV_WriteValue(tspContext,
 									 nv_data_public.nvIndex,
 									 offset, ulDataLength,
-									 rgbDataToWrite, NULL)))
+									 rgbDataToWrite, NULL))) {
+				/* the permissions used may be stale */
+				obj_nvstore_invalidate_datapublic(nv_data_public.nvIndex);
 				return result;
+			}
 		}
 	} else {
 		LogDebug("no policy, so noauthentication");
@@ -447,8 +460,11 @@ Tspi_NV_ReadValue(TSS_HNVSTORE hNvstore,	/* in */
 				if ((result = TCS_API(tspContext)->NV_ReadValue(tspContext,
 									nv_data_public.nvIndex,
 									offset, ulDataLength,
-									&auth, rgbDataRead)))
+									&auth, rgbDataRead))) {
+					/* the permissions used may be stale */
+					obj_nvstore_invalidate_datapublic(nv_data_public.nvIndex);
 					return result;
+				}
 
 				result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 				result |= Trspi_Hash_UINT32(&hashCtx, TSS_SUCCESS);
@@ -480,8 +496,11 @@ Tspi_NV_ReadValue(TSS_HNVSTORE hNvstore,	/* in */
 				if ((result = TCS_API(tspContext)->NV_ReadValueAuth(tspContext,
 									nv_data_public.nvIndex,
 									offset, ulDataLength,
-									&auth, rgbDataRead)))
+									&auth, rgbDataRead))) {
+					/* the permissions used may be stale */
+					obj_nvstore_invalidate_datapublic(nv_data_public.nvIndex);
 					return result;
+				}
 
 				result = Trspi_HashInit(&hashCtx, TSS_HASH_SHA1);
 				result |= Trspi_Hash_UINT32(&hashCtx, TSS_SUCCESS);
@@ -499,8 +518,11 @@ Tspi_NV_ReadValue(TSS_HNVSTORE hNvstore,	/* in */
 			if ((result = TCS_API(tspContext)->NV_ReadValue(tspContext,
 									nv_data_public.nvIndex,
 									offset, ulDataLength, NULL,
-									rgbDataRead)))
+									rgbDataRead))) {
+				/* the permissions used may be stale */
+				obj_nvstore_invalidate_datapublic(nv_data_public.nvIndex);
 				return result;
+			}
 		}
 	} else {
 		if ((result = TCS_API(tspContext)->NV_ReadValue(tspContext, nv_data_public.nvIndex,
@@ -60,7 +60,13 @@ Tspi_Context_LoadKeyByUUID(TSS_HCONTEXT tspContext,		/* in */
 #if 1
 		__tspi_memset(&info, 0, sizeof(TCS_LOADKEY_INFO));
 
-		result = RPC_LoadKeyByUUID(tspContext, uuidData, &info, &tcsKeyHandle);
+		/* owner evict keys have no blob in system PS. For the rest, fetch the blob in
+		 * the same round trip as the load */
+		if (memcmp(&uuidData, &owner_evict_uuid, sizeof(TSS_UUID)-1))
+			result = RPC_LoadKeyByUUIDAndBlob(tspContext, uuidData, &info,
+							  &tcsKeyHandle, &keyBlobSize, &keyBlob);
+		else
+			result = RPC_LoadKeyByUUID(tspContext, uuidData, &info, &tcsKeyHandle);
 
 		if (TSS_ERROR_CODE(result) == TCS_E_KM_LOADFAILED) {
 			TSS_HKEY keyHandle;
@@ -78,24 +84,24 @@ Tspi_Context_LoadKeyByUUID(TSS_HCONTEXT tspContext,		/* in */
 					result = RPC_LoadKeyByUUID(tspContext, uuidData,
 								   &info, &tcsKeyHandle);
 					if (result)
-						return result;
+						goto done;
 					goto cont;
 				}
 			}
 
 			if (obj_rsakey_get_policy(keyHandle, TSS_POLICY_USAGE,
 						  &hPolicy, NULL))
-				return result;
+				goto done;
 
 			if (secret_PerformAuth_OIAP(keyHandle, ordinal, hPolicy, FALSE,
 						    &info.paramDigest, &info.authData))
-				return result;
+				goto done;
 
 			if ((result = RPC_LoadKeyByUUID(tspContext, uuidData, &info,
 							&tcsKeyHandle)))
-				return result;
+				goto done;
 		} else if (result)
-			return result;
+			goto done;
 
 cont:
 		/*check if provided UUID has an owner evict key UUID prefix */
@@ -117,20 +123,16 @@ cont:
 			if (result != TSS_SUCCESS)
 				return result;
 		} else {
-			if ((result = RPC_GetRegisteredKeyBlob(tspContext, uuidData, &keyBlobSize,
-							       &keyBlob)))
-				return result;
-
 			if ((result = obj_rsakey_add_by_key(tspContext, &uuidData, keyBlob,
-							    TSS_OBJ_FLAG_SYSTEM_PS, phKey))) {
-				free (keyBlob);
-				return result;
-			}
-	
-			result = obj_rsakey_set_tcs_handle(*phKey, tcsKeyHandle);
+							    TSS_OBJ_FLAG_SYSTEM_PS, phKey)))
+				goto done;
 
-			free (keyBlob);
+			result = obj_rsakey_set_tcs_handle(*phKey, tcsKeyHandle);
 		}
+done:
+		free(keyBlob);
+		if (result)
+			return result;
 #else
 		if ((result = load_from_system_ps(tspContext, &uuidData, phKey)))
 			return result;
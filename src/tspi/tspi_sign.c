@@ -107,7 +107,7 @@ Tspi_Hash_VerifySignature(TSS_HHASH hHash,		/* in */
 			  BYTE * rgbSignature)		/* in */
 {
 	TCPA_RESULT result;
-	BYTE *pubKey = NULL;
+	Trspi_RSAPubKey pubKey;
 	UINT32 pubKeySize;
 	BYTE *hashData = NULL;
 	UINT32 hashDataSize;
@@ -120,30 +120,28 @@ Tspi_Hash_VerifySignature(TSS_HHASH hHash,		/* in */
 	if ((result = obj_rsakey_get_tsp_context(hKey, &tspContext)))
 		return result;
 
-	if ((result = obj_rsakey_get_modulus(hKey, &pubKeySize, &pubKey)))
+	if ((result = obj_rsakey_get_ss(hKey, &sigScheme)))
 		return result;
 
-	if ((result = obj_rsakey_get_ss(hKey, &sigScheme))) {
-		free_tspi(tspContext, pubKey);
+	if ((result = obj_rsakey_get_pub_handle(hKey, &pubKey, NULL, NULL, &pubKeySize)))
 		return result;
-	}
 
 	if ((result = obj_hash_get_value(hHash, &hashDataSize, &hashData))) {
-		free_tspi(tspContext, pubKey);
+		Trspi_RSA_PubKeyFree(&pubKey);
 		return result;
 	}
 
 	if (sigScheme == TSS_SS_RSASSAPKCS1V15_SHA1) {
-		result = Trspi_Verify(TSS_HASH_SHA1, hashData, hashDataSize, pubKey, pubKeySize,
-				      rgbSignature, ulSignatureLength);
+		result = Trspi_RSA_PubKey_Verify(&pubKey, TSS_HASH_SHA1, hashDataSize, hashData,
+						 ulSignatureLength, rgbSignature);
 	} else if (sigScheme == TSS_SS_RSASSAPKCS1V15_DER) {
-		result = Trspi_Verify(TSS_HASH_OTHER, hashData, hashDataSize, pubKey, pubKeySize,
-				      rgbSignature, ulSignatureLength);
+		result = Trspi_RSA_PubKey_Verify(&pubKey, TSS_HASH_OTHER, hashDataSize, hashData,
+						 ulSignatureLength, rgbSignature);
 	} else {
 		result = TSPERR(TSS_E_INVALID_SIGSCHEME);
 	}
 
-	free_tspi(tspContext, pubKey);
+	Trspi_RSA_PubKeyFree(&pubKey);
 	free_tspi(tspContext, hashData);
 
 	return result;